@@ -0,0 +1,4 @@
+# The native crash record parser sets these fields by name over JNI (crash_record_jni.h)
+-keepclassmembers class com.crashreporter.library.NativeCrashHandler$NativeCrashReport {
+    <fields>;
+}
@@ -0,0 +1,270 @@
+/**
+ * Bulk hex and base64 encoding
+ *
+ * Encoders for memory dumps and other byte runs that end up in crash
+ * reports. Each has a scalar version and vector versions for NEON (arm,
+ * arm64), SSE2/SSSE3 and AVX2 (x86, x86_64). The vector versions encode
+ * whole blocks and return how many input bytes they consumed;
+ * hex_encode() and base64_encode() run the widest one available and finish
+ * the tail with the scalar code.
+ *
+ * The baseline is picked at compile time (the Android x86 and x86_64 ABIs
+ * guarantee SSSE3, arm64 has NEON, armeabi-v7a is built with NEON); AVX2
+ * is used when the CPU reports it at run time. __builtin_cpu_supports()
+ * only reads a table filled in when the library is loaded, so, like the
+ * rest of this file, it is safe to call from a signal handler.
+ *
+ * Hex is lowercase, two characters per byte. Base64 is RFC 4648 with '='
+ * padding. Neither writes a terminating NUL.
+ */
+
+#ifndef CRASHREPORTER_BYTE_ENCODING_H
+#define CRASHREPORTER_BYTE_ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BYTE_ENCODING_AVX2 1
+#endif
+
+static const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static inline size_t base64_encoded_length(size_t length) {
+    return (length + 2) / 3 * 4;
+}
+
+// ---- Scalar ----
+
+static inline void hex_encode_scalar(char* out, const uint8_t* in, size_t length) {
+    static const char kHex[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        out[2 * i] = kHex[in[i] >> 4];
+        out[2 * i + 1] = kHex[in[i] & 0xf];
+    }
+}
+
+// Returns the encoded length, padding included
+static inline size_t base64_encode_scalar(char* out, const uint8_t* in, size_t length) {
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        uint32_t group = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+        out[written++] = kBase64Alphabet[group >> 18];
+        out[written++] = kBase64Alphabet[(group >> 12) & 0x3f];
+        out[written++] = kBase64Alphabet[(group >> 6) & 0x3f];
+        out[written++] = kBase64Alphabet[group & 0x3f];
+    }
+    if (i < length) {
+        uint32_t group = (uint32_t)in[i] << 16 | (i + 1 < length ? (uint32_t)in[i + 1] << 8 : 0);
+        out[written++] = kBase64Alphabet[group >> 18];
+        out[written++] = kBase64Alphabet[(group >> 12) & 0x3f];
+        out[written++] = i + 1 < length ? kBase64Alphabet[(group >> 6) & 0x3f] : '=';
+        out[written++] = '=';
+    }
+    return written;
+}
+
+// ---- NEON: 16 bytes per hex block, 48 per base64 block ----
+
+#if defined(__ARM_NEON)
+
+static inline uint8x16_t hex_digits_neon(uint8x16_t nibbles) {
+    uint8x16_t letters = vandq_u8(vcgtq_u8(nibbles, vdupq_n_u8(9)), vdupq_n_u8('a' - '0' - 10));
+    return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')), letters);
+}
+
+static inline size_t hex_encode_neon(char* out, const uint8_t* in, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t bytes = vld1q_u8(in + i);
+        uint8x16x2_t digits;
+        digits.val[0] = hex_digits_neon(vshrq_n_u8(bytes, 4));
+        digits.val[1] = hex_digits_neon(vandq_u8(bytes, vdupq_n_u8(0x0f)));
+        vst2q_u8((uint8_t*)out + 2 * i, digits);
+    }
+    return i;
+}
+
+// Six-bit indices to the alphabet by adding the offset of their range, so
+// that armeabi-v7a (which has no 64-byte table lookup) takes the same path
+static inline uint8x16_t base64_chars_neon(uint8x16_t indices) {
+    uint8x16_t offset = vdupq_n_u8('A');
+    offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(26)), vdupq_n_u8('a' - 26 - 'A')));
+    offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(52)), vdupq_n_u8((uint8_t)('0' - 52 - ('a' - 26)))));
+    offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(62)), vdupq_n_u8((uint8_t)('+' - 62 - ('0' - 52)))));
+    offset = vaddq_u8(offset, vandq_u8(vcgeq_u8(indices, vdupq_n_u8(63)), vdupq_n_u8((uint8_t)('/' - 63 - ('+' - 62)))));
+    return vaddq_u8(indices, offset);
+}
+
+static inline size_t base64_encode_neon(char* out, const uint8_t* in, size_t length) {
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    size_t i = 0;
+    for (; i + 48 <= length; i += 48) {
+        uint8x16x3_t bytes = vld3q_u8(in + i);
+        uint8x16x4_t chars;
+        chars.val[0] = base64_chars_neon(vshrq_n_u8(bytes.val[0], 2));
+        chars.val[1] = base64_chars_neon(
+            vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)), mask));
+        chars.val[2] = base64_chars_neon(
+            vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)), mask));
+        chars.val[3] = base64_chars_neon(vandq_u8(bytes.val[2], mask));
+        vst4q_u8((uint8_t*)out + i / 3 * 4, chars);
+    }
+    return i;
+}
+
+#endif // __ARM_NEON
+
+// ---- SSE2 hex and SSSE3 base64: 16 bytes per hex block, 12 per base64 block ----
+
+#if defined(__SSE2__)
+
+static inline __m128i hex_digits_sse2(__m128i nibbles) {
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+static inline size_t hex_encode_sse2(char* out, const uint8_t* in, size_t length) {
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i high = hex_digits_sse2(_mm_and_si128(_mm_srli_epi16(bytes, 4), low_mask));
+        __m128i low = hex_digits_sse2(_mm_and_si128(bytes, low_mask));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return i;
+}
+
+#endif // __SSE2__
+
+#if defined(__SSSE3__)
+
+// Twelve input bytes (of the 16 loaded) to sixteen characters
+// (W. Mula, D. Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions")
+static inline __m128i base64_chars_ssse3(__m128i bytes) {
+    bytes = _mm_shuffle_epi8(bytes, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    __m128i high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    __m128i indices = _mm_or_si128(high, low);
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+    __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+}
+
+static inline size_t base64_encode_ssse3(char* out, const uint8_t* in, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 12) {
+        __m128i chars = base64_chars_ssse3(_mm_loadu_si128((const __m128i*)(in + i)));
+        _mm_storeu_si128((__m128i*)(out + i / 3 * 4), chars);
+    }
+    return i;
+}
+
+#endif // __SSSE3__
+
+// ---- AVX2, when the CPU has it: 32 bytes per hex block, 24 per base64 block ----
+
+#if defined(BYTE_ENCODING_AVX2)
+
+static inline bool byte_encoding_has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static inline size_t hex_encode_avx2(char* out, const uint8_t* in, size_t length) {
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e',
+                                            'f', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd',
+                                            'e', 'f');
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_mask));
+        __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(bytes, low_mask));
+        // Unpacking works within 128-bit lanes: bytes 0-7 and 16-23, then 8-15 and 24-31
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256((__m256i*)(out + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+// base64_chars_ssse3() on both lanes, twelve input bytes in each
+__attribute__((target("avx2")))
+static inline size_t base64_encode_avx2(char* out, const uint8_t* in, size_t length) {
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    for (; i + 28 <= length; i += 24) {
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(in + i))),
+                                                _mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+        bytes = _mm256_shuffle_epi8(bytes, shuffle);
+        __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)),
+                                          _mm256_set1_epi32(0x04000040));
+        __m256i low = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)),
+                                         _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(high, low);
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices),
+                                                        _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+        _mm256_storeu_si256((__m256i*)(out + i / 3 * 4), chars);
+    }
+    return i;
+}
+
+#endif // BYTE_ENCODING_AVX2
+
+// ---- Dispatch ----
+
+// Writes 2 * length characters; returns that count
+static inline size_t hex_encode(char* out, const void* data, size_t length) {
+    const uint8_t* in = (const uint8_t*)data;
+    size_t done = 0;
+#if defined(BYTE_ENCODING_AVX2)
+    if (length >= 32 && byte_encoding_has_avx2()) {
+        done = hex_encode_avx2(out, in, length);
+    }
+#endif
+#if defined(__ARM_NEON)
+    done += hex_encode_neon(out + 2 * done, in + done, length - done);
+#elif defined(__SSE2__)
+    done += hex_encode_sse2(out + 2 * done, in + done, length - done);
+#endif
+    hex_encode_scalar(out + 2 * done, in + done, length - done);
+    return 2 * length;
+}
+
+// Writes base64_encoded_length(length) characters; returns that count
+static inline size_t base64_encode(char* out, const void* data, size_t length) {
+    const uint8_t* in = (const uint8_t*)data;
+    size_t done = 0;
+#if defined(BYTE_ENCODING_AVX2)
+    if (length >= 28 && byte_encoding_has_avx2()) {
+        done = base64_encode_avx2(out, in, length);
+    }
+#endif
+#if defined(__ARM_NEON)
+    done += base64_encode_neon(out + done / 3 * 4, in + done, length - done);
+#elif defined(__SSSE3__)
+    done += base64_encode_ssse3(out + done / 3 * 4, in + done, length - done);
+#endif
+    return done / 3 * 4 + base64_encode_scalar(out + done / 3 * 4, in + done, length - done);
+}
+
+#endif // CRASHREPORTER_BYTE_ENCODING_H
@@ -0,0 +1,590 @@
+/**
+ * Signal-safe DWARF CFI unwinder
+ *
+ * Third-party prebuilt libraries are usually built without frame pointers,
+ * and _Unwind_Backtrace may take locks or allocate inside the handler. This
+ * unwinder evaluates the .eh_frame call frame information itself: the FDE
+ * for each pc comes from the pre-built module map (module_map.h), the CIE/FDE
+ * instructions are interpreted into a register rule row, and the caller's
+ * registers are recovered from the CFA. Scratch state is static (only the
+ * crash owner thread unwinds), every stack read is checked against the
+ * crashing thread's stack bounds, and there are no locks. The only
+ * syscalls are one safe_memory read per module a walk enters: a library
+ * unloaded since the module map was built would otherwise fault the
+ * handler on its .eh_frame_hdr, so each module's table is checked to be
+ * mapped and unchanged before it is searched.
+ *
+ * Unsupported: DWARF expressions (DW_CFA_*expression, used by PLT stubs and
+ * signal trampolines) and 32-bit ARM EHABI (.ARM.exidx), which arm32 NDK
+ * binaries use instead of .eh_frame. The walk stops at such frames.
+ */
+
+#ifndef CRASHREPORTER_CFI_UNWINDER_H
+#define CRASHREPORTER_CFI_UNWINDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "crash_context.h"
+#include "dwarf_reader.h"
+#include "eh_frame_hdr.h"
+#include "module_map.h"
+#include "safe_memory.h"
+
+// DWARF register numbering: columns tracked, stack pointer, return address
+#if defined(__aarch64__)
+#define CFI_REG_COUNT 32        // x0-x30, sp
+#define CFI_SP_REG 31
+#define CFI_RA_REG 30
+#elif defined(__arm__)
+#define CFI_REG_COUNT 16        // r0-r15
+#define CFI_SP_REG 13
+#define CFI_RA_REG 14
+#elif defined(__x86_64__)
+#define CFI_REG_COUNT 17        // rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8-r15, rip
+#define CFI_SP_REG 7
+#define CFI_RA_REG 16
+#elif defined(__i386__)
+#define CFI_REG_COUNT 9         // eax, ecx, edx, ebx, esp, ebp, esi, edi, eip
+#define CFI_SP_REG 4
+#define CFI_RA_REG 8
+#else
+#define CFI_REG_COUNT 1
+#define CFI_SP_REG 0
+#define CFI_RA_REG 0
+#endif
+
+// DW_CFA_remember_state nesting supported per FDE
+#define CFI_MAX_REMEMBERED_ROWS 8
+
+// Call frame instructions (the high two bits select the first three)
+#define DW_CFA_advance_loc        0x40
+#define DW_CFA_offset             0x80
+#define DW_CFA_restore            0xc0
+#define DW_CFA_nop                0x00
+#define DW_CFA_set_loc            0x01
+#define DW_CFA_advance_loc1       0x02
+#define DW_CFA_advance_loc2       0x03
+#define DW_CFA_advance_loc4       0x04
+#define DW_CFA_offset_extended    0x05
+#define DW_CFA_restore_extended   0x06
+#define DW_CFA_undefined          0x07
+#define DW_CFA_same_value         0x08
+#define DW_CFA_register           0x09
+#define DW_CFA_remember_state     0x0a
+#define DW_CFA_restore_state      0x0b
+#define DW_CFA_def_cfa            0x0c
+#define DW_CFA_def_cfa_register   0x0d
+#define DW_CFA_def_cfa_offset     0x0e
+#define DW_CFA_def_cfa_expression 0x0f
+#define DW_CFA_expression         0x10
+#define DW_CFA_offset_extended_sf 0x11
+#define DW_CFA_def_cfa_sf         0x12
+#define DW_CFA_def_cfa_offset_sf  0x13
+#define DW_CFA_val_offset         0x14
+#define DW_CFA_val_offset_sf      0x15
+#define DW_CFA_val_expression     0x16
+#define DW_CFA_GNU_window_save    0x2d   // AArch64: DW_CFA_AARCH64_negate_ra_state
+#define DW_CFA_GNU_args_size      0x2e
+#define DW_CFA_GNU_negative_offset_extended 0x2f
+
+struct CfiRegisters {
+    uintptr_t r[CFI_REG_COUNT];     // By DWARF register number
+    uintptr_t pc;
+};
+
+enum CfiRuleType : uint8_t {
+    CFI_RULE_SAME,              // Callee-saved and untouched (also the default)
+    CFI_RULE_UNDEFINED,
+    CFI_RULE_OFFSET,            // Saved at CFA + value
+    CFI_RULE_VAL_OFFSET,        // Value is CFA + value
+    CFI_RULE_REGISTER,          // Saved in register value
+    CFI_RULE_UNSUPPORTED        // DWARF expression
+};
+
+struct CfiRule {
+    CfiRuleType type;
+    intptr_t value;
+};
+
+struct CfiRow {
+    uint32_t cfa_reg;
+    intptr_t cfa_offset;
+    bool cfa_unsupported;       // DW_CFA_def_cfa_expression
+    CfiRule rules[CFI_REG_COUNT];
+};
+
+struct CfiCie {
+    uint64_t code_align;
+    int64_t data_align;
+    uint32_t ra_reg;
+    uint8_t fde_encoding;
+    bool has_augmentation_data; // 'z'
+    bool signal_frame;          // 'S': the frame's pc is not a return address
+    const uint8_t* instructions;
+    const uint8_t* instructions_end;
+};
+
+struct CfiFde {
+    uintptr_t pc_begin;
+    uintptr_t pc_end;
+    const uint8_t* instructions;
+    const uint8_t* instructions_end;
+};
+
+// Interpreter scratch space, static so a deep remember-state stack never
+// lands on a possibly overflowed thread stack
+struct CfiScratch {
+    CfiRow row;
+    CfiRow initial;
+    CfiRow remembered[CFI_MAX_REMEMBERED_ROWS];
+};
+
+static CfiScratch g_cfi_scratch;
+
+// Per walk: whether each module's .eh_frame_hdr was checked, and its result
+enum CfiModuleState : uint8_t {
+    CFI_MODULE_UNCHECKED,
+    CFI_MODULE_MAPPED,
+    CFI_MODULE_STALE
+};
+
+static uint8_t g_cfi_module_state[MODULE_MAP_MAX_MODULES];
+
+// The module's unwind table, or null if it has none or was unloaded since the map was built
+static inline const EhFrameTable* cfi_module_table(const ModuleMap* map, int index) {
+    const LoadedModule* module = &map->modules[index];
+    if (!module->has_eh_frame) {
+        return nullptr;
+    }
+    if (g_cfi_module_state[index] == CFI_MODULE_UNCHECKED) {
+        uint8_t check[MODULE_MAP_EH_FRAME_CHECK_SIZE];
+        bool mapped = safe_memory_read_chunk(check, (uintptr_t)module->eh_frame.hdr + 4, sizeof(check)) &&
+                      memcmp(check, module->eh_frame_check, sizeof(check)) == 0;
+        g_cfi_module_state[index] = mapped ? CFI_MODULE_MAPPED : CFI_MODULE_STALE;
+    }
+    return g_cfi_module_state[index] == CFI_MODULE_MAPPED ? &module->eh_frame : nullptr;
+}
+
+static inline bool cfi_registers_from_context(const void* context, CfiRegisters* regs) {
+    if (!context) {
+        return false;
+    }
+    const ucontext_t* uc = (const ucontext_t*)context;
+
+#if defined(__aarch64__)
+    for (int i = 0; i < 31; i++) {
+        regs->r[i] = (uintptr_t)uc->uc_mcontext.regs[i];
+    }
+    regs->r[31] = (uintptr_t)uc->uc_mcontext.sp;
+    regs->pc = (uintptr_t)uc->uc_mcontext.pc;
+#elif defined(__arm__)
+    const mcontext_t* mc = &uc->uc_mcontext;
+    uintptr_t values[16] = {
+        mc->arm_r0, mc->arm_r1, mc->arm_r2, mc->arm_r3, mc->arm_r4, mc->arm_r5, mc->arm_r6, mc->arm_r7,
+        mc->arm_r8, mc->arm_r9, mc->arm_r10, mc->arm_fp, mc->arm_ip, mc->arm_sp, mc->arm_lr, mc->arm_pc
+    };
+    for (int i = 0; i < 16; i++) {
+        regs->r[i] = values[i];
+    }
+    regs->pc = (uintptr_t)mc->arm_pc;
+#elif defined(__x86_64__)
+    static const int kGregs[CFI_REG_COUNT] = {
+        REG_RAX, REG_RDX, REG_RCX, REG_RBX, REG_RSI, REG_RDI, REG_RBP, REG_RSP,
+        REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15, REG_RIP
+    };
+    for (int i = 0; i < CFI_REG_COUNT; i++) {
+        regs->r[i] = (uintptr_t)uc->uc_mcontext.gregs[kGregs[i]];
+    }
+    regs->pc = regs->r[CFI_RA_REG];
+#elif defined(__i386__)
+    static const int kGregs[CFI_REG_COUNT] = {
+        REG_EAX, REG_ECX, REG_EDX, REG_EBX, REG_ESP, REG_EBP, REG_ESI, REG_EDI, REG_EIP
+    };
+    for (int i = 0; i < CFI_REG_COUNT; i++) {
+        regs->r[i] = (uintptr_t)uc->uc_mcontext.gregs[kGregs[i]];
+    }
+    regs->pc = regs->r[CFI_RA_REG];
+#else
+    return false;
+#endif
+    return regs->pc != 0;
+}
+
+// Bounds of a CIE/FDE entry starting at entry; returns the cursor positioned
+// after the length field. The 64-bit length form keeps a 4-byte CIE pointer.
+static inline bool cfi_entry_bounds(const uint8_t* entry, DwarfCursor* cursor) {
+    dwarf_cursor_init(cursor, entry, entry + 12);
+    uint64_t length = dwarf_read_u32(cursor);
+    if (length == 0xffffffff) {
+        length = dwarf_read_u64(cursor);
+    }
+    if (!cursor->ok || length == 0 || length > ((uint64_t)1 << 32)) {
+        return false;
+    }
+    cursor->end = cursor->pos + length;
+    return true;
+}
+
+static inline bool cfi_parse_cie(const uint8_t* entry, CfiCie* cie) {
+    DwarfCursor cursor;
+    if (!cfi_entry_bounds(entry, &cursor) || dwarf_read_u32(&cursor) != 0) {
+        return false;
+    }
+
+    uint8_t version = dwarf_read_u8(&cursor);
+    if (version != 1 && version != 3 && version != 4) {
+        return false;
+    }
+
+    const char* augmentation = (const char*)cursor.pos;
+    size_t augmentation_len = 0;
+    while (dwarf_has(&cursor, augmentation_len + 1) && augmentation[augmentation_len] != '\0') {
+        augmentation_len++;
+    }
+    dwarf_skip(&cursor, augmentation_len + 1);
+
+    if (augmentation_len >= 2 && augmentation[0] == 'e' && augmentation[1] == 'h') {
+        dwarf_skip(&cursor, sizeof(uintptr_t));
+    }
+    if (version == 4) {
+        dwarf_skip(&cursor, 2);   // address_size, segment_selector_size
+    }
+
+    cie->code_align = dwarf_read_uleb128(&cursor);
+    cie->data_align = dwarf_read_sleb128(&cursor);
+    cie->ra_reg = version == 1 ? dwarf_read_u8(&cursor) : (uint32_t)dwarf_read_uleb128(&cursor);
+    cie->fde_encoding = DW_EH_PE_absptr;
+    cie->has_augmentation_data = augmentation_len > 0 && augmentation[0] == 'z';
+    cie->signal_frame = false;
+
+    if (cie->has_augmentation_data) {
+        uint64_t data_len = dwarf_read_uleb128(&cursor);
+        if (!dwarf_has(&cursor, data_len)) {
+            return false;
+        }
+        const uint8_t* data_end = cursor.pos + data_len;
+        for (size_t i = 1; i < augmentation_len && cursor.ok; i++) {
+            char c = augmentation[i];
+            if (c == 'L') {
+                dwarf_read_u8(&cursor);
+            } else if (c == 'R') {
+                cie->fde_encoding = dwarf_read_u8(&cursor);
+            } else if (c == 'P') {
+                uintptr_t personality;
+                uint8_t encoding = dwarf_read_u8(&cursor);
+                // Only skipped, so never follow the indirection
+                dwarf_read_encoded(&cursor, encoding & ~DW_EH_PE_indirect, 0, &personality);
+            } else if (c == 'S') {
+                cie->signal_frame = true;
+            } else if (c != 'B' && c != 'G') {
+                break;
+            }
+        }
+        cursor.pos = data_end;
+    }
+
+    cie->instructions = cursor.pos;
+    cie->instructions_end = cursor.end;
+    return cursor.ok;
+}
+
+static inline bool cfi_parse_fde(const uint8_t* entry, CfiFde* fde, CfiCie* cie) {
+    DwarfCursor cursor;
+    if (!cfi_entry_bounds(entry, &cursor)) {
+        return false;
+    }
+
+    const uint8_t* cie_pointer_field = cursor.pos;
+    uint32_t cie_pointer = dwarf_read_u32(&cursor);
+    if (!cursor.ok || cie_pointer == 0 || !cfi_parse_cie(cie_pointer_field - cie_pointer, cie)) {
+        return false;
+    }
+
+    uintptr_t pc_begin = 0;
+    uintptr_t pc_range = 0;
+    if (!dwarf_read_encoded(&cursor, cie->fde_encoding, 0, &pc_begin) ||
+        !dwarf_read_encoded(&cursor, cie->fde_encoding & 0x0f, 0, &pc_range)) {
+        return false;
+    }
+    if (cie->has_augmentation_data) {
+        dwarf_skip(&cursor, dwarf_read_uleb128(&cursor));
+    }
+
+    fde->pc_begin = pc_begin;
+    fde->pc_end = pc_begin + pc_range;
+    fde->instructions = cursor.pos;
+    fde->instructions_end = cursor.end;
+    return cursor.ok;
+}
+
+static inline void cfi_set_rule(CfiRow* row, uint64_t reg, CfiRuleType type, intptr_t value) {
+    if (reg < CFI_REG_COUNT) {
+        row->rules[reg].type = type;
+        row->rules[reg].value = value;
+    }
+}
+
+// Run call frame instructions until the row for target_pc is established.
+// initial is null while running the CIE's own initial instructions.
+static inline bool cfi_execute(const CfiCie* cie, const uint8_t* begin, const uint8_t* end,
+                               uintptr_t loc, uintptr_t target_pc, CfiRow* row, const CfiRow* initial) {
+    DwarfCursor cursor;
+    dwarf_cursor_init(&cursor, begin, end);
+    size_t remembered = 0;
+
+    while (!dwarf_at_end(&cursor)) {
+        uint8_t opcode = dwarf_read_u8(&cursor);
+        uint8_t operand = opcode & 0x3f;
+        uint64_t reg;
+
+        switch (opcode & 0xc0) {
+            case DW_CFA_advance_loc:
+                loc += operand * cie->code_align;
+                if (loc > target_pc) {
+                    return true;
+                }
+                continue;
+            case DW_CFA_offset:
+                cfi_set_rule(row, operand, CFI_RULE_OFFSET,
+                             (intptr_t)(dwarf_read_uleb128(&cursor) * cie->data_align));
+                continue;
+            case DW_CFA_restore:
+                if (initial && operand < CFI_REG_COUNT) {
+                    row->rules[operand] = initial->rules[operand];
+                }
+                continue;
+        }
+
+        switch (opcode) {
+            case DW_CFA_nop:
+                break;
+            case DW_CFA_set_loc: {
+                uintptr_t new_loc;
+                if (!dwarf_read_encoded(&cursor, cie->fde_encoding, 0, &new_loc)) {
+                    return false;
+                }
+                loc = new_loc;
+                if (loc > target_pc) {
+                    return true;
+                }
+                break;
+            }
+            case DW_CFA_advance_loc1:
+            case DW_CFA_advance_loc2:
+            case DW_CFA_advance_loc4: {
+                uint64_t delta = opcode == DW_CFA_advance_loc1 ? dwarf_read_u8(&cursor)
+                               : opcode == DW_CFA_advance_loc2 ? dwarf_read_u16(&cursor)
+                                                               : dwarf_read_u32(&cursor);
+                loc += delta * cie->code_align;
+                if (loc > target_pc) {
+                    return cursor.ok;
+                }
+                break;
+            }
+            case DW_CFA_offset_extended:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_OFFSET, (intptr_t)(dwarf_read_uleb128(&cursor) * cie->data_align));
+                break;
+            case DW_CFA_offset_extended_sf:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_OFFSET, (intptr_t)(dwarf_read_sleb128(&cursor) * cie->data_align));
+                break;
+            case DW_CFA_GNU_negative_offset_extended:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_OFFSET, -(intptr_t)(dwarf_read_uleb128(&cursor) * cie->data_align));
+                break;
+            case DW_CFA_val_offset:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_VAL_OFFSET, (intptr_t)(dwarf_read_uleb128(&cursor) * cie->data_align));
+                break;
+            case DW_CFA_val_offset_sf:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_VAL_OFFSET, (intptr_t)(dwarf_read_sleb128(&cursor) * cie->data_align));
+                break;
+            case DW_CFA_restore_extended:
+                reg = dwarf_read_uleb128(&cursor);
+                if (initial && reg < CFI_REG_COUNT) {
+                    row->rules[reg] = initial->rules[reg];
+                }
+                break;
+            case DW_CFA_undefined:
+                cfi_set_rule(row, dwarf_read_uleb128(&cursor), CFI_RULE_UNDEFINED, 0);
+                break;
+            case DW_CFA_same_value:
+                cfi_set_rule(row, dwarf_read_uleb128(&cursor), CFI_RULE_SAME, 0);
+                break;
+            case DW_CFA_register:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_REGISTER, (intptr_t)dwarf_read_uleb128(&cursor));
+                break;
+            case DW_CFA_remember_state:
+                if (remembered >= CFI_MAX_REMEMBERED_ROWS) {
+                    return false;
+                }
+                g_cfi_scratch.remembered[remembered++] = *row;
+                break;
+            case DW_CFA_restore_state:
+                if (remembered == 0) {
+                    return false;
+                }
+                *row = g_cfi_scratch.remembered[--remembered];
+                break;
+            case DW_CFA_def_cfa:
+                row->cfa_reg = (uint32_t)dwarf_read_uleb128(&cursor);
+                row->cfa_offset = (intptr_t)dwarf_read_uleb128(&cursor);
+                row->cfa_unsupported = false;
+                break;
+            case DW_CFA_def_cfa_sf:
+                row->cfa_reg = (uint32_t)dwarf_read_uleb128(&cursor);
+                row->cfa_offset = (intptr_t)(dwarf_read_sleb128(&cursor) * cie->data_align);
+                row->cfa_unsupported = false;
+                break;
+            case DW_CFA_def_cfa_register:
+                row->cfa_reg = (uint32_t)dwarf_read_uleb128(&cursor);
+                break;
+            case DW_CFA_def_cfa_offset:
+                row->cfa_offset = (intptr_t)dwarf_read_uleb128(&cursor);
+                break;
+            case DW_CFA_def_cfa_offset_sf:
+                row->cfa_offset = (intptr_t)(dwarf_read_sleb128(&cursor) * cie->data_align);
+                break;
+            case DW_CFA_def_cfa_expression:
+                row->cfa_unsupported = true;
+                dwarf_skip(&cursor, dwarf_read_uleb128(&cursor));
+                break;
+            case DW_CFA_expression:
+            case DW_CFA_val_expression:
+                reg = dwarf_read_uleb128(&cursor);
+                cfi_set_rule(row, reg, CFI_RULE_UNSUPPORTED, 0);
+                dwarf_skip(&cursor, dwarf_read_uleb128(&cursor));
+                break;
+            case DW_CFA_GNU_args_size:
+                dwarf_read_uleb128(&cursor);
+                break;
+            case DW_CFA_GNU_window_save:
+                // Return address signing state; PAC bits are stripped after the step
+                break;
+            default:
+                return false;
+        }
+    }
+    return cursor.ok;
+}
+
+static inline bool cfi_read_stack(const StackBounds* bounds, uintptr_t addr, uintptr_t* value) {
+    if (addr < bounds->lo || addr > bounds->hi - sizeof(uintptr_t) || (addr & (sizeof(uintptr_t) - 1)) != 0) {
+        return false;
+    }
+    *value = *(const uintptr_t*)addr;
+    return true;
+}
+
+// Recover the caller's registers. exact_pc: regs->pc is the faulting
+// instruction (or follows a signal frame) rather than a return address.
+// Returns false at the end of the stack or on anything it cannot trust.
+static inline bool cfi_step(CfiRegisters* regs, bool* exact_pc, const StackBounds* bounds, const ModuleMap* map) {
+    uintptr_t pc = unwind_normalize_pc(regs->pc);
+    uintptr_t lookup_pc = *exact_pc ? pc : pc - 1;
+
+    int module = module_map_find(map, lookup_pc);
+    const EhFrameTable* table = module >= 0 ? cfi_module_table(map, module) : nullptr;
+    const uint8_t* entry = table ? eh_frame_hdr_find_fde(table, lookup_pc) : nullptr;
+    CfiFde fde;
+    CfiCie cie;
+    if (!entry || !cfi_parse_fde(entry, &fde, &cie) || lookup_pc < fde.pc_begin || lookup_pc >= fde.pc_end ||
+        cie.ra_reg >= CFI_REG_COUNT) {
+        return false;
+    }
+
+    CfiRow* row = &g_cfi_scratch.row;
+    CfiRow* initial = &g_cfi_scratch.initial;
+    row->cfa_reg = CFI_SP_REG;
+    row->cfa_offset = 0;
+    row->cfa_unsupported = false;
+    for (int i = 0; i < CFI_REG_COUNT; i++) {
+        row->rules[i].type = CFI_RULE_SAME;
+        row->rules[i].value = 0;
+    }
+    if (!cfi_execute(&cie, cie.instructions, cie.instructions_end, fde.pc_begin, UINTPTR_MAX, row, nullptr)) {
+        return false;
+    }
+    *initial = *row;
+    if (!cfi_execute(&cie, fde.instructions, fde.instructions_end, fde.pc_begin, lookup_pc, row, initial)) {
+        return false;
+    }
+
+    if (row->cfa_unsupported || row->cfa_reg >= CFI_REG_COUNT) {
+        return false;
+    }
+    uintptr_t cfa = regs->r[row->cfa_reg] + row->cfa_offset;
+
+    CfiRegisters caller = *regs;
+    for (int i = 0; i < CFI_REG_COUNT; i++) {
+        const CfiRule* rule = &row->rules[i];
+        switch (rule->type) {
+            case CFI_RULE_SAME:
+                break;
+            case CFI_RULE_UNDEFINED:
+                if (i == (int)cie.ra_reg) {
+                    return false;   // Outermost frame
+                }
+                caller.r[i] = 0;
+                break;
+            case CFI_RULE_OFFSET:
+                if (!cfi_read_stack(bounds, cfa + rule->value, &caller.r[i])) {
+                    return false;
+                }
+                break;
+            case CFI_RULE_VAL_OFFSET:
+                caller.r[i] = cfa + rule->value;
+                break;
+            case CFI_RULE_REGISTER:
+                if ((size_t)rule->value >= CFI_REG_COUNT) {
+                    return false;
+                }
+                caller.r[i] = regs->r[rule->value];
+                break;
+            case CFI_RULE_UNSUPPORTED:
+                if (i == (int)cie.ra_reg) {
+                    return false;
+                }
+                break;
+        }
+    }
+
+    caller.r[CFI_SP_REG] = cfa;
+    caller.pc = unwind_strip_pac(caller.r[cie.ra_reg]);
+
+    // The caller's frame must be further up the same stack, and progress must be made
+    uintptr_t sp = regs->r[CFI_SP_REG];
+    if (caller.pc == 0 || cfa < sp || cfa > bounds->hi || (cfa == sp && caller.pc == regs->pc)) {
+        return false;
+    }
+
+    *regs = caller;
+    *exact_pc = cie.signal_frame;
+    return true;
+}
+
+// Walk the crashing thread's stack with CFI, starting at the faulting instruction
+static inline size_t unwind_cfi(const void* context, const StackBounds* bounds, const ModuleMap* map,
+                                uintptr_t* frames, size_t max_frames) {
+    CfiRegisters regs;
+    if (max_frames == 0 || !cfi_registers_from_context(context, &regs)) {
+        return 0;
+    }
+
+    memset(g_cfi_module_state, CFI_MODULE_UNCHECKED, sizeof(g_cfi_module_state));
+    size_t count = 0;
+    frames[count++] = regs.pc;
+    bool exact_pc = true;
+    while (count < max_frames && cfi_step(&regs, &exact_pc, bounds, map)) {
+        frames[count++] = regs.pc;
+    }
+    return count;
+}
+
+#endif // CRASHREPORTER_CFI_UNWINDER_H
@@ -0,0 +1,191 @@
+/**
+ * Accessors for the interrupted thread's machine context
+ *
+ * The ucontext_t passed to a SA_SIGINFO handler describes the faulting
+ * instruction; these helpers read it portably across the supported ABIs,
+ * together with the bounds of the interrupted thread's stack.
+ */
+
+#ifndef CRASHREPORTER_CRASH_CONTEXT_H
+#define CRASHREPORTER_CRASH_CONTEXT_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// Program counter of the faulting instruction (0 if unavailable)
+static inline uintptr_t crash_context_pc(const void* context) {
+    if (!context) {
+        return 0;
+    }
+    const ucontext_t* uc = (const ucontext_t*)context;
+
+#if defined(__aarch64__)
+    return (uintptr_t)uc->uc_mcontext.pc;
+#elif defined(__arm__)
+    return (uintptr_t)uc->uc_mcontext.arm_pc;
+#elif defined(__x86_64__)
+    return (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (uintptr_t)uc->uc_mcontext.gregs[REG_EIP];
+#else
+    return 0;
+#endif
+}
+
+// Registers an unwinder needs to start at the faulting instruction
+struct UnwindRegisters {
+    uintptr_t pc;
+    uintptr_t sp;
+    uintptr_t fp;   // Frame pointer (x29 / r11 or r7 / rbp / ebp)
+    uintptr_t lr;   // Link register; 0 on x86, where the return address is on the stack
+};
+
+// Fill regs from the signal context; returns false if there is no context
+static inline bool crash_context_registers(const void* context, UnwindRegisters* regs) {
+    regs->pc = regs->sp = regs->fp = regs->lr = 0;
+    if (!context) {
+        return false;
+    }
+    const ucontext_t* uc = (const ucontext_t*)context;
+
+#if defined(__aarch64__)
+    regs->pc = (uintptr_t)uc->uc_mcontext.pc;
+    regs->sp = (uintptr_t)uc->uc_mcontext.sp;
+    regs->fp = (uintptr_t)uc->uc_mcontext.regs[29];
+    regs->lr = (uintptr_t)uc->uc_mcontext.regs[30];
+#elif defined(__arm__)
+    regs->pc = (uintptr_t)uc->uc_mcontext.arm_pc;
+    regs->sp = (uintptr_t)uc->uc_mcontext.arm_sp;
+    // Thumb code (CPSR.T) keeps its frame pointer in r7, ARM code in r11
+    regs->fp = (uc->uc_mcontext.arm_cpsr & 0x20) ? (uintptr_t)uc->uc_mcontext.arm_r7
+                                                  : (uintptr_t)uc->uc_mcontext.arm_fp;
+    regs->lr = (uintptr_t)uc->uc_mcontext.arm_lr;
+#elif defined(__x86_64__)
+    regs->pc = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+    regs->sp = (uintptr_t)uc->uc_mcontext.gregs[REG_RSP];
+    regs->fp = (uintptr_t)uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__i386__)
+    regs->pc = (uintptr_t)uc->uc_mcontext.gregs[REG_EIP];
+    regs->sp = (uintptr_t)uc->uc_mcontext.gregs[REG_ESP];
+    regs->fp = (uintptr_t)uc->uc_mcontext.gregs[REG_EBP];
+#else
+    return false;
+#endif
+    return regs->pc != 0;
+}
+
+// [lo, hi) of a thread's stack
+struct StackBounds {
+    uintptr_t lo;
+    uintptr_t hi;
+};
+
+// Main thread bounds need /proc/self/maps, so they are resolved ahead of time
+static pid_t g_main_thread_tid = 0;
+static StackBounds g_main_thread_stack = { 0, 0 };
+
+static inline bool stack_bounds_of_current_thread(StackBounds* bounds) {
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+        return false;
+    }
+    void* base = nullptr;
+    size_t size = 0;
+    int rc = pthread_attr_getstack(&attr, &base, &size);
+    pthread_attr_destroy(&attr);
+    if (rc != 0 || !base || size == 0) {
+        return false;
+    }
+    bounds->lo = (uintptr_t)base;
+    bounds->hi = (uintptr_t)base + size;
+    return true;
+}
+
+// The main thread's stack from any thread: the [stack] mapping's top, and as far
+// down as it may grow (RLIMIT_STACK, up to the mapping below it), as
+// pthread_getattr_np() reports it on the main thread itself
+static inline bool stack_bounds_of_main_thread(StackBounds* bounds) {
+    FILE* maps = fopen("/proc/self/maps", "re");
+    if (!maps) {
+        return false;
+    }
+    char* line = nullptr;
+    size_t capacity = 0;
+    uintptr_t previous_end = 0;
+    bool found = false;
+    while (!found && getline(&line, &capacity, maps) > 0) {
+        unsigned long start = 0;
+        unsigned long end = 0;
+        if (sscanf(line, "%lx-%lx", &start, &end) != 2) {
+            continue;
+        }
+        if (strstr(line, " [stack]")) {
+            struct rlimit limit;
+            uintptr_t lo = previous_end;
+            if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < end &&
+                end - limit.rlim_cur > lo) {
+                lo = end - limit.rlim_cur;
+            }
+            bounds->lo = lo < start ? lo : start;
+            bounds->hi = end;
+            found = true;
+        }
+        previous_end = end;
+    }
+    free(line);
+    fclose(maps);
+    return found;
+}
+
+// Cache the main thread's stack bounds (call from initialize(), not the handler; any thread)
+static inline void stack_bounds_cache_main_thread() {
+    if (gettid() == getpid() ? stack_bounds_of_current_thread(&g_main_thread_stack)
+                             : stack_bounds_of_main_thread(&g_main_thread_stack)) {
+        g_main_thread_tid = getpid();
+    }
+}
+
+// Stack bounds of the crashing (current) thread. For non-main threads bionic
+// copies them out of the thread's own descriptor without locks or allocation;
+// for the main thread it would read /proc/self/maps, so without the cached
+// bounds there are none.
+static inline bool crash_thread_stack_bounds(uintptr_t sp, StackBounds* bounds) {
+    pid_t tid = gettid();
+    if (tid == g_main_thread_tid) {
+        *bounds = g_main_thread_stack;
+    } else if (g_main_thread_tid == 0 && tid == getpid()) {
+        return false;
+    } else if (!stack_bounds_of_current_thread(bounds)) {
+        return false;
+    }
+    // A fault on the guard page (stack overflow) leaves sp outside the stack
+    return sp >= bounds->lo && sp < bounds->hi;
+}
+
+// Remove pointer-authentication bits from a return address (no-op without PAC)
+static inline uintptr_t unwind_strip_pac(uintptr_t addr) {
+#if defined(__aarch64__)
+    register uintptr_t x30 __asm__("x30") = addr;
+    __asm__("hint 0x7" : "+r"(x30));  // XPACLRI
+    return x30;
+#else
+    return addr;
+#endif
+}
+
+// Strip the Thumb bit so pcs from different sources compare equal
+static inline uintptr_t unwind_normalize_pc(uintptr_t pc) {
+#if defined(__arm__)
+    return pc & ~(uintptr_t)1;
+#else
+    return pc;
+#endif
+}
+
+#endif // CRASHREPORTER_CRASH_CONTEXT_H
@@ -0,0 +1,94 @@
+/**
+ * Cross-thread crash coordination
+ *
+ * When several threads fault at nearly the same time, exactly one of them
+ * (the owner) captures and writes the crash record. The owner is elected
+ * with an atomic compare-and-swap on its tid. Every other crashing thread
+ * appends a compact secondary entry to a lock-free array, then parks until
+ * the owner has committed the record, so it can no longer kill the process
+ * halfway through the capture. A fault inside the owner's own handler is
+ * reported as recursive.
+ */
+
+#ifndef CRASHREPORTER_CRASH_COORDINATION_H
+#define CRASHREPORTER_CRASH_COORDINATION_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Secondary crashing threads recorded alongside the owner's record
+#define MAX_SECONDARY_CRASHES 16
+
+// How long a secondary thread waits for the owner before giving up
+#define CRASH_SECONDARY_PARK_TIMEOUT_MS 2000
+
+struct SecondaryCrash {
+    pid_t tid;                  // Written last; 0 while the entry is being filled
+    int signal;
+    int code;
+    uintptr_t fault_address;
+    uintptr_t pc;
+};
+
+struct CrashCoordinator {
+    pid_t owner_tid;            // 0 until a thread claims the capture
+    int capture_done;           // Set by the owner once the record is committed
+    uint32_t secondary_count;   // Claimed with an atomic fetch-add (may exceed the array)
+    SecondaryCrash secondary[MAX_SECONDARY_CRASHES];
+};
+
+enum CrashRole {
+    CRASH_ROLE_OWNER,
+    CRASH_ROLE_SECONDARY,
+    CRASH_ROLE_RECURSIVE
+};
+
+// Decide what the calling thread does with its fault (async-signal-safe)
+static inline CrashRole crash_coordinator_enter(CrashCoordinator* coordinator, pid_t tid) {
+    pid_t expected = 0;
+    if (__atomic_compare_exchange_n(&coordinator->owner_tid, &expected, tid, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return CRASH_ROLE_OWNER;
+    }
+    return expected == tid ? CRASH_ROLE_RECURSIVE : CRASH_ROLE_SECONDARY;
+}
+
+static inline void crash_coordinator_add_secondary(CrashCoordinator* coordinator, pid_t tid,
+                                                   const siginfo_t* info, uintptr_t pc) {
+    uint32_t index = __atomic_fetch_add(&coordinator->secondary_count, 1, __ATOMIC_RELAXED);
+    if (index >= MAX_SECONDARY_CRASHES) {
+        return;
+    }
+
+    SecondaryCrash* entry = &coordinator->secondary[index];
+    entry->signal = info->si_signo;
+    entry->code = info->si_code;
+    entry->fault_address = (uintptr_t)info->si_addr;
+    entry->pc = pc;
+    __atomic_store_n(&entry->tid, tid, __ATOMIC_RELEASE);
+}
+
+// Number of secondary entries the owner can read (some may still be filling in)
+static inline uint32_t crash_coordinator_secondary_count(const CrashCoordinator* coordinator) {
+    uint32_t count = __atomic_load_n(&coordinator->secondary_count, __ATOMIC_ACQUIRE);
+    return count < MAX_SECONDARY_CRASHES ? count : MAX_SECONDARY_CRASHES;
+}
+
+static inline void crash_coordinator_finish(CrashCoordinator* coordinator) {
+    __atomic_store_n(&coordinator->capture_done, 1, __ATOMIC_RELEASE);
+}
+
+// Wait until the owner has committed its record (bounded, async-signal-safe)
+static inline void crash_coordinator_park(CrashCoordinator* coordinator) {
+    struct timespec tick = { 0, 1000000 };  // 1ms
+    for (int waited = 0; waited < CRASH_SECONDARY_PARK_TIMEOUT_MS; waited++) {
+        if (__atomic_load_n(&coordinator->capture_done, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+        nanosleep(&tick, nullptr);
+    }
+}
+
+#endif // CRASHREPORTER_CRASH_COORDINATION_H
@@ -0,0 +1,268 @@
+/**
+ * Multi-slot crash journal
+ *
+ * A single pre-allocated file holds CRASH_JOURNAL_SLOT_COUNT fixed-size
+ * slots, so a crash loop no longer overwrites a record that has not been
+ * uploaded yet. At crash time a slot is claimed with an atomic counter:
+ * the slot index is sequence % slot_count, which is always the oldest slot,
+ * so a full journal evicts in O(1) with no directory operations and no lock.
+ *
+ * File layout (little-endian):
+ *
+ *   [0, CRASH_JOURNAL_HEADER_SIZE)  CrashJournalHeader
+ *   slot i at CRASH_JOURNAL_HEADER_SIZE + i * slot_size:
+ *     [0, CRASH_SLOT_HEADER_SIZE)   CrashSlotHeader
+ *     [CRASH_SLOT_HEADER_SIZE, ...) record body (crash_record_format.h)
+ *
+ * A slot is committed when commit_sequence == sequence != 0 and the body
+ * CRC-32 matches; commit_sequence is always written last. A slot with a
+ * sequence but no commit holds a torn record. The Kotlin side acknowledges a
+ * slot by zeroing its header. Keep in sync with NativeCrashHandler.kt.
+ *
+ * In CAPTURE_MODE_FILE the handler pwrite()s into the pre-opened fd; in
+ * CAPTURE_MODE_MMAP the whole journal is mapped MAP_SHARED and the record is
+ * formatted straight into the slot, with no syscalls on the crash path.
+ */
+
+#ifndef CRASHREPORTER_CRASH_JOURNAL_H
+#define CRASHREPORTER_CRASH_JOURNAL_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "crash_record_writer.h"
+#include "crc32.h"
+
+#define CRASH_JOURNAL_MAGIC "NCRJRNL1"
+#define CRASH_SLOT_MAGIC "NCRSLOT1"
+#define CRASH_JOURNAL_VERSION 1
+#define CRASH_JOURNAL_HEADER_SIZE 64
+#define CRASH_SLOT_HEADER_SIZE 64
+
+// Number of crash records kept until the Kotlin side uploads them
+#define CRASH_JOURNAL_SLOT_COUNT 8
+
+// Record body capacity of every slot. Both handlers use it: a journal with
+// another geometry is reformatted by crash_journal_open(), losing its records.
+#define CRASH_JOURNAL_BODY_SIZE (128 * 1024)
+
+struct CrashJournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slot_count;
+    uint32_t slot_size;         // Slot header + body capacity
+};
+
+struct CrashSlotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t sequence;          // Assigned when the slot is claimed
+    uint64_t body_capacity;
+    uint64_t body_length;
+    uint32_t body_crc32;
+    uint32_t reserved;
+    uint64_t commit_sequence;   // Equals sequence once the record is complete (written last)
+};
+
+static_assert(sizeof(CrashJournalHeader) <= CRASH_JOURNAL_HEADER_SIZE, "journal header too large");
+static_assert(sizeof(CrashSlotHeader) <= CRASH_SLOT_HEADER_SIZE, "slot header too large");
+
+struct CrashJournal {
+    int fd;                     // Pre-opened journal (CAPTURE_MODE_FILE), -1 otherwise
+    char* mapping;              // Whole journal (CAPTURE_MODE_MMAP), null otherwise
+    size_t mapping_size;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    size_t body_capacity;
+    uint64_t next_sequence;     // Claimed with an atomic fetch-add at crash time
+};
+
+struct CrashJournalSlot {
+    uint32_t index;
+    uint64_t sequence;
+    CrashSlotHeader* mapped_header;   // CAPTURE_MODE_MMAP only
+    char* mapped_body;                // CAPTURE_MODE_MMAP only
+};
+
+static inline bool crash_journal_is_open(const CrashJournal* journal) {
+    return journal->fd >= 0 || journal->mapping != nullptr;
+}
+
+static inline off_t crash_journal_slot_offset(const CrashJournal* journal, uint32_t index) {
+    return (off_t)CRASH_JOURNAL_HEADER_SIZE + (off_t)index * journal->slot_size;
+}
+
+// Reserve size bytes of real disk blocks, falling back to writing zeros on
+// filesystems without fallocate() support. A store into a sparse mapped page
+// on a full disk would be a SIGBUS, so the mmap mode depends on this too.
+static inline bool crash_journal_reserve(int fd, off_t size) {
+    if (fallocate(fd, 0, 0, size) == 0) {
+        return true;
+    }
+    if (errno != EOPNOTSUPP && errno != ENOSYS) {
+        return false;
+    }
+
+    static const char kZeros[4096] = {};
+    for (off_t offset = 0; offset < size; offset += (off_t)sizeof(kZeros)) {
+        size_t len = size - offset < (off_t)sizeof(kZeros) ? (size_t)(size - offset) : sizeof(kZeros);
+        if (!pwrite_fully(fd, kZeros, len, offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Open (or create) the journal, keeping every committed slot for the Kotlin
+// side, and continue the sequence after the newest slot. A journal with a
+// different geometry is reset. Returns false with errno set on failure.
+static inline bool crash_journal_open(CrashJournal* journal, const char* path,
+                                      uint32_t slot_count, size_t body_capacity, bool mapped) {
+    journal->fd = -1;
+    journal->mapping = nullptr;
+    journal->mapping_size = 0;
+    journal->slot_count = slot_count;
+    journal->slot_size = (uint32_t)(CRASH_SLOT_HEADER_SIZE + body_capacity);
+    journal->body_capacity = body_capacity;
+    journal->next_sequence = 1;
+
+    size_t file_size = CRASH_JOURNAL_HEADER_SIZE + (size_t)slot_count * journal->slot_size;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    CrashJournalHeader header;
+    memset(&header, 0, sizeof(header));
+    ssize_t n = pread(fd, &header, sizeof(header), 0);
+    bool compatible = n == (ssize_t)sizeof(header) &&
+                      memcmp(header.magic, CRASH_JOURNAL_MAGIC, sizeof(header.magic)) == 0 &&
+                      header.version == CRASH_JOURNAL_VERSION &&
+                      header.slot_count == slot_count &&
+                      header.slot_size == journal->slot_size;
+
+    if (compatible) {
+        // Continue after the newest claimed slot so slot order stays oldest-first
+        for (uint32_t i = 0; i < slot_count; i++) {
+            CrashSlotHeader slot;
+            if (pread(fd, &slot, sizeof(slot), crash_journal_slot_offset(journal, i)) == (ssize_t)sizeof(slot) &&
+                memcmp(slot.magic, CRASH_SLOT_MAGIC, sizeof(slot.magic)) == 0 &&
+                slot.sequence >= journal->next_sequence) {
+                journal->next_sequence = slot.sequence + 1;
+            }
+        }
+    } else if (ftruncate(fd, 0) != 0) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return false;
+    }
+
+    if (!crash_journal_reserve(fd, (off_t)file_size)) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return false;
+    }
+
+    if (!compatible) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CRASH_JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = CRASH_JOURNAL_VERSION;
+        header.header_size = CRASH_JOURNAL_HEADER_SIZE;
+        header.slot_count = slot_count;
+        header.slot_size = journal->slot_size;
+        if (!pwrite_fully(fd, &header, sizeof(header), 0)) {
+            int saved_errno = errno;
+            close(fd);
+            errno = saved_errno;
+            return false;
+        }
+    }
+
+    if (!mapped) {
+        journal->fd = fd;
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    int saved_errno = errno;
+    // The mapping keeps the file referenced; the fd is not needed any more
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        errno = saved_errno;
+        return false;
+    }
+
+    journal->mapping = (char*)mapping;
+    journal->mapping_size = file_size;
+    return true;
+}
+
+static inline void crash_journal_fill_claim(const CrashJournal* journal, CrashSlotHeader* header, uint64_t sequence) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, CRASH_SLOT_MAGIC, sizeof(header->magic));
+    header->version = CRASH_JOURNAL_VERSION;
+    header->header_size = CRASH_SLOT_HEADER_SIZE;
+    header->sequence = sequence;
+    header->body_capacity = journal->body_capacity;
+}
+
+// Claim the oldest slot and mark it as being written (async-signal-safe)
+static inline bool crash_journal_claim(CrashJournal* journal, CrashJournalSlot* slot) {
+    uint64_t sequence = __atomic_fetch_add(&journal->next_sequence, 1, __ATOMIC_RELAXED);
+    slot->index = (uint32_t)(sequence % journal->slot_count);
+    slot->sequence = sequence;
+    slot->mapped_header = nullptr;
+    slot->mapped_body = nullptr;
+
+    off_t offset = crash_journal_slot_offset(journal, slot->index);
+
+    if (journal->mapping) {
+        CrashSlotHeader* header = (CrashSlotHeader*)(journal->mapping + offset);
+        // Invalidate the evicted record before its body is overwritten
+        __atomic_store_n(&header->commit_sequence, 0, __ATOMIC_RELEASE);
+        crash_journal_fill_claim(journal, header, sequence);
+        slot->mapped_header = header;
+        slot->mapped_body = journal->mapping + offset + CRASH_SLOT_HEADER_SIZE;
+        return true;
+    }
+
+    CrashSlotHeader header;
+    crash_journal_fill_claim(journal, &header, sequence);
+    return pwrite_fully(journal->fd, &header, sizeof(header), offset);
+}
+
+// Write the record body, then seal the slot header (async-signal-safe).
+// In CAPTURE_MODE_MMAP the writer must have formatted into slot->mapped_body.
+static inline bool crash_journal_commit(CrashJournal* journal, const CrashJournalSlot* slot,
+                                        const CrashRecordWriter* writer) {
+    if (slot->mapped_header) {
+        CrashSlotHeader* header = slot->mapped_header;
+        header->body_length = writer->fmt.length;
+        header->body_crc32 = crc32_update(0, slot->mapped_body, writer->fmt.length);
+        __atomic_store_n(&header->commit_sequence, slot->sequence, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    off_t offset = crash_journal_slot_offset(journal, slot->index);
+    if (!record_writer_flush_at(writer, journal->fd, offset + CRASH_SLOT_HEADER_SIZE)) {
+        return false;
+    }
+
+    CrashSlotHeader header;
+    crash_journal_fill_claim(journal, &header, slot->sequence);
+    header.body_length = writer->fmt.length;
+    header.body_crc32 = crc32_update(0, writer->fmt.data, writer->fmt.length);
+    header.commit_sequence = slot->sequence;
+    return pwrite_fully(journal->fd, &header, sizeof(header), offset);
+}
+
+#endif // CRASHREPORTER_CRASH_JOURNAL_H
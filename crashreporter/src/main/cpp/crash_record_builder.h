@@ -0,0 +1,122 @@
+/**
+ * Crash record sections shared by both signal handlers
+ *
+ * Frames and module-pointing addresses are written as (module index,
+ * offset) against the module map the capture took; every module they
+ * reference is marked, and the MODULES section then lists only those, with
+ * load bias, build-id and path (crash_record_format.h). Names are resolved
+ * on the next launch.
+ *
+ * Async-signal-safe: formats into the caller's pre-reserved buffer only.
+ */
+
+#ifndef CRASHREPORTER_CRASH_RECORD_BUILDER_H
+#define CRASHREPORTER_CRASH_RECORD_BUILDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crash_coordination.h"
+#include "crash_record_format.h"
+#include "module_map.h"
+#include "signal_safe_format.h"
+
+// The module map of the record being written and the modules it references so far
+struct CrashRecordModules {
+    const ModuleMap* map;
+    uint64_t referenced[(MODULE_MAP_MAX_MODULES + 63) / 64];
+};
+
+static inline void crash_record_modules_init(CrashRecordModules* modules, const ModuleMap* map) {
+    modules->map = map;
+    memset(modules->referenced, 0, sizeof(modules->referenced));
+}
+
+// Varint module index and offset, marking the module for the module table
+static inline void crash_record_write_module_offset(FormatBuffer* fmt, CrashRecordModules* modules, int index,
+                                                    uintptr_t address) {
+    modules->referenced[index / 64] |= (uint64_t)1 << (index % 64);
+    crash_record_put_varint(fmt, (uint64_t)index);
+    crash_record_put_varint(fmt, address - modules->map->modules[index].load_bias);
+}
+
+// Frames as module index + 1 and offset; 0 and the absolute pc outside every module
+static inline void crash_record_write_frames(FormatBuffer* fmt, CrashRecordModules* modules, const uintptr_t* frames,
+                                             size_t count) {
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_FRAMES);
+    crash_record_put_varint(fmt, count);
+    for (size_t i = 0; i < count; i++) {
+        int index = module_map_find(modules->map, frames[i]);
+        if (index < 0) {
+            crash_record_put_varint(fmt, 0);
+            crash_record_put_varint(fmt, frames[i]);
+            continue;
+        }
+        modules->referenced[index / 64] |= (uint64_t)1 << (index % 64);
+        crash_record_put_varint(fmt, (uint64_t)index + 1);
+        crash_record_put_varint(fmt, frames[i] - modules->map->modules[index].load_bias);
+    }
+    crash_record_end_section(fmt, section);
+}
+
+// ADDRESSES entry if value points into a loaded module (code or data); register -1 is the fault address.
+// Call inside a CRASH_RECORD_SECTION_ADDRESSES section.
+static inline void crash_record_write_module_address(FormatBuffer* fmt, CrashRecordModules* modules,
+                                                     int register_index, uintptr_t value) {
+    int index = module_map_find(modules->map, value);
+    if (index < 0) {
+        return;
+    }
+    crash_record_put_varint(fmt, (uint64_t)(register_index + 1));
+    crash_record_write_module_offset(fmt, modules, index, value);
+}
+
+// Module table for the frames and addresses above: index, load bias, build-id, path
+static inline void crash_record_write_referenced_modules(FormatBuffer* fmt, const CrashRecordModules* modules) {
+    const ModuleMap* map = modules->map;
+    if (!map) {
+        return;
+    }
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_MODULES);
+    for (size_t i = 0; i < map->count; i++) {
+        if (!(modules->referenced[i / 64] & ((uint64_t)1 << (i % 64)))) {
+            continue;
+        }
+        const LoadedModule* module = &map->modules[i];
+        const char* path = module_map_path(map, module);
+        crash_record_put_varint(fmt, i);
+        crash_record_put_varint(fmt, module->load_bias);
+        fmt_append_char(fmt, (char)module->build_id.length);
+        fmt_append_bytes(fmt, (const char*)module->build_id.bytes, module->build_id.length);
+        crash_record_put_varint(fmt, strlen(path));
+        fmt_append_str(fmt, path);
+    }
+    crash_record_end_section(fmt, section);
+}
+
+// Append the compact entries left by other threads that crashed concurrently
+static inline void crash_record_write_secondary_crashes(FormatBuffer* fmt, const CrashCoordinator* coordinator) {
+    uint32_t count = crash_coordinator_secondary_count(coordinator);
+    if (count == 0) {
+        return;
+    }
+
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_SECONDARY);
+    for (uint32_t i = 0; i < count; i++) {
+        const SecondaryCrash* entry = &coordinator->secondary[i];
+        pid_t tid = __atomic_load_n(&entry->tid, __ATOMIC_ACQUIRE);
+        if (tid == 0) {
+            // Still being filled in by its thread
+            continue;
+        }
+        crash_record_put_varint(fmt, (uint64_t)tid);
+        crash_record_put_varint(fmt, (uint64_t)entry->signal);
+        crash_record_put_zigzag(fmt, entry->code);
+        crash_record_put_varint(fmt, entry->fault_address);
+        crash_record_put_varint(fmt, entry->pc);
+    }
+    crash_record_end_section(fmt, section);
+}
+
+#endif // CRASHREPORTER_CRASH_RECORD_BUILDER_H
@@ -0,0 +1,775 @@
+/**
+ * Crash record decoder
+ *
+ * Reads the binary records of crash_record_format.h in a single pass, for
+ * the app on the next launch (over JNI) and for host tools. Every length is
+ * bounds-checked against the buffer, so a corrupt record decodes to what
+ * could be read rather than failing outright.
+ *
+ * crash_record_to_text() renders a decoded record in the text layout the
+ * handler used to write ("[module]+0xoffset" frames followed by the module
+ * table), which the symbolizers consume. crash_record_to_json() renders it
+ * as the JSON document the app uploads (json_writer.h), and
+ * crash_record_report() prepares the fields the app's report is filled with.
+ * crash_record_modified_utf8() makes any of these safe to hand to JNI.
+ *
+ * Not async-signal-safe.
+ */
+
+#ifndef CRASHREPORTER_CRASH_RECORD_DECODER_H
+#define CRASHREPORTER_CRASH_RECORD_DECODER_H
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "crash_record_format.h"
+#include "json_writer.h"
+#include "unwind_method.h"
+
+struct CrashRecordFrame {
+    uint64_t pc;                // Absolute; 0 when its module is missing from the record
+    int64_t module;             // Module index; -1 outside every module
+    uint64_t offset;            // Into the module
+};
+
+struct CrashRecordAddress {
+    int register_index;         // Into CrashRecord::registers; -1 for the fault address
+    uint32_t module;
+    uint64_t offset;
+};
+
+struct CrashRecordModule {
+    uint32_t index;
+    uint64_t load_bias;
+    std::string build_id;       // Lowercase hex; empty if the module has none
+    std::string path;
+};
+
+struct CrashRecordSecondary {
+    int32_t tid;
+    int32_t signal;
+    int32_t code;
+    uint64_t fault_address;
+    uint64_t pc;
+};
+
+struct CrashRecordMemoryRange {
+    uint64_t start;
+    uint64_t length;
+};
+
+struct CrashRecord {
+    CrashRecordHeader header;
+    bool truncated = false;                 // Cut short by the handler, or by the end of the buffer
+    std::string thread_name;
+    std::vector<CrashRecordFrame> frames;
+    std::vector<uint64_t> registers;        // Block of header.arch
+    std::vector<CrashRecordAddress> addresses;
+    std::vector<CrashRecordModule> modules;
+    std::vector<CrashRecordSecondary> secondary_crashes;
+    uint64_t memory_start = 0;
+    std::string memory;
+    std::vector<CrashRecordMemoryRange> memory_unreadable;
+};
+
+struct CrashRecordReader {
+    const uint8_t* pos;
+    const uint8_t* end;
+    bool ok;
+};
+
+static inline uint64_t crash_record_read_varint(CrashRecordReader* reader) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (reader->pos >= reader->end) {
+            reader->ok = false;
+            return 0;
+        }
+        uint8_t byte = *reader->pos++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    reader->ok = false;
+    return 0;
+}
+
+static inline int64_t crash_record_read_zigzag(CrashRecordReader* reader) {
+    uint64_t value = crash_record_read_varint(reader);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Next length bytes, or null if fewer remain
+static inline const uint8_t* crash_record_read_bytes(CrashRecordReader* reader, uint64_t length) {
+    if (!reader->ok || length > (uint64_t)(reader->end - reader->pos)) {
+        reader->ok = false;
+        return nullptr;
+    }
+    const uint8_t* bytes = reader->pos;
+    reader->pos += length;
+    return bytes;
+}
+
+// Entry count for a section, capped by what its remaining bytes could hold (one byte per entry at least)
+static inline size_t crash_record_read_count(CrashRecordReader* reader) {
+    uint64_t count = crash_record_read_varint(reader);
+    uint64_t remaining = (uint64_t)(reader->end - reader->pos);
+    return (size_t)(count < remaining ? count : remaining);
+}
+
+static inline bool crash_record_is_binary(const void* data, size_t size) {
+    uint32_t magic = 0;
+    if (size >= sizeof(magic)) {
+        memcpy(&magic, data, sizeof(magic));
+    }
+    return magic == CRASH_RECORD_MAGIC;
+}
+
+static inline void crash_record_decode_section(CrashRecord* record, uint8_t type, CrashRecordReader* reader) {
+    const CrashRecordArchInfo* arch = crash_record_arch_info(record->header.arch);
+    switch (type) {
+        case CRASH_RECORD_SECTION_THREAD_NAME:
+            record->thread_name.assign((const char*)reader->pos, reader->end - reader->pos);
+            break;
+
+        case CRASH_RECORD_SECTION_FRAMES: {
+            size_t count = crash_record_read_count(reader);
+            record->frames.reserve(count);
+            for (size_t i = 0; i < count && reader->ok; i++) {
+                CrashRecordFrame frame;
+                frame.module = (int64_t)crash_record_read_varint(reader) - 1;
+                frame.offset = crash_record_read_varint(reader);
+                frame.pc = frame.module < 0 ? frame.offset : 0;
+                if (reader->ok) {
+                    record->frames.push_back(frame);
+                }
+            }
+            break;
+        }
+
+        case CRASH_RECORD_SECTION_REGISTERS: {
+            size_t size = arch->pointer_size;
+            size_t count = size ? (size_t)(reader->end - reader->pos) / size : 0;
+            record->registers.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                uint64_t value = 0;
+                memcpy(&value, reader->pos + i * size, size);
+                record->registers[i] = value;
+            }
+            break;
+        }
+
+        case CRASH_RECORD_SECTION_ADDRESSES:
+            while (reader->pos < reader->end && reader->ok) {
+                CrashRecordAddress address;
+                address.register_index = (int)crash_record_read_varint(reader) - 1;
+                address.module = (uint32_t)crash_record_read_varint(reader);
+                address.offset = crash_record_read_varint(reader);
+                if (reader->ok) {
+                    record->addresses.push_back(address);
+                }
+            }
+            break;
+
+        case CRASH_RECORD_SECTION_MODULES:
+            while (reader->pos < reader->end && reader->ok) {
+                static const char kHex[] = "0123456789abcdef";
+                CrashRecordModule module;
+                module.index = (uint32_t)crash_record_read_varint(reader);
+                module.load_bias = crash_record_read_varint(reader);
+                const uint8_t* length = crash_record_read_bytes(reader, 1);
+                const uint8_t* build_id = length ? crash_record_read_bytes(reader, *length) : nullptr;
+                for (size_t i = 0; build_id && i < *length; i++) {
+                    module.build_id += kHex[build_id[i] >> 4];
+                    module.build_id += kHex[build_id[i] & 0xf];
+                }
+                uint64_t path_length = crash_record_read_varint(reader);
+                const uint8_t* path = crash_record_read_bytes(reader, path_length);
+                if (!path) {
+                    break;
+                }
+                module.path.assign((const char*)path, path_length);
+                record->modules.push_back(std::move(module));
+            }
+            break;
+
+        case CRASH_RECORD_SECTION_SECONDARY:
+            while (reader->pos < reader->end && reader->ok) {
+                CrashRecordSecondary entry;
+                entry.tid = (int32_t)crash_record_read_varint(reader);
+                entry.signal = (int32_t)crash_record_read_varint(reader);
+                entry.code = (int32_t)crash_record_read_zigzag(reader);
+                entry.fault_address = crash_record_read_varint(reader);
+                entry.pc = crash_record_read_varint(reader);
+                if (reader->ok) {
+                    record->secondary_crashes.push_back(entry);
+                }
+            }
+            break;
+
+        case CRASH_RECORD_SECTION_MEMORY: {
+            record->memory_start = crash_record_read_varint(reader);
+            uint64_t length = crash_record_read_varint(reader);
+            const uint8_t* bytes = crash_record_read_bytes(reader, length);
+            if (!bytes) {
+                break;
+            }
+            record->memory.assign((const char*)bytes, length);
+            size_t count = crash_record_read_count(reader);
+            for (size_t i = 0; i < count && reader->ok; i++) {
+                CrashRecordMemoryRange range;
+                range.start = record->memory_start + crash_record_read_varint(reader);
+                range.length = crash_record_read_varint(reader);
+                if (reader->ok) {
+                    record->memory_unreadable.push_back(range);
+                }
+            }
+            break;
+        }
+
+        default:
+            break;      // Section from a newer version
+    }
+}
+
+// Decode the record at the start of data. Returns false if it is not a
+// record; otherwise stores the number of bytes it spans in *consumed (records
+// can be concatenated).
+static inline bool crash_record_decode(const void* data, size_t size, CrashRecord* record, size_t* consumed) {
+    if (!crash_record_is_binary(data, size) || size < offsetof(CrashRecordHeader, signal)) {
+        return false;
+    }
+    const uint8_t* bytes = (const uint8_t*)data;
+    memset(&record->header, 0, sizeof(record->header));
+    memcpy(&record->header, bytes, size < sizeof(record->header) ? size : sizeof(record->header));
+    const CrashRecordHeader& header = record->header;
+    if (header.header_size < offsetof(CrashRecordHeader, signal)) {
+        return false;
+    }
+    size_t length = header.record_length;
+    if (length < header.header_size || length > size) {
+        // Unfinished or cut off: decode what is there
+        record->truncated = true;
+        length = size;
+    }
+    if (header.flags & CRASH_RECORD_FLAG_TRUNCATED) {
+        record->truncated = true;
+    }
+    if (header.header_size < sizeof(header)) {
+        // Fields an older writer did not have
+        memset((char*)&record->header + header.header_size, 0, sizeof(header) - header.header_size);
+    }
+
+    const uint8_t* end = bytes + length;
+    const uint8_t* pos = bytes + (header.header_size < length ? header.header_size : length);
+    while ((size_t)(end - pos) >= CRASH_RECORD_SECTION_HEADER_SIZE) {
+        uint8_t type = pos[0];
+        uint32_t section_length;
+        memcpy(&section_length, pos + 1, sizeof(section_length));
+        pos += CRASH_RECORD_SECTION_HEADER_SIZE;
+        if (section_length > (size_t)(end - pos)) {
+            record->truncated = true;
+            section_length = (uint32_t)(end - pos);
+        }
+        CrashRecordReader reader = { pos, pos + section_length, true };
+        crash_record_decode_section(record, type, &reader);
+        if (!reader.ok) {
+            record->truncated = true;
+        }
+        pos += section_length;
+    }
+
+    // Frames are stored relative to their module
+    for (CrashRecordFrame& frame : record->frames) {
+        for (const CrashRecordModule& module : record->modules) {
+            if (frame.module == (int64_t)module.index) {
+                frame.pc = module.load_bias + frame.offset;
+                break;
+            }
+        }
+    }
+    *consumed = length;
+    return true;
+}
+
+// ---- Text rendering ----
+
+static inline void crash_record_append(std::string* out, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static inline void crash_record_append(std::string* out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) {
+        out->append(line, (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1);
+    }
+}
+
+static inline void crash_record_append_module_offset(std::string* out, uint32_t module, uint64_t offset) {
+    crash_record_append(out, " [%" PRIu32 "]+0x%" PRIx64 "\n", module, offset);
+}
+
+struct CrashRecordNamedRegister {
+    const char* name;
+    uint64_t value;
+};
+
+// Hex digits of a register value: the pointer width of the record's architecture
+static inline int crash_record_value_width(const CrashRecord& record) {
+    const CrashRecordArchInfo* arch = crash_record_arch_info(record.header.arch);
+    return arch->pointer_size ? arch->pointer_size * 2 : 16;
+}
+
+// pc, sp and lr by role first, then the block (minus registers those names already cover)
+static inline std::vector<CrashRecordNamedRegister> crash_record_named_registers(const CrashRecord& record) {
+    const CrashRecordArchInfo* arch = crash_record_arch_info(record.header.arch);
+    std::vector<CrashRecordNamedRegister> named;
+    named.reserve(record.registers.size() + 3);
+    const int roles[] = { arch->pc, arch->sp, arch->lr };
+    const char* const role_names[] = { "pc", "sp", "lr" };
+    for (int i = 0; i < 3; i++) {
+        if (roles[i] >= 0 && (size_t)roles[i] < record.registers.size()) {
+            named.push_back({ role_names[i], record.registers[roles[i]] });
+        }
+    }
+    for (size_t i = 0; i < record.registers.size() && i < arch->register_count; i++) {
+        const char* name = arch->names[i];
+        if (strcmp(name, "pc") != 0 && strcmp(name, "sp") != 0) {
+            named.push_back({ name, record.registers[i] });
+        }
+    }
+    return named;
+}
+
+// "tid 1234 SIGSEGV (11) code 1 fault 0x... pc 0x..."
+static inline void crash_record_append_secondary(std::string* out, const CrashRecordSecondary& entry) {
+    crash_record_append(out, "tid %d %s (%d) code %d fault 0x%" PRIx64 " pc 0x%" PRIx64, entry.tid,
+                        crash_signal_name(entry.signal), entry.signal, entry.code, entry.fault_address, entry.pc);
+}
+
+// Hex dump of the captured memory, split at the fault address as the handler captures
+// the bytes on either side of it; "??" for bytes that could not be read
+static inline void crash_record_append_memory_dump(std::string* out, const CrashRecord& record) {
+    uint64_t split = record.header.fault_address;
+    if (split < record.memory_start || split > record.memory_start + record.memory.size()) {
+        split = record.memory_start;
+    }
+    for (int part = 0; part < 2; part++) {
+        uint64_t start = part == 0 ? record.memory_start : split;
+        uint64_t end = part == 0 ? split : record.memory_start + record.memory.size();
+        if (start == end) {
+            continue;
+        }
+        if (part == 0) {
+            crash_record_append(out, "Before fault address (0x%" PRIx64 " - %" PRIu64 "):\n", split, end - start);
+        } else {
+            crash_record_append(out, "%sAfter fault address (0x%" PRIx64 "):\n", split > record.memory_start ? "\n" : "",
+                                split);
+        }
+        for (uint64_t line = start; line < end; line += 16) {
+            crash_record_append(out, "%04" PRIx64 ": ", line - start);
+            size_t count = (size_t)(end - line < 16 ? end - line : 16);
+            char digits[32];
+            hex_encode(digits, &record.memory[line - record.memory_start], count);
+            char text[48];
+            for (size_t i = 0; i < count; i++) {
+                text[3 * i] = digits[2 * i];
+                text[3 * i + 1] = digits[2 * i + 1];
+                text[3 * i + 2] = ' ';
+            }
+            // Most lines are fully readable; only the others are checked byte by byte
+            for (const CrashRecordMemoryRange& range : record.memory_unreadable) {
+                if (range.start >= line + count || (range.start < line && line - range.start >= range.length)) {
+                    continue;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (line + i - range.start < range.length) {
+                        text[3 * i] = '?';
+                        text[3 * i + 1] = '?';
+                    }
+                }
+            }
+            out->append(text, 3 * count);
+            *out += '\n';
+        }
+    }
+    for (size_t i = 0; i < record.memory_unreadable.size(); i++) {
+        const CrashRecordMemoryRange& range = record.memory_unreadable[i];
+        crash_record_append(out, "%s0x%" PRIx64 "-0x%" PRIx64, i == 0 ? "\nUnreadable: " : ", ", range.start,
+                            range.start + range.length);
+    }
+    if (!record.memory_unreadable.empty()) {
+        *out += '\n';
+    }
+}
+
+// The record in the handler's text layout
+static inline std::string crash_record_to_text(const CrashRecord& record) {
+    const CrashRecordHeader& header = record.header;
+    const CrashRecordArchInfo* arch = crash_record_arch_info(header.arch);
+    std::string out;
+    out.reserve(4096 + record.frames.size() * 48 + record.memory.size() * 4);
+
+    crash_record_append(&out, "NATIVE_CRASH\nSignal: %s (%d)\nDescription: %s\nCode: %d\nFault Address: 0x%" PRIx64 "\n",
+                        crash_signal_name(header.signal), header.signal, crash_signal_description(header.signal),
+                        header.code, header.fault_address);
+    out += "Thread: ";
+    out += record.thread_name;
+    crash_record_append(&out, "\nPID: %d\nTID: %d\nTime: %" PRId64 "\nFrame Count: %zu\nUnwinder: %s\n",
+                        header.pid, header.tid, header.crash_time, record.frames.size(),
+                        unwind_method_name((UnwindMethod)header.unwind_method));
+    if (record.truncated) {
+        out += "Truncated: yes\n";
+    }
+    out += '\n';
+
+    if (!record.secondary_crashes.empty()) {
+        out += "SECONDARY CRASHES:\n";
+        for (const CrashRecordSecondary& entry : record.secondary_crashes) {
+            out += "  ";
+            crash_record_append_secondary(&out, entry);
+            out += '\n';
+        }
+        out += '\n';
+    }
+
+    if (!record.registers.empty()) {
+        out += "REGISTERS:\n";
+        int width = crash_record_value_width(record);
+        for (const CrashRecordNamedRegister& reg : crash_record_named_registers(record)) {
+            crash_record_append(&out, "  %s: %0*" PRIx64 "\n", reg.name, width, reg.value);
+        }
+        out += '\n';
+    }
+
+    out += "STACK TRACE:\n";
+    int index_width = record.frames.size() > 100 ? 3 : 2;
+    for (size_t i = 0; i < record.frames.size(); i++) {
+        const CrashRecordFrame& frame = record.frames[i];
+        crash_record_append(&out, "#%0*zu pc 0x%" PRIx64, index_width, i, frame.pc);
+        if (frame.module < 0) {
+            out += " ???\n";
+        } else {
+            crash_record_append_module_offset(&out, (uint32_t)frame.module, frame.offset);
+        }
+    }
+
+    out += "ADDRESSES:\n";
+    for (const CrashRecordAddress& address : record.addresses) {
+        if (address.register_index < 0) {
+            out += "fault";
+        } else if ((size_t)address.register_index < arch->register_count) {
+            out += arch->names[address.register_index];
+        } else {
+            continue;
+        }
+        crash_record_append_module_offset(&out, address.module, address.offset);
+    }
+
+    out += "MODULES:\n";
+    for (const CrashRecordModule& module : record.modules) {
+        crash_record_append(&out, "[%" PRIu32 "] 0x%" PRIx64 " %s ", module.index, module.load_bias,
+                            module.build_id.empty() ? "-" : module.build_id.c_str());
+        out += module.path;
+        out += '\n';
+    }
+
+    if (!record.memory.empty()) {
+        out += "\nMEMORY DUMP:\n";
+        crash_record_append_memory_dump(&out, record);
+    }
+    return out;
+}
+
+// ---- Report fields ----
+
+// A decoded record as NativeCrashHandler.NativeCrashReport holds it (crash_record_jni.h)
+struct CrashRecordReport {
+    std::string signal;                         // "SIGSEGV (11)"
+    std::string fault_address;                  // "0x..."
+    std::vector<std::string> register_names;    // As crash_record_named_registers() orders them
+    std::vector<std::string> register_values;   // Zero-padded hex
+    std::vector<std::string> secondary_crashes;
+    std::string memory_dump;                    // As in the text layout; empty without memory
+    std::vector<int64_t> frame_pcs;
+    std::vector<int32_t> frame_modules;         // Position in module_paths; -1 when not listed
+    std::vector<int64_t> frame_offsets;
+    std::vector<std::string> module_paths;
+    std::vector<std::string> module_build_ids;
+};
+
+static inline void crash_record_report(const CrashRecord& record, CrashRecordReport* report) {
+    const CrashRecordHeader& header = record.header;
+    char signal[48];
+    snprintf(signal, sizeof(signal), "%s (%d)", crash_signal_name(header.signal), header.signal);
+    report->signal = signal;
+    char fault_address[24];
+    snprintf(fault_address, sizeof(fault_address), "0x%" PRIx64, header.fault_address);
+    report->fault_address = fault_address;
+
+    int width = crash_record_value_width(record);
+    for (const CrashRecordNamedRegister& reg : crash_record_named_registers(record)) {
+        char value[24];
+        snprintf(value, sizeof(value), "%0*" PRIx64, width, reg.value);
+        report->register_names.emplace_back(reg.name);
+        report->register_values.emplace_back(value);
+    }
+
+    report->secondary_crashes.resize(record.secondary_crashes.size());
+    for (size_t i = 0; i < record.secondary_crashes.size(); i++) {
+        crash_record_append_secondary(&report->secondary_crashes[i], record.secondary_crashes[i]);
+    }
+
+    if (!record.memory.empty()) {
+        report->memory_dump.reserve(record.memory.size() * 4);
+        crash_record_append_memory_dump(&report->memory_dump, record);
+    }
+
+    size_t frame_count = record.frames.size();
+    report->frame_pcs.resize(frame_count);
+    report->frame_modules.assign(frame_count, -1);
+    report->frame_offsets.resize(frame_count);
+    for (size_t i = 0; i < frame_count; i++) {
+        const CrashRecordFrame& frame = record.frames[i];
+        report->frame_pcs[i] = (int64_t)frame.pc;
+        report->frame_offsets[i] = (int64_t)frame.offset;
+        for (size_t m = 0; frame.module >= 0 && m < record.modules.size(); m++) {
+            if ((int64_t)record.modules[m].index == frame.module) {
+                report->frame_modules[i] = (int32_t)m;
+                break;
+            }
+        }
+    }
+
+    report->module_paths.resize(record.modules.size());
+    report->module_build_ids.resize(record.modules.size());
+    for (size_t m = 0; m < record.modules.size(); m++) {
+        report->module_paths[m] = record.modules[m].path;
+        report->module_build_ids[m] = record.modules[m].build_id;
+    }
+}
+
+// ---- JSON rendering ----
+
+// The record as one JSON object. frame_symbols, if given, holds one
+// "symbol+0xdelta" (or null) per frame, as the app resolved them.
+static inline void crash_record_write_json(JsonWriter* json, const CrashRecord& record,
+                                           const char* const* frame_symbols) {
+    const CrashRecordHeader& header = record.header;
+    const CrashRecordArchInfo* arch = crash_record_arch_info(header.arch);
+    json_begin_object(json);
+    json_key(json, "version");
+    json_uint(json, header.version);
+    json_key(json, "signal");
+    json_int(json, header.signal);
+    json_key(json, "signalName");
+    json_string(json, crash_signal_name(header.signal));
+    json_key(json, "description");
+    json_string(json, crash_signal_description(header.signal));
+    json_key(json, "code");
+    json_int(json, header.code);
+    json_key(json, "faultAddress");
+    json_hex(json, header.fault_address);
+    json_key(json, "pid");
+    json_int(json, header.pid);
+    json_key(json, "tid");
+    json_int(json, header.tid);
+    json_key(json, "time");
+    json_int(json, header.crash_time);
+    json_key(json, "thread");
+    json_string_n(json, record.thread_name.data(), record.thread_name.size());
+    json_key(json, "arch");
+    json_string(json, crash_record_arch_name(header.arch));
+    json_key(json, "unwinder");
+    json_string(json, unwind_method_name((UnwindMethod)header.unwind_method));
+    json_key(json, "truncated");
+    json_bool(json, record.truncated);
+
+    json_key(json, "registers");
+    json_begin_object(json);
+    for (size_t i = 0; i < record.registers.size() && i < arch->register_count; i++) {
+        json_key(json, arch->names[i]);
+        json_hex(json, record.registers[i]);
+    }
+    json_end_object(json);
+
+    json_key(json, "frames");
+    json_begin_array(json);
+    for (size_t i = 0; i < record.frames.size(); i++) {
+        const CrashRecordFrame& frame = record.frames[i];
+        json_begin_object(json);
+        json_key(json, "pc");
+        json_hex(json, frame.pc);
+        if (frame.module >= 0) {
+            json_key(json, "module");
+            json_int(json, frame.module);
+            json_key(json, "offset");
+            json_hex(json, frame.offset);
+        }
+        if (frame_symbols && frame_symbols[i]) {
+            json_key(json, "symbol");
+            json_string(json, frame_symbols[i]);
+        }
+        json_end_object(json);
+    }
+    json_end_array(json);
+
+    json_key(json, "addresses");
+    json_begin_array(json);
+    for (const CrashRecordAddress& address : record.addresses) {
+        if (address.register_index >= 0 && (size_t)address.register_index >= arch->register_count) {
+            continue;
+        }
+        json_begin_object(json);
+        json_key(json, "register");
+        json_string(json, address.register_index < 0 ? "fault" : arch->names[address.register_index]);
+        json_key(json, "module");
+        json_uint(json, address.module);
+        json_key(json, "offset");
+        json_hex(json, address.offset);
+        json_end_object(json);
+    }
+    json_end_array(json);
+
+    json_key(json, "modules");
+    json_begin_array(json);
+    for (const CrashRecordModule& module : record.modules) {
+        json_begin_object(json);
+        json_key(json, "index");
+        json_uint(json, module.index);
+        json_key(json, "loadBias");
+        json_hex(json, module.load_bias);
+        json_key(json, "buildId");
+        json_string_n(json, module.build_id.data(), module.build_id.size());
+        json_key(json, "path");
+        json_string_n(json, module.path.data(), module.path.size());
+        json_end_object(json);
+    }
+    json_end_array(json);
+
+    json_key(json, "secondaryCrashes");
+    json_begin_array(json);
+    for (const CrashRecordSecondary& entry : record.secondary_crashes) {
+        json_begin_object(json);
+        json_key(json, "tid");
+        json_int(json, entry.tid);
+        json_key(json, "signal");
+        json_int(json, entry.signal);
+        json_key(json, "code");
+        json_int(json, entry.code);
+        json_key(json, "faultAddress");
+        json_hex(json, entry.fault_address);
+        json_key(json, "pc");
+        json_hex(json, entry.pc);
+        json_end_object(json);
+    }
+    json_end_array(json);
+
+    // Last, so a document cut short by its buffer loses the memory rather than the frames
+    if (!record.memory.empty()) {
+        json_key(json, "memory");
+        json_begin_object(json);
+        json_key(json, "address");
+        json_hex(json, record.memory_start);
+        json_key(json, "base64");
+        json_base64_bytes(json, record.memory.data(), record.memory.size());
+        json_key(json, "unreadable");
+        json_begin_array(json);
+        for (const CrashRecordMemoryRange& range : record.memory_unreadable) {
+            json_begin_object(json);
+            json_key(json, "address");
+            json_hex(json, range.start);
+            json_key(json, "length");
+            json_uint(json, range.length);
+            json_end_object(json);
+        }
+        json_end_array(json);
+        json_end_object(json);
+    }
+    json_end_object(json);
+}
+
+static inline std::string crash_record_to_json(const CrashRecord& record, const char* const* frame_symbols) {
+    // Sized for the record up front; grown only if a symbol or path is unusually long
+    size_t capacity = 1024 + record.frames.size() * 160 + record.registers.size() * 40 + record.modules.size() * 320 +
+                      record.secondary_crashes.size() * 128 + base64_encoded_length(record.memory.size()) +
+                      record.memory_unreadable.size() * 48;
+    std::string out;
+    for (int attempt = 0; attempt < 4; attempt++, capacity *= 2) {
+        out.resize(capacity);
+        FormatBuffer fmt;
+        fmt_init(&fmt, &out[0], out.size());
+        JsonWriter json;
+        json_writer_init(&json, &fmt);
+        crash_record_write_json(&json, record, frame_symbols);
+        bool complete = json_finish(&json);
+        out.resize(fmt.length);
+        if (complete) {
+            break;
+        }
+    }
+    return out;
+}
+
+// ---- Modified UTF-8 ----
+
+// bytes as the modified UTF-8 JNI's NewStringUTF() requires. Thread names,
+// module paths and symbol names are whatever bytes the process held, so
+// sequences that are not well-formed UTF-8 become U+FFFD, as json_escape()
+// writes them; NUL becomes C0 80, and code points past U+FFFF a surrogate
+// pair of 3-byte sequences.
+static inline std::string crash_record_modified_utf8(const char* bytes, size_t length) {
+    const unsigned char* s = (const unsigned char*)bytes;
+    size_t i = 0;
+    while (i < length && s[i] != 0 && s[i] < 0x80) {
+        i++;
+    }
+    std::string out(bytes, i);
+    if (i == length) {
+        return out;
+    }
+    out.reserve(length + 16);
+    while (i < length) {
+        unsigned char c = s[i];
+        size_t run = c == 0 ? 0 : c < 0x80 ? 1 : json_utf8_sequence_length(s + i, length - i);
+        if (c == 0) {
+            out.append("\xc0\x80", 2);
+            i++;
+        } else if (run == 0) {
+            out.append("\xef\xbf\xbd", 3);
+            i++;
+        } else if (run < 4) {
+            out.append(bytes + i, run);
+            i += run;
+        } else {
+            uint32_t code_point = ((uint32_t)(c & 0x07) << 18) | ((uint32_t)(s[i + 1] & 0x3f) << 12) |
+                                  ((uint32_t)(s[i + 2] & 0x3f) << 6) | (uint32_t)(s[i + 3] & 0x3f);
+            code_point -= 0x10000;
+            uint32_t surrogates[2] = { 0xd800 + (code_point >> 10), 0xdc00 + (code_point & 0x3ff) };
+            for (uint32_t surrogate : surrogates) {
+                out.push_back((char)(0xe0 | (surrogate >> 12)));
+                out.push_back((char)(0x80 | ((surrogate >> 6) & 0x3f)));
+                out.push_back((char)(0x80 | (surrogate & 0x3f)));
+            }
+            i += 4;
+        }
+    }
+    return out;
+}
+
+static inline std::string crash_record_modified_utf8(const std::string& bytes) {
+    return crash_record_modified_utf8(bytes.data(), bytes.size());
+}
+
+#endif // CRASHREPORTER_CRASH_RECORD_DECODER_H
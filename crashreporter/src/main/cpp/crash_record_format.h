@@ -0,0 +1,290 @@
+/**
+ * Binary crash record format
+ *
+ * The record the handler stores for each crash (a journal slot body, see
+ * crash_journal.h). Writing it is mostly fixed-size stores and memcpy: no
+ * number formatting, and the registers and memory dump are copied as is.
+ * Frames are offsets into modules, as varints, so a record is several times
+ * smaller than the text it replaces. crash_record_decoder.h reads it back
+ * in one pass, for the app on the next launch (over JNI) and host tools.
+ *
+ * Layout (little-endian):
+ *
+ *   CrashRecordHeader
+ *   sections up to header.record_length, each:
+ *     u8 type, u32 payload length, payload
+ *
+ * Every section is optional, and the decoder skips types it does not know.
+ * Varints are unsigned LEB128.
+ *
+ *   THREAD_NAME  UTF-8 bytes
+ *   FRAMES       varint count, then per frame: varint module index + 1 and
+ *                varint offset into the module (0 and the absolute pc for a
+ *                frame outside every module)
+ *   REGISTERS    the register block of header.arch (CrashRecordArchInfo),
+ *                pointer-sized words
+ *   ADDRESSES    values that point into a module, per entry: varint
+ *                register index + 1 (0: fault address), varint module index,
+ *                varint offset
+ *   MODULES      modules referenced above, per entry: varint index, varint
+ *                load bias, u8 build-id length, build-id, varint path
+ *                length, path
+ *   SECONDARY    other threads that crashed concurrently, per entry: varint
+ *                tid, varint signal, zigzag varint si_code, varint fault
+ *                address, varint pc
+ *   MEMORY       varint start address, varint length, the bytes, then varint
+ *                count of unreadable ranges and per range varint offset from
+ *                start, varint length
+ *
+ * New sections and new trailing header fields (header_size) are compatible
+ * changes; CRASH_RECORD_VERSION only changes when an existing field or
+ * section changes meaning.
+ */
+
+#ifndef CRASHREPORTER_CRASH_RECORD_FORMAT_H
+#define CRASHREPORTER_CRASH_RECORD_FORMAT_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "signal_safe_format.h"
+
+#define CRASH_RECORD_MAGIC 0x4252434e     // "NCRB"
+#define CRASH_RECORD_VERSION 1
+
+#define CRASH_RECORD_SECTION_THREAD_NAME 1
+#define CRASH_RECORD_SECTION_FRAMES 2
+#define CRASH_RECORD_SECTION_REGISTERS 3
+#define CRASH_RECORD_SECTION_ADDRESSES 4
+#define CRASH_RECORD_SECTION_MODULES 5
+#define CRASH_RECORD_SECTION_SECONDARY 6
+#define CRASH_RECORD_SECTION_MEMORY 7
+
+// Section header: u8 type + u32 payload length
+#define CRASH_RECORD_SECTION_HEADER_SIZE 5
+
+// Header flags
+#define CRASH_RECORD_FLAG_TRUNCATED 0x1     // The record did not fit its buffer; the last section is cut short
+
+#define CRASH_RECORD_ARCH_UNKNOWN 0
+#define CRASH_RECORD_ARCH_ARM64 1
+#define CRASH_RECORD_ARCH_ARM 2
+#define CRASH_RECORD_ARCH_X86_64 3
+#define CRASH_RECORD_ARCH_X86 4
+
+// Largest register block of any architecture
+#define CRASH_RECORD_MAX_REGISTERS 34
+
+struct CrashRecordHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t record_length;     // Header and all sections; set when the record is complete
+    uint8_t arch;               // CRASH_RECORD_ARCH_*
+    uint8_t unwind_method;      // UnwindMethod
+    uint8_t flags;              // CRASH_RECORD_FLAG_*
+    uint8_t reserved;
+    int32_t signal;
+    int32_t code;
+    int32_t pid;
+    int32_t tid;
+    int64_t crash_time;
+    uint64_t fault_address;
+};
+
+static_assert(sizeof(CrashRecordHeader) == 48, "crash record header layout");
+
+// Register block of an architecture and the roles of its registers
+struct CrashRecordArchInfo {
+    uint8_t pointer_size;
+    uint8_t register_count;
+    int8_t pc;                  // Indexes into the block; -1 if the architecture has none
+    int8_t sp;
+    int8_t lr;
+    const char* const* names;
+};
+
+static const char* const kCrashRecordRegistersArm64[] = {
+    "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+    "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "x30",
+    "sp", "pc", "cpsr"
+};
+static const char* const kCrashRecordRegistersArm[] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "cpsr"
+};
+static const char* const kCrashRecordRegistersX86_64[] = {
+    "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+    "rip", "eflags"
+};
+static const char* const kCrashRecordRegistersX86[] = {
+    "eax", "ebx", "ecx", "edx", "esi", "edi", "ebp", "esp", "eip", "eflags"
+};
+
+static const CrashRecordArchInfo kCrashRecordArchs[] = {
+    { 0, 0, -1, -1, -1, nullptr },
+    { 8, 34, 32, 31, 30, kCrashRecordRegistersArm64 },
+    { 4, 17, 15, 13, 14, kCrashRecordRegistersArm },
+    { 8, 18, 16, 7, -1, kCrashRecordRegistersX86_64 },
+    { 4, 10, 8, 7, -1, kCrashRecordRegistersX86 },
+};
+
+static inline const CrashRecordArchInfo* crash_record_arch_info(uint8_t arch) {
+    return &kCrashRecordArchs[arch < sizeof(kCrashRecordArchs) / sizeof(kCrashRecordArchs[0]) ? arch : 0];
+}
+
+static inline const char* crash_record_arch_name(uint8_t arch) {
+    static const char* const kNames[] = { "unknown", "arm64", "arm", "x86_64", "x86" };
+    return kNames[arch < sizeof(kNames) / sizeof(kNames[0]) ? arch : 0];
+}
+
+#if defined(__aarch64__)
+#define CRASH_RECORD_ARCH_NATIVE CRASH_RECORD_ARCH_ARM64
+#elif defined(__arm__)
+#define CRASH_RECORD_ARCH_NATIVE CRASH_RECORD_ARCH_ARM
+#elif defined(__x86_64__)
+#define CRASH_RECORD_ARCH_NATIVE CRASH_RECORD_ARCH_X86_64
+#elif defined(__i386__)
+#define CRASH_RECORD_ARCH_NATIVE CRASH_RECORD_ARCH_X86
+#else
+#define CRASH_RECORD_ARCH_NATIVE CRASH_RECORD_ARCH_UNKNOWN
+#endif
+
+// Fill the native architecture's register block from the signal context; returns its size in registers
+static inline size_t crash_record_capture_registers(const void* context, uintptr_t* registers) {
+    if (!context) {
+        return 0;
+    }
+    const ucontext_t* uc = (const ucontext_t*)context;
+
+#if defined(__aarch64__)
+    for (int i = 0; i < 31; i++) {
+        registers[i] = uc->uc_mcontext.regs[i];
+    }
+    registers[31] = uc->uc_mcontext.sp;
+    registers[32] = uc->uc_mcontext.pc;
+    registers[33] = uc->uc_mcontext.pstate;
+#elif defined(__arm__)
+    // r0-r10, fp, ip, sp, lr, pc and cpsr are laid out in order
+    const unsigned long* gregs = &uc->uc_mcontext.arm_r0;
+    for (int i = 0; i < 17; i++) {
+        registers[i] = gregs[i];
+    }
+#elif defined(__x86_64__)
+    static const int kOrder[] = {
+        REG_RAX, REG_RBX, REG_RCX, REG_RDX, REG_RSI, REG_RDI, REG_RBP, REG_RSP, REG_R8, REG_R9, REG_R10, REG_R11,
+        REG_R12, REG_R13, REG_R14, REG_R15, REG_RIP, REG_EFL
+    };
+    for (int i = 0; i < 18; i++) {
+        registers[i] = (uintptr_t)uc->uc_mcontext.gregs[kOrder[i]];
+    }
+#elif defined(__i386__)
+    static const int kOrder[] = {
+        REG_EAX, REG_EBX, REG_ECX, REG_EDX, REG_ESI, REG_EDI, REG_EBP, REG_ESP, REG_EIP, REG_EFL
+    };
+    for (int i = 0; i < 10; i++) {
+        registers[i] = (uintptr_t)uc->uc_mcontext.gregs[kOrder[i]];
+    }
+#else
+    (void)uc;
+    (void)registers;
+#endif
+    return crash_record_arch_info(CRASH_RECORD_ARCH_NATIVE)->register_count;
+}
+
+// ---- Encoding (async-signal-safe) ----
+
+static inline void crash_record_put_varint(FormatBuffer* fmt, uint64_t value) {
+    char bytes[10];
+    size_t length = 0;
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[length++] = (char)(byte | (value ? 0x80 : 0));
+    } while (value);
+    fmt_append_bytes(fmt, bytes, length);
+}
+
+static inline void crash_record_put_zigzag(FormatBuffer* fmt, int64_t value) {
+    crash_record_put_varint(fmt, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+// Start the record with its header (record_length and flags are set by crash_record_finish)
+static inline void crash_record_begin(FormatBuffer* fmt, const CrashRecordHeader* header) {
+    fmt_append_bytes(fmt, (const char*)header, sizeof(*header));
+}
+
+// Open a section; returns the position to pass to crash_record_end_section
+static inline size_t crash_record_begin_section(FormatBuffer* fmt, uint8_t type) {
+    char section[CRASH_RECORD_SECTION_HEADER_SIZE] = { (char)type, 0, 0, 0, 0 };
+    size_t start = fmt->length;
+    fmt_append_bytes(fmt, section, sizeof(section));
+    return start;
+}
+
+// Close a section by storing the length of what was appended since it was opened
+static inline void crash_record_end_section(FormatBuffer* fmt, size_t start) {
+    if (start + CRASH_RECORD_SECTION_HEADER_SIZE > fmt->length) {
+        return;
+    }
+    uint32_t length = (uint32_t)(fmt->length - start - CRASH_RECORD_SECTION_HEADER_SIZE);
+    memcpy(fmt->data + start + 1, &length, sizeof(length));
+}
+
+static inline void crash_record_finish(FormatBuffer* fmt) {
+    if (fmt->length < sizeof(CrashRecordHeader)) {
+        return;
+    }
+    uint32_t length = (uint32_t)fmt->length;
+    memcpy(fmt->data + offsetof(CrashRecordHeader, record_length), &length, sizeof(length));
+    if (fmt->truncated) {
+        fmt->data[offsetof(CrashRecordHeader, flags)] |= CRASH_RECORD_FLAG_TRUNCATED;
+    }
+}
+
+// Start a record for a crash in this process (fields beyond these default to zero)
+static inline void crash_record_init_header(CrashRecordHeader* header, int signal, int code, uintptr_t fault_address,
+                                            int pid, int tid, int64_t crash_time, int unwind_method) {
+    memset(header, 0, sizeof(*header));
+    header->magic = CRASH_RECORD_MAGIC;
+    header->version = CRASH_RECORD_VERSION;
+    header->header_size = sizeof(*header);
+    header->arch = CRASH_RECORD_ARCH_NATIVE;
+    header->unwind_method = (uint8_t)unwind_method;
+    header->signal = signal;
+    header->code = code;
+    header->pid = pid;
+    header->tid = tid;
+    header->crash_time = crash_time;
+    header->fault_address = fault_address;
+}
+
+// ---- Shared by the handler and the decoder ----
+
+static inline const char* crash_signal_name(int sig) {
+    switch (sig) {
+        case SIGSEGV: return "SIGSEGV";
+        case SIGABRT: return "SIGABRT";
+        case SIGFPE:  return "SIGFPE";
+        case SIGILL:  return "SIGILL";
+        case SIGBUS:  return "SIGBUS";
+        case SIGTRAP: return "SIGTRAP";
+        default:      return "UNKNOWN";
+    }
+}
+
+static inline const char* crash_signal_description(int sig) {
+    switch (sig) {
+        case SIGSEGV: return "Segmentation fault (invalid memory access)";
+        case SIGABRT: return "Abort signal (abnormal termination)";
+        case SIGFPE:  return "Floating point exception";
+        case SIGILL:  return "Illegal instruction";
+        case SIGBUS:  return "Bus error (invalid memory alignment)";
+        case SIGTRAP: return "Trace/breakpoint trap";
+        default:      return "Unknown signal";
+    }
+}
+
+#endif // CRASHREPORTER_CRASH_RECORD_FORMAT_H
@@ -0,0 +1,276 @@
+/**
+ * Crash record JNI bridge
+ *
+ * Fills a NativeCrashHandler.NativeCrashReport from a decoded record
+ * (crash_record_decoder.h) in one native call, so the app does not render
+ * the record as text only to split and re-parse it line by line. Every
+ * array is allocated at its final size and filled in place.
+ *
+ * Records arrive as direct ByteBuffers over the memory-mapped journal, so
+ * they are decoded in place without first being copied onto the Java heap.
+ * crash_record_jni_to_json() renders one as the JSON document the app
+ * uploads verbatim.
+ *
+ * The bodies of NativeCrashHandler's next-launch methods (nativeSymbolize,
+ * nativeDecodeRecord, nativeParseRecord, nativeRecordToJson,
+ * nativeChecksum) live here too, so both handler builds export the same
+ * implementation through thin JNI wrappers.
+ *
+ * Field names and signatures must match NativeCrashReport's @JvmField
+ * properties. A missing field leaves a NoSuchFieldError pending and the
+ * fill fails.
+ *
+ * Not async-signal-safe.
+ */
+
+#ifndef CRASHREPORTER_CRASH_RECORD_JNI_H
+#define CRASHREPORTER_CRASH_RECORD_JNI_H
+
+#include <android/log.h>
+#include <jni.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "crash_record_decoder.h"
+#include "crash_record_format.h"
+#include "crc32.h"
+#include "demangle_cache.h"
+#include "symbol_cache.h"
+
+// A direct buffer's bytes, in place; false for a heap buffer
+static inline bool crash_record_jni_buffer(JNIEnv* env, jobject buffer, const void** data, size_t* size) {
+    void* address = buffer ? env->GetDirectBufferAddress(buffer) : nullptr;
+    jlong capacity = address ? env->GetDirectBufferCapacity(buffer) : -1;
+    if (capacity < 0) {
+        return false;
+    }
+    *data = address;
+    *size = (size_t)capacity;
+    return true;
+}
+
+// Decode the record a direct buffer holds, in place
+static inline bool crash_record_jni_decode(JNIEnv* env, jobject buffer, CrashRecord* record) {
+    const void* data = nullptr;
+    size_t size = 0;
+    size_t consumed = 0;
+    return crash_record_jni_buffer(env, buffer, &data, &size) && crash_record_decode(data, size, record, &consumed);
+}
+
+// A String from record bytes. NewStringUTF() takes modified UTF-8 only, and
+// aborts under CheckJNI on anything else, such as a thread name cut mid-character.
+static inline jstring crash_record_jni_string(JNIEnv* env, const std::string& bytes) {
+    return env->NewStringUTF(crash_record_modified_utf8(bytes).c_str());
+}
+
+static inline bool crash_record_jni_set_string(JNIEnv* env, jobject report, jclass cls, const char* field,
+                                               const std::string& value) {
+    jfieldID id = env->GetFieldID(cls, field, "Ljava/lang/String;");
+    jstring string = id ? crash_record_jni_string(env, value) : nullptr;
+    if (!string) {
+        return false;
+    }
+    env->SetObjectField(report, id, string);
+    env->DeleteLocalRef(string);
+    return true;
+}
+
+static inline bool crash_record_jni_set_strings(JNIEnv* env, jobject report, jclass cls, jclass string_class,
+                                                const char* field, const std::vector<std::string>& values) {
+    jfieldID id = env->GetFieldID(cls, field, "[Ljava/lang/String;");
+    jobjectArray array = id ? env->NewObjectArray((jsize)values.size(), string_class, nullptr) : nullptr;
+    if (!array) {
+        return false;
+    }
+    for (size_t i = 0; i < values.size(); i++) {
+        jstring string = crash_record_jni_string(env, values[i]);
+        if (!string) {
+            env->DeleteLocalRef(array);
+            return false;
+        }
+        env->SetObjectArrayElement(array, (jsize)i, string);
+        env->DeleteLocalRef(string);
+    }
+    env->SetObjectField(report, id, array);
+    env->DeleteLocalRef(array);
+    return true;
+}
+
+static inline bool crash_record_jni_set_longs(JNIEnv* env, jobject report, jclass cls, const char* field,
+                                              const std::vector<int64_t>& values) {
+    jfieldID id = env->GetFieldID(cls, field, "[J");
+    jlongArray array = id ? env->NewLongArray((jsize)values.size()) : nullptr;
+    if (!array) {
+        return false;
+    }
+    env->SetLongArrayRegion(array, 0, (jsize)values.size(), (const jlong*)values.data());
+    env->SetObjectField(report, id, array);
+    env->DeleteLocalRef(array);
+    return true;
+}
+
+static inline bool crash_record_jni_set_ints(JNIEnv* env, jobject report, jclass cls, const char* field,
+                                             const std::vector<int32_t>& values) {
+    jfieldID id = env->GetFieldID(cls, field, "[I");
+    jintArray array = id ? env->NewIntArray((jsize)values.size()) : nullptr;
+    if (!array) {
+        return false;
+    }
+    env->SetIntArrayRegion(array, 0, (jsize)values.size(), (const jint*)values.data());
+    env->SetObjectField(report, id, array);
+    env->DeleteLocalRef(array);
+    return true;
+}
+
+// Copy a decoded record into report. Frames keep their module + offset, with the
+// module as a position in modulePaths/moduleBuildIds (-1 when the record does
+// not list it), for the app to symbolize.
+static inline bool crash_record_fill_report(JNIEnv* env, const CrashRecord& record, jobject report) {
+    jclass cls = env->GetObjectClass(report);
+    jclass string_class = env->FindClass("java/lang/String");
+    if (!cls || !string_class) {
+        return false;
+    }
+    CrashRecordReport fields;
+    crash_record_report(record, &fields);
+    const char* description = crash_signal_description(record.header.signal);
+
+    jfieldID truncated = env->GetFieldID(cls, "truncated", "Z");
+    if (!truncated) {
+        return false;
+    }
+    env->SetBooleanField(report, truncated, record.truncated ? JNI_TRUE : JNI_FALSE);
+
+    return crash_record_jni_set_string(env, report, cls, "signal", fields.signal) &&
+           crash_record_jni_set_string(env, report, cls, "description", description) &&
+           crash_record_jni_set_string(env, report, cls, "faultAddress", fields.fault_address) &&
+           crash_record_jni_set_string(env, report, cls, "threadName", record.thread_name) &&
+           crash_record_jni_set_strings(env, report, cls, string_class, "registerNames", fields.register_names) &&
+           crash_record_jni_set_strings(env, report, cls, string_class, "registerValues", fields.register_values) &&
+           crash_record_jni_set_strings(env, report, cls, string_class, "secondaryCrashes", fields.secondary_crashes) &&
+           crash_record_jni_set_string(env, report, cls, "memoryDump", fields.memory_dump) &&
+           crash_record_jni_set_longs(env, report, cls, "framePcs", fields.frame_pcs) &&
+           crash_record_jni_set_ints(env, report, cls, "frameModules", fields.frame_modules) &&
+           crash_record_jni_set_longs(env, report, cls, "frameOffsets", fields.frame_offsets) &&
+           crash_record_jni_set_strings(env, report, cls, string_class, "modulePaths", fields.module_paths) &&
+           crash_record_jni_set_strings(env, report, cls, string_class, "moduleBuildIds", fields.module_build_ids);
+}
+
+// The record a direct buffer holds as its JSON document (crash_record_to_json()), with
+// the frame symbols the app resolved: a String?[] with one entry per frame, or null
+static inline jstring crash_record_jni_to_json(JNIEnv* env, jobject buffer, jobjectArray symbols) {
+    CrashRecord record;
+    if (!crash_record_jni_decode(env, buffer, &record)) {
+        return nullptr;
+    }
+    size_t count = record.frames.size();
+    std::vector<std::string> names;
+    std::vector<const char*> frame_symbols(count, nullptr);
+    if (symbols && (size_t)env->GetArrayLength(symbols) == count) {
+        names.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            jstring symbol = (jstring)env->GetObjectArrayElement(symbols, (jsize)i);
+            const char* utf = symbol ? env->GetStringUTFChars(symbol, nullptr) : nullptr;
+            if (utf) {
+                names[i] = utf;
+                frame_symbols[i] = names[i].c_str();
+                env->ReleaseStringUTFChars(symbol, utf);
+            }
+            if (symbol) {
+                env->DeleteLocalRef(symbol);
+            }
+        }
+    }
+    return crash_record_jni_string(env, crash_record_to_json(record, frame_symbols.data()));
+}
+
+// Demangled names of recent symbolizations; batches of records repeat the same frames
+static DemangleCache g_demangle_cache;
+static pthread_mutex_t g_demangle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Resolve "[index]+0xoffset" frames of a previous session's record against the
+// module file: one demangled "symbol+0xdelta" (or null) per offset. Runs on the next launch.
+// A non-empty build_id must match the file, or nothing is resolved; app libraries'
+// symbol indexes are cached under cache_dir by build-id.
+static inline jobjectArray crash_record_jni_symbolize(JNIEnv* env, const char* log_tag, jstring module_path,
+                                                      jstring build_id, jstring cache_dir, jlongArray offsets) {
+    jsize count = env->GetArrayLength(offsets);
+    jobjectArray result = env->NewObjectArray(count, env->FindClass("java/lang/String"), nullptr);
+    if (!result) {
+        return nullptr;
+    }
+
+    const char* path = env->GetStringUTFChars(module_path, nullptr);
+    const char* build_id_hex = env->GetStringUTFChars(build_id, nullptr);
+    const char* cache_dir_str = env->GetStringUTFChars(cache_dir, nullptr);
+    SymbolIndex index;
+    std::string image;
+    bool loaded = path && build_id_hex && cache_dir_str &&
+                  symbol_cache_load(cache_dir_str, path, build_id_hex, &index, &image);
+    if (path && build_id_hex && !loaded) {
+        __android_log_print(ANDROID_LOG_INFO, log_tag, "Not symbolizing %s: unreadable, or not the build that crashed",
+                            path);
+    }
+    if (path) env->ReleaseStringUTFChars(module_path, path);
+    if (build_id_hex) env->ReleaseStringUTFChars(build_id, build_id_hex);
+    if (cache_dir_str) env->ReleaseStringUTFChars(cache_dir, cache_dir_str);
+    if (!loaded) {
+        return result;
+    }
+
+    jlong* values = env->GetLongArrayElements(offsets, nullptr);
+    if (values) {
+        pthread_mutex_lock(&g_demangle_lock);
+        for (jsize i = 0; i < count; i++) {
+            uint64_t start = 0;
+            const SymbolIndexEntry* symbol = symbol_index_lookup(&index, (uint64_t)values[i], &start);
+            if (!symbol) {
+                continue;
+            }
+            char delta[24];
+            snprintf(delta, sizeof(delta), "+0x%llx", (unsigned long long)((uint64_t)values[i] - start));
+            const char* demangled = demangle_cache_lookup(&g_demangle_cache, symbol_index_name(&index, symbol));
+            std::string name = std::string(demangled) + delta;
+            jstring value = crash_record_jni_string(env, name);
+            env->SetObjectArrayElement(result, i, value);
+            env->DeleteLocalRef(value);
+        }
+        pthread_mutex_unlock(&g_demangle_lock);
+        env->ReleaseLongArrayElements(offsets, values, JNI_ABORT);
+    }
+    symbol_index_unmap(&index);
+    return result;
+}
+
+// Decode a binary crash record (crash_record_format.h) into the text layout the symbolizer reads;
+// null if the buffer does not hold a binary record
+static inline jstring crash_record_jni_to_text(JNIEnv* env, jobject buffer) {
+    CrashRecord record;
+    if (!crash_record_jni_decode(env, buffer, &record)) {
+        return nullptr;
+    }
+    return crash_record_jni_string(env, crash_record_to_text(record));
+}
+
+// Decode a binary crash record straight into a NativeCrashReport;
+// false if the buffer does not hold a binary record or a field could not be set
+static inline jboolean crash_record_jni_parse(JNIEnv* env, jobject buffer, jobject report) {
+    CrashRecord record;
+    return crash_record_jni_decode(env, buffer, &record) && crash_record_fill_report(env, record, report) ? JNI_TRUE
+                                                                                                         : JNI_FALSE;
+}
+
+// CRC-32 of a direct buffer's contents, as the journal stores it; -1 for a heap buffer
+static inline jlong crash_record_jni_checksum(JNIEnv* env, jobject buffer) {
+    const void* data = nullptr;
+    size_t size = 0;
+    if (!crash_record_jni_buffer(env, buffer, &data, &size)) {
+        return -1;
+    }
+    return (jlong)crc32_update(0, data, size);
+}
+
+#endif // CRASHREPORTER_CRASH_RECORD_JNI_H
@@ -0,0 +1,81 @@
+/**
+ * Crash record assembly and flushing
+ *
+ * The signal handler formats the complete record into a buffer reserved at
+ * initialize() time (or straight into the mapped journal slot) and hands it
+ * to the kernel as one contiguous span, instead of issuing one write() per
+ * line, register or byte.
+ */
+
+#ifndef CRASHREPORTER_CRASH_RECORD_WRITER_H
+#define CRASHREPORTER_CRASH_RECORD_WRITER_H
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "signal_safe_format.h"
+
+struct CrashRecordWriter {
+    FormatBuffer fmt;           // Backing arena (pre-reserved); the record is fmt.data[0, fmt.length)
+};
+
+// Touch every page of the arena so the crash path never takes a page fault on it
+static inline void record_writer_reserve(char* storage, size_t capacity) {
+    memset(storage, 0, capacity);
+}
+
+static inline void record_writer_init(CrashRecordWriter* writer, char* storage, size_t capacity) {
+    fmt_init(&writer->fmt, storage, capacity);
+}
+
+// Write the record, retrying on EINTR and partial writes.
+// Returns false if the kernel refused to accept the full record.
+static inline bool record_writer_flush(const CrashRecordWriter* writer, int fd) {
+    const char* p = writer->fmt.data;
+    size_t len = writer->fmt.length;
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (written == 0) {
+            return false;
+        }
+        p += written;
+        len -= (size_t)written;
+    }
+    return true;
+}
+
+// pwrite() a block fully at the given offset, retrying on EINTR and short writes
+static inline bool pwrite_fully(int fd, const void* data, size_t len, off_t offset) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (written == 0) {
+            return false;
+        }
+        p += written;
+        len -= (size_t)written;
+        offset += written;
+    }
+    return true;
+}
+
+// Write the record at offset as one span, retrying on EINTR and short writes
+static inline bool record_writer_flush_at(const CrashRecordWriter* writer, int fd, off_t offset) {
+    return pwrite_fully(fd, writer->fmt.data, writer->fmt.length, offset);
+}
+
+#endif // CRASHREPORTER_CRASH_RECORD_WRITER_H
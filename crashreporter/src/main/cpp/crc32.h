@@ -0,0 +1,40 @@
+/**
+ * CRC-32 (IEEE 802.3, same as java.util.zip.CRC32)
+ *
+ * The lookup table is built at compile time, so checksumming is safe to use
+ * from a signal handler.
+ */
+
+#ifndef CRASHREPORTER_CRC32_H
+#define CRASHREPORTER_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Crc32Table {
+    uint32_t entries[256];
+
+    constexpr Crc32Table() : entries() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+static constexpr Crc32Table kCrc32Table;
+
+// Continue a running CRC (pass 0 to start a new one)
+static inline uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = kCrc32Table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif // CRASHREPORTER_CRC32_H
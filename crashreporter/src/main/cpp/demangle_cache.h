@@ -0,0 +1,163 @@
+/**
+ * Memoizing C++ demangler
+ *
+ * Symbolized frames are demangled before they reach crash grouping, so
+ * fingerprints hash readable, stable names. Batches of crash records repeat
+ * the same frames heavily, and __cxa_demangle() is expensive (a parse and
+ * several allocations per name), so results are memoized. The cache is
+ * bounded: keys and results live in fixed arenas indexed by open-addressing
+ * tables, in two generations so that a full cache drops its cold entries
+ * and keeps the hot ones.
+ *
+ * Not async-signal-safe and not thread-safe: callers serialize access.
+ */
+
+#ifndef CRASHREPORTER_DEMANGLE_CACHE_H
+#define CRASHREPORTER_DEMANGLE_CACHE_H
+
+#include <cxxabi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+// Bytes of mangled and demangled names held by one generation
+#ifndef DEMANGLE_CACHE_ARENA_SIZE
+#define DEMANGLE_CACHE_ARENA_SIZE (512 * 1024)
+#endif
+
+// Hash table slots per generation (power of two); a generation is full at 3/4 occupancy
+#ifndef DEMANGLE_CACHE_SLOTS
+#define DEMANGLE_CACHE_SLOTS 8192
+#endif
+
+struct DemangleCacheSlot {
+    uint64_t hash;              // 0: empty
+    uint32_t mangled_offset;    // Into the generation's arena
+    uint32_t demangled_offset;
+};
+
+struct DemangleCacheGeneration {
+    DemangleCacheSlot slots[DEMANGLE_CACHE_SLOTS];
+    size_t slots_used;
+    size_t arena_used;
+    char arena[DEMANGLE_CACHE_ARENA_SIZE];
+};
+
+// Two generations: new entries go to the current one; when it fills up it
+// becomes the previous one (dropping the older), and names still in use are
+// copied forward on their next hit. Hot frames survive, the tail ages out.
+struct DemangleCache {
+    DemangleCacheGeneration generations[2];
+    int current;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+static inline uint64_t demangle_cache_hash(const char* name, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;   // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 1099511628211ULL;
+    }
+    return hash | 1;
+}
+
+static inline void demangle_cache_clear(DemangleCacheGeneration* generation) {
+    memset(generation->slots, 0, sizeof(generation->slots));
+    generation->slots_used = 0;
+    generation->arena_used = 0;
+}
+
+static inline void demangle_cache_reset(DemangleCache* cache) {
+    demangle_cache_clear(&cache->generations[0]);
+    demangle_cache_clear(&cache->generations[1]);
+    cache->current = 0;
+}
+
+// Slot holding name, or the empty slot where it would go
+static inline DemangleCacheSlot* demangle_cache_find(DemangleCacheGeneration* generation, const char* name,
+                                                     uint64_t hash) {
+    size_t mask = DEMANGLE_CACHE_SLOTS - 1;
+    size_t slot = (size_t)hash & mask;
+    for (; generation->slots[slot].hash != 0; slot = (slot + 1) & mask) {
+        const DemangleCacheSlot* entry = &generation->slots[slot];
+        if (entry->hash == hash && strcmp(generation->arena + entry->mangled_offset, name) == 0) {
+            break;
+        }
+    }
+    return &generation->slots[slot];
+}
+
+static inline uint32_t demangle_cache_store(DemangleCacheGeneration* generation, const char* str, size_t length) {
+    uint32_t offset = (uint32_t)generation->arena_used;
+    memcpy(generation->arena + offset, str, length);
+    generation->arena[offset + length] = '\0';
+    generation->arena_used += length + 1;
+    return offset;
+}
+
+// Add name -> result to the current generation, rotating generations when it is full
+static inline const char* demangle_cache_insert(DemangleCache* cache, const char* name, size_t length, uint64_t hash,
+                                                const char* result) {
+    bool same = result == name;
+    size_t result_length = same ? 0 : strlen(result);
+    size_t needed = length + 1 + (same ? 0 : result_length + 1);
+    if (needed > DEMANGLE_CACHE_ARENA_SIZE) {
+        return nullptr;
+    }
+
+    DemangleCacheGeneration* generation = &cache->generations[cache->current];
+    if (generation->arena_used + needed > DEMANGLE_CACHE_ARENA_SIZE ||
+        (generation->slots_used + 1) * 4 > DEMANGLE_CACHE_SLOTS * 3) {
+        cache->current ^= 1;
+        generation = &cache->generations[cache->current];
+        demangle_cache_clear(generation);
+    }
+
+    DemangleCacheSlot* entry = demangle_cache_find(generation, name, hash);
+    entry->mangled_offset = demangle_cache_store(generation, name, length);
+    entry->demangled_offset = same ? entry->mangled_offset : demangle_cache_store(generation, result, result_length);
+    entry->hash = hash;
+    generation->slots_used++;
+    return generation->arena + entry->demangled_offset;
+}
+
+// Demangled form of name, or name itself when it is not a mangled C++ name
+// (or does not demangle). The result is valid until the next call.
+static inline const char* demangle_cache_lookup(DemangleCache* cache, const char* name) {
+    if (strncmp(name, "_Z", 2) != 0) {
+        return name;
+    }
+
+    size_t length = strlen(name);
+    uint64_t hash = demangle_cache_hash(name, length);
+    DemangleCacheGeneration* current = &cache->generations[cache->current];
+    DemangleCacheSlot* entry = demangle_cache_find(current, name, hash);
+    if (entry->hash != 0) {
+        cache->hits++;
+        return current->arena + entry->demangled_offset;
+    }
+
+    DemangleCacheGeneration* previous = &cache->generations[cache->current ^ 1];
+    entry = demangle_cache_find(previous, name, hash);
+    if (entry->hash != 0) {
+        cache->hits++;
+        // Copied out first: promoting may recycle the previous generation
+        std::string result = previous->arena + entry->demangled_offset;
+        const char* promoted = demangle_cache_insert(cache, name, length, hash,
+                                                     entry->demangled_offset == entry->mangled_offset ? name
+                                                                                                      : result.c_str());
+        return promoted ? promoted : name;
+    }
+    cache->misses++;
+
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    const char* stored = demangle_cache_insert(cache, name, length, hash, status == 0 && demangled ? demangled : name);
+    free(demangled);
+    return stored ? stored : name;
+}
+
+#endif // CRASHREPORTER_DEMANGLE_CACHE_H
@@ -0,0 +1,1372 @@
+/**
+ * DWARF line and inline-frame index
+ *
+ * Resolves addresses of an unstripped library to file:line, including the
+ * chain of functions inlined at the address, from .debug_line and the
+ * DW_TAG_subprogram / DW_TAG_inlined_subroutine entries of .debug_info.
+ * DWARF 4 and 5 units are supported (not split DWARF, and not compressed
+ * debug sections).
+ *
+ * Debug files can be hundreds of megabytes, so nothing is read up front:
+ * the file is mmap'ed, opening only reads the first entry of each
+ * compilation unit to learn its address ranges, and a unit's line program
+ * and inline tree are decoded into compact tables the first time a lookup
+ * lands in it. Lookups are answered in batches sorted by address, so each
+ * unit is decoded once and visited once per batch.
+ *
+ * Not async-signal-safe: for next-launch and offline symbolization only.
+ */
+
+#ifndef CRASHREPORTER_DWARF_LINE_INDEX_H
+#define CRASHREPORTER_DWARF_LINE_INDEX_H
+
+#include <elf.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dwarf_reader.h"
+#include "elf_symbolizer.h"
+
+// Tags, attributes and forms used by the index (DWARF 5, section 7)
+#define DW_TAG_class_type         0x02
+#define DW_TAG_enumeration_type   0x04
+#define DW_TAG_structure_type     0x13
+#define DW_TAG_union_type         0x17
+#define DW_TAG_inlined_subroutine 0x1d
+#define DW_TAG_subprogram         0x2e
+
+#define DW_AT_sibling             0x01
+#define DW_AT_stmt_list           0x10
+#define DW_AT_low_pc              0x11
+#define DW_AT_high_pc             0x12
+#define DW_AT_name                0x03
+#define DW_AT_comp_dir            0x1b
+#define DW_AT_abstract_origin     0x31
+#define DW_AT_specification       0x47
+#define DW_AT_ranges              0x55
+#define DW_AT_call_file           0x58
+#define DW_AT_call_line           0x59
+#define DW_AT_linkage_name        0x6e
+#define DW_AT_str_offsets_base    0x72
+#define DW_AT_addr_base           0x73
+#define DW_AT_rnglists_base       0x74
+#define DW_AT_MIPS_linkage_name   0x2007
+
+#define DW_FORM_addr              0x01
+#define DW_FORM_block2            0x03
+#define DW_FORM_block4            0x04
+#define DW_FORM_data2             0x05
+#define DW_FORM_data4             0x06
+#define DW_FORM_data8             0x07
+#define DW_FORM_string            0x08
+#define DW_FORM_block             0x09
+#define DW_FORM_block1            0x0a
+#define DW_FORM_data1             0x0b
+#define DW_FORM_flag              0x0c
+#define DW_FORM_sdata             0x0d
+#define DW_FORM_strp              0x0e
+#define DW_FORM_udata             0x0f
+#define DW_FORM_ref_addr          0x10
+#define DW_FORM_ref1              0x11
+#define DW_FORM_ref2              0x12
+#define DW_FORM_ref4              0x13
+#define DW_FORM_ref8              0x14
+#define DW_FORM_ref_udata         0x15
+#define DW_FORM_indirect          0x16
+#define DW_FORM_sec_offset        0x17
+#define DW_FORM_exprloc           0x18
+#define DW_FORM_flag_present      0x19
+#define DW_FORM_strx              0x1a
+#define DW_FORM_addrx             0x1b
+#define DW_FORM_ref_sup4          0x1c
+#define DW_FORM_strp_sup          0x1d
+#define DW_FORM_data16            0x1e
+#define DW_FORM_line_strp         0x1f
+#define DW_FORM_ref_sig8          0x20
+#define DW_FORM_implicit_const    0x21
+#define DW_FORM_loclistx          0x22
+#define DW_FORM_rnglistx          0x23
+#define DW_FORM_ref_sup8          0x24
+#define DW_FORM_strx1             0x25
+#define DW_FORM_strx2             0x26
+#define DW_FORM_strx3             0x27
+#define DW_FORM_strx4             0x28
+#define DW_FORM_addrx1            0x29
+#define DW_FORM_addrx2            0x2a
+#define DW_FORM_addrx3            0x2b
+#define DW_FORM_addrx4            0x2c
+#define DW_FORM_GNU_addr_index    0x1f01
+#define DW_FORM_GNU_str_index     0x1f02
+#define DW_FORM_GNU_ref_alt       0x1f20
+#define DW_FORM_GNU_strp_alt      0x1f21
+
+// Unit types of DWARF 5 unit headers
+#define DW_UT_compile             0x01
+#define DW_UT_type                0x02
+#define DW_UT_partial             0x03
+#define DW_UT_skeleton            0x04
+#define DW_UT_split_compile       0x05
+#define DW_UT_split_type          0x06
+
+// Range list entries (.debug_rnglists)
+#define DW_RLE_end_of_list        0x00
+#define DW_RLE_base_addressx      0x01
+#define DW_RLE_startx_endx        0x02
+#define DW_RLE_startx_length      0x03
+#define DW_RLE_offset_pair        0x04
+#define DW_RLE_base_address       0x05
+#define DW_RLE_start_end          0x06
+#define DW_RLE_start_length       0x07
+
+// Line program opcodes
+#define DW_LNS_copy               0x01
+#define DW_LNS_advance_pc         0x02
+#define DW_LNS_advance_line       0x03
+#define DW_LNS_set_file           0x04
+#define DW_LNS_const_add_pc       0x08
+#define DW_LNS_fixed_advance_pc   0x09
+#define DW_LNE_end_sequence       0x01
+#define DW_LNE_set_address        0x02
+#define DW_LNE_define_file        0x03
+#define DW_LNCT_path              0x01
+#define DW_LNCT_directory_index   0x02
+
+// Abbreviation codes above this are not indexed (producers number them densely from 1)
+#define DWARF_MAX_ABBREV_CODE 65536
+
+// Reference chains followed to name a function (abstract origin, specification)
+#define DWARF_MAX_NAME_DEPTH 8
+
+// Row file number marking the end of a sequence
+#define DWARF_END_OF_SEQUENCE UINT32_MAX
+
+struct DwarfSection {
+    const uint8_t* data;
+    size_t size;
+};
+
+struct DwarfSections {
+    DwarfSection info;
+    DwarfSection abbrev;
+    DwarfSection line;
+    DwarfSection line_str;
+    DwarfSection str;
+    DwarfSection str_offsets;
+    DwarfSection addr;
+    DwarfSection ranges;        // DWARF 4
+    DwarfSection rnglists;      // DWARF 5
+};
+
+struct DwarfAbbrevAttr {
+    uint16_t name;
+    uint16_t form;
+    int64_t implicit_const;
+};
+
+struct DwarfAbbrev {
+    uint16_t tag;               // 0: code not defined
+    bool has_children;
+    uint32_t attrs_begin;       // Into DwarfAbbrevTable::attrs
+    uint32_t attrs_count;
+};
+
+// Parsed as far as the codes looked up so far: opening a unit needs only its first entry's
+struct DwarfAbbrevTable {
+    std::vector<DwarfAbbrev> by_code;
+    std::vector<DwarfAbbrevAttr> attrs;
+    DwarfCursor next;           // First abbreviation not parsed yet
+    bool complete;
+};
+
+// One attribute as read; strings and indexed forms are resolved on demand
+struct DwarfValue {
+    uint16_t form;
+    uint64_t value;             // Constant, address, offset, index or reference (section offset)
+    const char* string;         // DW_FORM_string
+};
+
+struct DwarfRange {
+    uint64_t low;
+    uint64_t high;              // Exclusive
+};
+
+struct DwarfLineRow {
+    uint64_t address;
+    uint32_t file;              // DWARF_END_OF_SEQUENCE: no code from address on
+    uint32_t line;
+};
+
+// A subprogram or inlined subroutine with code, in depth-first order
+struct DwarfInlineNode {
+    uint64_t die_offset;        // Named through this entry
+    uint32_t ranges_begin;      // Into DwarfUnitTables::node_ranges
+    uint32_t ranges_count;
+    uint32_t subtree_end;       // First node that is not a descendant
+    uint32_t call_file;         // Call site, for inlined subroutines
+    uint32_t call_line;
+};
+
+struct DwarfFunctionRange {
+    uint64_t low;
+    uint64_t high;
+    uint32_t node;              // Outermost node: the concrete function
+};
+
+// Decoded on first use
+struct DwarfUnitTables {
+    std::vector<std::string> files;             // Indexed by DWARF file number
+    std::vector<DwarfLineRow> rows;             // Sorted by address
+    std::vector<DwarfInlineNode> nodes;
+    std::vector<DwarfRange> node_ranges;
+    std::vector<DwarfFunctionRange> functions;  // Sorted by low
+};
+
+struct DwarfUnit {
+    uint64_t offset;            // Of the unit header in .debug_info
+    uint64_t end;
+    uint64_t die_offset;        // First entry
+    uint64_t abbrev_offset;
+    uint16_t version;
+    uint8_t address_size;
+    uint8_t offset_size;        // 4, or 8 for 64-bit DWARF
+    uint64_t base_address;      // DW_AT_low_pc of the unit, base of its range lists
+    uint64_t str_offsets_base;
+    uint64_t addr_base;
+    uint64_t rnglists_base;
+    bool has_lines;
+    uint64_t stmt_list;
+    const char* comp_dir;
+    std::unique_ptr<DwarfUnitTables> tables;
+};
+
+struct DwarfUnitRange {
+    uint64_t low;
+    uint64_t high;
+    uint32_t unit;
+};
+
+struct DwarfLineIndex {
+    void* mapping;
+    size_t mapping_size;
+    DwarfSections sections;
+    std::vector<DwarfUnit> units;               // By offset
+    std::vector<DwarfUnitRange> unit_ranges;    // Sorted by low
+    std::unordered_map<uint64_t, DwarfAbbrevTable> abbrevs;            // By .debug_abbrev offset
+    std::unordered_map<uint64_t, std::string> names;                   // Function names by DIE offset
+    size_t decoded_units;
+};
+
+// One frame of a resolved address; pointers stay valid while the index is open
+struct DwarfFrame {
+    const char* function;       // Linkage (mangled) name when known, else the plain name; null if unknown
+    const char* file;           // Null if unknown
+    uint32_t line;
+};
+
+struct DwarfLocation {
+    std::vector<DwarfFrame> frames;     // Outermost (the concrete function) first, innermost inlined last
+};
+
+static inline void dwarf_cursor_at(DwarfCursor* cursor, const DwarfSection* section, uint64_t offset) {
+    if (offset > section->size) {
+        dwarf_cursor_init(cursor, section->data, section->data);
+        cursor->ok = false;
+        return;
+    }
+    dwarf_cursor_init(cursor, section->data + offset, section->data + section->size);
+}
+
+// Initial length field: sets *offset_size and returns the unit length
+static inline uint64_t dwarf_read_initial_length(DwarfCursor* cursor, uint8_t* offset_size) {
+    uint64_t length = dwarf_read_u32(cursor);
+    *offset_size = 4;
+    if (length == 0xffffffff) {
+        length = dwarf_read_u64(cursor);
+        *offset_size = 8;
+    } else if (length >= 0xfffffff0) {
+        cursor->ok = false;
+    }
+    return length;
+}
+
+static inline const char* dwarf_read_cstring(DwarfCursor* cursor) {
+    const uint8_t* end = dwarf_has(cursor, 1) ? (const uint8_t*)memchr(cursor->pos, 0, cursor->end - cursor->pos)
+                                              : nullptr;
+    if (!end) {
+        cursor->ok = false;
+        return nullptr;
+    }
+    const char* string = (const char*)cursor->pos;
+    cursor->pos = end + 1;
+    return string;
+}
+
+static inline const char* dwarf_section_string(const DwarfSection* section, uint64_t offset) {
+    if (offset >= section->size || !memchr(section->data + offset, 0, section->size - offset)) {
+        return nullptr;
+    }
+    return (const char*)section->data + offset;
+}
+
+// Read one attribute value of the given form; false on an unknown form
+static bool dwarf_read_value(DwarfCursor* cursor, const DwarfUnit* unit, uint16_t form, int64_t implicit_const,
+                             DwarfValue* value) {
+    value->form = form;
+    value->value = 0;
+    value->string = nullptr;
+    switch (form) {
+        case DW_FORM_addr:          value->value = dwarf_read_fixed(cursor, unit->address_size); break;
+        case DW_FORM_data1:
+        case DW_FORM_ref1:
+        case DW_FORM_flag:
+        case DW_FORM_strx1:
+        case DW_FORM_addrx1:        value->value = dwarf_read_u8(cursor); break;
+        case DW_FORM_data2:
+        case DW_FORM_ref2:
+        case DW_FORM_strx2:
+        case DW_FORM_addrx2:        value->value = dwarf_read_u16(cursor); break;
+        case DW_FORM_strx3:
+        case DW_FORM_addrx3:        value->value = dwarf_read_fixed(cursor, 3); break;
+        case DW_FORM_data4:
+        case DW_FORM_ref4:
+        case DW_FORM_ref_sup4:
+        case DW_FORM_strx4:
+        case DW_FORM_addrx4:        value->value = dwarf_read_u32(cursor); break;
+        case DW_FORM_data8:
+        case DW_FORM_ref8:
+        case DW_FORM_ref_sig8:
+        case DW_FORM_ref_sup8:      value->value = dwarf_read_u64(cursor); break;
+        case DW_FORM_data16:        dwarf_skip(cursor, 16); break;
+        case DW_FORM_sdata:         value->value = (uint64_t)dwarf_read_sleb128(cursor); break;
+        case DW_FORM_udata:
+        case DW_FORM_ref_udata:
+        case DW_FORM_strx:
+        case DW_FORM_addrx:
+        case DW_FORM_loclistx:
+        case DW_FORM_rnglistx:
+        case DW_FORM_GNU_addr_index:
+        case DW_FORM_GNU_str_index: value->value = dwarf_read_uleb128(cursor); break;
+        case DW_FORM_strp:
+        case DW_FORM_line_strp:
+        case DW_FORM_sec_offset:
+        case DW_FORM_strp_sup:
+        case DW_FORM_GNU_ref_alt:
+        case DW_FORM_GNU_strp_alt:  value->value = dwarf_read_fixed(cursor, unit->offset_size); break;
+        case DW_FORM_ref_addr:
+            // DWARF 2 sized it as an address
+            value->value = dwarf_read_fixed(cursor, unit->version <= 2 ? unit->address_size : unit->offset_size);
+            break;
+        case DW_FORM_string:        value->string = dwarf_read_cstring(cursor); break;
+        case DW_FORM_block1:        dwarf_skip(cursor, dwarf_read_u8(cursor)); break;
+        case DW_FORM_block2:        dwarf_skip(cursor, dwarf_read_u16(cursor)); break;
+        case DW_FORM_block4:        dwarf_skip(cursor, dwarf_read_u32(cursor)); break;
+        case DW_FORM_block:
+        case DW_FORM_exprloc:       dwarf_skip(cursor, dwarf_read_uleb128(cursor)); break;
+        case DW_FORM_flag_present:  value->value = 1; break;
+        case DW_FORM_implicit_const: value->value = (uint64_t)implicit_const; break;
+        case DW_FORM_indirect: {
+            uint16_t actual = (uint16_t)dwarf_read_uleb128(cursor);
+            return actual != DW_FORM_indirect && actual != DW_FORM_implicit_const &&
+                   dwarf_read_value(cursor, unit, actual, 0, value);
+        }
+        default:
+            cursor->ok = false;
+            return false;
+    }
+    // Unit-relative references become .debug_info offsets
+    if (form == DW_FORM_ref1 || form == DW_FORM_ref2 || form == DW_FORM_ref4 || form == DW_FORM_ref8 ||
+        form == DW_FORM_ref_udata) {
+        value->value += unit->offset;
+    }
+    return cursor->ok;
+}
+
+static inline bool dwarf_form_is_constant(uint16_t form) {
+    return form == DW_FORM_data1 || form == DW_FORM_data2 || form == DW_FORM_data4 || form == DW_FORM_data8 ||
+           form == DW_FORM_sdata || form == DW_FORM_udata || form == DW_FORM_implicit_const;
+}
+
+static inline const char* dwarf_value_string(const DwarfLineIndex* index, const DwarfUnit* unit,
+                                             const DwarfValue* value) {
+    uint64_t offset;
+    switch (value->form) {
+        case DW_FORM_string:
+            return value->string;
+        case DW_FORM_strp:
+            return dwarf_section_string(&index->sections.str, value->value);
+        case DW_FORM_line_strp:
+            return dwarf_section_string(&index->sections.line_str, value->value);
+        case DW_FORM_strx:
+        case DW_FORM_strx1:
+        case DW_FORM_strx2:
+        case DW_FORM_strx3:
+        case DW_FORM_strx4:
+        case DW_FORM_GNU_str_index: {
+            DwarfCursor cursor;
+            dwarf_cursor_at(&cursor, &index->sections.str_offsets,
+                            unit->str_offsets_base + value->value * unit->offset_size);
+            offset = dwarf_read_fixed(&cursor, unit->offset_size);
+            return cursor.ok ? dwarf_section_string(&index->sections.str, offset) : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+static inline bool dwarf_value_address(const DwarfLineIndex* index, const DwarfUnit* unit, const DwarfValue* value,
+                                       uint64_t* address) {
+    switch (value->form) {
+        case DW_FORM_addr:
+            *address = value->value;
+            return true;
+        case DW_FORM_addrx:
+        case DW_FORM_addrx1:
+        case DW_FORM_addrx2:
+        case DW_FORM_addrx3:
+        case DW_FORM_addrx4:
+        case DW_FORM_GNU_addr_index: {
+            DwarfCursor cursor;
+            dwarf_cursor_at(&cursor, &index->sections.addr, unit->addr_base + value->value * unit->address_size);
+            *address = dwarf_read_fixed(&cursor, unit->address_size);
+            return cursor.ok;
+        }
+        default:
+            return false;
+    }
+}
+
+static inline uint64_t dwarf_indexed_address(const DwarfLineIndex* index, const DwarfUnit* unit, uint64_t slot) {
+    DwarfValue value = { DW_FORM_addrx, slot, nullptr };
+    uint64_t address = 0;
+    dwarf_value_address(index, unit, &value, &address);
+    return address;
+}
+
+// Linkers resolve references to discarded functions to 0 (or -1, -2)
+static inline bool dwarf_address_is_tombstone(const DwarfUnit* unit, uint64_t address) {
+    uint64_t max = unit->address_size == 4 ? UINT32_MAX : UINT64_MAX;
+    return address == 0 || address >= max - 1;
+}
+
+static inline void dwarf_add_range(const DwarfUnit* unit, uint64_t low, uint64_t high,
+                                   std::vector<DwarfRange>* ranges) {
+    if (low < high && !dwarf_address_is_tombstone(unit, low)) {
+        ranges->push_back({ low, high });
+    }
+}
+
+// Append the ranges of a DW_AT_ranges value: .debug_ranges (DWARF 4) or .debug_rnglists (DWARF 5)
+static void dwarf_read_ranges(const DwarfLineIndex* index, const DwarfUnit* unit, const DwarfValue* value,
+                              std::vector<DwarfRange>* ranges) {
+    DwarfCursor cursor;
+    uint64_t base = unit->base_address;
+    if (unit->version < 5) {
+        dwarf_cursor_at(&cursor, &index->sections.ranges, value->value);
+        uint64_t max = unit->address_size == 4 ? UINT32_MAX : UINT64_MAX;
+        while (cursor.ok) {
+            uint64_t start = dwarf_read_fixed(&cursor, unit->address_size);
+            uint64_t end = dwarf_read_fixed(&cursor, unit->address_size);
+            if (!cursor.ok || (start == 0 && end == 0)) {
+                break;
+            }
+            if (start == max) {
+                base = end;
+            } else {
+                dwarf_add_range(unit, base + start, base + end, ranges);
+            }
+        }
+        return;
+    }
+
+    uint64_t offset = value->value;
+    if (value->form == DW_FORM_rnglistx) {
+        // Index into the offset table that follows the list header; offsets are relative to it
+        dwarf_cursor_at(&cursor, &index->sections.rnglists, unit->rnglists_base + value->value * unit->offset_size);
+        offset = unit->rnglists_base + dwarf_read_fixed(&cursor, unit->offset_size);
+        if (!cursor.ok) {
+            return;
+        }
+    }
+    dwarf_cursor_at(&cursor, &index->sections.rnglists, offset);
+    while (cursor.ok) {
+        uint8_t kind = dwarf_read_u8(&cursor);
+        uint64_t start;
+        switch (kind) {
+            case DW_RLE_end_of_list:
+                return;
+            case DW_RLE_base_addressx:
+                base = dwarf_indexed_address(index, unit, dwarf_read_uleb128(&cursor));
+                break;
+            case DW_RLE_startx_endx:
+                start = dwarf_indexed_address(index, unit, dwarf_read_uleb128(&cursor));
+                dwarf_add_range(unit, start, dwarf_indexed_address(index, unit, dwarf_read_uleb128(&cursor)), ranges);
+                break;
+            case DW_RLE_startx_length:
+                start = dwarf_indexed_address(index, unit, dwarf_read_uleb128(&cursor));
+                dwarf_add_range(unit, start, start + dwarf_read_uleb128(&cursor), ranges);
+                break;
+            case DW_RLE_offset_pair:
+                start = base + dwarf_read_uleb128(&cursor);
+                dwarf_add_range(unit, start, base + dwarf_read_uleb128(&cursor), ranges);
+                break;
+            case DW_RLE_base_address:
+                base = dwarf_read_fixed(&cursor, unit->address_size);
+                break;
+            case DW_RLE_start_end:
+                start = dwarf_read_fixed(&cursor, unit->address_size);
+                dwarf_add_range(unit, start, dwarf_read_fixed(&cursor, unit->address_size), ranges);
+                break;
+            case DW_RLE_start_length:
+                start = dwarf_read_fixed(&cursor, unit->address_size);
+                dwarf_add_range(unit, start, start + dwarf_read_uleb128(&cursor), ranges);
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+// Code ranges of an entry from its low_pc/high_pc or ranges attributes
+static void dwarf_entry_ranges(const DwarfLineIndex* index, const DwarfUnit* unit, const DwarfValue* low_pc,
+                               const DwarfValue* high_pc, const DwarfValue* ranges_value,
+                               std::vector<DwarfRange>* ranges) {
+    if (ranges_value) {
+        dwarf_read_ranges(index, unit, ranges_value, ranges);
+        return;
+    }
+    uint64_t low;
+    if (!low_pc || !high_pc || !dwarf_value_address(index, unit, low_pc, &low)) {
+        return;
+    }
+    uint64_t high;
+    if (dwarf_form_is_constant(high_pc->form)) {
+        high = low + high_pc->value;
+    } else if (!dwarf_value_address(index, unit, high_pc, &high)) {
+        return;
+    }
+    dwarf_add_range(unit, low, high, ranges);
+}
+
+static DwarfAbbrevTable* dwarf_abbrev_table(DwarfLineIndex* index, uint64_t offset) {
+    auto inserted = index->abbrevs.emplace(offset, DwarfAbbrevTable());
+    DwarfAbbrevTable* table = &inserted.first->second;
+    if (inserted.second) {
+        dwarf_cursor_at(&table->next, &index->sections.abbrev, offset);
+        table->complete = false;
+    }
+    return table;
+}
+
+static bool dwarf_abbrev_parse_next(DwarfAbbrevTable* table) {
+    DwarfCursor* cursor = &table->next;
+    uint64_t code = dwarf_read_uleb128(cursor);
+    if (!cursor->ok || code == 0 || code > DWARF_MAX_ABBREV_CODE) {
+        table->complete = true;
+        return false;
+    }
+    DwarfAbbrev abbrev;
+    abbrev.tag = (uint16_t)dwarf_read_uleb128(cursor);
+    abbrev.has_children = dwarf_read_u8(cursor) != 0;
+    abbrev.attrs_begin = (uint32_t)table->attrs.size();
+    while (cursor->ok) {
+        uint16_t name = (uint16_t)dwarf_read_uleb128(cursor);
+        uint16_t form = (uint16_t)dwarf_read_uleb128(cursor);
+        int64_t implicit_const = form == DW_FORM_implicit_const ? dwarf_read_sleb128(cursor) : 0;
+        if (name == 0 && form == 0) {
+            break;
+        }
+        table->attrs.push_back({ name, form, implicit_const });
+    }
+    abbrev.attrs_count = (uint32_t)table->attrs.size() - abbrev.attrs_begin;
+    if (table->by_code.size() <= code) {
+        table->by_code.resize(code + 1, DwarfAbbrev { 0, false, 0, 0 });
+    }
+    table->by_code[code] = abbrev;
+    return cursor->ok;
+}
+
+// Abbreviation for a code, parsing the table up to it; null if undefined.
+// Invalidated by the next lookup in the same table.
+static inline const DwarfAbbrev* dwarf_abbrev(DwarfAbbrevTable* table, uint64_t code) {
+    while (code >= table->by_code.size() || table->by_code[code].tag == 0) {
+        if (table->complete || !dwarf_abbrev_parse_next(table)) {
+            return code < table->by_code.size() && table->by_code[code].tag != 0 ? &table->by_code[code] : nullptr;
+        }
+    }
+    return &table->by_code[code];
+}
+
+// Unit containing a .debug_info offset
+static inline DwarfUnit* dwarf_unit_at(DwarfLineIndex* index, uint64_t offset) {
+    auto it = std::upper_bound(index->units.begin(), index->units.end(), offset,
+                               [](uint64_t value, const DwarfUnit& unit) { return value < unit.offset; });
+    if (it == index->units.begin() || offset >= (it - 1)->end) {
+        return nullptr;
+    }
+    return &*(it - 1);
+}
+
+// Name of the function described by the entry at a .debug_info offset,
+// following abstract origins and specifications to the declaration
+static const char* dwarf_function_name(DwarfLineIndex* index, uint64_t offset, int depth = 0) {
+    auto cached = index->names.find(offset);
+    if (cached != index->names.end()) {
+        return cached->second.empty() ? nullptr : cached->second.c_str();
+    }
+    DwarfUnit* unit = dwarf_unit_at(index, offset);
+    if (!unit || depth > DWARF_MAX_NAME_DEPTH) {
+        return nullptr;
+    }
+
+    DwarfCursor cursor;
+    dwarf_cursor_at(&cursor, &index->sections.info, offset);
+    cursor.end = std::min(cursor.end, index->sections.info.data + unit->end);
+    DwarfAbbrevTable* abbrevs = dwarf_abbrev_table(index, unit->abbrev_offset);
+    const DwarfAbbrev* abbrev = dwarf_abbrev(abbrevs, dwarf_read_uleb128(&cursor));
+    const char* linkage_name = nullptr;
+    const char* name = nullptr;
+    uint64_t origin = 0;
+    for (uint32_t i = 0; abbrev && i < abbrev->attrs_count; i++) {
+        const DwarfAbbrevAttr& attr = abbrevs->attrs[abbrev->attrs_begin + i];
+        DwarfValue value;
+        if (!dwarf_read_value(&cursor, unit, attr.form, attr.implicit_const, &value)) {
+            break;
+        }
+        if (attr.name == DW_AT_linkage_name || attr.name == DW_AT_MIPS_linkage_name) {
+            linkage_name = dwarf_value_string(index, unit, &value);
+        } else if (attr.name == DW_AT_name) {
+            name = dwarf_value_string(index, unit, &value);
+        } else if ((attr.name == DW_AT_abstract_origin || attr.name == DW_AT_specification) &&
+                   value.form != DW_FORM_GNU_ref_alt && value.form != DW_FORM_ref_sig8) {
+            origin = value.value;
+        }
+    }
+    // Abstract instances often carry only the plain name; the declaration has the linkage name
+    const char* result = linkage_name;
+    if (!result && origin != 0 && origin != offset) {
+        result = dwarf_function_name(index, origin, depth + 1);
+    }
+    if (!result) {
+        result = name;
+    }
+    std::string& entry = index->names[offset];
+    entry = result ? result : "";
+    return entry.empty() ? nullptr : entry.c_str();
+}
+
+static inline std::string dwarf_join_path(const char* directory, const char* name) {
+    if (!directory || !*directory || name[0] == '/') {
+        return name;
+    }
+    std::string path = directory;
+    if (path.back() != '/') {
+        path += '/';
+    }
+    return path + name;
+}
+
+// Directory or file table of a DWARF 5 line program header: (content type, form) pairs, then the entries
+static bool dwarf_read_entry_formats(DwarfCursor* cursor, const DwarfLineIndex* index, const DwarfUnit* unit,
+                                     std::vector<std::pair<const char*, uint64_t>>* entries) {
+    uint8_t format_count = dwarf_read_u8(cursor);
+    std::vector<std::pair<uint64_t, uint16_t>> formats(format_count);
+    for (auto& format : formats) {
+        format.first = dwarf_read_uleb128(cursor);
+        format.second = (uint16_t)dwarf_read_uleb128(cursor);
+    }
+    uint64_t count = dwarf_read_uleb128(cursor);
+    for (uint64_t i = 0; i < count && cursor->ok; i++) {
+        const char* path = nullptr;
+        uint64_t directory = 0;
+        for (const auto& format : formats) {
+            DwarfValue value;
+            if (!dwarf_read_value(cursor, unit, format.second, 0, &value)) {
+                return false;
+            }
+            if (format.first == DW_LNCT_path) {
+                path = dwarf_value_string(index, unit, &value);
+            } else if (format.first == DW_LNCT_directory_index) {
+                directory = value.value;
+            }
+        }
+        entries->push_back({ path ? path : "", directory });
+    }
+    return cursor->ok;
+}
+
+// Run the unit's line program into tables->files and tables->rows
+static void dwarf_decode_lines(const DwarfLineIndex* index, const DwarfUnit* unit, DwarfUnitTables* tables) {
+    DwarfCursor cursor;
+    dwarf_cursor_at(&cursor, &index->sections.line, unit->stmt_list);
+    DwarfUnit header_unit;      // Sizes of the line program, which may differ from the unit's
+    header_unit.offset = 0;
+    header_unit.version = 0;
+    header_unit.address_size = unit->address_size;
+    header_unit.str_offsets_base = unit->str_offsets_base;
+    uint64_t length = dwarf_read_initial_length(&cursor, &header_unit.offset_size);
+    if (!dwarf_has(&cursor, length)) {
+        return;
+    }
+    cursor.end = cursor.pos + length;
+    header_unit.version = dwarf_read_u16(&cursor);
+    if (header_unit.version < 2 || header_unit.version > 5) {
+        return;
+    }
+    if (header_unit.version >= 5) {
+        header_unit.address_size = dwarf_read_u8(&cursor);
+        dwarf_skip(&cursor, 1);     // Segment selector size
+    }
+    uint64_t header_length = dwarf_read_fixed(&cursor, header_unit.offset_size);
+    if (!dwarf_has(&cursor, header_length)) {
+        return;
+    }
+    const uint8_t* program = cursor.pos + header_length;
+    uint8_t min_instruction_length = dwarf_read_u8(&cursor);
+    if (header_unit.version >= 4) {
+        dwarf_skip(&cursor, 1);     // Maximum operations per instruction (VLIW only)
+    }
+    dwarf_skip(&cursor, 1);         // default_is_stmt
+    int8_t line_base = (int8_t)dwarf_read_u8(&cursor);
+    uint8_t line_range = dwarf_read_u8(&cursor);
+    uint8_t opcode_base = dwarf_read_u8(&cursor);
+    std::vector<uint8_t> opcode_lengths(opcode_base > 0 ? opcode_base - 1 : 0);
+    for (uint8_t& opcode_length : opcode_lengths) {
+        opcode_length = dwarf_read_u8(&cursor);
+    }
+    if (!cursor.ok || line_range == 0) {
+        return;
+    }
+
+    // Directory 0 is the compilation directory (explicit from DWARF 5 on); file numbers start at 1 before DWARF 5
+    std::vector<std::pair<const char*, uint64_t>> directories;
+    std::vector<std::pair<const char*, uint64_t>> files;
+    if (header_unit.version >= 5) {
+        if (!dwarf_read_entry_formats(&cursor, index, &header_unit, &directories) ||
+            !dwarf_read_entry_formats(&cursor, index, &header_unit, &files)) {
+            return;
+        }
+    } else {
+        directories.push_back({ unit->comp_dir ? unit->comp_dir : "", 0 });
+        while (cursor.ok) {
+            const char* directory = dwarf_read_cstring(&cursor);
+            if (!directory || !*directory) {
+                break;
+            }
+            directories.push_back({ directory, 0 });
+        }
+        files.push_back({ "", 0 });
+        while (cursor.ok) {
+            const char* name = dwarf_read_cstring(&cursor);
+            if (!name || !*name) {
+                break;
+            }
+            uint64_t directory = dwarf_read_uleb128(&cursor);
+            dwarf_read_uleb128(&cursor);    // Modification time
+            dwarf_read_uleb128(&cursor);    // Length
+            files.push_back({ name, directory });
+        }
+    }
+    if (!cursor.ok) {
+        return;
+    }
+    auto add_file = [&](const char* name, uint64_t directory) {
+        const char* path = directory < directories.size() ? directories[directory].first : nullptr;
+        if (path && path[0] != '/' && directory != 0) {
+            tables->files.push_back(dwarf_join_path(unit->comp_dir, dwarf_join_path(path, name).c_str()));
+        } else {
+            tables->files.push_back(dwarf_join_path(path ? path : unit->comp_dir, name));
+        }
+    };
+    for (const auto& file : files) {
+        add_file(file.first, file.second);
+    }
+
+    // The line number state machine; rows of discarded functions (address 0) are dropped with their sequence
+    cursor.pos = program;
+    std::vector<DwarfLineRow> sequence;
+    std::vector<DwarfRange> sequences;      // Row index ranges in tables->rows, one per sequence
+    uint64_t address = 0;
+    uint32_t file = 1;
+    int64_t line = 1;
+    auto emit = [&]() { sequence.push_back({ address, file, (uint32_t)line }); };
+    while (cursor.ok && !dwarf_at_end(&cursor)) {
+        uint8_t opcode = dwarf_read_u8(&cursor);
+        if (opcode >= opcode_base) {
+            uint8_t adjusted = opcode - opcode_base;
+            address += (uint64_t)(adjusted / line_range) * min_instruction_length;
+            line += line_base + adjusted % line_range;
+            emit();
+            continue;
+        }
+        switch (opcode) {
+            case 0: {
+                uint64_t length = dwarf_read_uleb128(&cursor);
+                if (length == 0 || !dwarf_has(&cursor, length)) {
+                    cursor.ok = false;
+                    break;
+                }
+                const uint8_t* next = cursor.pos + length;
+                uint8_t extended = dwarf_read_u8(&cursor);
+                if (extended == DW_LNE_end_sequence) {
+                    if (!sequence.empty() && !dwarf_address_is_tombstone(unit, sequence[0].address)) {
+                        sequences.push_back({ tables->rows.size(), tables->rows.size() + sequence.size() + 1 });
+                        tables->rows.insert(tables->rows.end(), sequence.begin(), sequence.end());
+                        tables->rows.push_back({ address, DWARF_END_OF_SEQUENCE, 0 });
+                    }
+                    sequence.clear();
+                    address = 0;
+                    file = 1;
+                    line = 1;
+                } else if (extended == DW_LNE_set_address) {
+                    address = dwarf_read_fixed(&cursor, std::min<uint64_t>(length - 1, 8));
+                } else if (extended == DW_LNE_define_file) {
+                    const char* name = dwarf_read_cstring(&cursor);
+                    uint64_t directory = dwarf_read_uleb128(&cursor);
+                    if (name) {
+                        add_file(name, directory);
+                    }
+                }
+                cursor.pos = next;
+                break;
+            }
+            case DW_LNS_copy:
+                emit();
+                break;
+            case DW_LNS_advance_pc:
+                address += dwarf_read_uleb128(&cursor) * min_instruction_length;
+                break;
+            case DW_LNS_advance_line:
+                line += dwarf_read_sleb128(&cursor);
+                break;
+            case DW_LNS_set_file:
+                file = (uint32_t)dwarf_read_uleb128(&cursor);
+                break;
+            case DW_LNS_const_add_pc:
+                address += (uint64_t)((255 - opcode_base) / line_range) * min_instruction_length;
+                break;
+            case DW_LNS_fixed_advance_pc:
+                address += dwarf_read_u16(&cursor);
+                break;
+            default:
+                // Standard opcodes without state we need (column, is_stmt, ...) and unknown ones
+                for (uint8_t i = 0; i < opcode_lengths[opcode - 1]; i++) {
+                    dwarf_read_uleb128(&cursor);
+                }
+                break;
+        }
+    }
+
+    // Rows only increase within a sequence, but sequences come in any order: order them by start address.
+    // A sequence ending where the next one starts stays before it, so the start row wins a lookup there.
+    auto by_start = [&](const DwarfRange& a, const DwarfRange& b) {
+        return tables->rows[a.low].address < tables->rows[b.low].address;
+    };
+    if (!std::is_sorted(sequences.begin(), sequences.end(), by_start)) {
+        std::stable_sort(sequences.begin(), sequences.end(), by_start);
+        std::vector<DwarfLineRow> rows;
+        rows.reserve(tables->rows.size());
+        for (const DwarfRange& range : sequences) {
+            rows.insert(rows.end(), tables->rows.begin() + range.low, tables->rows.begin() + range.high);
+        }
+        tables->rows.swap(rows);
+    }
+}
+
+// Size of an attribute of the given form when it does not depend on its data; -1 otherwise
+static inline int dwarf_form_fixed_size(const DwarfUnit* unit, uint16_t form) {
+    switch (form) {
+        case DW_FORM_flag_present:
+        case DW_FORM_implicit_const: return 0;
+        case DW_FORM_data1:
+        case DW_FORM_ref1:
+        case DW_FORM_flag:
+        case DW_FORM_strx1:
+        case DW_FORM_addrx1:         return 1;
+        case DW_FORM_data2:
+        case DW_FORM_ref2:
+        case DW_FORM_strx2:
+        case DW_FORM_addrx2:         return 2;
+        case DW_FORM_strx3:
+        case DW_FORM_addrx3:         return 3;
+        case DW_FORM_data4:
+        case DW_FORM_ref4:
+        case DW_FORM_ref_sup4:
+        case DW_FORM_strx4:
+        case DW_FORM_addrx4:         return 4;
+        case DW_FORM_data8:
+        case DW_FORM_ref8:
+        case DW_FORM_ref_sig8:
+        case DW_FORM_ref_sup8:       return 8;
+        case DW_FORM_data16:         return 16;
+        case DW_FORM_addr:           return unit->address_size;
+        case DW_FORM_strp:
+        case DW_FORM_line_strp:
+        case DW_FORM_sec_offset:
+        case DW_FORM_strp_sup:
+        case DW_FORM_GNU_ref_alt:
+        case DW_FORM_GNU_strp_alt:   return unit->offset_size;
+        case DW_FORM_ref_addr:       return unit->version <= 2 ? unit->address_size : unit->offset_size;
+        default:                     return -1;
+    }
+}
+
+// Types hold member declarations only: definitions with code are emitted at namespace scope
+static inline bool dwarf_tag_is_type(uint16_t tag) {
+    return tag == DW_TAG_class_type || tag == DW_TAG_structure_type || tag == DW_TAG_union_type ||
+           tag == DW_TAG_enumeration_type;
+}
+
+// Walk the unit's entries into the tree of functions and inlined calls.
+// Most entries describe types and variables: those are skipped by their
+// precomputed size, and the members of types by their DW_AT_sibling.
+// (Functions without code are walked: GCC nests the lambdas of an inline
+// function, with their code, under its abstract instance.)
+static void dwarf_decode_inlines(DwarfLineIndex* index, const DwarfUnit* unit, DwarfUnitTables* tables) {
+    DwarfAbbrevTable* abbrevs = dwarf_abbrev_table(index, unit->abbrev_offset);
+    const uint8_t* info = index->sections.info.data;
+    DwarfCursor cursor;
+    dwarf_cursor_at(&cursor, &index->sections.info, unit->die_offset);
+    cursor.end = info + unit->end;
+
+    std::vector<int32_t> fixed_sizes;       // Per abbreviation code: attribute bytes, -1 variable, -2 not computed
+    std::vector<int64_t> open;              // Per open entry with children: its node, or -1
+    size_t open_nodes = 0;
+    std::vector<DwarfRange> ranges;
+    while (cursor.ok && !dwarf_at_end(&cursor)) {
+        uint64_t die_offset = (uint64_t)(cursor.pos - info);
+        uint64_t code = dwarf_read_uleb128(&cursor);
+        if (code == 0) {
+            if (open.empty()) {
+                break;
+            }
+            if (open.back() >= 0) {
+                tables->nodes[open.back()].subtree_end = (uint32_t)tables->nodes.size();
+                open_nodes--;
+            }
+            open.pop_back();
+            if (open.empty()) {
+                break;
+            }
+            continue;
+        }
+        const DwarfAbbrev* abbrev = dwarf_abbrev(abbrevs, code);
+        if (!abbrev) {
+            break;
+        }
+
+        bool is_function = abbrev->tag == DW_TAG_subprogram || abbrev->tag == DW_TAG_inlined_subroutine;
+        if (!is_function && !(abbrev->has_children && dwarf_tag_is_type(abbrev->tag))) {
+            if (fixed_sizes.size() <= code) {
+                fixed_sizes.resize(code + 1, -2);
+            }
+            if (fixed_sizes[code] == -2) {
+                int32_t size = 0;
+                for (uint32_t i = 0; i < abbrev->attrs_count && size >= 0; i++) {
+                    int form_size = dwarf_form_fixed_size(unit, abbrevs->attrs[abbrev->attrs_begin + i].form);
+                    size = form_size < 0 ? -1 : size + form_size;
+                }
+                fixed_sizes[code] = size;
+            }
+            if (fixed_sizes[code] >= 0) {
+                dwarf_skip(&cursor, (size_t)fixed_sizes[code]);
+                if (abbrev->has_children) {
+                    open.push_back(-1);
+                }
+                continue;
+            }
+        }
+
+        DwarfValue low_pc = {};
+        DwarfValue high_pc = {};
+        DwarfValue ranges_value = {};
+        bool has_low = false;
+        bool has_high = false;
+        bool has_ranges = false;
+        uint32_t call_file = 0;
+        uint32_t call_line = 0;
+        uint64_t sibling = 0;
+        for (uint32_t i = 0; i < abbrev->attrs_count; i++) {
+            const DwarfAbbrevAttr& attr = abbrevs->attrs[abbrev->attrs_begin + i];
+            DwarfValue value;
+            if (!dwarf_read_value(&cursor, unit, attr.form, attr.implicit_const, &value)) {
+                break;
+            }
+            switch (attr.name) {
+                case DW_AT_sibling:   sibling = value.value; break;
+                case DW_AT_low_pc:    low_pc = value; has_low = true; break;
+                case DW_AT_high_pc:   high_pc = value; has_high = true; break;
+                case DW_AT_ranges:    ranges_value = value; has_ranges = true; break;
+                case DW_AT_call_file: call_file = (uint32_t)value.value; break;
+                case DW_AT_call_line: call_line = (uint32_t)value.value; break;
+                default: break;
+            }
+        }
+        if (!cursor.ok) {
+            break;
+        }
+
+        int64_t node = -1;
+        if (is_function) {
+            ranges.clear();
+            dwarf_entry_ranges(index, unit, has_low ? &low_pc : nullptr, has_high ? &high_pc : nullptr,
+                               has_ranges ? &ranges_value : nullptr, &ranges);
+            if (!ranges.empty()) {
+                node = (int64_t)tables->nodes.size();
+                DwarfInlineNode inline_node = { die_offset, (uint32_t)tables->node_ranges.size(),
+                                                (uint32_t)ranges.size(), 0, call_file, call_line };
+                tables->nodes.push_back(inline_node);
+                tables->node_ranges.insert(tables->node_ranges.end(), ranges.begin(), ranges.end());
+                if (open_nodes == 0) {
+                    for (const DwarfRange& range : ranges) {
+                        tables->functions.push_back({ range.low, range.high, (uint32_t)node });
+                    }
+                }
+            }
+        }
+        if (!abbrev->has_children) {
+            if (node >= 0) {
+                tables->nodes[node].subtree_end = (uint32_t)tables->nodes.size();
+            }
+        } else if (dwarf_tag_is_type(abbrev->tag) && sibling > die_offset && sibling <= unit->end) {
+            cursor.pos = info + sibling;
+        } else {
+            open.push_back(node);
+            open_nodes += node >= 0 ? 1 : 0;
+        }
+    }
+    // A truncated unit closes whatever is still open
+    for (int64_t entry : open) {
+        if (entry >= 0) {
+            tables->nodes[entry].subtree_end = (uint32_t)tables->nodes.size();
+        }
+    }
+    std::sort(tables->functions.begin(), tables->functions.end(),
+              [](const DwarfFunctionRange& a, const DwarfFunctionRange& b) { return a.low < b.low; });
+}
+
+static DwarfUnitTables* dwarf_unit_tables(DwarfLineIndex* index, DwarfUnit* unit) {
+    if (!unit->tables) {
+        unit->tables.reset(new DwarfUnitTables());
+        if (unit->has_lines) {
+            dwarf_decode_lines(index, unit, unit->tables.get());
+        }
+        dwarf_decode_inlines(index, unit, unit->tables.get());
+        index->decoded_units++;
+    }
+    return unit->tables.get();
+}
+
+// Read a unit header and its first entry; false when the unit cannot be used
+static bool dwarf_read_unit(DwarfLineIndex* index, DwarfCursor* cursor, DwarfUnit* unit,
+                            std::vector<DwarfRange>* ranges) {
+    const uint8_t* info = index->sections.info.data;
+    unit->offset = (uint64_t)(cursor->pos - info);
+    uint64_t length = dwarf_read_initial_length(cursor, &unit->offset_size);
+    if (!dwarf_has(cursor, length)) {
+        cursor->ok = false;
+        return false;
+    }
+    unit->end = (uint64_t)(cursor->pos - info) + length;
+    DwarfCursor header = *cursor;
+    header.end = cursor->pos + length;
+    cursor->pos += length;
+
+    unit->version = dwarf_read_u16(&header);
+    uint8_t unit_type = DW_UT_compile;
+    if (unit->version >= 5) {
+        unit_type = dwarf_read_u8(&header);
+        unit->address_size = dwarf_read_u8(&header);
+        unit->abbrev_offset = dwarf_read_fixed(&header, unit->offset_size);
+        if (unit_type == DW_UT_skeleton || unit_type == DW_UT_split_compile) {
+            dwarf_skip(&header, 8);     // DWO id
+        } else if (unit_type == DW_UT_type || unit_type == DW_UT_split_type) {
+            dwarf_skip(&header, 8 + unit->offset_size);
+        }
+    } else {
+        unit->abbrev_offset = dwarf_read_fixed(&header, unit->offset_size);
+        unit->address_size = dwarf_read_u8(&header);
+    }
+    unit->die_offset = (uint64_t)(header.pos - info);
+    unit->base_address = 0;
+    unit->str_offsets_base = unit->version >= 5 ? 8 : 0;     // Past the table header
+    unit->addr_base = unit->version >= 5 ? 8 : 0;
+    unit->rnglists_base = 0;
+    unit->has_lines = false;
+    unit->stmt_list = 0;
+    unit->comp_dir = nullptr;
+    if (!header.ok || unit->version < 2 || unit->version > 5 || (unit->address_size != 4 && unit->address_size != 8) ||
+        (unit_type != DW_UT_compile && unit_type != DW_UT_partial)) {
+        return false;
+    }
+
+    // The unit entry: bases first, since its other attributes may be indexed through them
+    DwarfAbbrevTable* abbrevs = dwarf_abbrev_table(index, unit->abbrev_offset);
+    const DwarfAbbrev* abbrev = dwarf_abbrev(abbrevs, dwarf_read_uleb128(&header));
+    if (!abbrev) {
+        return false;
+    }
+    std::vector<std::pair<uint16_t, DwarfValue>> values;
+    for (uint32_t i = 0; i < abbrev->attrs_count; i++) {
+        const DwarfAbbrevAttr& attr = abbrevs->attrs[abbrev->attrs_begin + i];
+        DwarfValue value;
+        if (!dwarf_read_value(&header, unit, attr.form, attr.implicit_const, &value)) {
+            return false;
+        }
+        switch (attr.name) {
+            case DW_AT_str_offsets_base: unit->str_offsets_base = value.value; break;
+            case DW_AT_addr_base:        unit->addr_base = value.value; break;
+            case DW_AT_rnglists_base:    unit->rnglists_base = value.value; break;
+            default: values.push_back({ attr.name, value }); break;
+        }
+    }
+    const DwarfValue* low_pc = nullptr;
+    const DwarfValue* high_pc = nullptr;
+    const DwarfValue* ranges_value = nullptr;
+    for (const auto& entry : values) {
+        switch (entry.first) {
+            case DW_AT_low_pc:
+                low_pc = &entry.second;
+                dwarf_value_address(index, unit, low_pc, &unit->base_address);
+                break;
+            case DW_AT_high_pc:   high_pc = &entry.second; break;
+            case DW_AT_ranges:    ranges_value = &entry.second; break;
+            case DW_AT_comp_dir:  unit->comp_dir = dwarf_value_string(index, unit, &entry.second); break;
+            case DW_AT_stmt_list:
+                unit->has_lines = true;
+                unit->stmt_list = entry.second.value;
+                break;
+            default: break;
+        }
+    }
+    dwarf_entry_ranges(index, unit, low_pc, high_pc, ranges_value, ranges);
+    return true;
+}
+
+template <typename Ehdr, typename Shdr>
+static bool dwarf_find_sections(const uint8_t* image, size_t size, DwarfSections* sections) {
+    struct Wanted {
+        const char* name;
+        DwarfSection* section;
+    };
+    const Wanted wanted[] = {
+        { ".debug_info", &sections->info },         { ".debug_abbrev", &sections->abbrev },
+        { ".debug_line", &sections->line },         { ".debug_line_str", &sections->line_str },
+        { ".debug_str", &sections->str },           { ".debug_str_offsets", &sections->str_offsets },
+        { ".debug_addr", &sections->addr },         { ".debug_ranges", &sections->ranges },
+        { ".debug_rnglists", &sections->rnglists },
+    };
+
+    Ehdr ehdr;
+    if (size < sizeof(ehdr)) {
+        return false;
+    }
+    memcpy(&ehdr, image, sizeof(ehdr));
+    if (ehdr.e_shentsize != sizeof(Shdr) || ehdr.e_shoff > size ||
+        (size - ehdr.e_shoff) / sizeof(Shdr) < ehdr.e_shnum || ehdr.e_shstrndx >= ehdr.e_shnum) {
+        return false;
+    }
+    std::vector<Shdr> headers(ehdr.e_shnum);
+    memcpy(headers.data(), image + ehdr.e_shoff, sizeof(Shdr) * headers.size());
+    const Shdr& names = headers[ehdr.e_shstrndx];
+    if (names.sh_offset > size || names.sh_size > size - names.sh_offset) {
+        return false;
+    }
+    DwarfSection name_table = { image + names.sh_offset, (size_t)names.sh_size };
+
+    for (const Shdr& header : headers) {
+        const char* name = dwarf_section_string(&name_table, header.sh_name);
+        // Compressed sections (SHF_COMPRESSED, .zdebug_*) are left out: their units read as absent
+        if (!name || header.sh_type == SHT_NOBITS || (header.sh_flags & SHF_COMPRESSED) ||
+            header.sh_offset > size || header.sh_size > size - header.sh_offset) {
+            continue;
+        }
+        for (const Wanted& entry : wanted) {
+            if (strcmp(name, entry.name) == 0) {
+                *entry.section = { image + header.sh_offset, (size_t)header.sh_size };
+            }
+        }
+    }
+    return sections->info.size > 0 && sections->abbrev.size > 0;
+}
+
+static inline void dwarf_line_index_close(DwarfLineIndex* index) {
+    if (index->mapping) {
+        munmap(index->mapping, index->mapping_size);
+        index->mapping = nullptr;
+    }
+    index->units.clear();
+    index->unit_ranges.clear();
+    index->abbrevs.clear();
+    index->names.clear();
+}
+
+// Map the ELF file at path ("apk!/entry" supported) and index its compilation
+// units; false if it has no usable .debug_info.
+static bool dwarf_line_index_open(const char* path, DwarfLineIndex* index) {
+    memset(&index->sections, 0, sizeof(index->sections));
+    index->mapping = nullptr;
+    index->decoded_units = 0;
+
+    uint64_t base;
+    unsigned char ident[EI_NIDENT];
+    int fd = elf_open_image(path, &base, ident);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_size > base) {
+        mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    index->mapping = mapping;
+    index->mapping_size = (size_t)st.st_size;
+    const uint8_t* image = (const uint8_t*)mapping + base;
+    size_t size = (size_t)((uint64_t)st.st_size - base);
+    bool found = ident[EI_CLASS] == ELFCLASS64 ? dwarf_find_sections<Elf64_Ehdr, Elf64_Shdr>(image, size, &index->sections)
+                                               : dwarf_find_sections<Elf32_Ehdr, Elf32_Shdr>(image, size, &index->sections);
+    if (!found) {
+        dwarf_line_index_close(index);
+        return false;
+    }
+
+    DwarfCursor cursor;
+    dwarf_cursor_at(&cursor, &index->sections.info, 0);
+    std::vector<DwarfRange> ranges;
+    while (cursor.ok && !dwarf_at_end(&cursor)) {
+        DwarfUnit unit;
+        ranges.clear();
+        if (!dwarf_read_unit(index, &cursor, &unit, &ranges)) {
+            continue;
+        }
+        uint32_t number = (uint32_t)index->units.size();
+        index->units.push_back(std::move(unit));
+        DwarfUnit* added = &index->units.back();
+        if (ranges.empty() && added->has_lines) {
+            // No ranges in the unit entry: its line table says where its code is
+            const std::vector<DwarfLineRow>& rows = dwarf_unit_tables(index, added)->rows;
+            for (size_t i = 0; i + 1 < rows.size(); i++) {
+                if (rows[i].file != DWARF_END_OF_SEQUENCE) {
+                    size_t end = i + 1;
+                    while (end < rows.size() && rows[end].file != DWARF_END_OF_SEQUENCE) {
+                        end++;
+                    }
+                    if (end < rows.size()) {
+                        ranges.push_back({ rows[i].address, rows[end].address });
+                    }
+                    i = end;
+                }
+            }
+        }
+        for (const DwarfRange& range : ranges) {
+            index->unit_ranges.push_back({ range.low, range.high, number });
+        }
+    }
+    std::sort(index->unit_ranges.begin(), index->unit_ranges.end(),
+              [](const DwarfUnitRange& a, const DwarfUnitRange& b) { return a.low < b.low; });
+    return !index->units.empty();
+}
+
+static inline const char* dwarf_file_name(const DwarfUnitTables* tables, uint32_t file) {
+    return file < tables->files.size() && !tables->files[file].empty() ? tables->files[file].c_str() : nullptr;
+}
+
+static inline bool dwarf_node_contains(const DwarfUnitTables* tables, const DwarfInlineNode* node, uint64_t address) {
+    for (uint32_t i = 0; i < node->ranges_count; i++) {
+        const DwarfRange& range = tables->node_ranges[node->ranges_begin + i];
+        if (address >= range.low && address < range.high) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Resolve one address of a decoded unit
+static void dwarf_resolve(DwarfLineIndex* index, const DwarfUnitTables* tables, uint64_t address,
+                          DwarfLocation* location) {
+    const DwarfLineRow* row = nullptr;
+    auto it = std::upper_bound(tables->rows.begin(), tables->rows.end(), address,
+                               [](uint64_t value, const DwarfLineRow& entry) { return value < entry.address; });
+    if (it != tables->rows.begin() && (it - 1)->file != DWARF_END_OF_SEQUENCE) {
+        row = &*(it - 1);
+    }
+
+    // The concrete function, then each inlined call containing the address, outermost first
+    std::vector<uint32_t> chain;
+    auto function = std::upper_bound(tables->functions.begin(), tables->functions.end(), address,
+                                     [](uint64_t value, const DwarfFunctionRange& range) { return value < range.low; });
+    if (function != tables->functions.begin() && address < (function - 1)->high) {
+        uint32_t node = (function - 1)->node;
+        chain.push_back(node);
+        uint32_t end = tables->nodes[node].subtree_end;
+        for (uint32_t next = node + 1; next < end;) {
+            if (dwarf_node_contains(tables, &tables->nodes[next], address)) {
+                chain.push_back(next);
+                end = tables->nodes[next].subtree_end;
+                next++;
+            } else {
+                next = std::max(tables->nodes[next].subtree_end, next + 1);
+            }
+        }
+    }
+
+    // Each frame's location is the call site of the next one; the innermost is where the row puts it
+    for (size_t i = 0; i < chain.size(); i++) {
+        DwarfFrame frame = { dwarf_function_name(index, tables->nodes[chain[i]].die_offset), nullptr, 0 };
+        if (i + 1 < chain.size()) {
+            const DwarfInlineNode& call = tables->nodes[chain[i + 1]];
+            frame.file = dwarf_file_name(tables, call.call_file);
+            frame.line = call.call_line;
+        } else if (row) {
+            frame.file = dwarf_file_name(tables, row->file);
+            frame.line = row->line;
+        }
+        location->frames.push_back(frame);
+    }
+    if (chain.empty() && row) {
+        location->frames.push_back({ nullptr, dwarf_file_name(tables, row->file), row->line });
+    }
+}
+
+// Resolve a batch of addresses (ELF virtual addresses; for return addresses
+// pass the address of the call, e.g. the return address - 1). Addresses are
+// visited in sorted order so each unit is decoded and searched once.
+static void dwarf_line_index_lookup(DwarfLineIndex* index, const uint64_t* addresses, size_t count,
+                                    DwarfLocation* locations) {
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+        locations[i].frames.clear();
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return addresses[a] < addresses[b]; });
+
+    DwarfUnit* unit = nullptr;
+    const DwarfUnitRange* range = nullptr;
+    for (size_t i : order) {
+        uint64_t address = addresses[i];
+        if (!range || address < range->low || address >= range->high) {
+            auto it = std::upper_bound(index->unit_ranges.begin(), index->unit_ranges.end(), address,
+                                       [](uint64_t value, const DwarfUnitRange& entry) { return value < entry.low; });
+            range = it == index->unit_ranges.begin() || address >= (it - 1)->high ? nullptr : &*(it - 1);
+            unit = range ? &index->units[range->unit] : nullptr;
+        }
+        if (unit) {
+            dwarf_resolve(index, dwarf_unit_tables(index, unit), address, &locations[i]);
+        }
+    }
+}
+
+#endif // CRASHREPORTER_DWARF_LINE_INDEX_H
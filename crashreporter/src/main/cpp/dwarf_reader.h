@@ -0,0 +1,176 @@
+/**
+ * Bounded readers for DWARF / .eh_frame encoded data
+ *
+ * Every read goes through a cursor that knows where its data ends, so a
+ * malformed table stops the reader instead of running off into unmapped
+ * memory. No allocation and no locks: safe inside a signal handler.
+ */
+
+#ifndef CRASHREPORTER_DWARF_READER_H
+#define CRASHREPORTER_DWARF_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pointer encodings (DW_EH_PE_*): low nibble is the format...
+#define DW_EH_PE_absptr   0x00
+#define DW_EH_PE_uleb128  0x01
+#define DW_EH_PE_udata2   0x02
+#define DW_EH_PE_udata4   0x03
+#define DW_EH_PE_udata8   0x04
+#define DW_EH_PE_sleb128  0x09
+#define DW_EH_PE_sdata2   0x0a
+#define DW_EH_PE_sdata4   0x0b
+#define DW_EH_PE_sdata8   0x0c
+// ...bits 4-6 what it is relative to...
+#define DW_EH_PE_pcrel    0x10
+#define DW_EH_PE_textrel  0x20
+#define DW_EH_PE_datarel  0x30
+#define DW_EH_PE_funcrel  0x40
+#define DW_EH_PE_aligned  0x50
+// ...and bit 7 an extra indirection
+#define DW_EH_PE_indirect 0x80
+#define DW_EH_PE_omit     0xff
+
+struct DwarfCursor {
+    const uint8_t* pos;
+    const uint8_t* end;
+    bool ok;                    // Cleared by the first out-of-bounds or malformed read
+};
+
+static inline void dwarf_cursor_init(DwarfCursor* cursor, const void* start, const void* end) {
+    cursor->pos = (const uint8_t*)start;
+    cursor->end = (const uint8_t*)end;
+    cursor->ok = cursor->pos <= cursor->end;
+}
+
+static inline bool dwarf_has(const DwarfCursor* cursor, size_t len) {
+    return cursor->ok && (size_t)(cursor->end - cursor->pos) >= len;
+}
+
+static inline bool dwarf_at_end(const DwarfCursor* cursor) {
+    return !cursor->ok || cursor->pos >= cursor->end;
+}
+
+static inline void dwarf_skip(DwarfCursor* cursor, size_t len) {
+    if (!dwarf_has(cursor, len)) {
+        cursor->ok = false;
+        return;
+    }
+    cursor->pos += len;
+}
+
+// Fixed-size little-endian reads (unaligned-safe); 0 once the cursor has failed
+static inline uint64_t dwarf_read_fixed(DwarfCursor* cursor, size_t len) {
+    if (!dwarf_has(cursor, len)) {
+        cursor->ok = false;
+        return 0;
+    }
+    uint64_t value = 0;
+    memcpy(&value, cursor->pos, len);
+    cursor->pos += len;
+    return value;
+}
+
+static inline uint8_t dwarf_read_u8(DwarfCursor* cursor) {
+    return (uint8_t)dwarf_read_fixed(cursor, 1);
+}
+
+static inline uint16_t dwarf_read_u16(DwarfCursor* cursor) {
+    return (uint16_t)dwarf_read_fixed(cursor, 2);
+}
+
+static inline uint32_t dwarf_read_u32(DwarfCursor* cursor) {
+    return (uint32_t)dwarf_read_fixed(cursor, 4);
+}
+
+static inline uint64_t dwarf_read_u64(DwarfCursor* cursor) {
+    return dwarf_read_fixed(cursor, 8);
+}
+
+static inline uint64_t dwarf_read_uleb128(DwarfCursor* cursor) {
+    uint64_t value = 0;
+    unsigned shift = 0;
+    while (dwarf_has(cursor, 1)) {
+        uint8_t byte = *cursor->pos++;
+        if (shift < 64) {
+            value |= (uint64_t)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    cursor->ok = false;
+    return 0;
+}
+
+static inline int64_t dwarf_read_sleb128(DwarfCursor* cursor) {
+    int64_t value = 0;
+    unsigned shift = 0;
+    while (dwarf_has(cursor, 1)) {
+        uint8_t byte = *cursor->pos++;
+        if (shift < 64) {
+            value |= (int64_t)((uint64_t)(byte & 0x7f) << shift);
+        }
+        shift += 7;
+        if ((byte & 0x80) == 0) {
+            if (shift < 64 && (byte & 0x40)) {
+                value |= -((int64_t)1 << shift);
+            }
+            return value;
+        }
+    }
+    cursor->ok = false;
+    return 0;
+}
+
+// Read a DW_EH_PE_* encoded pointer. data_base resolves datarel values
+// (the .eh_frame_hdr address); textrel/funcrel/aligned are not used by
+// .eh_frame on the supported ABIs and fail the read.
+static inline bool dwarf_read_encoded(DwarfCursor* cursor, uint8_t encoding, uintptr_t data_base, uintptr_t* out) {
+    if (encoding == DW_EH_PE_omit) {
+        cursor->ok = false;
+        return false;
+    }
+
+    uintptr_t field = (uintptr_t)cursor->pos;
+    uint64_t value;
+    switch (encoding & 0x0f) {
+        case DW_EH_PE_absptr:  value = dwarf_read_fixed(cursor, sizeof(uintptr_t)); break;
+        case DW_EH_PE_uleb128: value = dwarf_read_uleb128(cursor); break;
+        case DW_EH_PE_udata2:  value = dwarf_read_u16(cursor); break;
+        case DW_EH_PE_udata4:  value = dwarf_read_u32(cursor); break;
+        case DW_EH_PE_udata8:  value = dwarf_read_u64(cursor); break;
+        case DW_EH_PE_sleb128: value = (uint64_t)dwarf_read_sleb128(cursor); break;
+        case DW_EH_PE_sdata2:  value = (uint64_t)(int64_t)(int16_t)dwarf_read_u16(cursor); break;
+        case DW_EH_PE_sdata4:  value = (uint64_t)(int64_t)(int32_t)dwarf_read_u32(cursor); break;
+        case DW_EH_PE_sdata8:  value = dwarf_read_u64(cursor); break;
+        default:
+            cursor->ok = false;
+            return false;
+    }
+    if (!cursor->ok) {
+        return false;
+    }
+
+    uintptr_t result = (uintptr_t)value;
+    switch (encoding & 0x70) {
+        case DW_EH_PE_absptr:  break;
+        case DW_EH_PE_pcrel:   result += field; break;
+        case DW_EH_PE_datarel: result += data_base; break;
+        default:
+            cursor->ok = false;
+            return false;
+    }
+
+    if (encoding & DW_EH_PE_indirect) {
+        // Points into the module's own (relocated) data
+        memcpy(&result, (const void*)result, sizeof(result));
+    }
+    *out = result;
+    return true;
+}
+
+#endif // CRASHREPORTER_DWARF_READER_H
@@ -0,0 +1,76 @@
+/**
+ * .eh_frame_hdr lookup tables
+ *
+ * The linker-generated .eh_frame_hdr section (PT_GNU_EH_FRAME) holds a
+ * table of {function start, FDE} pairs sorted by address. Each module's
+ * table is located once when the module map is built (module_map.h);
+ * finding the FDE for a pc at crash time is then a binary search over
+ * memory that is already mapped, with no loader lock, no allocation and no
+ * syscall.
+ */
+
+#ifndef CRASHREPORTER_EH_FRAME_HDR_H
+#define CRASHREPORTER_EH_FRAME_HDR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dwarf_reader.h"
+
+// The only table encoding the binary search supports (what lld and ld.bfd emit)
+#define EH_FRAME_HDR_TABLE_ENCODING (DW_EH_PE_datarel | DW_EH_PE_sdata4)
+
+struct EhFrameTable {
+    const uint8_t* hdr;         // .eh_frame_hdr, base of the datarel table entries
+    const int32_t* entries;     // fde_count {initial location, FDE} pairs
+    size_t fde_count;
+};
+
+// Locate the binary-search table of a mapped .eh_frame_hdr; false if it has none
+static inline bool eh_frame_hdr_parse(const uint8_t* hdr, EhFrameTable* table) {
+    // version, eh_frame_ptr_enc, fde_count_enc, table_enc, eh_frame_ptr, fde_count
+    DwarfCursor cursor;
+    dwarf_cursor_init(&cursor, hdr, hdr + 4 + 2 * sizeof(uint64_t));
+    uint8_t version = dwarf_read_u8(&cursor);
+    uint8_t eh_frame_ptr_enc = dwarf_read_u8(&cursor);
+    uint8_t fde_count_enc = dwarf_read_u8(&cursor);
+    uint8_t table_enc = dwarf_read_u8(&cursor);
+    if (!cursor.ok || version != 1 || table_enc != EH_FRAME_HDR_TABLE_ENCODING ||
+        fde_count_enc == DW_EH_PE_omit) {
+        return false;
+    }
+
+    uintptr_t eh_frame = 0;
+    uintptr_t fde_count = 0;
+    if (!dwarf_read_encoded(&cursor, eh_frame_ptr_enc, (uintptr_t)hdr, &eh_frame) ||
+        !dwarf_read_encoded(&cursor, fde_count_enc, (uintptr_t)hdr, &fde_count) || fde_count == 0) {
+        return false;
+    }
+
+    table->hdr = hdr;
+    table->entries = (const int32_t*)cursor.pos;
+    table->fde_count = fde_count;
+    return true;
+}
+
+// FDE whose range may contain pc: the entry with the greatest initial
+// location <= pc. The caller checks the FDE's own pc range.
+static inline const uint8_t* eh_frame_hdr_find_fde(const EhFrameTable* table, uintptr_t pc) {
+    uintptr_t base = (uintptr_t)table->hdr;
+    size_t lo = 0;
+    size_t hi = table->fde_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (base + (intptr_t)table->entries[mid * 2] <= pc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return nullptr;
+    }
+    return (const uint8_t*)(base + (intptr_t)table->entries[(lo - 1) * 2 + 1]);
+}
+
+#endif // CRASHREPORTER_EH_FRAME_HDR_H
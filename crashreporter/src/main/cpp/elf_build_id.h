@@ -0,0 +1,83 @@
+/**
+ * GNU build-id notes
+ *
+ * The linker stores a hash of the module's contents in an NT_GNU_BUILD_ID
+ * note (PT_NOTE segment, .note.gnu.build-id section). It identifies the
+ * exact build of a library independently of its path, so a crash record
+ * can be matched with the right symbols after the app was updated.
+ * Parsing works on any buffer of notes: mapped memory in the module map,
+ * or bytes read from the file when symbolizing.
+ */
+
+#ifndef CRASHREPORTER_ELF_BUILD_ID_H
+#define CRASHREPORTER_ELF_BUILD_ID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Longest build-id kept (lld/ld.bfd emit 8, 16 or 20 bytes)
+#define ELF_BUILD_ID_MAX_SIZE 32
+
+#define ELF_NOTE_GNU_BUILD_ID 3
+
+struct ElfBuildId {
+    uint8_t length;             // 0: module has no build-id
+    uint8_t bytes[ELF_BUILD_ID_MAX_SIZE];
+};
+
+static inline size_t elf_note_align(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+// Find the NT_GNU_BUILD_ID note in a PT_NOTE segment; false if there is none
+static inline bool elf_build_id_from_notes(const uint8_t* notes, size_t size, ElfBuildId* build_id) {
+    // Elf32_Nhdr and Elf64_Nhdr are both three 32-bit words: namesz, descsz, type
+    size_t pos = 0;
+    while (size - pos >= 12) {
+        uint32_t header[3];
+        memcpy(header, notes + pos, sizeof(header));
+        size_t name_size = elf_note_align(header[0]);
+        size_t desc_size = elf_note_align(header[1]);
+        pos += 12;
+        if (name_size > size - pos || desc_size > size - pos - name_size) {
+            return false;
+        }
+        if (header[2] == ELF_NOTE_GNU_BUILD_ID && header[0] == 4 && memcmp(notes + pos, "GNU", 4) == 0 &&
+            header[1] > 0 && header[1] <= ELF_BUILD_ID_MAX_SIZE) {
+            build_id->length = (uint8_t)header[1];
+            memcpy(build_id->bytes, notes + pos + name_size, header[1]);
+            return true;
+        }
+        pos += name_size + desc_size;
+    }
+    return false;
+}
+
+static inline bool elf_build_id_equal(const ElfBuildId* a, const ElfBuildId* b) {
+    return a->length == b->length && memcmp(a->bytes, b->bytes, a->length) == 0;
+}
+
+// Parse the lowercase hex form written to crash records; false if malformed
+static inline bool elf_build_id_from_hex(const char* hex, ElfBuildId* build_id) {
+    size_t len = strlen(hex);
+    if (len == 0 || len % 2 != 0 || len / 2 > ELF_BUILD_ID_MAX_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = hex[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (nibble < 0) {
+            return false;
+        }
+        if (i % 2 == 0) {
+            build_id->bytes[i / 2] = (uint8_t)(nibble << 4);
+        } else {
+            build_id->bytes[i / 2] |= (uint8_t)nibble;
+        }
+    }
+    build_id->length = (uint8_t)(len / 2);
+    return true;
+}
+
+#endif // CRASHREPORTER_ELF_BUILD_ID_H
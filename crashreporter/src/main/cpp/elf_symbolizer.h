@@ -0,0 +1,354 @@
+/**
+ * Post-crash ELF symbolization
+ *
+ * Crash records carry (module, offset) pairs instead of names; this resolves
+ * them on the next launch, off the crash path. The module's .symtab (or
+ * .dynsym when stripped) is read with pread() and sorted once per module.
+ * Stripped system libraries carry their local function symbols in an
+ * xz-compressed .gnu_debugdata ELF ("MiniDebugInfo"); it is decoded
+ * (xz_decoder.h) and merged in, so frames in libc or libart get names.
+ * Libraries loaded straight from an APK ("base.apk!/lib/<abi>/libfoo.so")
+ * are located inside the zip, where they are stored uncompressed. The file's
+ * build-id is read too, so callers can refuse a library that was replaced
+ * since the crash.
+ *
+ * Not async-signal-safe: never include this in the crash path. The host
+ * symbolizer (tools/symbolizer) builds on the same code.
+ */
+
+#ifndef CRASHREPORTER_ELF_SYMBOLIZER_H
+#define CRASHREPORTER_ELF_SYMBOLIZER_H
+
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "elf_build_id.h"
+#include "xz_decoder.h"
+
+// Upper bound on a symbol or string table we are willing to load
+#define ELF_SYMBOLIZER_MAX_TABLE_SIZE (256u * 1024 * 1024)
+
+struct ElfSymbol {
+    uint64_t address;           // ELF virtual address
+    uint64_t size;
+    uint32_t name_offset;       // Into ElfSymbolTable::names
+};
+
+struct ElfSymbolTable {
+    std::vector<ElfSymbol> symbols;     // Sorted by address
+    std::string names;
+    ElfBuildId build_id;                // length 0 if the file has none
+    size_t debugdata_symbols = 0;       // Of symbols, how many came from .gnu_debugdata
+};
+
+// An ELF image in a file (fd, at base), or in memory (data: a decoded .gnu_debugdata)
+struct ElfImageReader {
+    int fd;
+    uint64_t base;
+    const std::string* data;
+};
+
+static inline bool elf_pread_fully(int fd, void* data, size_t len, uint64_t offset) {
+    char* out = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = pread(fd, out, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        out += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+static inline bool elf_image_read(const ElfImageReader* image, void* data, size_t len, uint64_t offset) {
+    if (!image->data) {
+        return elf_pread_fully(image->fd, data, len, image->base + offset);
+    }
+    if (offset > image->data->size() || len > image->data->size() - offset) {
+        return false;
+    }
+    memcpy(data, image->data->data() + offset, len);
+    return true;
+}
+
+static inline uint16_t elf_le16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t elf_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Offset of a stored (uncompressed) entry's data inside a zip file
+static inline bool elf_zip_find_entry(int fd, const std::string& entry, uint64_t* data_offset) {
+    off_t file_size = lseek(fd, 0, SEEK_END);
+    if (file_size < 22) {
+        return false;
+    }
+
+    // End of central directory record: last 22 bytes plus up to 64 KiB of comment
+    size_t tail_size = (size_t)std::min<off_t>(file_size, 22 + 0xffff);
+    std::vector<uint8_t> tail(tail_size);
+    if (!elf_pread_fully(fd, tail.data(), tail_size, (uint64_t)(file_size - (off_t)tail_size))) {
+        return false;
+    }
+    const uint8_t* eocd = nullptr;
+    for (size_t i = tail_size - 22 + 1; i-- > 0;) {
+        if (elf_le32(&tail[i]) == 0x06054b50) {
+            eocd = &tail[i];
+            break;
+        }
+    }
+    if (!eocd) {
+        return false;
+    }
+
+    uint32_t cd_size = elf_le32(eocd + 12);
+    uint32_t cd_offset = elf_le32(eocd + 16);
+    std::vector<uint8_t> cd(cd_size);
+    if (!elf_pread_fully(fd, cd.data(), cd_size, cd_offset)) {
+        return false;
+    }
+
+    for (size_t pos = 0; pos + 46 <= cd.size() && elf_le32(&cd[pos]) == 0x02014b50;) {
+        uint16_t method = elf_le16(&cd[pos + 10]);
+        uint16_t name_len = elf_le16(&cd[pos + 28]);
+        uint16_t extra_len = elf_le16(&cd[pos + 30]);
+        uint16_t comment_len = elf_le16(&cd[pos + 32]);
+        uint32_t local_offset = elf_le32(&cd[pos + 42]);
+        if (pos + 46 + name_len > cd.size()) {
+            return false;
+        }
+        if (name_len == entry.size() && memcmp(&cd[pos + 46], entry.data(), name_len) == 0) {
+            uint8_t local[30];
+            if (method != 0 || !elf_pread_fully(fd, local, sizeof(local), local_offset) ||
+                elf_le32(local) != 0x04034b50) {
+                return false;
+            }
+            *data_offset = (uint64_t)local_offset + 30 + elf_le16(local + 26) + elf_le16(local + 28);
+            return true;
+        }
+        pos += 46 + name_len + extra_len + comment_len;
+    }
+    return false;
+}
+
+template <typename Ehdr, typename Shdr, typename Sym>
+static bool elf_load_symbols_class(const ElfImageReader* image, ElfSymbolTable* table);
+
+// Merge the symbols of the MiniDebugInfo ELF compressed in section into table
+template <typename Ehdr, typename Shdr, typename Sym>
+static void elf_merge_debugdata(const ElfImageReader* image, const Shdr& section, ElfSymbolTable* table) {
+    XzSource source = { image->fd, nullptr, image->base + section.sh_offset, section.sh_size };
+    std::string decoded;
+    char elf_class = sizeof(Ehdr) == sizeof(Elf64_Ehdr) ? ELFCLASS64 : ELFCLASS32;
+    if (!xz_decode(&source, &decoded) || decoded.size() < sizeof(Ehdr) ||
+        memcmp(decoded.data(), ELFMAG, SELFMAG) != 0 || decoded[EI_CLASS] != elf_class) {
+        return;
+    }
+    ElfImageReader inner = { -1, 0, &decoded };
+    ElfSymbolTable mini;
+    if (!elf_load_symbols_class<Ehdr, Shdr, Sym>(&inner, &mini) || mini.symbols.empty()) {
+        return;
+    }
+    uint32_t names_base = (uint32_t)table->names.size();
+    table->names += mini.names;
+    for (const ElfSymbol& symbol : mini.symbols) {
+        table->symbols.push_back({ symbol.address, symbol.size, names_base + symbol.name_offset });
+    }
+    table->debugdata_symbols = mini.symbols.size();
+}
+
+template <typename Ehdr, typename Shdr, typename Sym>
+static bool elf_load_symbols_class(const ElfImageReader* image, ElfSymbolTable* table) {
+    Ehdr ehdr;
+    if (!elf_image_read(image, &ehdr, sizeof(ehdr), 0) || ehdr.e_shentsize != sizeof(Shdr) || ehdr.e_shnum == 0) {
+        return false;
+    }
+    std::vector<Shdr> sections(ehdr.e_shnum);
+    if (!elf_image_read(image, sections.data(), sizeof(Shdr) * sections.size(), ehdr.e_shoff)) {
+        return false;
+    }
+
+    // Prefer the full symbol table; stripped libraries only have .dynsym
+    const Shdr* symtab = nullptr;
+    for (const Shdr& section : sections) {
+        if (section.sh_type == SHT_SYMTAB || (section.sh_type == SHT_DYNSYM && !symtab)) {
+            symtab = &section;
+        }
+    }
+    if (!symtab || symtab->sh_link >= sections.size() || symtab->sh_entsize != sizeof(Sym)) {
+        return false;
+    }
+    const Shdr& strtab = sections[symtab->sh_link];
+    if (symtab->sh_size > ELF_SYMBOLIZER_MAX_TABLE_SIZE || strtab.sh_size > ELF_SYMBOLIZER_MAX_TABLE_SIZE) {
+        return false;
+    }
+
+    std::vector<Sym> symbols(symtab->sh_size / sizeof(Sym));
+    table->names.resize(strtab.sh_size);
+    if (!elf_image_read(image, symbols.data(), sizeof(Sym) * symbols.size(), symtab->sh_offset) ||
+        !elf_image_read(image, &table->names[0], strtab.sh_size, strtab.sh_offset)) {
+        return false;
+    }
+
+    table->symbols.clear();
+    for (const Sym& sym : symbols) {
+        int type = sym.st_info & 0xf;
+        if ((type == STT_FUNC || type == STT_GNU_IFUNC) && sym.st_value != 0 && sym.st_shndx != SHN_UNDEF &&
+            sym.st_name < table->names.size()) {
+            // Unsized symbols (_init, _fini, hand-written assembly) end with their section at the latest
+            uint64_t size = sym.st_size;
+            if (size == 0 && sym.st_shndx < sections.size()) {
+                const Shdr& section = sections[sym.st_shndx];
+                if (sym.st_value >= section.sh_addr && sym.st_value < section.sh_addr + section.sh_size) {
+                    size = section.sh_addr + section.sh_size - sym.st_value;
+                }
+            }
+            table->symbols.push_back({ (uint64_t)sym.st_value, size, sym.st_name });
+        }
+    }
+
+    // .dynsym only names exported functions; the rest may be in .gnu_debugdata
+    if (symtab->sh_type == SHT_DYNSYM && !image->data && ehdr.e_shstrndx < sections.size()) {
+        const Shdr& shstrtab = sections[ehdr.e_shstrndx];
+        std::string section_names(std::min<uint64_t>(shstrtab.sh_size, 64 * 1024), '\0');
+        if (elf_image_read(image, &section_names[0], section_names.size(), shstrtab.sh_offset)) {
+            for (const Shdr& section : sections) {
+                if (section.sh_type == SHT_PROGBITS && section.sh_name < section_names.size() &&
+                    strcmp(section_names.c_str() + section.sh_name, ".gnu_debugdata") == 0) {
+                    elf_merge_debugdata<Ehdr, Shdr, Sym>(image, section, table);
+                    break;
+                }
+            }
+        }
+    }
+
+    std::sort(table->symbols.begin(), table->symbols.end(),
+              [](const ElfSymbol& a, const ElfSymbol& b) { return a.address < b.address; });
+    return true;
+}
+
+template <typename Ehdr, typename Phdr>
+static void elf_read_build_id_class(int fd, uint64_t base, ElfBuildId* build_id) {
+    build_id->length = 0;
+    Ehdr ehdr;
+    if (!elf_pread_fully(fd, &ehdr, sizeof(ehdr), base) || ehdr.e_phentsize != sizeof(Phdr)) {
+        return;
+    }
+    std::vector<Phdr> phdrs(ehdr.e_phnum);
+    if (!elf_pread_fully(fd, phdrs.data(), sizeof(Phdr) * phdrs.size(), base + ehdr.e_phoff)) {
+        return;
+    }
+    for (const Phdr& phdr : phdrs) {
+        if (phdr.p_type != PT_NOTE || phdr.p_filesz > 64 * 1024) {
+            continue;
+        }
+        std::vector<uint8_t> notes(phdr.p_filesz);
+        if (elf_pread_fully(fd, notes.data(), notes.size(), base + phdr.p_offset) &&
+            elf_build_id_from_notes(notes.data(), notes.size(), build_id)) {
+            return;
+        }
+    }
+}
+
+// Open the ELF image at path ("apk!/entry" supported); -1 if it is not one.
+// base is the image's offset in the file; ident receives e_ident.
+static inline int elf_open_image(const char* path, uint64_t* base, unsigned char* ident) {
+    std::string file = path;
+    std::string entry;
+    size_t separator = file.find("!/");
+    if (separator != std::string::npos) {
+        entry = file.substr(separator + 2);
+        file.resize(separator);
+    }
+
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    *base = 0;
+    if ((entry.empty() || elf_zip_find_entry(fd, entry, base)) && elf_pread_fully(fd, ident, EI_NIDENT, *base) &&
+        memcmp(ident, ELFMAG, SELFMAG) == 0) {
+        return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+static inline void elf_read_build_id(int fd, uint64_t base, const unsigned char* ident, ElfBuildId* build_id) {
+    if (ident[EI_CLASS] == ELFCLASS64) {
+        elf_read_build_id_class<Elf64_Ehdr, Elf64_Phdr>(fd, base, build_id);
+    } else {
+        elf_read_build_id_class<Elf32_Ehdr, Elf32_Phdr>(fd, base, build_id);
+    }
+}
+
+// Build-id of the module at path, without loading its symbols
+static inline bool elf_file_build_id(const char* path, ElfBuildId* build_id) {
+    uint64_t base;
+    unsigned char ident[EI_NIDENT];
+    int fd = elf_open_image(path, &base, ident);
+    if (fd < 0) {
+        return false;
+    }
+    elf_read_build_id(fd, base, ident, build_id);
+    close(fd);
+    return build_id->length > 0;
+}
+
+// Load the function symbols of the module at path ("apk!/entry" supported)
+static inline bool elf_symbols_load(const char* path, ElfSymbolTable* table) {
+    uint64_t base;
+    unsigned char ident[EI_NIDENT];
+    int fd = elf_open_image(path, &base, ident);
+    if (fd < 0) {
+        return false;
+    }
+
+    elf_read_build_id(fd, base, ident, &table->build_id);
+    ElfImageReader image = { fd, base, nullptr };
+    bool ok = ident[EI_CLASS] == ELFCLASS64 ? elf_load_symbols_class<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(&image, table)
+                                            : elf_load_symbols_class<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(&image, table);
+    close(fd);
+    return ok;
+}
+
+// Function containing address (an ELF virtual address), or null
+static inline const ElfSymbol* elf_symbols_lookup(const ElfSymbolTable* table, uint64_t address) {
+    auto it = std::upper_bound(table->symbols.begin(), table->symbols.end(), address,
+                               [](uint64_t value, const ElfSymbol& sym) { return value < sym.address; });
+    while (it != table->symbols.begin()) {
+        --it;
+        if (address < it->address + it->size) {
+            return &*it;
+        }
+        // Aliases share an address; an unsized symbol ends where the next one starts
+        if (it->size == 0) {
+            return &*it;
+        }
+        if (it == table->symbols.begin() || (it - 1)->address != it->address) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+static inline const char* elf_symbol_name(const ElfSymbolTable* table, const ElfSymbol* symbol) {
+    return table->names.c_str() + symbol->name_offset;
+}
+
+#endif // CRASHREPORTER_ELF_SYMBOLIZER_H
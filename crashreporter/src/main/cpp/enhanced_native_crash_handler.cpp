@@ -5,7 +5,7 @@
  * - Register dump (PC, SP, LR, general purpose registers)
  * - Memory dump around fault address
  * - Increased stack depth (128 frames)
- * - JSON output format
+ * - JSON output format (binary record at crash time, JSON document on the next launch)
  * - Better symbol resolution
  */
 
@@ -20,10 +20,21 @@
 #include <cstdlib>
 #include <pthread.h>
 #include <android/log.h>
-#include <unwind.h>
-#include <dlfcn.h>
 #include <ucontext.h>
 
+#include "crash_context.h"
+#include "crash_coordination.h"
+#include "crash_journal.h"
+#include "crash_record_builder.h"
+#include "crash_record_format.h"
+#include "crash_record_jni.h"
+#include "crash_record_writer.h"
+#include "minidump_writer.h"
+#include "module_map.h"
+#include "safe_memory.h"
+#include "signal_safe_format.h"
+#include "stack_unwinder.h"
+
 #define LOG_TAG "EnhancedNativeCrashHandler"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
@@ -35,13 +46,19 @@
 // Memory dump size (256 bytes before and after fault address)
 #define MEMORY_DUMP_SIZE 256
 
+// Unreadable ranges recorded for the dump (2 x 256 bytes span at most 4 pages)
+#define MEMORY_DUMP_MAX_UNREADABLE 4
+
+// Capture modes (keep in sync with NativeCrashHandler.CaptureMode)
+#define CAPTURE_MODE_FILE 0
+#define CAPTURE_MODE_MMAP 1
+
 // Structure to hold enhanced crash information
 struct EnhancedCrashInfo {
     // Basic crash info
     int signal;
     int code;
     void* fault_address;
-    char signal_name[32];
     char thread_name[128];
     pid_t pid;
     pid_t tid;
@@ -50,343 +67,186 @@ struct EnhancedCrashInfo {
     // Stack frames
     uintptr_t stack_frames[MAX_STACK_FRAMES];
     size_t frame_count;
+    UnwindMethod unwind_method;
 
-    // NEW: Register dump
-    struct {
-        uintptr_t pc;   // Program Counter
-        uintptr_t sp;   // Stack Pointer
-        uintptr_t lr;   // Link Register (return address)
-
-        #ifdef __aarch64__
-        // ARM64 registers
-        uintptr_t x[31];    // x0-x30 general purpose registers
-        uintptr_t cpsr;     // Current Program Status Register
-        #elif defined(__arm__)
-        // ARM32 registers
-        uintptr_t r[16];    // r0-r15 general purpose registers
-        uintptr_t cpsr;     // Current Program Status Register
-        #elif defined(__i386__)
-        // x86 registers
-        uintptr_t eax, ebx, ecx, edx;
-        uintptr_t esi, edi, ebp, esp, eip;
-        #elif defined(__x86_64__)
-        // x86_64 registers
-        uintptr_t rax, rbx, rcx, rdx;
-        uintptr_t rsi, rdi, rbp, rsp, rip;
-        uintptr_t r8, r9, r10, r11, r12, r13, r14, r15;
-        #endif
-    } registers;
+    // Register block of the architecture (see CrashRecordArchInfo)
+    uintptr_t registers[CRASH_RECORD_MAX_REGISTERS];
+    size_t register_count;
 
     // NEW: Memory dump around fault address
-    unsigned char memory_before[MEMORY_DUMP_SIZE];
-    unsigned char memory_after[MEMORY_DUMP_SIZE];
-    bool memory_readable;
+    unsigned char memory[2 * MEMORY_DUMP_SIZE];    // From memory_start
+    uintptr_t memory_start;     // Fault address - MEMORY_DUMP_SIZE, kept inside the address space
+    bool memory_readable;       // At least one byte of the dump could be read
+    MemoryRange memory_unreadable[MEMORY_DUMP_MAX_UNREADABLE];
+    size_t memory_unreadable_count;
 };
 
 // Global storage for crash info (must be signal-safe)
 static EnhancedCrashInfo g_crash_info;
 static char g_crash_file_path[256];
+static char g_journal_path[256];
+// Crash journal opened and pre-allocated by initialize() (see crash_journal.h)
+static CrashJournal g_journal = { -1, nullptr, 0, 0, 0, 0, 0 };
+// Pre-reserved arena the whole crash record is formatted into before it is flushed
+static char g_record_buffer[CRASH_JOURNAL_BODY_SIZE];
+// Elects the one thread that captures when several threads crash at once
+static CrashCoordinator g_coordinator;
+// Optional minidump output, prepared by initialize() (see minidump_writer.h)
+static MinidumpWriter g_minidump = {};
+static char g_minidump_buffer[MINIDUMP_BUFFER_SIZE];
+// Primary unwinder selected at initialize() (UNWINDER_*)
+static int g_unwinder = UNWINDER_UNWIND_BACKTRACE;
 static struct sigaction g_old_handlers[32];
 static bool g_initialized = false;
 
-// Signal names
-static const char* get_signal_name(int sig) {
-    switch (sig) {
-        case SIGSEGV: return "SIGSEGV";
-        case SIGABRT: return "SIGABRT";
-        case SIGFPE:  return "SIGFPE";
-        case SIGILL:  return "SIGILL";
-        case SIGBUS:  return "SIGBUS";
-        case SIGTRAP: return "SIGTRAP";
-        default:      return "UNKNOWN";
-    }
-}
-
-// Signal descriptions
-static const char* get_signal_description(int sig) {
-    switch (sig) {
-        case SIGSEGV: return "Segmentation fault (invalid memory access)";
-        case SIGABRT: return "Abort signal (abnormal termination)";
-        case SIGFPE:  return "Floating point exception";
-        case SIGILL:  return "Illegal instruction";
-        case SIGBUS:  return "Bus error (invalid memory alignment)";
-        case SIGTRAP: return "Trace/breakpoint trap";
-        default:      return "Unknown signal";
-    }
-}
-
-// Unwind callback structure
-struct UnwindState {
-    uintptr_t* frames;
-    size_t frame_count;
-    size_t max_frames;
-};
-
-// Callback for stack unwinding
-static _Unwind_Reason_Code unwind_callback(struct _Unwind_Context* context, void* arg) {
-    UnwindState* state = static_cast<UnwindState*>(arg);
-
-    if (state->frame_count >= state->max_frames) {
-        return _URC_END_OF_STACK;
-    }
-
-    uintptr_t pc = _Unwind_GetIP(context);
-    if (pc) {
-        state->frames[state->frame_count++] = pc;
-    }
-
-    return _URC_NO_REASON;
-}
-
-// Capture stack trace
-static size_t capture_stack_trace(uintptr_t* frames, size_t max_frames) {
-    UnwindState state;
-    state.frames = frames;
-    state.frame_count = 0;
-    state.max_frames = max_frames;
-
-    _Unwind_Backtrace(unwind_callback, &state);
-
-    return state.frame_count;
-}
-
 // Get thread name
 static void get_thread_name(char* buffer, size_t size) {
 #if __ANDROID_API__ >= 26
     pthread_t thread = pthread_self();
-    if (pthread_getname_np(thread, buffer, size) != 0) {
-        snprintf(buffer, size, "Thread-%d", (int)gettid());
+    if (pthread_getname_np(thread, buffer, size) == 0) {
+        return;
     }
-#else
-    snprintf(buffer, size, "Thread-%d", (int)gettid());
 #endif
-}
-
-// NEW: Capture registers from context
-static void capture_registers(EnhancedCrashInfo* info, void* context) {
-    if (!context) return;
-
-    ucontext_t* uc = (ucontext_t*)context;
-
-    #ifdef __aarch64__
-    // ARM64
-    info->registers.pc = uc->uc_mcontext.pc;
-    info->registers.sp = uc->uc_mcontext.sp;
-    // LR is x30 on ARM64
-    info->registers.lr = uc->uc_mcontext.regs[30];
-    info->registers.cpsr = uc->uc_mcontext.pstate;
-
-    for (int i = 0; i < 31; i++) {
-        info->registers.x[i] = uc->uc_mcontext.regs[i];
-    }
-
-    #elif defined(__arm__)
-    // ARM32
-    info->registers.pc = uc->uc_mcontext.arm_pc;
-    info->registers.sp = uc->uc_mcontext.arm_sp;
-    info->registers.lr = uc->uc_mcontext.arm_lr;
-    info->registers.cpsr = uc->uc_mcontext.arm_cpsr;
-
-    info->registers.r[0] = uc->uc_mcontext.arm_r0;
-    info->registers.r[1] = uc->uc_mcontext.arm_r1;
-    info->registers.r[2] = uc->uc_mcontext.arm_r2;
-    info->registers.r[3] = uc->uc_mcontext.arm_r3;
-    info->registers.r[4] = uc->uc_mcontext.arm_r4;
-    info->registers.r[5] = uc->uc_mcontext.arm_r5;
-    info->registers.r[6] = uc->uc_mcontext.arm_r6;
-    info->registers.r[7] = uc->uc_mcontext.arm_r7;
-    info->registers.r[8] = uc->uc_mcontext.arm_r8;
-    info->registers.r[9] = uc->uc_mcontext.arm_r9;
-    info->registers.r[10] = uc->uc_mcontext.arm_r10;
-    info->registers.r[11] = uc->uc_mcontext.arm_fp;
-    info->registers.r[12] = uc->uc_mcontext.arm_ip;
-    info->registers.r[13] = uc->uc_mcontext.arm_sp;
-    info->registers.r[14] = uc->uc_mcontext.arm_lr;
-    info->registers.r[15] = uc->uc_mcontext.arm_pc;
-
-    #elif defined(__x86_64__)
-    // x86_64
-    info->registers.rip = uc->uc_mcontext.gregs[REG_RIP];
-    info->registers.rsp = uc->uc_mcontext.gregs[REG_RSP];
-    info->registers.rbp = uc->uc_mcontext.gregs[REG_RBP];
-    info->registers.rax = uc->uc_mcontext.gregs[REG_RAX];
-    info->registers.rbx = uc->uc_mcontext.gregs[REG_RBX];
-    info->registers.rcx = uc->uc_mcontext.gregs[REG_RCX];
-    info->registers.rdx = uc->uc_mcontext.gregs[REG_RDX];
-    info->registers.rsi = uc->uc_mcontext.gregs[REG_RSI];
-    info->registers.rdi = uc->uc_mcontext.gregs[REG_RDI];
-
-    #elif defined(__i386__)
-    // x86
-    info->registers.eip = uc->uc_mcontext.gregs[REG_EIP];
-    info->registers.esp = uc->uc_mcontext.gregs[REG_ESP];
-    info->registers.ebp = uc->uc_mcontext.gregs[REG_EBP];
-    info->registers.eax = uc->uc_mcontext.gregs[REG_EAX];
-    info->registers.ebx = uc->uc_mcontext.gregs[REG_EBX];
-    info->registers.ecx = uc->uc_mcontext.gregs[REG_ECX];
-    info->registers.edx = uc->uc_mcontext.gregs[REG_EDX];
-    info->registers.esi = uc->uc_mcontext.gregs[REG_ESI];
-    info->registers.edi = uc->uc_mcontext.gregs[REG_EDI];
-    #endif
+    char storage[32];
+    FormatBuffer fmt;
+    fmt_init(&fmt, storage, sizeof(storage));
+    fmt_append_str(&fmt, "Thread-");
+    fmt_append_dec(&fmt, gettid());
+    fmt_copy_cstr(buffer, size, &fmt);
 }
 
 // NEW: Try to read memory around fault address
 static void capture_memory_dump(EnhancedCrashInfo* info) {
     info->memory_readable = false;
+    info->memory_unreadable_count = 0;
 
     if (!info->fault_address) {
         return;
     }
 
-    // Try to read memory before fault address
-    unsigned char* addr = (unsigned char*)info->fault_address;
-
-    // Read before
-    for (int i = 0; i < MEMORY_DUMP_SIZE; i++) {
-        unsigned char* read_addr = addr - MEMORY_DUMP_SIZE + i;
-        // Try to read (may fail if not readable)
-        __builtin_memcpy(&info->memory_before[i], read_addr, 1);
+    // Null-pointer dereferences fault below MEMORY_DUMP_SIZE: clamp rather than wrap
+    uintptr_t addr = (uintptr_t)info->fault_address;
+    if (addr < MEMORY_DUMP_SIZE) {
+        info->memory_start = 0;
+    } else if (addr > UINTPTR_MAX - MEMORY_DUMP_SIZE) {
+        info->memory_start = UINTPTR_MAX - sizeof(info->memory) + 1;
+    } else {
+        info->memory_start = addr - MEMORY_DUMP_SIZE;
     }
 
-    // Read after
-    for (int i = 0; i < MEMORY_DUMP_SIZE; i++) {
-        unsigned char* read_addr = addr + i;
-        __builtin_memcpy(&info->memory_after[i], read_addr, 1);
-    }
+    // The fault address itself is often unmapped: read through the kernel, a page at a time
+    size_t readable = safe_memory_read(info->memory, info->memory_start, sizeof(info->memory),
+                                       info->memory_unreadable, MEMORY_DUMP_MAX_UNREADABLE,
+                                       &info->memory_unreadable_count);
 
-    info->memory_readable = true;
+    info->memory_readable = readable > 0;
 }
 
-// Write crash info to file (async-signal-safe operations only!)
-static void write_crash_to_file(const EnhancedCrashInfo* info) {
-    int fd = open(g_crash_file_path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
-    if (fd < 0) {
-        return;
+// Bytes around the fault address and the ranges of them that could not be read
+static void write_memory_dump(FormatBuffer* fmt, const EnhancedCrashInfo* info) {
+    uintptr_t start = info->memory_start;
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_MEMORY);
+    crash_record_put_varint(fmt, start);
+    crash_record_put_varint(fmt, sizeof(info->memory));
+    fmt_append_bytes(fmt, (const char*)info->memory, sizeof(info->memory));
+    crash_record_put_varint(fmt, info->memory_unreadable_count);
+    for (size_t i = 0; i < info->memory_unreadable_count; i++) {
+        crash_record_put_varint(fmt, info->memory_unreadable[i].start - start);
+        crash_record_put_varint(fmt, info->memory_unreadable[i].length);
     }
+    crash_record_end_section(fmt, section);
+}
 
-    char buffer[1024];
-    int len;
-
-    // Write header
-    len = snprintf(buffer, sizeof(buffer),
-                   "NATIVE_CRASH\n"
-                   "Signal: %s (%d)\n"
-                   "Description: %s\n"
-                   "Code: %d\n"
-                   "Fault Address: %p\n"
-                   "Thread: %s\n"
-                   "PID: %d\n"
-                   "TID: %d\n"
-                   "Time: %ld\n"
-                   "Frame Count: %zu\n\n",
-                   info->signal_name,
-                   info->signal,
-                   get_signal_description(info->signal),
-                   info->code,
-                   info->fault_address,
-                   info->thread_name,
-                   info->pid,
-                   info->tid,
-                   info->crash_time,
-                   info->frame_count);
-    write(fd, buffer, len);
-
-    // Write registers
-    write(fd, "REGISTERS:\n", 11);
-
-    #ifdef __aarch64__
-    len = snprintf(buffer, sizeof(buffer),
-                  "  pc:   %016lx\n  sp:   %016lx\n  lr:   %016lx\n  cpsr: %016lx\n",
-                  info->registers.pc, info->registers.sp,
-                  info->registers.lr, info->registers.cpsr);
-    write(fd, buffer, len);
-
-    for (int i = 0; i < 31; i++) {
-        len = snprintf(buffer, sizeof(buffer), "  x%-2d:  %016lx\n", i, info->registers.x[i]);
-        write(fd, buffer, len);
-    }
-
-    #elif defined(__arm__)
-    len = snprintf(buffer, sizeof(buffer),
-                  "  pc:   %08lx\n  sp:   %08lx\n  lr:   %08lx\n  cpsr: %08lx\n",
-                  info->registers.pc, info->registers.sp,
-                  info->registers.lr, info->registers.cpsr);
-    write(fd, buffer, len);
-
-    for (int i = 0; i < 16; i++) {
-        len = snprintf(buffer, sizeof(buffer), "  r%-2d:  %08lx\n", i, info->registers.r[i]);
-        write(fd, buffer, len);
+// Write crash info to file (async-signal-safe operations only!)
+static void write_crash_to_file(const EnhancedCrashInfo* info, const ModuleMap* modules) {
+    CrashJournalSlot slot;
+    bool has_slot = crash_journal_is_open(&g_journal) && crash_journal_claim(&g_journal, &slot);
+
+    CrashRecordWriter writer;
+    if (has_slot && slot.mapped_body) {
+        // Format straight into the shared mapping
+        record_writer_init(&writer, slot.mapped_body, g_journal.body_capacity);
+    } else {
+        record_writer_init(&writer, g_record_buffer, CRASH_JOURNAL_BODY_SIZE);
     }
-    #endif
-
-    write(fd, "\n", 1);
-
-    // Write stack frames
-    write(fd, "STACK TRACE:\n", 13);
-    for (size_t i = 0; i < info->frame_count; i++) {
-        Dl_info dl_info;
-        if (dladdr((void*)info->stack_frames[i], &dl_info)) {
-            len = snprintf(buffer, sizeof(buffer),
-                          "#%03zu pc %p %s (%s+%p)\n",
-                          i,
-                          (void*)info->stack_frames[i],
-                          dl_info.dli_fname ? dl_info.dli_fname : "???",
-                          dl_info.dli_sname ? dl_info.dli_sname : "???",
-                          (void*)((char*)info->stack_frames[i] - (char*)dl_info.dli_saddr));
-        } else {
-            len = snprintf(buffer, sizeof(buffer),
-                          "#%03zu pc %p ???\n",
-                          i,
-                          (void*)info->stack_frames[i]);
+    FormatBuffer* fmt = &writer.fmt;
+
+    // Binary record (crash_record_format.h); decoded and symbolized on the next launch
+    CrashRecordHeader header;
+    crash_record_init_header(&header, info->signal, info->code, (uintptr_t)info->fault_address, info->pid,
+                             info->tid, info->crash_time, info->unwind_method);
+    crash_record_begin(fmt, &header);
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_THREAD_NAME);
+    fmt_append_strn(fmt, info->thread_name, sizeof(info->thread_name));
+    crash_record_end_section(fmt, section);
+
+    crash_record_write_secondary_crashes(fmt, &g_coordinator);
+
+    // Registers as the raw block
+    section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_REGISTERS);
+    fmt_append_bytes(fmt, (const char*)info->registers, info->register_count * sizeof(uintptr_t));
+    crash_record_end_section(fmt, section);
+
+    // Frames as module index + offset; names are resolved on the next launch
+    CrashRecordModules referenced;
+    crash_record_modules_init(&referenced, modules);
+    crash_record_write_frames(fmt, &referenced, info->stack_frames, info->frame_count);
+
+    // Fault address and registers that point into a module (globals, vtables, code)
+    int sp = crash_record_arch_info(CRASH_RECORD_ARCH_NATIVE)->sp;
+    section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_ADDRESSES);
+    crash_record_write_module_address(fmt, &referenced, -1, (uintptr_t)info->fault_address);
+    for (size_t i = 0; i < info->register_count; i++) {
+        if ((int)i != sp) {
+            crash_record_write_module_address(fmt, &referenced, (int)i, info->registers[i]);
         }
-        write(fd, buffer, len);
     }
+    crash_record_end_section(fmt, section);
+    crash_record_write_referenced_modules(fmt, &referenced);
 
-    // Write memory dump
     if (info->memory_readable) {
-        write(fd, "\nMEMORY DUMP:\n", 14);
-        len = snprintf(buffer, sizeof(buffer), "Before fault address (%p - 256):\n", info->fault_address);
-        write(fd, buffer, len);
-
-        // Write hex dump (simplified)
-        for (int i = 0; i < MEMORY_DUMP_SIZE; i += 16) {
-            len = snprintf(buffer, sizeof(buffer), "%04x: ", i);
-            write(fd, buffer, len);
-
-            for (int j = 0; j < 16 && (i + j) < MEMORY_DUMP_SIZE; j++) {
-                len = snprintf(buffer, sizeof(buffer), "%02x ", info->memory_before[i + j]);
-                write(fd, buffer, len);
-            }
-            write(fd, "\n", 1);
-        }
-
-        len = snprintf(buffer, sizeof(buffer), "\nAfter fault address (%p):\n", info->fault_address);
-        write(fd, buffer, len);
-
-        for (int i = 0; i < MEMORY_DUMP_SIZE; i += 16) {
-            len = snprintf(buffer, sizeof(buffer), "%04x: ", i);
-            write(fd, buffer, len);
-
-            for (int j = 0; j < 16 && (i + j) < MEMORY_DUMP_SIZE; j++) {
-                len = snprintf(buffer, sizeof(buffer), "%02x ", info->memory_after[i + j]);
-                write(fd, buffer, len);
-            }
-            write(fd, "\n", 1);
+        write_memory_dump(fmt, info);
+    }
+    crash_record_finish(fmt);
+
+    if (has_slot) {
+        // Body first, slot header with the commit marker last
+        crash_journal_commit(&g_journal, &slot, &writer);
+    } else {
+        // initialize() could not prepare the journal; last-resort legacy file
+        int fd = open(g_crash_file_path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return;
         }
+        record_writer_flush(&writer, fd);
+        close(fd);
     }
-
-    close(fd);
-
-    LOGI("Enhanced native crash info written to: %s", g_crash_file_path);
 }
 
 // Enhanced signal handler
 static void signal_handler(int sig, siginfo_t* info, void* context) {
-    static volatile sig_atomic_t handling_crash = 0;
-    if (handling_crash) {
-        _exit(1);
+    pid_t tid = gettid();
+
+    // Elect a single owner for the capture; other crashing threads must not kill it
+    switch (crash_coordinator_enter(&g_coordinator, tid)) {
+        case CRASH_ROLE_RECURSIVE:
+            // Crashed again inside our own handler
+            _exit(1);
+
+        case CRASH_ROLE_SECONDARY:
+            crash_coordinator_add_secondary(&g_coordinator, tid, info, crash_context_pc(context));
+            crash_coordinator_park(&g_coordinator);
+            // Record committed (or owner stuck): die with our own signal once the handler returns
+            signal(sig, SIG_DFL);
+            raise(sig);
+            return;
+
+        case CRASH_ROLE_OWNER:
+            break;
     }
-    handling_crash = 1;
+
+    // One module map for the whole capture, so frame, record and minidump indexes agree
+    const ModuleMap* modules = module_map_begin_crash();
 
     // Collect crash information
     memset(&g_crash_info, 0, sizeof(g_crash_info));
@@ -394,23 +254,25 @@ static void signal_handler(int sig, siginfo_t* info, void* context) {
     g_crash_info.code = info->si_code;
     g_crash_info.fault_address = info->si_addr;
     g_crash_info.pid = getpid();
-    g_crash_info.tid = gettid();
+    g_crash_info.tid = tid;
     g_crash_info.crash_time = time(nullptr);
 
-    strncpy(g_crash_info.signal_name, get_signal_name(sig), sizeof(g_crash_info.signal_name) - 1);
     get_thread_name(g_crash_info.thread_name, sizeof(g_crash_info.thread_name));
 
     // NEW: Capture registers
-    capture_registers(&g_crash_info, context);
+    g_crash_info.register_count = crash_record_capture_registers(context, g_crash_info.registers);
 
     // NEW: Capture memory dump
     capture_memory_dump(&g_crash_info);
 
-    // Capture stack trace
-    g_crash_info.frame_count = capture_stack_trace(g_crash_info.stack_frames, MAX_STACK_FRAMES);
+    // Capture stack trace, starting at the faulting instruction
+    g_crash_info.frame_count = capture_stack(context, g_unwinder, modules, g_crash_info.stack_frames,
+                                             MAX_STACK_FRAMES, &g_crash_info.unwind_method);
 
     // Write crash info to file
-    write_crash_to_file(&g_crash_info);
+    write_crash_to_file(&g_crash_info, modules);
+    minidump_write(&g_minidump, info, context, tid, g_crash_info.crash_time, modules);
+    crash_coordinator_finish(&g_coordinator);
 
     // Call original handler
     struct sigaction* old_handler = &g_old_handlers[sig];
@@ -427,7 +289,7 @@ static void signal_handler(int sig, siginfo_t* info, void* context) {
 
 // Initialize native crash handler
 extern "C" JNIEXPORT void JNICALL
-Java_com_crashreporter_library_NativeCrashHandler_initialize(JNIEnv* env, jobject /* this */, jstring crash_dir) {
+Java_com_crashreporter_library_NativeCrashHandler_initialize(JNIEnv* env, jobject /* this */, jstring crash_dir, jint capture_mode, jint unwinder, jboolean minidump) {
     if (g_initialized) {
         LOGD("Native crash handler already initialized");
         return;
@@ -435,9 +297,34 @@ Java_com_crashreporter_library_NativeCrashHandler_initialize(JNIEnv* env, jobjec
 
     const char* crash_dir_str = env->GetStringUTFChars(crash_dir, nullptr);
     snprintf(g_crash_file_path, sizeof(g_crash_file_path), "%s/native_crash.txt", crash_dir_str);
+    snprintf(g_journal_path, sizeof(g_journal_path), "%s/native_crash.journal", crash_dir_str);
+    g_minidump.fd = -1;
+    if (minidump && !minidump_writer_open(&g_minidump, crash_dir_str, g_minidump_buffer, sizeof(g_minidump_buffer))) {
+        LOGE("Failed to prepare minidump output in %s: %s", crash_dir_str, strerror(errno));
+    }
     env->ReleaseStringUTFChars(crash_dir, crash_dir_str);
 
-    LOGI("Initializing enhanced native crash handler, crash file: %s", g_crash_file_path);
+    // Open and pre-allocate the journal now; the handler never opens files
+    bool mapped = capture_mode == CAPTURE_MODE_MMAP;
+    if (!crash_journal_open(&g_journal, g_journal_path, CRASH_JOURNAL_SLOT_COUNT, CRASH_JOURNAL_BODY_SIZE, mapped)) {
+        LOGE("Failed to prepare crash journal %s: %s", g_journal_path, strerror(errno));
+        if (mapped && crash_journal_open(&g_journal, g_journal_path, CRASH_JOURNAL_SLOT_COUNT, CRASH_JOURNAL_BODY_SIZE, false)) {
+            LOGI("Falling back to file capture mode");
+        }
+    }
+
+    g_unwinder = unwinder;
+    stack_unwinder_init();
+    module_map_start_watcher();
+    safe_memory_init();
+
+    if (!g_journal.mapping) {
+        // Commit the record arena now so the handler never page-faults on it
+        record_writer_reserve(g_record_buffer, CRASH_JOURNAL_BODY_SIZE);
+    }
+
+    LOGI("Initializing enhanced native crash handler, crash journal: %s (mode %d, unwinder %d)",
+         g_journal_path, (int)capture_mode, (int)unwinder);
 
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
@@ -471,6 +358,46 @@ Java_com_crashreporter_library_NativeCrashHandler_triggerNativeCrash(JNIEnv* env
     }
 }
 
+// Re-snapshot the loaded modules if libraries were loaded or unloaded since the last build
+extern "C" JNIEXPORT void JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeRefreshLoadedModules(JNIEnv* /* env */, jobject /* this */) {
+    if (g_initialized) {
+        module_map_refresh_if_changed();
+    }
+}
+
+// Resolve a previous session's frame offsets against a module file (crash_record_jni.h)
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeSymbolize(JNIEnv* env, jobject /* this */, jstring module_path, jstring build_id, jstring cache_dir, jlongArray offsets) {
+    return crash_record_jni_symbolize(env, LOG_TAG, module_path, build_id, cache_dir, offsets);
+}
+
+// Decode a binary crash record into the text layout the symbolizer reads; null if it is not one
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeDecodeRecord(JNIEnv* env, jobject /* this */, jobject record) {
+    return crash_record_jni_to_text(env, record);
+}
+
+// Decode a binary crash record straight into a NativeCrashReport
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeParseRecord(JNIEnv* env, jobject /* this */, jobject record, jobject report) {
+    return crash_record_jni_parse(env, record, report);
+}
+
+// A binary crash record as its JSON upload document, with the frame symbols resolved
+// by the app (one per frame, or null); null if the buffer does not hold a binary record
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeRecordToJson(JNIEnv* env, jobject /* this */, jobject record, jobjectArray symbols) {
+    return crash_record_jni_to_json(env, record, symbols);
+}
+
+// CRC-32 of a direct buffer's contents, as the journal stores it; -1 for a heap buffer
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeChecksum(JNIEnv* env, jobject /* this */, jobject buffer) {
+    return crash_record_jni_checksum(env, buffer);
+}
+
+// Get initialization status
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_crashreporter_library_NativeCrashHandler_isInitialized(JNIEnv* env, jobject /* this */) {
     return g_initialized ? JNI_TRUE : JNI_FALSE;
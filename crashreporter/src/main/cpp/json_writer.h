@@ -0,0 +1,317 @@
+/**
+ * Streaming JSON writer
+ *
+ * Writes JSON into a FormatBuffer (signal_safe_format.h) without allocating,
+ * locking or recursing, so it is safe to use from a signal handler. Objects
+ * and arrays nest up to JSON_WRITER_MAX_DEPTH levels; commas are tracked per
+ * level, and the key of an object member is passed with json_key() just
+ * before its value.
+ *
+ * The output is always complete JSON. The writer keeps back one byte for
+ * the closing bracket of every open container, and a value (with its key)
+ * that does not fit in the rest of the buffer is left out whole: the writer
+ * is flagged as truncated, a container that did not fit swallows everything
+ * written into it, and json_finish() closes whatever is still open.
+ *
+ * Strings are escaped per RFC 8259; bytes that are not valid UTF-8 come out
+ * as U+FFFD. Addresses are written as "0x..." strings, since JSON numbers
+ * lose precision past 2^53 in most parsers; byte runs go out as base64
+ * strings (byte_encoding.h).
+ */
+
+#ifndef CRASHREPORTER_JSON_WRITER_H
+#define CRASHREPORTER_JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "byte_encoding.h"
+#include "signal_safe_format.h"
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+struct JsonWriter {
+    FormatBuffer* out;
+    const char* key;            // Key of the next value, inside an object
+    uint32_t depth;
+    uint32_t skip_depth;        // Depth of the container that did not fit; 0 when writing
+    uint32_t has_items;         // Bit per level: the next value there needs a comma
+    uint32_t is_object;         // Bit per level: closes with '}' rather than ']'
+    size_t reserved;            // Bytes kept back for closing the open containers
+    bool truncated;             // A value was left out for lack of room
+};
+
+static inline void json_writer_init(JsonWriter* writer, FormatBuffer* out) {
+    writer->out = out;
+    writer->key = nullptr;
+    writer->depth = 0;
+    writer->skip_depth = 0;
+    writer->has_items = 0;
+    writer->is_object = 0;
+    writer->reserved = 0;
+    writer->truncated = false;
+}
+
+// Length of the well-formed UTF-8 sequence at s (RFC 3629: no overlongs,
+// surrogates or code points past U+10FFFF); 0 if it is not one
+static inline size_t json_utf8_sequence_length(const unsigned char* s, size_t remaining) {
+    unsigned char lead = s[0];
+    size_t length;
+    unsigned char min = 0x80;
+    unsigned char max = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        if (lead == 0xe0) min = 0xa0;
+        if (lead == 0xed) max = 0x9f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        if (lead == 0xf0) min = 0x90;
+        if (lead == 0xf4) max = 0x8f;
+    } else {
+        return 0;
+    }
+    if (length > remaining || s[1] < min || s[1] > max) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (s[i] < 0x80 || s[i] > 0xbf) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// Escape length bytes of a string (without quotes) into out, or only count
+// them when out is null. Returns the escaped length.
+static inline size_t json_escape(FormatBuffer* out, const char* str, size_t length) {
+    static const char kHex[] = "0123456789abcdef";
+    const unsigned char* s = (const unsigned char*)str;
+    size_t written = 0;
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = s[i];
+        char escaped[6] = { '\\', 0, 0, 0, 0, 0 };
+        size_t escaped_length = 2;
+        switch (c) {
+            case '"':  escaped[1] = '"'; break;
+            case '\\': escaped[1] = '\\'; break;
+            case '\b': escaped[1] = 'b'; break;
+            case '\f': escaped[1] = 'f'; break;
+            case '\n': escaped[1] = 'n'; break;
+            case '\r': escaped[1] = 'r'; break;
+            case '\t': escaped[1] = 't'; break;
+            default:
+                if (c < 0x20) {
+                    escaped[1] = 'u';
+                    escaped[2] = '0';
+                    escaped[3] = '0';
+                    escaped[4] = kHex[c >> 4];
+                    escaped[5] = kHex[c & 0xf];
+                    escaped_length = 6;
+                } else {
+                    // Printable ASCII and well-formed UTF-8 go through as is
+                    size_t run = c < 0x80 ? 1 : json_utf8_sequence_length(s + i, length - i);
+                    if (run) {
+                        if (out) fmt_append_bytes(out, str + i, run);
+                        written += run;
+                        i += run;
+                        continue;
+                    }
+                    if (out) fmt_append_bytes(out, "\\ufffd", 6);
+                    written += 6;
+                    i++;
+                    continue;
+                }
+                break;
+        }
+        if (out) fmt_append_bytes(out, escaped, escaped_length);
+        written += escaped_length;
+        i++;
+    }
+    return written;
+}
+
+static inline size_t json_strlen(const char* str) {
+    size_t length = 0;
+    while (str[length] != '\0') {
+        length++;
+    }
+    return length;
+}
+
+// Separator and key of the next value, if value_length more bytes (plus
+// extra_reserved kept back for it) fit; otherwise the value is left out.
+static inline bool json_begin_value(JsonWriter* writer, size_t value_length, size_t extra_reserved) {
+    const char* key = writer->key;
+    writer->key = nullptr;
+    if (writer->skip_depth) {
+        return false;
+    }
+    uint32_t bit = writer->depth ? 1u << (writer->depth - 1) : 0;
+    bool comma = (writer->has_items & bit) != 0;
+    if (!(writer->is_object & bit)) {
+        key = nullptr;          // Array elements and the top-level value have no key
+    }
+    size_t key_length = key ? json_escape(nullptr, key, json_strlen(key)) : 0;
+    size_t needed = comma + (key ? key_length + 3 : 0) + value_length + extra_reserved;
+    FormatBuffer* out = writer->out;
+    if (out->length + writer->reserved > out->capacity || needed > out->capacity - out->length - writer->reserved) {
+        writer->truncated = true;
+        return false;
+    }
+    if (comma) {
+        fmt_append_char(out, ',');
+    }
+    if (key) {
+        fmt_append_char(out, '"');
+        json_escape(out, key, json_strlen(key));
+        fmt_append_bytes(out, "\":", 2);
+    }
+    writer->has_items |= bit;
+    return true;
+}
+
+// Key of the next value (objects only); must stay valid until that value is written
+static inline void json_key(JsonWriter* writer, const char* key) {
+    writer->key = key;
+}
+
+static inline void json_begin(JsonWriter* writer, bool object) {
+    bool fits = writer->depth < JSON_WRITER_MAX_DEPTH && json_begin_value(writer, 1, 1);
+    writer->key = nullptr;
+    writer->depth++;
+    if (!fits) {
+        if (!writer->skip_depth) {
+            writer->skip_depth = writer->depth;
+            writer->truncated = true;
+        }
+        return;
+    }
+    uint32_t bit = 1u << (writer->depth - 1);
+    fmt_append_char(writer->out, object ? '{' : '[');
+    writer->reserved++;
+    writer->has_items &= ~bit;
+    writer->is_object = object ? writer->is_object | bit : writer->is_object & ~bit;
+}
+
+static inline void json_end(JsonWriter* writer) {
+    writer->key = nullptr;
+    if (writer->depth == 0) {
+        return;
+    }
+    if (writer->skip_depth) {
+        if (writer->depth == writer->skip_depth) {
+            writer->skip_depth = 0;
+        }
+        writer->depth--;
+        return;
+    }
+    uint32_t bit = 1u << (writer->depth - 1);
+    fmt_append_char(writer->out, (writer->is_object & bit) ? '}' : ']');
+    writer->reserved--;
+    writer->depth--;
+}
+
+static inline void json_begin_object(JsonWriter* writer) {
+    json_begin(writer, true);
+}
+
+static inline void json_end_object(JsonWriter* writer) {
+    json_end(writer);
+}
+
+static inline void json_begin_array(JsonWriter* writer) {
+    json_begin(writer, false);
+}
+
+static inline void json_end_array(JsonWriter* writer) {
+    json_end(writer);
+}
+
+static inline void json_string_n(JsonWriter* writer, const char* str, size_t length) {
+    if (json_begin_value(writer, json_escape(nullptr, str, length) + 2, 0)) {
+        fmt_append_char(writer->out, '"');
+        json_escape(writer->out, str, length);
+        fmt_append_char(writer->out, '"');
+    }
+}
+
+// nullptr writes null
+static inline void json_string(JsonWriter* writer, const char* str) {
+    if (!str) {
+        if (json_begin_value(writer, 4, 0)) {
+            fmt_append_bytes(writer->out, "null", 4);
+        }
+        return;
+    }
+    json_string_n(writer, str, json_strlen(str));
+}
+
+static inline void json_bool(JsonWriter* writer, bool value) {
+    if (json_begin_value(writer, value ? 4 : 5, 0)) {
+        fmt_append_str(writer->out, value ? "true" : "false");
+    }
+}
+
+static inline size_t json_udec_length(uint64_t value) {
+    size_t length = 1;
+    while (value >= 10) {
+        value /= 10;
+        length++;
+    }
+    return length;
+}
+
+static inline void json_uint(JsonWriter* writer, uint64_t value) {
+    if (json_begin_value(writer, json_udec_length(value), 0)) {
+        fmt_append_udec(writer->out, value);
+    }
+}
+
+static inline void json_int(JsonWriter* writer, int64_t value) {
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    if (json_begin_value(writer, json_udec_length(magnitude) + (value < 0), 0)) {
+        fmt_append_dec(writer->out, value);
+    }
+}
+
+// "0x1a2b"
+static inline void json_hex(JsonWriter* writer, uint64_t value) {
+    size_t digits = 1;
+    for (uint64_t rest = value >> 4; rest; rest >>= 4) {
+        digits++;
+    }
+    if (json_begin_value(writer, digits + 4, 0)) {
+        fmt_append_bytes(writer->out, "\"0x", 3);
+        fmt_append_hex(writer->out, value);
+        fmt_append_char(writer->out, '"');
+    }
+}
+
+// Bytes as one base64 string, for bulk data such as memory dumps
+static inline void json_base64_bytes(JsonWriter* writer, const void* data, size_t length) {
+    if (length > (SIZE_MAX - 4) / 4 * 3) {
+        writer->key = nullptr;
+        writer->truncated = true;
+        return;
+    }
+    if (!json_begin_value(writer, base64_encoded_length(length) + 2, 0)) {
+        return;
+    }
+    FormatBuffer* out = writer->out;
+    out->data[out->length++] = '"';
+    out->length += base64_encode(out->data + out->length, data, length);
+    out->data[out->length++] = '"';
+}
+
+// Close every open container; true if nothing was left out
+static inline bool json_finish(JsonWriter* writer) {
+    while (writer->depth) {
+        json_end(writer);
+    }
+    return !writer->truncated && !writer->out->truncated;
+}
+
+#endif // CRASHREPORTER_JSON_WRITER_H
@@ -0,0 +1,780 @@
+/**
+ * Breakpad-compatible minidump writer
+ *
+ * Optional second output of the crash handler, next to the text record: a
+ * minidump in the format Breakpad and Crashpad write, so existing tooling
+ * (minidump_stackwalk, rust-minidump, crash backends) can read it as is.
+ * It holds:
+ *
+ *   - system info: CPU architecture and count, OS version (uname)
+ *   - the exception (signal, si_code, fault address) with the crashing
+ *     thread's full register context
+ *   - the thread list: the crashing thread with its context and stack. The
+ *     other threads are left out: their registers would need ptrace from
+ *     another process, and minidump_stackwalk reports a thread without a
+ *     context as an error.
+ *   - the module list from the module map (module_map.h), with ELF build-ids
+ *     as CodeView records in Breakpad's "BpEL" form
+ *   - memory: the crashing thread's stack from sp, and 256 bytes around the
+ *     pc, the fault address and every register that points to readable
+ *     memory, read through safe_memory.h
+ *
+ * Everything is prepared at initialize(): the output file is opened, the
+ * arena the dump is assembled in is committed, /proc/self/task is opened
+ * and the system description is read. At crash time the dump is built in
+ * the arena, written with a single pwrite() and renamed to its final name,
+ * so a dump is never seen half written. The crash path makes a bounded
+ * number of syscalls: a process_vm_readv() per memory region (per page for
+ * a partly unreadable one), the write and the rename. A stream that does
+ * not fit in the arena is left out of the directory rather than listed
+ * empty.
+ */
+
+#ifndef CRASHREPORTER_MINIDUMP_WRITER_H
+#define CRASHREPORTER_MINIDUMP_WRITER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "crash_context.h"
+#include "crash_record_writer.h"
+#include "module_map.h"
+#include "safe_memory.h"
+#include "signal_safe_format.h"
+
+// Arena a dump is assembled in (worst case with MODULE_MAP_MAX_MODULES long paths is ~300 KiB)
+#define MINIDUMP_BUFFER_SIZE (384 * 1024)
+
+// Crashing thread's stack captured above sp, and below it (x86-64 red zone)
+#define MINIDUMP_STACK_SIZE (32 * 1024)
+#define MINIDUMP_STACK_RED_ZONE 128
+
+// Memory captured around the pc, the fault address and pointer-valued registers
+#define MINIDUMP_REGISTER_MEMORY_SIZE 256
+
+#define MINIDUMP_MAX_MEMORY_RANGES 48
+#define MINIDUMP_MAX_MEMORY_REGIONS 64
+
+// Completed dumps: <crash dir>/MINIDUMP_DIR/<time>-<tid>.dmp (keep in sync with NativeCrashHandler.kt)
+#define MINIDUMP_DIR "minidumps"
+#define MINIDUMP_PENDING_FILE "dump.pending"
+
+#define MINIDUMP_SIGNATURE 0x504d444d     // "MDMP"
+#define MINIDUMP_VERSION 0xa793
+
+#define MINIDUMP_STREAM_THREAD_LIST 3
+#define MINIDUMP_STREAM_MODULE_LIST 4
+#define MINIDUMP_STREAM_MEMORY_LIST 5
+#define MINIDUMP_STREAM_EXCEPTION 6
+#define MINIDUMP_STREAM_SYSTEM_INFO 7
+#define MINIDUMP_STREAM_MISC_INFO 15
+#define MINIDUMP_MAX_STREAMS 6
+
+#define MINIDUMP_CPU_X86 0
+#define MINIDUMP_CPU_ARM 5
+#define MINIDUMP_CPU_AMD64 9
+#define MINIDUMP_CPU_ARM64 12
+#define MINIDUMP_CPU_UNKNOWN 0xffff
+#define MINIDUMP_OS_ANDROID 0x8203
+
+#define MINIDUMP_CV_SIGNATURE_ELF 0x4270454c   // "BpEL"
+#define MINIDUMP_MISC_PROCESS_ID 0x1
+
+// Context flags: architecture bit | control | integer | floating point
+#define MINIDUMP_CONTEXT_X86 0x00010007         // + segment registers
+#define MINIDUMP_CONTEXT_ARM 0x40000002
+#define MINIDUMP_CONTEXT_AMD64 0x00100003
+#define MINIDUMP_CONTEXT_ARM64 0x00400003
+#define MINIDUMP_CONTEXT_AMD64_FLOATING_POINT 0x8
+#define MINIDUMP_CONTEXT_ARM64_FLOATING_POINT 0x4
+
+// On-disk records (little-endian, packed as in Breakpad's minidump_format.h)
+#pragma pack(push, 1)
+
+struct MinidumpLocation {
+    uint32_t data_size;
+    uint32_t rva;
+};
+
+struct MinidumpHeader {
+    uint32_t signature;
+    uint32_t version;
+    uint32_t stream_count;
+    uint32_t stream_directory_rva;
+    uint32_t checksum;
+    uint32_t time_date_stamp;
+    uint64_t flags;
+};
+
+struct MinidumpDirectory {
+    uint32_t stream_type;
+    MinidumpLocation location;
+};
+
+struct MinidumpMemoryDescriptor {
+    uint64_t start_of_memory_range;
+    MinidumpLocation memory;
+};
+
+struct MinidumpThread {
+    uint32_t thread_id;
+    uint32_t suspend_count;
+    uint32_t priority_class;
+    uint32_t priority;
+    uint64_t teb;
+    MinidumpMemoryDescriptor stack;
+    MinidumpLocation thread_context;
+};
+
+struct MinidumpModule {
+    uint64_t base_of_image;
+    uint32_t size_of_image;
+    uint32_t checksum;
+    uint32_t time_date_stamp;
+    uint32_t module_name_rva;
+    uint32_t version_info[13];      // VS_FIXEDFILEINFO, unused on Linux
+    MinidumpLocation cv_record;
+    MinidumpLocation misc_record;
+    uint64_t reserved0;
+    uint64_t reserved1;
+};
+
+struct MinidumpException {
+    uint32_t thread_id;
+    uint32_t alignment;
+    uint32_t exception_code;        // Signal number
+    uint32_t exception_flags;       // si_code
+    uint64_t exception_record;
+    uint64_t exception_address;     // si_addr
+    uint32_t number_parameters;
+    uint32_t alignment2;
+    uint64_t exception_information[15];
+    MinidumpLocation thread_context;
+};
+
+struct MinidumpSystemInfo {
+    uint16_t processor_architecture;
+    uint16_t processor_level;
+    uint16_t processor_revision;
+    uint8_t number_of_processors;
+    uint8_t product_type;
+    uint32_t major_version;
+    uint32_t minor_version;
+    uint32_t build_number;
+    uint32_t platform_id;
+    uint32_t csd_version_rva;       // MDString: full uname description
+    uint16_t suite_mask;
+    uint16_t reserved2;
+    uint8_t cpu[24];
+};
+
+struct MinidumpMiscInfo {
+    uint32_t size_of_info;
+    uint32_t flags1;
+    uint32_t process_id;
+    uint32_t process_create_time;
+    uint32_t process_user_time;
+    uint32_t process_kernel_time;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(MinidumpHeader) == 32, "minidump header layout");
+static_assert(sizeof(MinidumpThread) == 48, "minidump thread layout");
+static_assert(sizeof(MinidumpModule) == 108, "minidump module layout");
+static_assert(sizeof(MinidumpException) == 168, "minidump exception layout");
+static_assert(sizeof(MinidumpSystemInfo) == 56, "minidump system info layout");
+
+// CPU contexts: the layouts of Windows' CONTEXT structures, which Breakpad reuses
+struct MinidumpUint128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+#if defined(__aarch64__)
+struct MinidumpContext {
+    uint32_t context_flags;
+    uint32_t cpsr;
+    uint64_t iregs[33];             // x0-x28, fp, lr, sp, pc
+    MinidumpUint128 float_regs[32];
+    uint32_t fpcr;
+    uint32_t fpsr;
+    uint32_t bcr[8];
+    uint64_t bvr[8];
+    uint32_t wcr[2];
+    uint64_t wvr[2];
+};
+static_assert(sizeof(MinidumpContext) == 912, "arm64 context layout");
+#define MINIDUMP_CPU MINIDUMP_CPU_ARM64
+#elif defined(__arm__)
+struct MinidumpContext {
+    uint32_t context_flags;
+    uint32_t iregs[16];             // r0-r12, sp, lr, pc
+    uint32_t cpsr;
+    uint64_t fpscr;
+    uint64_t float_regs[32];
+    uint32_t float_extra[8];
+};
+static_assert(sizeof(MinidumpContext) == 368, "arm context layout");
+#define MINIDUMP_CPU MINIDUMP_CPU_ARM
+#elif defined(__x86_64__)
+struct MinidumpContext {
+    uint64_t p_home[6];
+    uint32_t context_flags;
+    uint32_t mx_csr;
+    uint16_t cs, ds, es, fs, gs, ss;
+    uint32_t eflags;
+    uint64_t dr0, dr1, dr2, dr3, dr6, dr7;
+    uint64_t rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi;
+    uint64_t r8, r9, r10, r11, r12, r13, r14, r15;
+    uint64_t rip;
+    uint8_t float_save[512];        // FXSAVE area
+    MinidumpUint128 vector_register[26];
+    uint64_t vector_control;
+    uint64_t debug_control;
+    uint64_t last_branch_to_rip;
+    uint64_t last_branch_from_rip;
+    uint64_t last_exception_to_rip;
+    uint64_t last_exception_from_rip;
+};
+static_assert(sizeof(MinidumpContext) == 1232, "amd64 context layout");
+#define MINIDUMP_CPU MINIDUMP_CPU_AMD64
+#elif defined(__i386__)
+struct MinidumpContext {
+    uint32_t context_flags;
+    uint32_t dr0, dr1, dr2, dr3, dr6, dr7;
+    uint8_t float_save[112];        // FSAVE area + cr0_npx_state
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebx, edx, ecx, eax;
+    uint32_t ebp, eip, cs, eflags, esp, ss;
+    uint8_t extended_registers[512];
+};
+static_assert(sizeof(MinidumpContext) == 716, "x86 context layout");
+#define MINIDUMP_CPU MINIDUMP_CPU_X86
+#else
+// No context layout for this architecture; the dump has everything else
+struct MinidumpContext {
+    uint32_t context_flags;
+};
+#define MINIDUMP_CPU MINIDUMP_CPU_UNKNOWN
+#endif
+
+// Address range to capture, before merging
+struct MinidumpRange {
+    uintptr_t start;
+    uintptr_t end;
+};
+
+struct MinidumpWriter {
+    int fd;                                 // Pending dump, opened at initialize(); -1 if disabled
+    char pending_path[256];
+    char dir[256];                          // Completed dumps are renamed into it
+    char* buffer;                           // Committed arena
+    size_t capacity;
+    size_t used;
+
+    // Gathered at initialize()
+    uint32_t os_major;
+    uint32_t os_minor;
+    uint32_t os_build;
+    uint8_t cpu_count;
+    char os_description[256];               // "Linux <release> <version> <machine>"
+
+    // Crash-time scratch
+    MinidumpRange ranges[MINIDUMP_MAX_MEMORY_RANGES];
+    MinidumpMemoryDescriptor regions[MINIDUMP_MAX_MEMORY_REGIONS];
+};
+
+static inline bool minidump_writer_is_open(const MinidumpWriter* writer) {
+    return writer->fd >= 0;
+}
+
+// "4.19.113-g1234" -> 4, 19, 113
+static inline void minidump_parse_release(const char* release, uint32_t* parts, int count) {
+    for (int i = 0; i < count; i++) {
+        parts[i] = 0;
+        while (*release >= '0' && *release <= '9') {
+            parts[i] = parts[i] * 10 + (uint32_t)(*release++ - '0');
+        }
+        if (*release != '.') {
+            break;
+        }
+        release++;
+    }
+}
+
+// Prepare everything the crash path needs (call from initialize(), not the handler).
+// buffer must stay valid for the life of the process; it is committed here.
+static inline bool minidump_writer_open(MinidumpWriter* writer, const char* crash_dir, char* buffer, size_t capacity) {
+    snprintf(writer->dir, sizeof(writer->dir), "%s/%s", crash_dir, MINIDUMP_DIR);
+    snprintf(writer->pending_path, sizeof(writer->pending_path), "%s/%s", writer->dir, MINIDUMP_PENDING_FILE);
+    if (mkdir(writer->dir, 0700) != 0 && errno != EEXIST) {
+        return false;
+    }
+    writer->fd = open(writer->pending_path, O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0600);
+    if (writer->fd < 0) {
+        return false;
+    }
+
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    record_writer_reserve(buffer, capacity);
+
+    struct utsname name;
+    writer->os_description[0] = '\0';
+    if (uname(&name) == 0) {
+        uint32_t version[3];
+        minidump_parse_release(name.release, version, 3);
+        writer->os_major = version[0];
+        writer->os_minor = version[1];
+        writer->os_build = version[2];
+        snprintf(writer->os_description, sizeof(writer->os_description), "Linux %s %s %s", name.release,
+                 name.version, name.machine);
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    writer->cpu_count = (uint8_t)(cpus > 255 ? 255 : cpus > 0 ? cpus : 1);
+    safe_memory_init();
+    return true;
+}
+
+// ---- Crash path (async-signal-safe) ----
+
+// Reserve size bytes (8-aligned) in the arena; 0 if it is full (rva 0 is the header)
+static inline uint32_t minidump_alloc(MinidumpWriter* writer, size_t size) {
+    size_t start = (writer->used + 7) & ~(size_t)7;
+    if (start > writer->capacity || size > writer->capacity - start) {
+        return 0;
+    }
+    memset(writer->buffer + start, 0, size);
+    writer->used = start + size;
+    return (uint32_t)start;
+}
+
+static inline void* minidump_at(MinidumpWriter* writer, uint32_t rva) {
+    return writer->buffer + rva;
+}
+
+// MDString: byte length, then UTF-16LE text and a NUL. Invalid UTF-8 becomes U+FFFD.
+static inline uint32_t minidump_write_string(MinidumpWriter* writer, const char* str) {
+    size_t units = 0;
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        units += (*p & 0xc0) != 0x80 ? ((*p >= 0xf0) ? 2 : 1) : 0;
+    }
+    uint32_t rva = minidump_alloc(writer, 4 + (units + 1) * 2);
+    if (!rva) {
+        return 0;
+    }
+    uint8_t* out = (uint8_t*)minidump_at(writer, rva) + 4;
+    size_t written = 0;
+    for (const unsigned char* p = (const unsigned char*)str; *p && written < units;) {
+        uint32_t cp = *p++;
+        int extra = cp >= 0xf0 ? 3 : cp >= 0xe0 ? 2 : cp >= 0xc0 ? 1 : 0;
+        if (cp >= 0x80 && cp < 0xc0) {
+            cp = 0xfffd;
+        }
+        cp &= extra ? 0x7f >> (extra + 1) : 0x7f;
+        for (int i = 0; i < extra; i++) {
+            if ((*p & 0xc0) != 0x80) {
+                cp = 0xfffd;
+                break;
+            }
+            cp = (cp << 6) | (*p++ & 0x3f);
+        }
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            uint16_t pair[2] = { (uint16_t)(0xd800 | (cp >> 10)), (uint16_t)(0xdc00 | (cp & 0x3ff)) };
+            if (written + 2 > units) {
+                break;
+            }
+            memcpy(out + written * 2, pair, 4);
+            written += 2;
+        } else {
+            uint16_t unit = (uint16_t)cp;
+            memcpy(out + written * 2, &unit, 2);
+            written++;
+        }
+    }
+    uint32_t length = (uint32_t)(written * 2);
+    memcpy(minidump_at(writer, rva), &length, 4);
+    return rva;
+}
+
+// Fill the context from the signal's ucontext; pointer-like register values go to values
+static inline size_t minidump_fill_context(MinidumpContext* ctx, const void* context, uintptr_t* values) {
+    const ucontext_t* uc = (const ucontext_t*)context;
+    size_t count = 0;
+#if defined(__aarch64__)
+    ctx->context_flags = MINIDUMP_CONTEXT_ARM64;
+    for (int i = 0; i < 31; i++) {
+        ctx->iregs[i] = values[count++] = uc->uc_mcontext.regs[i];
+    }
+    ctx->iregs[31] = uc->uc_mcontext.sp;
+    ctx->iregs[32] = values[count++] = uc->uc_mcontext.pc;
+    ctx->cpsr = (uint32_t)uc->uc_mcontext.pstate;
+    // Floating point state is one of the records in __reserved
+    const uint8_t* record = (const uint8_t*)uc->uc_mcontext.__reserved;
+    const uint8_t* end = record + sizeof(uc->uc_mcontext.__reserved);
+    while (record + sizeof(struct _aarch64_ctx) <= end) {
+        const struct _aarch64_ctx* head = (const struct _aarch64_ctx*)record;
+        if (head->magic == 0 || head->size < sizeof(*head) || head->size > (size_t)(end - record)) {
+            break;
+        }
+        if (head->magic == FPSIMD_MAGIC && head->size >= sizeof(struct fpsimd_context)) {
+            const struct fpsimd_context* fpsimd = (const struct fpsimd_context*)record;
+            ctx->context_flags |= MINIDUMP_CONTEXT_ARM64_FLOATING_POINT;
+            ctx->fpsr = fpsimd->fpsr;
+            ctx->fpcr = fpsimd->fpcr;
+            memcpy(ctx->float_regs, fpsimd->vregs, sizeof(ctx->float_regs));
+            break;
+        }
+        record += head->size;
+    }
+#elif defined(__arm__)
+    const unsigned long* gregs = &uc->uc_mcontext.arm_r0;     // r0-r10, fp, ip, sp, lr, pc are contiguous
+    ctx->context_flags = MINIDUMP_CONTEXT_ARM;
+    for (int i = 0; i < 16; i++) {
+        ctx->iregs[i] = (uint32_t)gregs[i];
+        if (i != 13) {
+            values[count++] = gregs[i];
+        }
+    }
+    ctx->cpsr = (uint32_t)uc->uc_mcontext.arm_cpsr;
+#elif defined(__x86_64__)
+    const greg_t* gregs = uc->uc_mcontext.gregs;
+    ctx->context_flags = MINIDUMP_CONTEXT_AMD64;
+    ctx->rax = gregs[REG_RAX];
+    ctx->rcx = gregs[REG_RCX];
+    ctx->rdx = gregs[REG_RDX];
+    ctx->rbx = gregs[REG_RBX];
+    ctx->rsp = gregs[REG_RSP];
+    ctx->rbp = gregs[REG_RBP];
+    ctx->rsi = gregs[REG_RSI];
+    ctx->rdi = gregs[REG_RDI];
+    ctx->r8 = gregs[REG_R8];
+    ctx->r9 = gregs[REG_R9];
+    ctx->r10 = gregs[REG_R10];
+    ctx->r11 = gregs[REG_R11];
+    ctx->r12 = gregs[REG_R12];
+    ctx->r13 = gregs[REG_R13];
+    ctx->r14 = gregs[REG_R14];
+    ctx->r15 = gregs[REG_R15];
+    ctx->rip = gregs[REG_RIP];
+    ctx->eflags = (uint32_t)gregs[REG_EFL];
+    ctx->cs = (uint16_t)(gregs[REG_CSGSFS] & 0xffff);
+    ctx->gs = (uint16_t)((gregs[REG_CSGSFS] >> 16) & 0xffff);
+    ctx->fs = (uint16_t)((gregs[REG_CSGSFS] >> 32) & 0xffff);
+    if (uc->uc_mcontext.fpregs) {
+        ctx->context_flags |= MINIDUMP_CONTEXT_AMD64_FLOATING_POINT;
+        memcpy(ctx->float_save, uc->uc_mcontext.fpregs, sizeof(ctx->float_save));
+        memcpy(&ctx->mx_csr, ctx->float_save + 24, sizeof(ctx->mx_csr));
+    }
+    const uint64_t* integer = &ctx->rax;
+    for (int i = 0; i < 17; i++) {
+        if (&integer[i] != &ctx->rsp) {
+            values[count++] = integer[i];
+        }
+    }
+#elif defined(__i386__)
+    const greg_t* gregs = uc->uc_mcontext.gregs;
+    ctx->context_flags = MINIDUMP_CONTEXT_X86;
+    ctx->gs = gregs[REG_GS];
+    ctx->fs = gregs[REG_FS];
+    ctx->es = gregs[REG_ES];
+    ctx->ds = gregs[REG_DS];
+    ctx->edi = values[count++] = gregs[REG_EDI];
+    ctx->esi = values[count++] = gregs[REG_ESI];
+    ctx->ebx = values[count++] = gregs[REG_EBX];
+    ctx->edx = values[count++] = gregs[REG_EDX];
+    ctx->ecx = values[count++] = gregs[REG_ECX];
+    ctx->eax = values[count++] = gregs[REG_EAX];
+    ctx->ebp = values[count++] = gregs[REG_EBP];
+    ctx->eip = values[count++] = gregs[REG_EIP];
+    ctx->cs = gregs[REG_CS];
+    ctx->eflags = gregs[REG_EFL];
+    ctx->esp = gregs[REG_ESP];
+    ctx->ss = gregs[REG_SS];
+#else
+    (void)uc;
+    (void)ctx;
+    (void)values;
+#endif
+    return count;
+}
+
+static inline void minidump_add_range(MinidumpWriter* writer, size_t* count, uintptr_t start, uintptr_t end) {
+    if (*count < MINIDUMP_MAX_MEMORY_RANGES && start < end) {
+        writer->ranges[*count].start = start;
+        writer->ranges[*count].end = end;
+        (*count)++;
+    }
+}
+
+// Sort and merge the ranges in place; returns how many remain
+static inline size_t minidump_merge_ranges(MinidumpRange* ranges, size_t count) {
+    for (size_t i = 1; i < count; i++) {
+        MinidumpRange range = ranges[i];
+        size_t j = i;
+        for (; j > 0 && ranges[j - 1].start > range.start; j--) {
+            ranges[j] = ranges[j - 1];
+        }
+        ranges[j] = range;
+    }
+    size_t merged = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (merged > 0 && ranges[i].start <= ranges[merged - 1].end) {
+            if (ranges[i].end > ranges[merged - 1].end) {
+                ranges[merged - 1].end = ranges[i].end;
+            }
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    return merged;
+}
+
+// Append the readable parts of [start, end) as memory regions. One read covers
+// the whole range when it is readable; otherwise it is retried page by page.
+static inline void minidump_capture_range(MinidumpWriter* writer, size_t* region_count, uintptr_t start,
+                                          uintptr_t end) {
+    uintptr_t addr = start;
+    bool whole = true;
+    while (addr < end && *region_count < MINIDUMP_MAX_MEMORY_REGIONS) {
+        size_t chunk = whole ? end - addr : g_safe_memory_page_size - (addr & (g_safe_memory_page_size - 1));
+        if (chunk > end - addr) {
+            chunk = end - addr;
+        }
+        size_t used = writer->used;
+        uint32_t rva = minidump_alloc(writer, chunk);
+        if (!rva) {
+            return;
+        }
+        if (!safe_memory_read_chunk(minidump_at(writer, rva), addr, chunk)) {
+            writer->used = used;
+            if (whole) {
+                whole = false;
+                continue;
+            }
+            addr += chunk;
+            continue;
+        }
+        MinidumpMemoryDescriptor* last = *region_count ? &writer->regions[*region_count - 1] : nullptr;
+        if (last && last->start_of_memory_range + last->memory.data_size == addr &&
+            last->memory.rva + last->memory.data_size == rva) {
+            last->memory.data_size += (uint32_t)chunk;
+        } else {
+            MinidumpMemoryDescriptor* region = &writer->regions[(*region_count)++];
+            region->start_of_memory_range = addr;
+            region->memory.data_size = (uint32_t)chunk;
+            region->memory.rva = rva;
+        }
+        addr += chunk;
+    }
+}
+
+// Append a stream to the directory; one whose allocation failed (rva 0) is left out
+static inline void minidump_add_stream(MinidumpDirectory* directory, uint32_t* count, uint32_t type, uint32_t rva,
+                                       size_t size) {
+    if (!rva) {
+        return;
+    }
+    directory[*count].stream_type = type;
+    directory[*count].location.rva = rva;
+    directory[*count].location.data_size = (uint32_t)size;
+    (*count)++;
+}
+
+static inline void minidump_write_modules(MinidumpWriter* writer, const ModuleMap* modules,
+                                          MinidumpDirectory* directory, uint32_t* stream_count) {
+    uint32_t count = modules ? (uint32_t)modules->count : 0;
+    uint32_t list_rva = minidump_alloc(writer, 4 + count * sizeof(MinidumpModule));
+    if (!list_rva) {
+        return;
+    }
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const LoadedModule* loaded = &modules->modules[i];
+        MinidumpModule module;
+        memset(&module, 0, sizeof(module));
+        module.base_of_image = modules->starts[i];
+        module.size_of_image = (uint32_t)(modules->ends[i] - modules->starts[i]);
+        module.module_name_rva = minidump_write_string(writer, module_map_path(modules, loaded));
+        if (!module.module_name_rva) {
+            break;      // Arena full: keep the modules written so far
+        }
+        if (loaded->build_id.length > 0) {
+            uint32_t cv_size = 4 + loaded->build_id.length;
+            uint32_t cv_rva = minidump_alloc(writer, cv_size);
+            if (cv_rva) {
+                uint32_t signature = MINIDUMP_CV_SIGNATURE_ELF;
+                memcpy(minidump_at(writer, cv_rva), &signature, 4);
+                memcpy((char*)minidump_at(writer, cv_rva) + 4, loaded->build_id.bytes, loaded->build_id.length);
+                module.cv_record.rva = cv_rva;
+                module.cv_record.data_size = cv_size;
+            }
+        }
+        memcpy((char*)minidump_at(writer, list_rva) + 4 + written * sizeof(MinidumpModule), &module, sizeof(module));
+        written++;
+    }
+    memcpy(minidump_at(writer, list_rva), &written, 4);
+    minidump_add_stream(directory, stream_count, MINIDUMP_STREAM_MODULE_LIST, list_rva,
+                        4 + written * sizeof(MinidumpModule));
+}
+
+// Assemble the dump of the crash in context and publish it as <dir>/<time>-<tid>.dmp.
+// Async-signal-safe; call once, from the thread that owns the capture, with the
+// module map the rest of the capture used.
+static inline bool minidump_write(MinidumpWriter* writer, const siginfo_t* info, const void* context, pid_t tid,
+                                  time_t crash_time, const ModuleMap* modules) {
+    if (!minidump_writer_is_open(writer) || !context) {
+        return false;
+    }
+    writer->used = 0;
+    uint32_t header_rva = minidump_alloc(writer, sizeof(MinidumpHeader));
+    uint32_t directory_rva = minidump_alloc(writer, MINIDUMP_MAX_STREAMS * sizeof(MinidumpDirectory));
+    // Crashing thread's registers, shared by the exception and the thread list
+    uint32_t context_rva = minidump_alloc(writer, sizeof(MinidumpContext));
+    if (!directory_rva || !context_rva) {
+        return false;
+    }
+    MinidumpDirectory directory[MINIDUMP_MAX_STREAMS];
+    memset(directory, 0, sizeof(directory));
+    uint32_t stream_count = 0;
+
+    MinidumpContext* ctx = (MinidumpContext*)minidump_at(writer, context_rva);
+    uintptr_t values[40];
+    size_t value_count = minidump_fill_context(ctx, context, values);
+    MinidumpLocation context_location = { sizeof(MinidumpContext), context_rva };
+
+    // System info
+    uint32_t system_rva = minidump_alloc(writer, sizeof(MinidumpSystemInfo));
+    if (system_rva) {
+        MinidumpSystemInfo system;
+        memset(&system, 0, sizeof(system));
+        system.processor_architecture = MINIDUMP_CPU;
+        system.number_of_processors = writer->cpu_count;
+        system.major_version = writer->os_major;
+        system.minor_version = writer->os_minor;
+        system.build_number = writer->os_build;
+        system.platform_id = MINIDUMP_OS_ANDROID;
+        system.csd_version_rva = minidump_write_string(writer, writer->os_description);
+        memcpy(minidump_at(writer, system_rva), &system, sizeof(system));
+        minidump_add_stream(directory, &stream_count, MINIDUMP_STREAM_SYSTEM_INFO, system_rva, sizeof(system));
+    }
+
+    uint32_t misc_rva = minidump_alloc(writer, sizeof(MinidumpMiscInfo));
+    if (misc_rva) {
+        MinidumpMiscInfo misc = { sizeof(MinidumpMiscInfo), MINIDUMP_MISC_PROCESS_ID, (uint32_t)getpid(), 0, 0, 0 };
+        memcpy(minidump_at(writer, misc_rva), &misc, sizeof(misc));
+        minidump_add_stream(directory, &stream_count, MINIDUMP_STREAM_MISC_INFO, misc_rva, sizeof(misc));
+    }
+
+    uint32_t exception_rva = minidump_alloc(writer, sizeof(MinidumpException));
+    if (exception_rva) {
+        MinidumpException exception;
+        memset(&exception, 0, sizeof(exception));
+        exception.thread_id = (uint32_t)tid;
+        exception.exception_code = (uint32_t)info->si_signo;
+        exception.exception_flags = (uint32_t)info->si_code;
+        exception.exception_address = (uintptr_t)info->si_addr;
+        exception.thread_context = context_location;
+        memcpy(minidump_at(writer, exception_rva), &exception, sizeof(exception));
+        minidump_add_stream(directory, &stream_count, MINIDUMP_STREAM_EXCEPTION, exception_rva, sizeof(exception));
+    }
+
+    // Memory: the stack from just below sp, and around the pc, the fault address and registers
+    UnwindRegisters regs;
+    crash_context_registers(context, &regs);
+    StackBounds bounds;
+    uintptr_t stack_start = regs.sp > MINIDUMP_STACK_RED_ZONE ? regs.sp - MINIDUMP_STACK_RED_ZONE : 0;
+    uintptr_t stack_end = regs.sp + MINIDUMP_STACK_SIZE;
+    if (crash_thread_stack_bounds(regs.sp, &bounds) && stack_end > bounds.hi) {
+        stack_end = bounds.hi;
+    }
+    size_t range_count = 0;
+    minidump_add_range(writer, &range_count, stack_start, stack_end);
+    values[value_count++] = (uintptr_t)info->si_addr;
+    for (size_t i = 0; i < value_count; i++) {
+        uintptr_t value = values[i];
+        if (value >= g_safe_memory_page_size && value < UINTPTR_MAX - MINIDUMP_REGISTER_MEMORY_SIZE) {
+            minidump_add_range(writer, &range_count, value - MINIDUMP_REGISTER_MEMORY_SIZE / 2,
+                               value + MINIDUMP_REGISTER_MEMORY_SIZE / 2);
+        }
+    }
+    range_count = minidump_merge_ranges(writer->ranges, range_count);
+
+    // The thread list and modules go before the memory, which takes whatever arena is left
+    uint32_t threads_rva = minidump_alloc(writer, 4 + sizeof(MinidumpThread));
+    minidump_write_modules(writer, modules, directory, &stream_count);
+
+    size_t region_count = 0;
+    for (size_t i = 0; i < range_count; i++) {
+        minidump_capture_range(writer, &region_count, writer->ranges[i].start, writer->ranges[i].end);
+    }
+    size_t memory_size = 4 + region_count * sizeof(MinidumpMemoryDescriptor);
+    uint32_t memory_rva = minidump_alloc(writer, memory_size);
+    if (memory_rva) {
+        uint32_t count = (uint32_t)region_count;
+        memcpy(minidump_at(writer, memory_rva), &count, 4);
+        memcpy((char*)minidump_at(writer, memory_rva) + 4, writer->regions,
+               region_count * sizeof(MinidumpMemoryDescriptor));
+        minidump_add_stream(directory, &stream_count, MINIDUMP_STREAM_MEMORY_LIST, memory_rva, memory_size);
+    }
+
+    // Only the crashing thread, with its context and the captured region holding sp as its stack
+    if (threads_rva) {
+        uint32_t count = 1;
+        MinidumpThread thread;
+        memset(&thread, 0, sizeof(thread));
+        thread.thread_id = (uint32_t)tid;
+        thread.thread_context = context_location;
+        for (size_t r = 0; r < region_count; r++) {
+            const MinidumpMemoryDescriptor* region = &writer->regions[r];
+            if (regs.sp - region->start_of_memory_range < region->memory.data_size) {
+                thread.stack = *region;
+                break;
+            }
+        }
+        memcpy(minidump_at(writer, threads_rva), &count, 4);
+        memcpy((char*)minidump_at(writer, threads_rva) + 4, &thread, sizeof(thread));
+        minidump_add_stream(directory, &stream_count, MINIDUMP_STREAM_THREAD_LIST, threads_rva,
+                            4 + sizeof(MinidumpThread));
+    }
+
+    MinidumpHeader header;
+    memset(&header, 0, sizeof(header));
+    header.signature = MINIDUMP_SIGNATURE;
+    header.version = MINIDUMP_VERSION;
+    header.stream_count = stream_count;
+    header.stream_directory_rva = directory_rva;
+    header.time_date_stamp = (uint32_t)crash_time;
+    memcpy(minidump_at(writer, header_rva), &header, sizeof(header));
+    memcpy(minidump_at(writer, directory_rva), directory, sizeof(directory));
+
+    if (!pwrite_fully(writer->fd, writer->buffer, writer->used, 0)) {
+        return false;
+    }
+
+    char path[sizeof(writer->dir) + 48];
+    FormatBuffer fmt;
+    fmt_init(&fmt, path, sizeof(path));
+    fmt_append_str(&fmt, writer->dir);
+    fmt_append_char(&fmt, '/');
+    fmt_append_dec(&fmt, crash_time);
+    fmt_append_char(&fmt, '-');
+    fmt_append_dec(&fmt, tid);
+    fmt_append_str(&fmt, ".dmp");
+    fmt_append_char(&fmt, '\0');
+    return !fmt.truncated && rename(writer->pending_path, path) == 0;
+}
+
+#endif // CRASHREPORTER_MINIDUMP_WRITER_H
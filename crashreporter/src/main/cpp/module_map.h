@@ -0,0 +1,315 @@
+/**
+ * Snapshot of the loaded modules, taken ahead of any crash
+ *
+ * dladdr() takes the linker lock (a deadlock if the crash happened inside
+ * dlopen) and scans modules linearly, so the handler must not call it. At
+ * initialize() time the modules are enumerated with dl_iterate_phdr() into
+ * pre-reserved storage: the sorted segment bounds used by the search are
+ * kept in their own dense arrays, apart from the colder per-module data
+ * (load bias, path, build-id, .eh_frame_hdr table). At crash time any pc, register
+ * value or fault address is resolved to (module index, offset) with a
+ * branch-free binary search; names are resolved later, on the next launch.
+ *
+ * The map follows dlopen/dlclose from any caller, Java or native: a
+ * low-frequency watcher thread compares the loader's dlopen/dlclose
+ * counters (or, on loaders without them, a fingerprint of the module list)
+ * and rebuilds only when they changed, which costs one dl_iterate_phdr()
+ * pass per tick otherwise. refreshLoadedModules() and
+ * NativeCrashHandler.loadLibrary() bring it up to date immediately. A
+ * library unloaded since the last tick is still in the map; the CFI walk
+ * checks a module's .eh_frame_hdr is still mapped before reading it
+ * (cfi_unwinder.h).
+ * The map is double-buffered: a rebuild fills the inactive copy and
+ * publishes it with an atomic pointer store, so a crash during a rebuild
+ * still sees a complete map. Once a crash owner has taken the map, rebuilds
+ * stop, so the copy it holds is never refilled under it. A module that
+ * survives a rebuild keeps the build-id and .eh_frame_hdr table parsed when
+ * it first appeared.
+ */
+
+#ifndef CRASHREPORTER_MODULE_MAP_H
+#define CRASHREPORTER_MODULE_MAP_H
+
+#include <link.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "eh_frame_hdr.h"
+#include "elf_build_id.h"
+
+// Loaded modules the map can hold; addresses in later modules are reported as unknown
+#define MODULE_MAP_MAX_MODULES 512
+
+// Storage shared by all module paths
+#define MODULE_MAP_PATH_ARENA_SIZE (64 * 1024)
+
+// How often the watcher thread checks for dlopen/dlclose
+#define MODULE_MAP_WATCH_INTERVAL_MS 1000
+
+// Bytes of .eh_frame_hdr after its 4 encoding bytes (eh_frame_ptr, fde_count)
+// kept to recognize the same table at crash time
+#define MODULE_MAP_EH_FRAME_CHECK_SIZE 8
+
+struct LoadedModule {
+    uintptr_t load_bias;        // Runtime address - ELF virtual address
+    uint32_t path_offset;       // Into ModuleMap::paths (NUL-terminated)
+    bool has_eh_frame;
+    EhFrameTable eh_frame;
+    uint8_t eh_frame_check[MODULE_MAP_EH_FRAME_CHECK_SIZE];
+    ElfBuildId build_id;
+};
+
+// Identifies a set of loaded modules, to detect dlopen/dlclose cheaply
+struct ModuleMapGeneration {
+    bool has_counters;          // Loader reports dlpi_adds/dlpi_subs
+    unsigned long long adds;
+    unsigned long long subs;
+    uint64_t fingerprint;       // Fallback: hash of every module's load bias
+};
+
+struct ModuleMap {
+    size_t count;
+    // Search keys, sorted: all PT_LOAD segments of module i span [starts[i], ends[i])
+    uintptr_t starts[MODULE_MAP_MAX_MODULES];
+    uintptr_t ends[MODULE_MAP_MAX_MODULES];
+    LoadedModule modules[MODULE_MAP_MAX_MODULES];
+    ModuleMapGeneration generation;
+    size_t paths_used;
+    char paths[MODULE_MAP_PATH_ARENA_SIZE];
+};
+
+static ModuleMap g_module_maps[2];
+static ModuleMap* g_module_map = nullptr;           // Published copy, read by the handler
+static pthread_mutex_t g_module_map_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool g_module_map_crashing = false;          // Set by the crash owner; no rebuild after it
+static bool g_module_map_watching = false;
+
+static inline bool module_map_has_counters(size_t info_size) {
+    return info_size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(((struct dl_phdr_info*)nullptr)->dlpi_subs);
+}
+
+static int module_map_generation_callback(struct dl_phdr_info* info, size_t size, void* data) {
+    ModuleMapGeneration* generation = static_cast<ModuleMapGeneration*>(data);
+    if (module_map_has_counters(size)) {
+        generation->has_counters = true;
+        generation->adds = info->dlpi_adds;
+        generation->subs = info->dlpi_subs;
+        return 1;   // The counters are global; no need to visit the other modules
+    }
+    generation->fingerprint = generation->fingerprint * 1099511628211ULL ^ (uint64_t)info->dlpi_addr;
+    return 0;
+}
+
+static inline ModuleMapGeneration module_map_read_generation() {
+    ModuleMapGeneration generation = { false, 0, 0, 14695981039346656037ULL };
+    dl_iterate_phdr(module_map_generation_callback, &generation);
+    return generation;
+}
+
+// Index of the module any segment of which contains address, or -1 (async-signal-safe).
+// The loop body compiles to a conditional move: no data-dependent branches.
+static inline int module_map_find(const ModuleMap* map, uintptr_t address) {
+    if (!map || map->count == 0) {
+        return -1;
+    }
+
+    const uintptr_t* base = map->starts;
+    size_t n = map->count;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = base[half] <= address ? base + half : base;
+        n -= half;
+    }
+    size_t index = (size_t)(base - map->starts);
+    return *base <= address && address < map->ends[index] ? (int)index : -1;
+}
+
+struct ModuleMapBuilder {
+    ModuleMap* map;             // Being built
+    const ModuleMap* previous;  // Published map, whose parsed modules are reused
+};
+
+// The same module in the previous map (same mapping, same path), or null
+static inline const LoadedModule* module_map_find_previous(const ModuleMap* previous, uintptr_t start, uintptr_t end,
+                                                          uintptr_t load_bias, const char* path) {
+    int index = module_map_find(previous, start);
+    if (index < 0) {
+        return nullptr;
+    }
+    const LoadedModule* module = &previous->modules[index];
+    bool same = previous->starts[index] == start && previous->ends[index] == end && module->load_bias == load_bias &&
+                strcmp(previous->paths + module->path_offset, path) == 0;
+    return same ? module : nullptr;
+}
+
+// Parse the build-id and unwind table of a newly loaded module from its mapped headers
+static inline void module_map_parse_headers(struct dl_phdr_info* info, uintptr_t start, uintptr_t end,
+                                            LoadedModule* module) {
+    module->has_eh_frame = false;
+    module->build_id.length = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        uintptr_t address = info->dlpi_addr + phdr->p_vaddr;
+        if (phdr->p_type == PT_GNU_EH_FRAME) {
+            module->has_eh_frame = eh_frame_hdr_parse((const uint8_t*)address, &module->eh_frame);
+            if (module->has_eh_frame) {
+                memcpy(module->eh_frame_check, (const uint8_t*)address + 4, MODULE_MAP_EH_FRAME_CHECK_SIZE);
+            }
+        } else if (phdr->p_type == PT_NOTE && module->build_id.length == 0 && address >= start &&
+                   phdr->p_memsz <= end - address) {
+            elf_build_id_from_notes((const uint8_t*)address, phdr->p_memsz, &module->build_id);
+        }
+    }
+}
+
+static int module_map_add(struct dl_phdr_info* info, size_t /* size */, void* data) {
+    ModuleMapBuilder* builder = static_cast<ModuleMapBuilder*>(data);
+    ModuleMap* map = builder->map;
+    if (map->count >= MODULE_MAP_MAX_MODULES) {
+        return 0;
+    }
+
+    uintptr_t start = UINTPTR_MAX;
+    uintptr_t end = 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type == PT_LOAD) {
+            uintptr_t seg_start = info->dlpi_addr + phdr->p_vaddr;
+            uintptr_t seg_end = seg_start + phdr->p_memsz;
+            if (seg_start < start) start = seg_start;
+            if (seg_end > end) end = seg_end;
+        }
+    }
+    if (start >= end) {
+        return 0;
+    }
+
+    const char* path = info->dlpi_name ? info->dlpi_name : "";
+    LoadedModule* module = &map->modules[map->count];
+    const LoadedModule* known = module_map_find_previous(builder->previous, start, end, info->dlpi_addr, path);
+    if (known) {
+        *module = *known;
+    } else {
+        module->load_bias = info->dlpi_addr;
+        module_map_parse_headers(info, start, end, module);
+    }
+
+    // A module whose path no longer fits is still mapped, just unnamed
+    size_t len = strlen(path);
+    if (map->paths_used + len + 1 > sizeof(map->paths)) {
+        len = 0;
+        if (map->paths_used + 1 > sizeof(map->paths)) {
+            return 0;
+        }
+    }
+    module->path_offset = (uint32_t)map->paths_used;
+    memcpy(map->paths + map->paths_used, path, len);
+    map->paths[map->paths_used + len] = '\0';
+    map->paths_used += len + 1;
+
+    map->starts[map->count] = start;
+    map->ends[map->count] = end;
+    map->count++;
+    return 0;
+}
+
+// Rebuild the inactive copy and publish it; caller holds g_module_map_lock
+static inline void module_map_rebuild_locked(const ModuleMapGeneration* generation) {
+    if (__atomic_load_n(&g_module_map_crashing, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+    ModuleMap* active = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE);
+    ModuleMap* map = active == &g_module_maps[0] ? &g_module_maps[1] : &g_module_maps[0];
+    map->count = 0;
+    map->paths_used = 0;
+    map->generation = *generation;
+    ModuleMapBuilder builder = { map, active };
+    dl_iterate_phdr(module_map_add, &builder);
+
+    // Insertion sort: modules are mostly enumerated in load-address order already
+    for (size_t i = 1; i < map->count; i++) {
+        uintptr_t start = map->starts[i];
+        uintptr_t end = map->ends[i];
+        LoadedModule module = map->modules[i];
+        size_t j = i;
+        while (j > 0 && map->starts[j - 1] > start) {
+            map->starts[j] = map->starts[j - 1];
+            map->ends[j] = map->ends[j - 1];
+            map->modules[j] = map->modules[j - 1];
+            j--;
+        }
+        map->starts[j] = start;
+        map->ends[j] = end;
+        map->modules[j] = module;
+    }
+
+    __atomic_store_n(&g_module_map, map, __ATOMIC_RELEASE);
+}
+
+// (Re)build the map from the currently loaded modules. Not signal-safe:
+// call from initialize() and after loading libraries, never from the handler.
+static inline void module_map_build() {
+    pthread_mutex_lock(&g_module_map_lock);
+    ModuleMapGeneration generation = module_map_read_generation();
+    module_map_rebuild_locked(&generation);
+    pthread_mutex_unlock(&g_module_map_lock);
+}
+
+// Rebuild only if a library was loaded or unloaded since the last build
+static inline bool module_map_refresh_if_changed() {
+    pthread_mutex_lock(&g_module_map_lock);
+    ModuleMapGeneration generation = module_map_read_generation();
+    const ModuleMap* active = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE);
+    bool changed = !active || active->generation.has_counters != generation.has_counters ||
+                   (generation.has_counters ? active->generation.adds != generation.adds ||
+                                              active->generation.subs != generation.subs
+                                            : active->generation.fingerprint != generation.fingerprint);
+    if (changed) {
+        module_map_rebuild_locked(&generation);
+    }
+    pthread_mutex_unlock(&g_module_map_lock);
+    return changed;
+}
+
+static void* module_map_watch(void* /* arg */) {
+    struct timespec interval = { MODULE_MAP_WATCH_INTERVAL_MS / 1000,
+                                 (MODULE_MAP_WATCH_INTERVAL_MS % 1000) * 1000000L };
+    while (!__atomic_load_n(&g_module_map_crashing, __ATOMIC_SEQ_CST)) {
+        nanosleep(&interval, nullptr);
+        module_map_refresh_if_changed();
+    }
+    return nullptr;
+}
+
+// Start the thread that follows dlopen/dlclose (once; call from initialize())
+static inline void module_map_start_watcher() {
+    if (g_module_map_watching) {
+        return;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, module_map_watch, nullptr) == 0) {
+        pthread_setname_np(thread, "crash-modmap");
+        g_module_map_watching = true;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// Take the map for a crash capture (async-signal-safe). No rebuild starts
+// after this, so the copy returned is never refilled while the crash path
+// reads it; take it once and pass it down, so indexes stay consistent.
+static inline const ModuleMap* module_map_begin_crash() {
+    __atomic_store_n(&g_module_map_crashing, true, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&g_module_map, __ATOMIC_SEQ_CST);
+}
+
+static inline const char* module_map_path(const ModuleMap* map, const LoadedModule* module) {
+    return map->paths + module->path_offset;
+}
+
+#endif // CRASHREPORTER_MODULE_MAP_H
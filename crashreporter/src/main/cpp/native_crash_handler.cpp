@@ -14,8 +14,18 @@
 #include <cstdlib>
 #include <pthread.h>
 #include <android/log.h>
-#include <unwind.h>
-#include <dlfcn.h>
+
+#include "crash_context.h"
+#include "crash_coordination.h"
+#include "crash_journal.h"
+#include "crash_record_builder.h"
+#include "crash_record_format.h"
+#include "crash_record_jni.h"
+#include "crash_record_writer.h"
+#include "minidump_writer.h"
+#include "module_map.h"
+#include "signal_safe_format.h"
+#include "stack_unwinder.h"
 
 #define LOG_TAG "NativeCrashHandler"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
@@ -25,169 +35,132 @@
 // Maximum stack frames to capture
 #define MAX_STACK_FRAMES 64
 
+// Capture modes (keep in sync with NativeCrashHandler.CaptureMode)
+#define CAPTURE_MODE_FILE 0
+#define CAPTURE_MODE_MMAP 1
+
 // Structure to hold crash information
 struct CrashInfo {
     int signal;
     int code;
     void* fault_address;
-    char signal_name[32];
     char thread_name[128];
     pid_t pid;
     pid_t tid;
     time_t crash_time;
     uintptr_t stack_frames[MAX_STACK_FRAMES];
     size_t frame_count;
+    UnwindMethod unwind_method;
 };
 
 // Global storage for crash info (must be signal-safe)
 static CrashInfo g_crash_info;
 static char g_crash_file_path[256];
+static char g_journal_path[256];
+// Crash journal opened and pre-allocated by initialize() (see crash_journal.h)
+static CrashJournal g_journal = { -1, nullptr, 0, 0, 0, 0, 0 };
+// Pre-reserved arena the whole crash record is formatted into before it is flushed
+static char g_record_buffer[CRASH_JOURNAL_BODY_SIZE];
+// Elects the one thread that captures when several threads crash at once
+static CrashCoordinator g_coordinator;
+// Optional minidump output, prepared by initialize() (see minidump_writer.h)
+static MinidumpWriter g_minidump = {};
+static char g_minidump_buffer[MINIDUMP_BUFFER_SIZE];
+// Primary unwinder selected at initialize() (UNWINDER_*)
+static int g_unwinder = UNWINDER_UNWIND_BACKTRACE;
 static struct sigaction g_old_handlers[32];
 static bool g_initialized = false;
 
-// Signal names for better error reporting
-static const char* get_signal_name(int sig) {
-    switch (sig) {
-        case SIGSEGV: return "SIGSEGV";
-        case SIGABRT: return "SIGABRT";
-        case SIGFPE:  return "SIGFPE";
-        case SIGILL:  return "SIGILL";
-        case SIGBUS:  return "SIGBUS";
-        case SIGTRAP: return "SIGTRAP";
-        default:      return "UNKNOWN";
-    }
-}
-
-// Get signal description
-static const char* get_signal_description(int sig) {
-    switch (sig) {
-        case SIGSEGV: return "Segmentation fault (invalid memory access)";
-        case SIGABRT: return "Abort signal (abnormal termination)";
-        case SIGFPE:  return "Floating point exception";
-        case SIGILL:  return "Illegal instruction";
-        case SIGBUS:  return "Bus error (invalid memory alignment)";
-        case SIGTRAP: return "Trace/breakpoint trap";
-        default:      return "Unknown signal";
-    }
-}
-
-// Unwind callback structure
-struct UnwindState {
-    uintptr_t* frames;
-    size_t frame_count;
-    size_t max_frames;
-};
-
-// Callback for stack unwinding
-static _Unwind_Reason_Code unwind_callback(struct _Unwind_Context* context, void* arg) {
-    UnwindState* state = static_cast<UnwindState*>(arg);
-
-    if (state->frame_count >= state->max_frames) {
-        return _URC_END_OF_STACK;
-    }
-
-    uintptr_t pc = _Unwind_GetIP(context);
-    if (pc) {
-        state->frames[state->frame_count++] = pc;
-    }
-
-    return _URC_NO_REASON;
-}
-
-// Capture stack trace (async-signal-safe)
-static size_t capture_stack_trace(uintptr_t* frames, size_t max_frames) {
-    UnwindState state;
-    state.frames = frames;
-    state.frame_count = 0;
-    state.max_frames = max_frames;
-
-    _Unwind_Backtrace(unwind_callback, &state);
-
-    return state.frame_count;
-}
-
 // Get thread name (async-signal-safe)
 static void get_thread_name(char* buffer, size_t size) {
 #if __ANDROID_API__ >= 26
     pthread_t thread = pthread_self();
-    if (pthread_getname_np(thread, buffer, size) != 0) {
-        snprintf(buffer, size, "Thread-%d", (int)gettid());
+    if (pthread_getname_np(thread, buffer, size) == 0) {
+        return;
     }
-#else
-    // pthread_getname_np requires Android API 26+
-    snprintf(buffer, size, "Thread-%d", (int)gettid());
 #endif
+    // pthread_getname_np requires Android API 26+
+    char storage[32];
+    FormatBuffer fmt;
+    fmt_init(&fmt, storage, sizeof(storage));
+    fmt_append_str(&fmt, "Thread-");
+    fmt_append_dec(&fmt, gettid());
+    fmt_copy_cstr(buffer, size, &fmt);
 }
 
 // Write crash info to file (async-signal-safe operations only!)
-static void write_crash_to_file(const CrashInfo* info) {
-    // Open file for writing (use creat for async-signal-safety)
-    int fd = open(g_crash_file_path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
-    if (fd < 0) {
-        return;
+static void write_crash_to_file(const CrashInfo* info, const ModuleMap* modules) {
+    CrashJournalSlot slot;
+    bool has_slot = crash_journal_is_open(&g_journal) && crash_journal_claim(&g_journal, &slot);
+
+    CrashRecordWriter writer;
+    if (has_slot && slot.mapped_body) {
+        // Format straight into the shared mapping
+        record_writer_init(&writer, slot.mapped_body, g_journal.body_capacity);
+    } else {
+        record_writer_init(&writer, g_record_buffer, CRASH_JOURNAL_BODY_SIZE);
     }
-
-    char buffer[512];
-    int len;
-
-    // Write header
-    len = snprintf(buffer, sizeof(buffer),
-                   "NATIVE_CRASH\n"
-                   "Signal: %s (%d)\n"
-                   "Description: %s\n"
-                   "Code: %d\n"
-                   "Fault Address: %p\n"
-                   "Thread: %s\n"
-                   "PID: %d\n"
-                   "TID: %d\n"
-                   "Time: %ld\n"
-                   "Frame Count: %zu\n",
-                   info->signal_name,
-                   info->signal,
-                   get_signal_description(info->signal),
-                   info->code,
-                   info->fault_address,
-                   info->thread_name,
-                   info->pid,
-                   info->tid,
-                   info->crash_time,
-                   info->frame_count);
-    write(fd, buffer, len);
-
-    // Write stack frames
-    write(fd, "Stack Trace:\n", 13);
-    for (size_t i = 0; i < info->frame_count; i++) {
-        Dl_info dl_info;
-        if (dladdr((void*)info->stack_frames[i], &dl_info)) {
-            len = snprintf(buffer, sizeof(buffer),
-                          "#%02zu pc %p %s (%s+%p)\n",
-                          i,
-                          (void*)info->stack_frames[i],
-                          dl_info.dli_fname ? dl_info.dli_fname : "???",
-                          dl_info.dli_sname ? dl_info.dli_sname : "???",
-                          (void*)((char*)info->stack_frames[i] - (char*)dl_info.dli_saddr));
-        } else {
-            len = snprintf(buffer, sizeof(buffer),
-                          "#%02zu pc %p ???\n",
-                          i,
-                          (void*)info->stack_frames[i]);
+    FormatBuffer* fmt = &writer.fmt;
+
+    // Binary record (crash_record_format.h); decoded and symbolized on the next launch
+    CrashRecordHeader header;
+    crash_record_init_header(&header, info->signal, info->code, (uintptr_t)info->fault_address, info->pid,
+                             info->tid, info->crash_time, info->unwind_method);
+    crash_record_begin(fmt, &header);
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_THREAD_NAME);
+    fmt_append_strn(fmt, info->thread_name, sizeof(info->thread_name));
+    crash_record_end_section(fmt, section);
+
+    crash_record_write_secondary_crashes(fmt, &g_coordinator);
+
+    // Frames as module index + offset; names are resolved on the next launch
+    CrashRecordModules referenced;
+    crash_record_modules_init(&referenced, modules);
+    crash_record_write_frames(fmt, &referenced, info->stack_frames, info->frame_count);
+    section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_ADDRESSES);
+    crash_record_write_module_address(fmt, &referenced, -1, (uintptr_t)info->fault_address);
+    crash_record_end_section(fmt, section);
+    crash_record_write_referenced_modules(fmt, &referenced);
+    crash_record_finish(fmt);
+
+    if (has_slot) {
+        // Body first, slot header with the commit marker last
+        crash_journal_commit(&g_journal, &slot, &writer);
+    } else {
+        // initialize() could not prepare the journal; last-resort legacy file
+        int fd = open(g_crash_file_path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return;
         }
-        write(fd, buffer, len);
+        record_writer_flush(&writer, fd);
+        close(fd);
     }
-
-    close(fd);
-
-    LOGI("Native crash info written to: %s", g_crash_file_path);
 }
 
 // Signal handler (MUST be async-signal-safe!)
 static void signal_handler(int sig, siginfo_t* info, void* context) {
-    // Prevent recursive crashes
-    static volatile sig_atomic_t handling_crash = 0;
-    if (handling_crash) {
-        _exit(1);
+    pid_t tid = gettid();
+
+    // Elect a single owner for the capture; other crashing threads must not kill it
+    switch (crash_coordinator_enter(&g_coordinator, tid)) {
+        case CRASH_ROLE_RECURSIVE:
+            // Crashed again inside our own handler
+            _exit(1);
+
+        case CRASH_ROLE_SECONDARY:
+            crash_coordinator_add_secondary(&g_coordinator, tid, info, crash_context_pc(context));
+            crash_coordinator_park(&g_coordinator);
+            // Record committed (or owner stuck): die with our own signal once the handler returns
+            signal(sig, SIG_DFL);
+            raise(sig);
+            return;
+
+        case CRASH_ROLE_OWNER:
+            break;
     }
-    handling_crash = 1;
+
+    // One module map for the whole capture, so frame, record and minidump indexes agree
+    const ModuleMap* modules = module_map_begin_crash();
 
     // Collect crash information
     memset(&g_crash_info, 0, sizeof(g_crash_info));
@@ -195,17 +168,19 @@ static void signal_handler(int sig, siginfo_t* info, void* context) {
     g_crash_info.code = info->si_code;
     g_crash_info.fault_address = info->si_addr;
     g_crash_info.pid = getpid();
-    g_crash_info.tid = gettid();
+    g_crash_info.tid = tid;
     g_crash_info.crash_time = time(nullptr);
 
-    strncpy(g_crash_info.signal_name, get_signal_name(sig), sizeof(g_crash_info.signal_name) - 1);
     get_thread_name(g_crash_info.thread_name, sizeof(g_crash_info.thread_name));
 
-    // Capture stack trace
-    g_crash_info.frame_count = capture_stack_trace(g_crash_info.stack_frames, MAX_STACK_FRAMES);
+    // Capture stack trace, starting at the faulting instruction
+    g_crash_info.frame_count = capture_stack(context, g_unwinder, modules, g_crash_info.stack_frames,
+                                             MAX_STACK_FRAMES, &g_crash_info.unwind_method);
 
     // Write crash info to file
-    write_crash_to_file(&g_crash_info);
+    write_crash_to_file(&g_crash_info, modules);
+    minidump_write(&g_minidump, info, context, tid, g_crash_info.crash_time, modules);
+    crash_coordinator_finish(&g_coordinator);
 
     // Call original handler (if any)
     struct sigaction* old_handler = &g_old_handlers[sig];
@@ -222,7 +197,7 @@ static void signal_handler(int sig, siginfo_t* info, void* context) {
 
 // Initialize native crash handler
 extern "C" JNIEXPORT void JNICALL
-Java_com_crashreporter_library_NativeCrashHandler_initialize(JNIEnv* env, jobject /* this */, jstring crash_dir) {
+Java_com_crashreporter_library_NativeCrashHandler_initialize(JNIEnv* env, jobject /* this */, jstring crash_dir, jint capture_mode, jint unwinder, jboolean minidump) {
     if (g_initialized) {
         LOGD("Native crash handler already initialized");
         return;
@@ -231,9 +206,33 @@ Java_com_crashreporter_library_NativeCrashHandler_initialize(JNIEnv* env, jobjec
     // Get crash directory path
     const char* crash_dir_str = env->GetStringUTFChars(crash_dir, nullptr);
     snprintf(g_crash_file_path, sizeof(g_crash_file_path), "%s/native_crash.txt", crash_dir_str);
+    snprintf(g_journal_path, sizeof(g_journal_path), "%s/native_crash.journal", crash_dir_str);
+    g_minidump.fd = -1;
+    if (minidump && !minidump_writer_open(&g_minidump, crash_dir_str, g_minidump_buffer, sizeof(g_minidump_buffer))) {
+        LOGE("Failed to prepare minidump output in %s: %s", crash_dir_str, strerror(errno));
+    }
     env->ReleaseStringUTFChars(crash_dir, crash_dir_str);
 
-    LOGI("Initializing native crash handler, crash file: %s", g_crash_file_path);
+    // Open and pre-allocate the journal now; the handler never opens files
+    bool mapped = capture_mode == CAPTURE_MODE_MMAP;
+    if (!crash_journal_open(&g_journal, g_journal_path, CRASH_JOURNAL_SLOT_COUNT, CRASH_JOURNAL_BODY_SIZE, mapped)) {
+        LOGE("Failed to prepare crash journal %s: %s", g_journal_path, strerror(errno));
+        if (mapped && crash_journal_open(&g_journal, g_journal_path, CRASH_JOURNAL_SLOT_COUNT, CRASH_JOURNAL_BODY_SIZE, false)) {
+            LOGI("Falling back to file capture mode");
+        }
+    }
+
+    g_unwinder = unwinder;
+    stack_unwinder_init();
+    module_map_start_watcher();
+
+    if (!g_journal.mapping) {
+        // Commit the record arena now so the handler never page-faults on it
+        record_writer_reserve(g_record_buffer, CRASH_JOURNAL_BODY_SIZE);
+    }
+
+    LOGI("Initializing native crash handler, crash journal: %s (mode %d, unwinder %d)",
+         g_journal_path, (int)capture_mode, (int)unwinder);
 
     // Set up signal handlers
     struct sigaction sa;
@@ -293,6 +292,45 @@ Java_com_crashreporter_library_NativeCrashHandler_triggerNativeCrash(JNIEnv* env
     }
 }
 
+// Re-snapshot the loaded modules if libraries were loaded or unloaded since the last build
+extern "C" JNIEXPORT void JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeRefreshLoadedModules(JNIEnv* /* env */, jobject /* this */) {
+    if (g_initialized) {
+        module_map_refresh_if_changed();
+    }
+}
+
+// Resolve a previous session's frame offsets against a module file (crash_record_jni.h)
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeSymbolize(JNIEnv* env, jobject /* this */, jstring module_path, jstring build_id, jstring cache_dir, jlongArray offsets) {
+    return crash_record_jni_symbolize(env, LOG_TAG, module_path, build_id, cache_dir, offsets);
+}
+
+// Decode a binary crash record into the text layout the symbolizer reads; null if it is not one
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeDecodeRecord(JNIEnv* env, jobject /* this */, jobject record) {
+    return crash_record_jni_to_text(env, record);
+}
+
+// Decode a binary crash record straight into a NativeCrashReport
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeParseRecord(JNIEnv* env, jobject /* this */, jobject record, jobject report) {
+    return crash_record_jni_parse(env, record, report);
+}
+
+// A binary crash record as its JSON upload document, with the frame symbols resolved
+// by the app (one per frame, or null); null if the buffer does not hold a binary record
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeRecordToJson(JNIEnv* env, jobject /* this */, jobject record, jobjectArray symbols) {
+    return crash_record_jni_to_json(env, record, symbols);
+}
+
+// CRC-32 of a direct buffer's contents, as the journal stores it; -1 for a heap buffer
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_crashreporter_library_NativeCrashHandler_nativeChecksum(JNIEnv* env, jobject /* this */, jobject buffer) {
+    return crash_record_jni_checksum(env, buffer);
+}
+
 // Get initialization status
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_crashreporter_library_NativeCrashHandler_isInitialized(JNIEnv* env, jobject /* this */) {
@@ -0,0 +1,124 @@
+/**
+ * Fault-free reads of arbitrary process memory
+ *
+ * Dereferencing an address from a crash (the SIGSEGV fault address, a
+ * corrupt pointer) inside the handler would fault again. Reads here are
+ * done by the kernel instead: process_vm_readv() on our own pid, or, where
+ * seccomp or an old kernel refuses it, a write() of the source into a pipe
+ * pre-opened at initialize(). Either way an unmapped or unreadable page
+ * comes back as EFAULT rather than a signal. Memory is copied a page at a
+ * time, and every unreadable range is reported to the caller.
+ */
+
+#ifndef CRASHREPORTER_SAFE_MEMORY_H
+#define CRASHREPORTER_SAFE_MEMORY_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// A range of addresses that could not be read
+struct MemoryRange {
+    uintptr_t start;
+    size_t length;
+};
+
+static size_t g_safe_memory_page_size = 4096;
+static int g_safe_memory_pipe[2] = { -1, -1 };
+static bool g_safe_memory_use_vm_readv = true;
+static pid_t g_safe_memory_pid = 0;     // Ours, kept current across fork(); 0 before init
+
+static void safe_memory_update_pid() {
+    g_safe_memory_pid = getpid();
+}
+
+// Cache the page size and pid and open the fallback pipe (call from initialize(), not the handler)
+static inline void safe_memory_init() {
+    if (g_safe_memory_pid == 0) {
+        pthread_atfork(nullptr, nullptr, safe_memory_update_pid);
+    }
+    safe_memory_update_pid();
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size > 0) {
+        g_safe_memory_page_size = (size_t)page_size;
+    }
+    if (g_safe_memory_pipe[0] < 0 && pipe2(g_safe_memory_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        g_safe_memory_pipe[0] = g_safe_memory_pipe[1] = -1;
+    }
+}
+
+// Copy len bytes that lie within a single page; false if any of it is unreadable
+static inline bool safe_memory_read_chunk(void* dst, uintptr_t src, size_t len) {
+    if (g_safe_memory_use_vm_readv) {
+        struct iovec local = { dst, len };
+        struct iovec remote = { (void*)src, len };
+        ssize_t n = syscall(SYS_process_vm_readv, g_safe_memory_pid ? g_safe_memory_pid : getpid(), &local, 1, &remote, 1, 0);
+        if (n == (ssize_t)len) {
+            return true;
+        }
+        if (n >= 0 || (errno != ENOSYS && errno != EPERM)) {
+            return false;
+        }
+        // Not permitted here; use the pipe from now on
+        g_safe_memory_use_vm_readv = false;
+    }
+
+    if (g_safe_memory_pipe[1] < 0) {
+        return false;
+    }
+    ssize_t written = write(g_safe_memory_pipe[1], (const void*)src, len);
+    if (written <= 0) {
+        return false;
+    }
+    size_t drained = 0;
+    while (drained < (size_t)written) {
+        ssize_t n = read(g_safe_memory_pipe[0], (char*)dst + drained, (size_t)written - drained);
+        if (n <= 0) {
+            break;
+        }
+        drained += (size_t)n;
+    }
+    return written == (ssize_t)len && drained == len;
+}
+
+// Copy [src, src + len) into dst page by page without ever faulting.
+// Unreadable bytes are zeroed and described in unreadable (adjacent ranges
+// merged; ranges beyond max_unreadable are dropped). Returns readable bytes.
+static inline size_t safe_memory_read(void* dst, uintptr_t src, size_t len,
+                                      MemoryRange* unreadable, size_t max_unreadable, size_t* unreadable_count) {
+    size_t readable = 0;
+    size_t offset = 0;
+    while (offset < len) {
+        uintptr_t addr = src + offset;
+        // Distance to the next page boundary (wraps correctly at the top of the address space)
+        size_t chunk = g_safe_memory_page_size - (addr & (g_safe_memory_page_size - 1));
+        if (chunk > len - offset) {
+            chunk = len - offset;
+        }
+
+        char* out = (char*)dst + offset;
+        if (safe_memory_read_chunk(out, addr, chunk)) {
+            readable += chunk;
+        } else {
+            memset(out, 0, chunk);
+            MemoryRange* last = *unreadable_count ? &unreadable[*unreadable_count - 1] : nullptr;
+            if (last && last->start + last->length == addr) {
+                last->length += chunk;
+            } else if (*unreadable_count < max_unreadable) {
+                unreadable[*unreadable_count].start = addr;
+                unreadable[*unreadable_count].length = chunk;
+                (*unreadable_count)++;
+            }
+        }
+        offset += chunk;
+    }
+    return readable;
+}
+
+#endif // CRASHREPORTER_SAFE_MEMORY_H
@@ -0,0 +1,133 @@
+/**
+ * Async-signal-safe formatting helpers
+ *
+ * Allocation-free, lock-free and locale-free replacements for the snprintf
+ * calls on the crash path. Every function appends to a caller-provided buffer
+ * (normally on the signal handler's stack) and never writes past its end;
+ * output that does not fit is dropped and the buffer is flagged as truncated.
+ */
+
+#ifndef CRASHREPORTER_SIGNAL_SAFE_FORMAT_H
+#define CRASHREPORTER_SIGNAL_SAFE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Output buffer used by all fmt_* helpers
+struct FormatBuffer {
+    char* data;
+    size_t capacity;
+    size_t length;
+    bool truncated;
+};
+
+static inline void fmt_init(FormatBuffer* buf, char* storage, size_t capacity) {
+    buf->data = storage;
+    buf->capacity = capacity;
+    buf->length = 0;
+    buf->truncated = false;
+}
+
+static inline void fmt_append_char(FormatBuffer* buf, char c) {
+    if (buf->length < buf->capacity) {
+        buf->data[buf->length++] = c;
+    } else {
+        buf->truncated = true;
+    }
+}
+
+static inline void fmt_append_bytes(FormatBuffer* buf, const char* src, size_t len) {
+    size_t room = buf->capacity - buf->length;
+    if (len > room) {
+        len = room;
+        buf->truncated = true;
+    }
+    for (size_t i = 0; i < len; i++) {
+        buf->data[buf->length + i] = src[i];
+    }
+    buf->length += len;
+}
+
+// Append at most max_len characters of a NUL-terminated string (nullptr prints "???")
+static inline void fmt_append_strn(FormatBuffer* buf, const char* str, size_t max_len) {
+    if (!str) {
+        str = "???";
+    }
+    size_t len = 0;
+    while (len < max_len && str[len] != '\0') {
+        len++;
+    }
+    fmt_append_bytes(buf, str, len);
+}
+
+static inline void fmt_append_str(FormatBuffer* buf, const char* str) {
+    fmt_append_strn(buf, str, SIZE_MAX);
+}
+
+// Unsigned decimal, left-padded with zeros to at least min_width digits ("%0*llu")
+static inline void fmt_append_udec_padded(FormatBuffer* buf, uint64_t value, int min_width) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+
+    for (int i = count; i < min_width; i++) {
+        fmt_append_char(buf, '0');
+    }
+    while (count > 0) {
+        fmt_append_char(buf, digits[--count]);
+    }
+}
+
+static inline void fmt_append_udec(FormatBuffer* buf, uint64_t value) {
+    fmt_append_udec_padded(buf, value, 1);
+}
+
+// Signed decimal ("%lld")
+static inline void fmt_append_dec(FormatBuffer* buf, int64_t value) {
+    if (value < 0) {
+        fmt_append_char(buf, '-');
+        // Negate in unsigned space so INT64_MIN does not overflow
+        fmt_append_udec(buf, 0 - (uint64_t)value);
+    } else {
+        fmt_append_udec(buf, (uint64_t)value);
+    }
+}
+
+// Lowercase hex, left-padded with zeros to at least min_width digits ("%0*llx")
+static inline void fmt_append_hex_padded(FormatBuffer* buf, uint64_t value, int min_width) {
+    static const char kHexDigits[] = "0123456789abcdef";
+    char digits[16];
+    int count = 0;
+    do {
+        digits[count++] = kHexDigits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+
+    for (int i = count; i < min_width; i++) {
+        fmt_append_char(buf, '0');
+    }
+    while (count > 0) {
+        fmt_append_char(buf, digits[--count]);
+    }
+}
+
+static inline void fmt_append_hex(FormatBuffer* buf, uint64_t value) {
+    fmt_append_hex_padded(buf, value, 1);
+}
+
+// Copy a formatted buffer into a fixed-size C string field (always NUL-terminated)
+static inline void fmt_copy_cstr(char* dest, size_t dest_size, const FormatBuffer* buf) {
+    if (dest_size == 0) {
+        return;
+    }
+    size_t len = buf->length < dest_size - 1 ? buf->length : dest_size - 1;
+    for (size_t i = 0; i < len; i++) {
+        dest[i] = buf->data[i];
+    }
+    dest[len] = '\0';
+}
+
+#endif // CRASHREPORTER_SIGNAL_SAFE_FORMAT_H
@@ -0,0 +1,233 @@
+/**
+ * Stack capture seeded from the faulting context
+ *
+ * _Unwind_Backtrace called from a signal handler starts at the handler's own
+ * frames and the kernel's sigreturn trampoline, which waste frame budget and
+ * are stripped anyway. The trace recorded here starts exactly at the
+ * faulting instruction taken from the ucontext: frames above it are skipped
+ * (within a fixed step budget) and never count towards max_frames. If the
+ * faulting pc is never matched (the unwinder could not cross the signal
+ * frame), the handler frames it did walk are dropped and the stack is
+ * walked from the ucontext by the CFI, then the frame-pointer walker; only
+ * if both fail are the frames derivable from the registers alone (pc,
+ * then lr) recorded.
+ *
+ * The frame-pointer walker is a faster, lock-free alternative that can be
+ * selected as the primary unwinder. It follows the {previous fp, return
+ * address} frame records that -fno-omit-frame-pointer emits on every
+ * supported ABI, validating each record against the crashing thread's stack
+ * bounds, and stops cleanly at the first corrupt or missing record.
+ * _Unwind_Backtrace remains the fallback when the walk cannot start.
+ *
+ * The CFI unwinder (cfi_unwinder.h) is the accurate lock-free choice for
+ * code built without frame pointers, with the same fallback.
+ */
+
+#ifndef CRASHREPORTER_STACK_UNWINDER_H
+#define CRASHREPORTER_STACK_UNWINDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unwind.h>
+
+#include "cfi_unwinder.h"
+#include "crash_context.h"
+#include "module_map.h"
+#include "unwind_method.h"
+
+// Upper bound on handler/trampoline frames walked before the faulting frame
+#define UNWIND_MAX_SKIPPED_FRAMES 32
+
+// Primary unwinder choice (keep in sync with NativeCrashHandler.Unwinder)
+#define UNWINDER_UNWIND_BACKTRACE 0
+#define UNWINDER_FRAME_POINTER 1
+#define UNWINDER_CFI 2
+
+// A frame-pointer or CFI walk shorter than this falls back to _Unwind_Backtrace
+#define UNWIND_MIN_FRAMES 3
+
+struct ContextUnwindState {
+    uintptr_t* frames;
+    size_t frame_count;
+    size_t max_frames;
+    uintptr_t fault_pc;         // 0: record every frame
+    bool reached_fault;
+    size_t skipped;
+};
+
+static _Unwind_Reason_Code context_unwind_callback(struct _Unwind_Context* context, void* arg) {
+    ContextUnwindState* state = static_cast<ContextUnwindState*>(arg);
+
+    uintptr_t pc = _Unwind_GetIP(context);
+    if (!pc) {
+        return _URC_NO_REASON;
+    }
+
+    if (!state->reached_fault) {
+        if (unwind_normalize_pc(pc) != unwind_normalize_pc(state->fault_pc)) {
+            // Handler or trampoline frame
+            if (++state->skipped >= UNWIND_MAX_SKIPPED_FRAMES) {
+                return _URC_END_OF_STACK;
+            }
+            return _URC_NO_REASON;
+        }
+        state->reached_fault = true;
+    }
+
+    if (state->frame_count >= state->max_frames) {
+        return _URC_END_OF_STACK;
+    }
+    state->frames[state->frame_count++] = pc;
+    return _URC_NO_REASON;
+}
+
+// Whether fp can hold a frame record: aligned, at or above lowest and inside the stack
+static inline bool unwind_frame_record_valid(uintptr_t fp, uintptr_t lowest, const StackBounds* bounds) {
+    const uintptr_t record_size = 2 * sizeof(uintptr_t);
+    return fp >= lowest && fp <= bounds->hi - record_size && (fp & (sizeof(uintptr_t) - 1)) == 0;
+}
+
+// Walk {previous fp, return address} frame records starting at the faulting
+// context. Every record must be aligned, inside the stack and strictly above
+// the previous one, so corruption or a frame without a record ends the walk.
+static inline size_t unwind_frame_pointers(const UnwindRegisters* regs, const StackBounds* bounds,
+                                           uintptr_t* frames, size_t max_frames) {
+    size_t count = 0;
+    if (max_frames == 0) {
+        return 0;
+    }
+    frames[count++] = regs->pc;
+
+    uintptr_t fp = regs->fp;
+    uintptr_t lowest = regs->sp;
+    const uintptr_t record_size = 2 * sizeof(uintptr_t);
+
+#if defined(__aarch64__) || defined(__arm__)
+    // A leaf function, or one stopped in its prologue, has not stored lr in a
+    // record yet: its caller is only in lr and the first record already holds
+    // the caller's caller. (On x86 the call itself pushes the return address.)
+    uintptr_t lr = unwind_strip_pac(regs->lr);
+    if (lr && unwind_normalize_pc(lr) != unwind_normalize_pc(regs->pc) && count < max_frames) {
+        if (!unwind_frame_record_valid(fp, lowest, bounds) ||
+            unwind_normalize_pc(unwind_strip_pac(((const uintptr_t*)fp)[1])) != unwind_normalize_pc(lr)) {
+            frames[count++] = lr;
+        }
+    }
+#endif
+
+    while (count < max_frames) {
+        if (!unwind_frame_record_valid(fp, lowest, bounds)) {
+            break;
+        }
+
+        const uintptr_t* record = (const uintptr_t*)fp;
+        uintptr_t next_fp = record[0];
+        uintptr_t return_address = unwind_strip_pac(record[1]);
+        if (return_address == 0) {
+            break;
+        }
+
+        frames[count++] = return_address;
+        if (next_fp <= fp) {
+            // Outermost frame (fp == 0) or a loop
+            break;
+        }
+        lowest = fp + record_size;
+        fp = next_fp;
+    }
+
+    return count;
+}
+
+// The frames derivable from the registers alone: pc, then lr
+static inline size_t unwind_registers_only(const UnwindRegisters* regs, uintptr_t* frames, size_t max_frames) {
+    size_t count = 0;
+    if (max_frames > count) {
+        frames[count++] = regs->pc;
+    }
+    if (regs->lr && unwind_normalize_pc(regs->lr) != unwind_normalize_pc(regs->pc) && max_frames > count) {
+        frames[count++] = regs->lr;
+    }
+    return count;
+}
+
+// Capture the crashing thread's stack starting at the faulting instruction
+static inline size_t capture_stack_from_context(const void* context, const ModuleMap* modules, uintptr_t* frames,
+                                                size_t max_frames, UnwindMethod* method) {
+    UnwindRegisters regs;
+    bool has_regs = crash_context_registers(context, &regs);
+
+    ContextUnwindState state;
+    state.frames = frames;
+    state.frame_count = 0;
+    state.max_frames = max_frames;
+    state.fault_pc = has_regs ? regs.pc : 0;
+    state.reached_fault = !has_regs;
+    state.skipped = 0;
+
+    _Unwind_Backtrace(context_unwind_callback, &state);
+
+    if (!has_regs) {
+        *method = state.frame_count ? UNWIND_METHOD_HANDLER : UNWIND_METHOD_NONE;
+        return state.frame_count;
+    }
+    if (state.reached_fault) {
+        *method = UNWIND_METHOD_CONTEXT;
+        return state.frame_count;
+    }
+
+    // The fault pc was never matched, so everything walked was handler or
+    // trampoline frames: unwind from the context without the system unwinder
+    StackBounds bounds;
+    if (crash_thread_stack_bounds(regs.sp, &bounds)) {
+        size_t walked = unwind_cfi(context, &bounds, modules, frames, max_frames);
+        if (walked >= UNWIND_MIN_FRAMES || walked == max_frames) {
+            *method = UNWIND_METHOD_CFI;
+            return walked;
+        }
+        walked = unwind_frame_pointers(&regs, &bounds, frames, max_frames);
+        if (walked >= UNWIND_MIN_FRAMES || walked == max_frames) {
+            *method = UNWIND_METHOD_FRAME_POINTER;
+            return walked;
+        }
+    }
+
+    *method = UNWIND_METHOD_REGISTERS_ONLY;
+    return unwind_registers_only(&regs, frames, max_frames);
+}
+
+static inline _Unwind_Reason_Code unwind_warm_up_callback(struct _Unwind_Context* /* ctx */, void* /* arg */) {
+    return _URC_END_OF_STACK;
+}
+
+// Prepare the unwinders' lookup tables (call from initialize(), not the handler).
+// The first _Unwind_Backtrace runs the unwinder's one-time setup (a futex on
+// glibc's libgcc), which the crash path should neither pay for nor block on.
+static inline void stack_unwinder_init() {
+    stack_bounds_cache_main_thread();
+    safe_memory_init();
+    module_map_build();
+    _Unwind_Backtrace(unwind_warm_up_callback, nullptr);
+}
+
+// Capture the crashing thread's stack with the selected primary unwinder.
+// modules is the map the whole capture uses (module_map_begin_crash(), taken once).
+static inline size_t capture_stack(const void* context, int unwinder, const ModuleMap* modules, uintptr_t* frames,
+                                   size_t max_frames, UnwindMethod* method) {
+    if (unwinder == UNWINDER_FRAME_POINTER || unwinder == UNWINDER_CFI) {
+        UnwindRegisters regs;
+        StackBounds bounds;
+        if (crash_context_registers(context, &regs) && crash_thread_stack_bounds(regs.sp, &bounds)) {
+            size_t count = unwinder == UNWINDER_CFI ? unwind_cfi(context, &bounds, modules, frames, max_frames)
+                                                    : unwind_frame_pointers(&regs, &bounds, frames, max_frames);
+            if (count >= UNWIND_MIN_FRAMES || count == max_frames) {
+                *method = unwinder == UNWINDER_CFI ? UNWIND_METHOD_CFI : UNWIND_METHOD_FRAME_POINTER;
+                return count;
+            }
+        }
+    }
+
+    return capture_stack_from_context(context, modules, frames, max_frames, method);
+}
+
+#endif // CRASHREPORTER_STACK_UNWINDER_H
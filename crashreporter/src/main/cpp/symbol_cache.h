@@ -0,0 +1,145 @@
+/**
+ * Persistent symbol index cache, keyed by build-id
+ *
+ * Symbolizing the previous session's crash on launch must not re-read and
+ * re-sort a library's symbol table every time. The first symbolization of
+ * a library writes its symbol index (symbol_index.h) to
+ * <cache dir>/<build-id>.sidx; later launches only mmap that file, check
+ * its header and build-id, and search it in place. Pages are faulted in
+ * lazily, by the lookups that touch them.
+ *
+ * System libraries are cached too: their index includes the decompressed
+ * .gnu_debugdata symbols, the most expensive part to rebuild. The build-id
+ * key keeps entries valid across OS updates, which simply produce new
+ * build-ids. Not async-signal-safe.
+ */
+
+#ifndef CRASHREPORTER_SYMBOL_CACHE_H
+#define CRASHREPORTER_SYMBOL_CACHE_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "elf_build_id.h"
+#include "elf_symbolizer.h"
+#include "symbol_index.h"
+
+// Cached indexes kept (app and system libraries); the least recently written ones go first
+#define SYMBOL_CACHE_MAX_ENTRIES 64
+
+#define SYMBOL_CACHE_SUFFIX ".sidx"
+
+static inline std::string symbol_cache_path(const char* cache_dir, const char* build_id_hex) {
+    return std::string(cache_dir) + "/" + build_id_hex + SYMBOL_CACHE_SUFFIX;
+}
+
+// Remove the oldest entries beyond SYMBOL_CACHE_MAX_ENTRIES
+static inline void symbol_cache_prune(const char* cache_dir) {
+    DIR* dir = opendir(cache_dir);
+    if (!dir) {
+        return;
+    }
+    std::vector<std::pair<time_t, std::string>> entries;
+    size_t suffix_length = strlen(SYMBOL_CACHE_SUFFIX);
+    while (struct dirent* entry = readdir(dir)) {
+        size_t length = strlen(entry->d_name);
+        if (length <= suffix_length || strcmp(entry->d_name + length - suffix_length, SYMBOL_CACHE_SUFFIX) != 0) {
+            continue;
+        }
+        std::string path = std::string(cache_dir) + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            entries.emplace_back(st.st_mtime, path);
+        }
+    }
+    closedir(dir);
+
+    if (entries.size() <= SYMBOL_CACHE_MAX_ENTRIES) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t i = 0; i < entries.size() - SYMBOL_CACHE_MAX_ENTRIES; i++) {
+        unlink(entries[i].second.c_str());
+    }
+}
+
+// Write an index image under its build-id; readers never see a partial file
+static inline bool symbol_cache_store(const char* cache_dir, const char* build_id_hex, const std::string& image) {
+    std::string path = symbol_cache_path(cache_dir, build_id_hex);
+    std::string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    const char* data = image.data();
+    size_t remaining = image.size();
+    while (remaining > 0) {
+        ssize_t written = write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        remaining -= (size_t)written;
+    }
+    bool ok = remaining == 0 && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    symbol_cache_prune(cache_dir);
+    return true;
+}
+
+// Symbol index for the module at path whose build-id must be build_id_hex
+// (empty: unknown, nothing is cached). Maps the cached index when there is
+// one; otherwise builds it from the ELF file into *image and caches it.
+// False if the file is unreadable or is not the build that crashed.
+static inline bool symbol_cache_load(const char* cache_dir, const char* module_path, const char* build_id_hex,
+                                     SymbolIndex* index, std::string* image) {
+    ElfBuildId expected;
+    bool has_build_id = build_id_hex[0] != '\0';
+    if (has_build_id && !elf_build_id_from_hex(build_id_hex, &expected)) {
+        return false;
+    }
+    bool cacheable = has_build_id && cache_dir[0] != '\0';
+
+    if (cacheable && symbol_index_map_file(symbol_cache_path(cache_dir, build_id_hex).c_str(), index)) {
+        if (elf_build_id_equal(&index->header->build_id, &expected)) {
+            return true;
+        }
+        symbol_index_unmap(index);
+    }
+
+    ElfSymbolTable table;
+    if (!elf_symbols_load(module_path, &table)) {
+        return false;
+    }
+    // The library may have been replaced by an app update since the crash
+    if (has_build_id && !elf_build_id_equal(&expected, &table.build_id)) {
+        return false;
+    }
+    symbol_index_build(&table, image);
+    if (!symbol_index_open(image->data(), image->size(), index)) {
+        return false;
+    }
+    if (cacheable) {
+        symbol_cache_store(cache_dir, build_id_hex, *image);
+    }
+    return true;
+}
+
+#endif // CRASHREPORTER_SYMBOL_CACHE_H
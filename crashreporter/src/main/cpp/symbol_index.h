@@ -0,0 +1,210 @@
+/**
+ * Memory-mappable symbol index
+ *
+ * A flat image built once from an ElfSymbolTable and searched in place:
+ *
+ *   SymbolIndexHeader
+ *   uint64_t keys[count + 1]              start addresses, Eytzinger order (slot 0 unused)
+ *   SymbolIndexEntry entries[count + 1]   size and name of the symbol in the same slot
+ *   char names[]                          NUL-terminated, referenced by name_offset
+ *
+ * The Eytzinger layout stores the implicit binary search tree breadth-first,
+ * so the first levels of every search share a few cache lines and the
+ * next levels can be prefetched; a lookup in a table of several hundred
+ * thousand symbols costs a handful of cache misses instead of a binary
+ * search over .symtab-sized arrays. Opening an index only validates the
+ * header: the image can be mmap'ed and used without parsing.
+ *
+ * Not async-signal-safe: for next-launch and offline symbolization only.
+ */
+
+#ifndef CRASHREPORTER_SYMBOL_INDEX_H
+#define CRASHREPORTER_SYMBOL_INDEX_H
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "elf_build_id.h"
+#include "elf_symbolizer.h"
+
+#define SYMBOL_INDEX_MAGIC 0x58444953u     // "SIDX"
+#define SYMBOL_INDEX_VERSION 1
+
+struct SymbolIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;             // Symbols; keys and entries hold count + 1 slots
+    uint64_t keys_offset;       // From the start of the image, 8-byte aligned
+    uint64_t entries_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    ElfBuildId build_id;        // Of the ELF file the index was built from
+};
+
+struct SymbolIndexEntry {
+    uint32_t size;
+    uint32_t name_offset;       // Into the names pool
+};
+
+struct SymbolIndex {
+    const SymbolIndexHeader* header;
+    const uint64_t* keys;
+    const SymbolIndexEntry* entries;
+    const char* names;
+    void* mapping;              // Set when the image was mapped from a file
+    size_t mapping_size;
+};
+
+static inline size_t symbol_index_align(size_t offset) {
+    return (offset + 7) & ~(size_t)7;
+}
+
+// Place sorted[] into keys/entries in Eytzinger order (in-order walk of the implicit tree)
+static size_t symbol_index_fill(const std::vector<const ElfSymbol*>& sorted, size_t next, size_t slot, uint64_t* keys,
+                                SymbolIndexEntry* entries, const std::vector<uint32_t>& name_offsets) {
+    if (slot >= sorted.size() + 1) {
+        return next;
+    }
+    next = symbol_index_fill(sorted, next, 2 * slot, keys, entries, name_offsets);
+    keys[slot] = sorted[next]->address;
+    entries[slot].size = (uint32_t)std::min<uint64_t>(sorted[next]->size, UINT32_MAX);
+    entries[slot].name_offset = name_offsets[next];
+    next++;
+    return symbol_index_fill(sorted, next, 2 * slot + 1, keys, entries, name_offsets);
+}
+
+// Serialize table into an index image. Of symbols sharing an address
+// (aliases) only the largest is kept; names are copied into a compact pool.
+static inline void symbol_index_build(const ElfSymbolTable* table, std::string* image) {
+    std::vector<const ElfSymbol*> sorted;
+    for (const ElfSymbol& symbol : table->symbols) {
+        if (!sorted.empty() && sorted.back()->address == symbol.address) {
+            if (symbol.size > sorted.back()->size) {
+                sorted.back() = &symbol;
+            }
+            continue;
+        }
+        sorted.push_back(&symbol);
+    }
+
+    std::string names;
+    std::vector<uint32_t> name_offsets;
+    name_offsets.reserve(sorted.size());
+    for (const ElfSymbol* symbol : sorted) {
+        name_offsets.push_back((uint32_t)names.size());
+        names += elf_symbol_name(table, symbol);
+        names += '\0';
+    }
+
+    size_t slots = sorted.size() + 1;
+    SymbolIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SYMBOL_INDEX_MAGIC;
+    header.version = SYMBOL_INDEX_VERSION;
+    header.count = sorted.size();
+    header.keys_offset = symbol_index_align(sizeof(header));
+    header.entries_offset = symbol_index_align(header.keys_offset + slots * sizeof(uint64_t));
+    header.names_offset = symbol_index_align(header.entries_offset + slots * sizeof(SymbolIndexEntry));
+    header.names_size = names.size();
+    header.build_id = table->build_id;
+
+    image->assign(header.names_offset + names.size(), '\0');
+    char* base = &(*image)[0];
+    memcpy(base, &header, sizeof(header));
+    symbol_index_fill(sorted, 0, 1, (uint64_t*)(base + header.keys_offset),
+                      (SymbolIndexEntry*)(base + header.entries_offset), name_offsets);
+    memcpy(base + header.names_offset, names.data(), names.size());
+}
+
+// Validate an index image in memory (8-byte aligned); no parsing, O(1)
+static inline bool symbol_index_open(const void* data, size_t size, SymbolIndex* index) {
+    const SymbolIndexHeader* header = (const SymbolIndexHeader*)data;
+    if (size < sizeof(*header) || header->magic != SYMBOL_INDEX_MAGIC || header->version != SYMBOL_INDEX_VERSION) {
+        return false;
+    }
+    uint64_t slots = header->count + 1;
+    if (header->count > size / sizeof(uint64_t) || header->keys_offset % 8 != 0 || header->entries_offset % 8 != 0 ||
+        header->keys_offset < sizeof(*header) || header->keys_offset + slots * sizeof(uint64_t) > header->entries_offset ||
+        header->entries_offset + slots * sizeof(SymbolIndexEntry) > header->names_offset ||
+        header->names_offset > size || header->names_size > size - header->names_offset) {
+        return false;
+    }
+    if (header->names_size > 0 && ((const char*)data)[header->names_offset + header->names_size - 1] != '\0') {
+        return false;
+    }
+    index->header = header;
+    index->keys = (const uint64_t*)((const char*)data + header->keys_offset);
+    index->entries = (const SymbolIndexEntry*)((const char*)data + header->entries_offset);
+    index->names = (const char*)data + header->names_offset;
+    index->mapping = nullptr;
+    return true;
+}
+
+// Symbol containing address, or null; *start receives its start address.
+// Descends the Eytzinger tree; the predecessor of address is the node of
+// the last right turn, encoded by the lowest set bit of the final slot.
+static inline const SymbolIndexEntry* symbol_index_lookup(const SymbolIndex* index, uint64_t address,
+                                                          uint64_t* start) {
+    uint64_t count = index->header->count;
+    size_t slot = 1;
+    while (slot <= count) {
+        __builtin_prefetch(index->keys + slot * 8);
+        slot = 2 * slot + (index->keys[slot] <= address);
+    }
+    slot >>= __builtin_ctzll(slot) + 1;
+    if (slot == 0) {
+        return nullptr;
+    }
+    const SymbolIndexEntry* entry = &index->entries[slot];
+    if (address - index->keys[slot] >= entry->size) {
+        return nullptr;
+    }
+    *start = index->keys[slot];
+    return entry;
+}
+
+static inline const char* symbol_index_name(const SymbolIndex* index, const SymbolIndexEntry* entry) {
+    return entry->name_offset < index->header->names_size ? index->names + entry->name_offset : "";
+}
+
+// Map an index file read-only and validate it
+static inline bool symbol_index_map_file(const char* path, SymbolIndex* index) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    if (!symbol_index_open(mapping, (size_t)st.st_size, index)) {
+        munmap(mapping, (size_t)st.st_size);
+        return false;
+    }
+    index->mapping = mapping;
+    index->mapping_size = (size_t)st.st_size;
+    return true;
+}
+
+static inline void symbol_index_unmap(SymbolIndex* index) {
+    if (index->mapping) {
+        munmap(index->mapping, index->mapping_size);
+        index->mapping = nullptr;
+    }
+}
+
+#endif // CRASHREPORTER_SYMBOL_INDEX_H
@@ -0,0 +1,31 @@
+/**
+ * How a recorded stack trace was obtained
+ *
+ * Stored in crash records (crash_record_format.h), so it is shared by the
+ * handler's unwinders and the record decoder.
+ */
+
+#ifndef CRASHREPORTER_UNWIND_METHOD_H
+#define CRASHREPORTER_UNWIND_METHOD_H
+
+enum UnwindMethod {
+    UNWIND_METHOD_NONE,
+    UNWIND_METHOD_CONTEXT,          // Unwound from the faulting instruction
+    UNWIND_METHOD_REGISTERS_ONLY,   // No walk from the context succeeded; pc/lr from the context only
+    UNWIND_METHOD_HANDLER,          // Raw trace from inside the handler (no context)
+    UNWIND_METHOD_FRAME_POINTER,    // Frame-pointer walk from the faulting context
+    UNWIND_METHOD_CFI               // In-house DWARF CFI walk from the faulting context
+};
+
+static inline const char* unwind_method_name(UnwindMethod method) {
+    switch (method) {
+        case UNWIND_METHOD_CONTEXT:        return "context";
+        case UNWIND_METHOD_REGISTERS_ONLY: return "registers-only";
+        case UNWIND_METHOD_HANDLER:        return "handler";
+        case UNWIND_METHOD_FRAME_POINTER:  return "frame-pointer";
+        case UNWIND_METHOD_CFI:            return "cfi";
+        default:                           return "none";
+    }
+}
+
+#endif // CRASHREPORTER_UNWIND_METHOD_H
@@ -0,0 +1,784 @@
+/**
+ * Streaming xz / LZMA2 decoder
+ *
+ * Android system libraries (libc, libart, libhwui, ...) ship with a sparse
+ * .dynsym; their full function table is in .gnu_debugdata ("MiniDebugInfo"),
+ * a small ELF file compressed with xz. This decodes such streams without
+ * liblzma, which the NDK does not provide.
+ *
+ * The compressed input is read in XZ_INPUT_CHUNK_SIZE pieces straight from
+ * the file (or used in place when it is in memory). The output goes into a
+ * single buffer sized up front from the stream index, and that buffer is
+ * also the LZMA dictionary: every byte is written once and never copied.
+ *
+ * Supports the LZMA2 filter, which is what xz and the Android build use,
+ * with CRC32 and CRC64 checks verified. SHA-256 checks are skipped, and
+ * BCJ and delta filters are rejected. Not async-signal-safe.
+ */
+
+#ifndef CRASHREPORTER_XZ_DECODER_H
+#define CRASHREPORTER_XZ_DECODER_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "crc32.h"
+
+// Compressed bytes read from the file at a time; holds the largest LZMA2 chunk
+#define XZ_INPUT_CHUNK_SIZE (64 * 1024)
+
+// Upper bound on the decoded size we are willing to allocate
+#define XZ_MAX_OUTPUT_SIZE (64u * 1024 * 1024)
+
+// Upper bound on a stream index (one record per block)
+#define XZ_MAX_INDEX_SIZE (1024 * 1024)
+
+#define XZ_HEADER_MAGIC "\xfd" "7zXZ"     // Followed by a NUL: 6 bytes
+#define XZ_FOOTER_MAGIC "YZ"
+#define XZ_STREAM_HEADER_SIZE 12
+
+#define XZ_CHECK_NONE 0x00
+#define XZ_CHECK_CRC32 0x01
+#define XZ_CHECK_CRC64 0x04
+
+#define XZ_FILTER_LZMA2 0x21
+
+// LZMA model (see the LZMA SDK's LzmaSpec)
+#define LZMA_STATES 12
+#define LZMA_LITERAL_STATES 7           // States below this follow a literal
+#define LZMA_POS_STATES_MAX 16          // 1 << pb, pb <= 4
+#define LZMA_LITERAL_CODER_SIZE 0x300
+#define LZMA_LITERAL_CODERS_MAX 16      // 1 << (lc + lp), lc + lp <= 4 in LZMA2
+#define LZMA_LEN_LOW_BITS 3
+#define LZMA_LEN_MID_BITS 3
+#define LZMA_LEN_HIGH_BITS 8
+#define LZMA_DIST_STATES 4
+#define LZMA_DIST_SLOT_BITS 6
+#define LZMA_DIST_MODEL_END 14
+#define LZMA_FULL_DISTANCES 128
+#define LZMA_ALIGN_BITS 4
+#define LZMA_MATCH_MIN_LEN 2
+
+#define LZMA_PROB_BITS 11
+#define LZMA_PROB_INIT (1 << (LZMA_PROB_BITS - 1))
+#define LZMA_MOVE_BITS 5
+#define LZMA_RANGE_TOP (1u << 24)
+
+// Slicing-by-8 tables: entries[k][b] is the CRC of byte b followed by k zero bytes
+struct Crc64Table {
+    uint64_t entries[8][256];
+
+    constexpr Crc64Table() : entries() {
+        for (uint64_t i = 0; i < 256; i++) {
+            uint64_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xC96C5795D7870F42ULL ^ (c >> 1)) : (c >> 1);
+            }
+            entries[0][i] = c;
+        }
+        for (int k = 1; k < 8; k++) {
+            for (int i = 0; i < 256; i++) {
+                uint64_t c = entries[k - 1][i];
+                entries[k][i] = entries[0][c & 0xff] ^ (c >> 8);
+            }
+        }
+    }
+};
+
+static constexpr Crc64Table kCrc64Table;
+
+// CRC-64/XZ (ECMA-182, reflected); continue a running CRC, 0 to start.
+// Verifies every decoded byte, so it takes eight bytes per step.
+static inline uint64_t crc64_update(uint64_t crc, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for (; len >= 8; len -= 8, p += 8) {
+        uint64_t word = crc ^ ((uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) |
+                               ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+                               ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56));
+        crc = kCrc64Table.entries[7][word & 0xff] ^ kCrc64Table.entries[6][(word >> 8) & 0xff] ^
+              kCrc64Table.entries[5][(word >> 16) & 0xff] ^ kCrc64Table.entries[4][(word >> 24) & 0xff] ^
+              kCrc64Table.entries[3][(word >> 32) & 0xff] ^ kCrc64Table.entries[2][(word >> 40) & 0xff] ^
+              kCrc64Table.entries[1][(word >> 48) & 0xff] ^ kCrc64Table.entries[0][word >> 56];
+    }
+    for (; len > 0; len--, p++) {
+        crc = kCrc64Table.entries[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Where the compressed stream is: a range of a file, or memory
+struct XzSource {
+    int fd;                     // -1: the stream is at data
+    const uint8_t* data;
+    uint64_t offset;            // Of the stream in the file
+    uint64_t size;
+};
+
+struct XzInput {
+    XzSource source;
+    uint64_t next;              // Stream offset of the first byte not yet buffered
+    const uint8_t* pos;
+    const uint8_t* end;
+    bool ok;                    // Cleared by a read error or a read past the stream
+    uint8_t buffer[XZ_INPUT_CHUNK_SIZE];
+};
+
+struct LzmaLenDecoder {
+    uint16_t choice;
+    uint16_t choice2;
+    uint16_t low[LZMA_POS_STATES_MAX][1 << LZMA_LEN_LOW_BITS];
+    uint16_t mid[LZMA_POS_STATES_MAX][1 << LZMA_LEN_MID_BITS];
+    uint16_t high[1 << LZMA_LEN_HIGH_BITS];
+};
+
+// Every adaptive probability; reset as one array
+struct LzmaProbabilities {
+    uint16_t is_match[LZMA_STATES][LZMA_POS_STATES_MAX];
+    uint16_t is_rep[LZMA_STATES];
+    uint16_t is_rep0[LZMA_STATES];
+    uint16_t is_rep1[LZMA_STATES];
+    uint16_t is_rep2[LZMA_STATES];
+    uint16_t is_rep0_long[LZMA_STATES][LZMA_POS_STATES_MAX];
+    uint16_t dist_slot[LZMA_DIST_STATES][1 << LZMA_DIST_SLOT_BITS];
+    uint16_t dist_special[LZMA_FULL_DISTANCES - LZMA_DIST_MODEL_END];
+    uint16_t dist_align[1 << LZMA_ALIGN_BITS];
+    LzmaLenDecoder match_len;
+    LzmaLenDecoder rep_len;
+    uint16_t literal[LZMA_LITERAL_CODERS_MAX][LZMA_LITERAL_CODER_SIZE];
+};
+
+struct XzDecoder {
+    XzInput input;
+
+    // LZMA state, kept across chunks that do not reset it
+    uint32_t lc;
+    uint32_t lp;
+    uint32_t pb;
+    uint32_t state;
+    uint32_t reps[4];
+    LzmaProbabilities probs;
+
+    // Output, which is the dictionary too
+    uint8_t* out;
+    size_t out_size;
+    size_t pos;
+    size_t dict_start;          // Matches cannot reach before the last dictionary reset
+};
+
+// Range decoder over one chunk, which is contiguous in the input buffer. It
+// lives on the stack so its fields stay in registers: stores to the output
+// (uint8_t) may alias anything reachable through a pointer.
+struct LzmaRangeDecoder {
+    uint32_t range;
+    uint32_t code;
+    const uint8_t* pos;         // May run past end on corrupt input; nothing is read there
+    const uint8_t* end;
+};
+
+static inline uint64_t xz_input_offset(const XzInput* input) {
+    return input->next - (uint64_t)(input->end - input->pos);
+}
+
+// Continue reading at a stream offset
+static inline void xz_input_seek(XzInput* input, uint64_t offset) {
+    input->ok = offset <= input->source.size;
+    input->next = offset;
+    input->pos = input->end = input->buffer;
+    if (input->ok && input->source.fd < 0) {
+        // In memory: no buffering
+        input->pos = input->source.data + offset;
+        input->end = input->source.data + input->source.size;
+        input->next = input->source.size;
+    }
+}
+
+static inline bool xz_input_refill(XzInput* input) {
+    if (!input->ok || input->source.fd < 0 || input->next >= input->source.size) {
+        input->ok = false;
+        return false;
+    }
+    size_t len = (size_t)std::min<uint64_t>(XZ_INPUT_CHUNK_SIZE, input->source.size - input->next);
+    ssize_t n;
+    do {
+        n = pread(input->source.fd, input->buffer, len, (off_t)(input->source.offset + input->next));
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        input->ok = false;
+        return false;
+    }
+    input->pos = input->buffer;
+    input->end = input->buffer + n;
+    input->next += (uint64_t)n;
+    return true;
+}
+
+// Make the next len (<= XZ_INPUT_CHUNK_SIZE) bytes contiguous at input->pos
+static inline bool xz_input_fill(XzInput* input, size_t len) {
+    size_t buffered = (size_t)(input->end - input->pos);
+    if (buffered >= len) {
+        return true;
+    }
+    if (!input->ok || input->source.fd < 0 || len - buffered > input->source.size - input->next) {
+        input->ok = false;
+        return false;
+    }
+    memmove(input->buffer, input->pos, buffered);
+    input->pos = input->buffer;
+    input->end = input->buffer + buffered;
+    size_t want = (size_t)std::min<uint64_t>(XZ_INPUT_CHUNK_SIZE - buffered, input->source.size - input->next);
+    uint8_t* dest = input->buffer + buffered;
+    while (want > 0) {
+        ssize_t n = pread(input->source.fd, dest, want, (off_t)(input->source.offset + input->next));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            input->ok = false;
+            return false;
+        }
+        dest += n;
+        want -= (size_t)n;
+        input->end += n;
+        input->next += (uint64_t)n;
+    }
+    return true;
+}
+
+static inline uint8_t xz_input_byte(XzInput* input) {
+    if (input->pos == input->end && !xz_input_refill(input)) {
+        return 0;
+    }
+    return *input->pos++;
+}
+
+static inline bool xz_input_read(XzInput* input, void* out, size_t len) {
+    uint8_t* dest = (uint8_t*)out;
+    while (len > 0) {
+        if (input->pos == input->end && !xz_input_refill(input)) {
+            return false;
+        }
+        size_t n = std::min(len, (size_t)(input->end - input->pos));
+        memcpy(dest, input->pos, n);
+        input->pos += n;
+        dest += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Read len bytes at a stream offset, for the index and footer
+static inline bool xz_source_read(const XzSource* source, uint64_t offset, void* out, size_t len) {
+    if (offset > source->size || len > source->size - offset) {
+        return false;
+    }
+    if (source->fd < 0) {
+        memcpy(out, source->data + offset, len);
+        return true;
+    }
+    uint8_t* dest = (uint8_t*)out;
+    while (len > 0) {
+        ssize_t n = pread(source->fd, dest, len, (off_t)(source->offset + offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        dest += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+static inline uint32_t xz_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Multibyte integer: 7 bits per byte, least significant first, at most 9 bytes
+static inline bool xz_read_varint(const uint8_t** pos, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (int i = 0; i < 9 && *pos < end; i++) {
+        uint8_t byte = *(*pos)++;
+        *value |= (uint64_t)(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            return byte != 0 || i == 0;
+        }
+    }
+    return false;
+}
+
+static inline size_t xz_check_size(uint8_t check) {
+    static const uint8_t kSizes[16] = { 0, 4, 4, 4, 8, 8, 8, 16, 16, 16, 32, 32, 32, 64, 64, 64 };
+    return kSizes[check & 0x0f];
+}
+
+// ---- Range decoder and LZMA ----
+
+static inline uint8_t lzma_rc_byte(LzmaRangeDecoder* rc) {
+    uint8_t byte = rc->pos < rc->end ? *rc->pos : 0;
+    rc->pos++;
+    return byte;
+}
+
+static inline void lzma_normalize(LzmaRangeDecoder* rc) {
+    if (rc->range < LZMA_RANGE_TOP) {
+        rc->range <<= 8;
+        rc->code = (rc->code << 8) | lzma_rc_byte(rc);
+    }
+}
+
+static inline uint32_t lzma_bit(LzmaRangeDecoder* rc, uint16_t* prob) {
+    uint32_t bound = (rc->range >> LZMA_PROB_BITS) * *prob;
+    uint32_t bit;
+    if (rc->code < bound) {
+        rc->range = bound;
+        *prob += ((1 << LZMA_PROB_BITS) - *prob) >> LZMA_MOVE_BITS;
+        bit = 0;
+    } else {
+        rc->range -= bound;
+        rc->code -= bound;
+        *prob -= *prob >> LZMA_MOVE_BITS;
+        bit = 1;
+    }
+    lzma_normalize(rc);
+    return bit;
+}
+
+static inline uint32_t lzma_bit_tree(LzmaRangeDecoder* rc, uint16_t* probs, int bits) {
+    uint32_t symbol = 1;
+    for (int i = 0; i < bits; i++) {
+        symbol = (symbol << 1) | lzma_bit(rc, &probs[symbol]);
+    }
+    return symbol - (1u << bits);
+}
+
+static inline uint32_t lzma_bit_tree_reverse(LzmaRangeDecoder* rc, uint16_t* probs, int bits) {
+    uint32_t symbol = 1;
+    uint32_t result = 0;
+    for (int i = 0; i < bits; i++) {
+        uint32_t bit = lzma_bit(rc, &probs[symbol]);
+        symbol = (symbol << 1) | bit;
+        result |= bit << i;
+    }
+    return result;
+}
+
+static inline uint32_t lzma_direct_bits(LzmaRangeDecoder* rc, int bits) {
+    uint32_t result = 0;
+    for (int i = 0; i < bits; i++) {
+        rc->range >>= 1;
+        uint32_t bit = rc->code >= rc->range ? 1 : 0;
+        rc->code -= rc->range & (0u - bit);
+        result = (result << 1) | bit;
+        lzma_normalize(rc);
+    }
+    return result;
+}
+
+static inline uint32_t lzma_len(LzmaRangeDecoder* rc, LzmaLenDecoder* len, uint32_t pos_state) {
+    if (!lzma_bit(rc, &len->choice)) {
+        return lzma_bit_tree(rc, len->low[pos_state], LZMA_LEN_LOW_BITS);
+    }
+    if (!lzma_bit(rc, &len->choice2)) {
+        return (1 << LZMA_LEN_LOW_BITS) + lzma_bit_tree(rc, len->mid[pos_state], LZMA_LEN_MID_BITS);
+    }
+    return (1 << LZMA_LEN_LOW_BITS) + (1 << LZMA_LEN_MID_BITS) + lzma_bit_tree(rc, len->high, LZMA_LEN_HIGH_BITS);
+}
+
+static inline uint32_t lzma_distance(LzmaRangeDecoder* rc, LzmaProbabilities* probs, uint32_t len) {
+    uint32_t dist_state = std::min<uint32_t>(len, LZMA_DIST_STATES - 1);
+    uint32_t slot = lzma_bit_tree(rc, probs->dist_slot[dist_state], LZMA_DIST_SLOT_BITS);
+    if (slot < 4) {
+        return slot;
+    }
+    int direct_bits = (int)(slot >> 1) - 1;
+    uint32_t dist = (2 | (slot & 1)) << direct_bits;
+    if (slot < LZMA_DIST_MODEL_END) {
+        return dist + lzma_bit_tree_reverse(rc, probs->dist_special + dist - slot, direct_bits);
+    }
+    dist += lzma_direct_bits(rc, direct_bits - LZMA_ALIGN_BITS) << LZMA_ALIGN_BITS;
+    return dist + lzma_bit_tree_reverse(rc, probs->dist_align, LZMA_ALIGN_BITS);
+}
+
+static inline void lzma_reset_state(XzDecoder* decoder) {
+    uint16_t* probs = (uint16_t*)&decoder->probs;
+    for (size_t i = 0; i < sizeof(decoder->probs) / sizeof(uint16_t); i++) {
+        probs[i] = LZMA_PROB_INIT;
+    }
+    decoder->state = 0;
+    memset(decoder->reps, 0, sizeof(decoder->reps));
+}
+
+// Decode one LZMA chunk of unpacked bytes from packed input bytes
+static bool lzma_decode_chunk(XzDecoder* decoder, size_t unpacked, uint32_t packed) {
+    XzInput* input = &decoder->input;
+    if (packed < 5 || !xz_input_fill(input, packed)) {
+        return false;
+    }
+    LzmaRangeDecoder rc = { 0xffffffff, 0, input->pos, input->pos + packed };
+    if (lzma_rc_byte(&rc) != 0) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        rc.code = (rc.code << 8) | lzma_rc_byte(&rc);
+    }
+
+    uint8_t* out = decoder->out;
+    size_t pos = decoder->pos;
+    size_t limit = pos + unpacked;
+    size_t dict_start = decoder->dict_start;
+    uint32_t lc = decoder->lc;
+    uint32_t pos_mask = (1u << decoder->pb) - 1;
+    uint32_t literal_pos_mask = (1u << decoder->lp) - 1;
+    uint32_t state = decoder->state;
+    uint32_t rep0 = decoder->reps[0];
+    uint32_t rep1 = decoder->reps[1];
+    uint32_t rep2 = decoder->reps[2];
+    uint32_t rep3 = decoder->reps[3];
+    LzmaProbabilities* probs = &decoder->probs;
+    bool ok = true;
+    while (pos < limit) {
+        uint32_t pos_state = (uint32_t)pos & pos_mask;
+        if (!lzma_bit(&rc, &probs->is_match[state][pos_state])) {
+            uint32_t previous = pos > dict_start ? out[pos - 1] : 0;
+            uint16_t* literal = probs->literal[((pos & literal_pos_mask) << lc) + (previous >> (8 - lc))];
+            uint32_t symbol = 1;
+            if (state >= LZMA_LITERAL_STATES) {
+                // After a match the literal is coded against the byte at rep0
+                if (rep0 >= pos - dict_start) {
+                    ok = false;
+                    break;
+                }
+                uint32_t match_byte = out[pos - rep0 - 1];
+                do {
+                    uint32_t match_bit = (match_byte >> 7) & 1;
+                    match_byte <<= 1;
+                    uint32_t bit = lzma_bit(&rc, &literal[((1 + match_bit) << 8) + symbol]);
+                    symbol = (symbol << 1) | bit;
+                    if (match_bit != bit) {
+                        break;
+                    }
+                } while (symbol < 0x100);
+            }
+            while (symbol < 0x100) {
+                symbol = (symbol << 1) | lzma_bit(&rc, &literal[symbol]);
+            }
+            out[pos++] = (uint8_t)symbol;
+            state = state < 4 ? 0 : state < 10 ? state - 3 : state - 6;
+            continue;
+        }
+
+        uint32_t len;
+        if (lzma_bit(&rc, &probs->is_rep[state])) {
+            if (pos == dict_start) {
+                ok = false;
+                break;
+            }
+            if (!lzma_bit(&rc, &probs->is_rep0[state])) {
+                if (!lzma_bit(&rc, &probs->is_rep0_long[state][pos_state])) {
+                    // Short rep: one byte at rep0
+                    if (rep0 >= pos - dict_start) {
+                        ok = false;
+                        break;
+                    }
+                    state = state < LZMA_LITERAL_STATES ? 9 : 11;
+                    out[pos] = out[pos - rep0 - 1];
+                    pos++;
+                    continue;
+                }
+            } else {
+                uint32_t dist;
+                if (!lzma_bit(&rc, &probs->is_rep1[state])) {
+                    dist = rep1;
+                } else {
+                    if (!lzma_bit(&rc, &probs->is_rep2[state])) {
+                        dist = rep2;
+                    } else {
+                        dist = rep3;
+                        rep3 = rep2;
+                    }
+                    rep2 = rep1;
+                }
+                rep1 = rep0;
+                rep0 = dist;
+            }
+            len = lzma_len(&rc, &probs->rep_len, pos_state);
+            state = state < LZMA_LITERAL_STATES ? 8 : 11;
+        } else {
+            rep3 = rep2;
+            rep2 = rep1;
+            rep1 = rep0;
+            len = lzma_len(&rc, &probs->match_len, pos_state);
+            state = state < LZMA_LITERAL_STATES ? 7 : 10;
+            rep0 = lzma_distance(&rc, probs, len);
+        }
+
+        // LZMA2 has no end marker, and a match never crosses a chunk
+        len += LZMA_MATCH_MIN_LEN;
+        if (rep0 >= pos - dict_start || len > limit - pos) {
+            ok = false;
+            break;
+        }
+        const uint8_t* from = out + pos - rep0 - 1;
+        for (uint32_t i = 0; i < len; i++) {
+            out[pos + i] = from[i];     // Overlapping copies repeat the pattern
+        }
+        pos += len;
+    }
+
+    input->pos += packed;
+    decoder->pos = pos;
+    decoder->state = state;
+    decoder->reps[0] = rep0;
+    decoder->reps[1] = rep1;
+    decoder->reps[2] = rep2;
+    decoder->reps[3] = rep3;
+    return ok && rc.code == 0 && rc.pos == rc.end;
+}
+
+// Decode LZMA2 chunks up to the end marker
+static bool lzma2_decode(XzDecoder* decoder) {
+    bool need_dict_reset = true;
+    bool need_props = true;
+    for (;;) {
+        uint8_t control = xz_input_byte(&decoder->input);
+        if (!decoder->input.ok) {
+            return false;
+        }
+        if (control == 0x00) {
+            return true;
+        }
+
+        if (control == 0x01 || control >= 0xe0) {
+            decoder->dict_start = decoder->pos;
+            need_dict_reset = false;
+            need_props = true;
+        } else if (need_dict_reset) {
+            return false;
+        }
+
+        if (control < 0x80) {
+            // Stored chunk
+            if (control > 0x02) {
+                return false;
+            }
+            size_t size = ((size_t)xz_input_byte(&decoder->input) << 8) | xz_input_byte(&decoder->input);
+            size += 1;
+            if (size > decoder->out_size - decoder->pos ||
+                !xz_input_read(&decoder->input, decoder->out + decoder->pos, size)) {
+                return false;
+            }
+            decoder->pos += size;
+            continue;
+        }
+
+        size_t unpacked = ((size_t)(control & 0x1f) << 16) | ((size_t)xz_input_byte(&decoder->input) << 8);
+        unpacked = (unpacked | xz_input_byte(&decoder->input)) + 1;
+        uint32_t packed = ((uint32_t)xz_input_byte(&decoder->input) << 8);
+        packed = (packed | xz_input_byte(&decoder->input)) + 1;
+        if (control >= 0xc0) {
+            uint32_t props = xz_input_byte(&decoder->input);
+            if (props >= 9 * 5 * 5) {
+                return false;
+            }
+            decoder->lc = props % 9;
+            props /= 9;
+            decoder->lp = props % 5;
+            decoder->pb = props / 5;
+            if (decoder->lc + decoder->lp > 4) {
+                return false;
+            }
+            need_props = false;
+            lzma_reset_state(decoder);
+        } else if (need_props) {
+            return false;
+        } else if (control >= 0xa0) {
+            lzma_reset_state(decoder);
+        }
+        if (!decoder->input.ok || unpacked > decoder->out_size - decoder->pos ||
+            !lzma_decode_chunk(decoder, unpacked, packed)) {
+            return false;
+        }
+    }
+}
+
+// ---- Container ----
+
+struct XzStreamInfo {
+    uint64_t start;             // Stream header offset
+    uint64_t index_start;       // End of the blocks
+    uint64_t uncompressed;
+    uint8_t check;
+};
+
+// Walk the streams from the end, through their footers and indexes, to learn the decoded size
+static bool xz_read_streams(const XzSource* source, std::vector<XzStreamInfo>* streams) {
+    uint64_t end = source->size;
+    uint8_t tail[XZ_STREAM_HEADER_SIZE];
+    std::vector<uint8_t> index;
+    while (end > 0) {
+        // Stream padding: NUL bytes in multiples of four
+        while (end >= 4 && xz_source_read(source, end - 4, tail, 4) && xz_le32(tail) == 0) {
+            end -= 4;
+        }
+        if (end < 2 * XZ_STREAM_HEADER_SIZE || !xz_source_read(source, end - XZ_STREAM_HEADER_SIZE, tail, sizeof(tail)) ||
+            memcmp(tail + 10, XZ_FOOTER_MAGIC, 2) != 0 || crc32_update(0, tail + 4, 6) != xz_le32(tail)) {
+            return false;
+        }
+        uint64_t index_size = ((uint64_t)xz_le32(tail + 4) + 1) * 4;
+        if (index_size > XZ_MAX_INDEX_SIZE || index_size > end - 2 * XZ_STREAM_HEADER_SIZE) {
+            return false;
+        }
+        XzStreamInfo stream;
+        stream.check = tail[9] & 0x0f;
+        stream.index_start = end - XZ_STREAM_HEADER_SIZE - index_size;
+        index.resize(index_size);
+        if (!xz_source_read(source, stream.index_start, index.data(), index.size()) || index[0] != 0x00 ||
+            crc32_update(0, index.data(), index.size() - 4) != xz_le32(&index[index.size() - 4])) {
+            return false;
+        }
+        const uint8_t* pos = &index[1];
+        const uint8_t* index_end = &index[index.size() - 4];
+        uint64_t records;
+        uint64_t blocks_size = 0;
+        stream.uncompressed = 0;
+        if (!xz_read_varint(&pos, index_end, &records)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < records; i++) {
+            uint64_t unpadded;
+            uint64_t uncompressed;
+            if (!xz_read_varint(&pos, index_end, &unpadded) || !xz_read_varint(&pos, index_end, &uncompressed) ||
+                unpadded > XZ_MAX_OUTPUT_SIZE * 2ULL || uncompressed > XZ_MAX_OUTPUT_SIZE) {
+                return false;
+            }
+            blocks_size += (unpadded + 3) & ~3ULL;
+            stream.uncompressed += uncompressed;
+        }
+        if (stream.uncompressed > XZ_MAX_OUTPUT_SIZE || blocks_size + XZ_STREAM_HEADER_SIZE > stream.index_start) {
+            return false;
+        }
+        stream.start = stream.index_start - blocks_size - XZ_STREAM_HEADER_SIZE;
+        streams->insert(streams->begin(), stream);
+        end = stream.start;
+    }
+    return !streams->empty();
+}
+
+// Decode one block at the input position; its output is appended at decoder->pos
+static bool xz_decode_block(XzDecoder* decoder, uint8_t check) {
+    XzInput* input = &decoder->input;
+    uint8_t header[1024];
+    header[0] = xz_input_byte(input);
+    size_t header_size = ((size_t)header[0] + 1) * 4;
+    if (header[0] == 0 || !xz_input_read(input, header + 1, header_size - 1) ||
+        crc32_update(0, header, header_size - 4) != xz_le32(header + header_size - 4)) {
+        return false;
+    }
+    uint8_t flags = header[1];
+    if ((flags & 0x3c) != 0 || (flags & 0x03) != 0) {
+        return false;       // Reserved bits, or more than one filter
+    }
+    const uint8_t* pos = header + 2;
+    const uint8_t* end = header + header_size - 4;
+    uint64_t compressed_size = 0;
+    uint64_t uncompressed_size = 0;
+    uint64_t filter;
+    uint64_t props_size;
+    if (((flags & 0x40) && !xz_read_varint(&pos, end, &compressed_size)) ||
+        ((flags & 0x80) && !xz_read_varint(&pos, end, &uncompressed_size)) || !xz_read_varint(&pos, end, &filter) ||
+        !xz_read_varint(&pos, end, &props_size) || filter != XZ_FILTER_LZMA2 || props_size != 1 || pos >= end ||
+        *pos++ > 40) {
+        return false;
+    }
+    for (; pos < end; pos++) {
+        if (*pos != 0) {
+            return false;
+        }
+    }
+
+    uint64_t data_start = xz_input_offset(input);
+    size_t output_start = decoder->pos;
+    if (!lzma2_decode(decoder)) {
+        return false;
+    }
+    uint64_t data_size = xz_input_offset(input) - data_start;
+    size_t output_size = decoder->pos - output_start;
+    if (((flags & 0x40) && compressed_size != data_size) || ((flags & 0x80) && uncompressed_size != output_size)) {
+        return false;
+    }
+    for (; data_size % 4 != 0; data_size++) {
+        if (xz_input_byte(input) != 0) {
+            return false;
+        }
+    }
+
+    uint8_t stored[64];
+    size_t check_size = xz_check_size(check);
+    if (!xz_input_read(input, stored, check_size)) {
+        return false;
+    }
+    const uint8_t* block = decoder->out + output_start;
+    if (check == XZ_CHECK_CRC32) {
+        return crc32_update(0, block, output_size) == xz_le32(stored);
+    }
+    if (check == XZ_CHECK_CRC64) {
+        uint64_t crc = crc64_update(0, block, output_size);
+        return memcmp(&crc, stored, 8) == 0;    // Little-endian, as the CRC32 above
+    }
+    return true;
+}
+
+// Decode the xz data in source into *out. False on corrupt data, an
+// unsupported filter, or output above XZ_MAX_OUTPUT_SIZE.
+static bool xz_decode(const XzSource* source, std::string* out) {
+    std::vector<XzStreamInfo> streams;
+    if (!xz_read_streams(source, &streams)) {
+        return false;
+    }
+    uint64_t total = 0;
+    for (const XzStreamInfo& stream : streams) {
+        total += stream.uncompressed;
+    }
+    if (total > XZ_MAX_OUTPUT_SIZE) {
+        return false;
+    }
+
+    std::unique_ptr<XzDecoder> decoder(new XzDecoder());
+    out->resize((size_t)total);
+    decoder->input.source = *source;
+    decoder->out = (uint8_t*)&(*out)[0];
+    decoder->out_size = (size_t)total;
+    decoder->pos = 0;
+    for (const XzStreamInfo& stream : streams) {
+        uint8_t header[XZ_STREAM_HEADER_SIZE];
+        xz_input_seek(&decoder->input, stream.start);
+        if (!xz_input_read(&decoder->input, header, sizeof(header)) || memcmp(header, XZ_HEADER_MAGIC, 6) != 0 ||
+            header[6] != 0 || header[7] != stream.check || crc32_update(0, header + 6, 2) != xz_le32(header + 8)) {
+            return false;
+        }
+        size_t stream_output = decoder->pos;
+        while (xz_input_offset(&decoder->input) < stream.index_start) {
+            if (!xz_decode_block(decoder.get(), stream.check)) {
+                return false;
+            }
+        }
+        if (xz_input_offset(&decoder->input) != stream.index_start ||
+            decoder->pos - stream_output != stream.uncompressed) {
+            return false;
+        }
+    }
+    return decoder->pos == decoder->out_size;
+}
+
+#endif // CRASHREPORTER_XZ_DECODER_H
@@ -98,9 +98,10 @@ object CrashGrouping {
                     // Remove line numbers and file info, keep class.method
                     frames.add(methodPart)
                 }
-                // Native format: "#00 pc 0x7f8a9b3c4d libunity.so (MyClass::myMethod+0x1c)"
+                // Native format: "#00 pc 0x7f8a9b3c4d libunity.so (MyClass::myMethod(int)+0x1c)"
+                // Names are demangled and may contain '(' and '+' (operator+)
                 trimmed.startsWith("#") -> {
-                    val methodPart = trimmed.substringAfter("(").substringBefore("+")
+                    val methodPart = trimmed.substringAfter(" (", "").substringBeforeLast("+0x")
                     if (methodPart.isNotBlank()) {
                         frames.add(methodPart)
                     }
@@ -251,17 +252,23 @@ object CrashGrouping {
 
     /**
      * Optimize payload to reduce size
+     *
+     * A native crash with a nativeCrash document goes out without stackTrace, nativeRegisters
+     * and memoryDump: the document carries the same frames, registers and memory, and the
+     * backend reads them from it. Grouping has already used the stack trace by then.
      */
     fun optimizePayload(crashData: CrashData): CrashData {
+        val hasNativeDocument = crashData.nativeCrash.isNotEmpty()
         return crashData.copy(
-            stackTrace = limitStackTrace(crashData.stackTrace),
+            stackTrace = if (hasNativeDocument) "" else limitStackTrace(crashData.stackTrace),
+            nativeRegisters = if (hasNativeDocument) emptyMap() else crashData.nativeRegisters,
             allThreads = limitThreads(crashData.allThreads, crashData.threadName),
             breadcrumbs = crashData.breadcrumbs.takeLast(MAX_BREADCRUMBS),
             memoryWarnings = crashData.memoryWarnings.takeLast(10),
             networkChanges = crashData.networkChanges.takeLast(10),
             customData = crashData.customData.entries.take(20).associate { it.key to scrubText(it.value) },
             exceptionMessage = scrubText(crashData.exceptionMessage),
-            memoryDump = crashData.memoryDump.take(1000)
+            memoryDump = if (hasNativeDocument) "" else crashData.memoryDump.take(1000)
         )
     }
 
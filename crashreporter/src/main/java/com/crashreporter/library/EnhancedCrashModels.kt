@@ -54,6 +54,9 @@ data class CrashData(
     val nativeFaultAddress: String = "",
     val nativeRegisters: Map<String, String> = emptyMap(),
     val memoryDump: String = "",
+    // JSON document of the native record, uploaded as an object; when set, the upload leaves out
+    // stackTrace, nativeRegisters and memoryDump, which it duplicates (CrashGrouping.optimizePayload)
+    val nativeCrash: String = "",
     val recentLogcat: String = "",  // Last 50 lines of logcat (max 5KB)
 
     // NEW FIELDS - Memory Warnings & Network Tracking
@@ -46,7 +46,14 @@ object EnhancedCrashReporter {
      * Initialize the enhanced crash reporter
      */
     @JvmStatic
-    fun initialize(context: Context, apiEndpoint: String, enableANRDetection: Boolean = true) {
+    fun initialize(
+        context: Context,
+        apiEndpoint: String,
+        enableANRDetection: Boolean = true,
+        nativeCaptureMode: NativeCrashHandler.CaptureMode = NativeCrashHandler.CaptureMode.FILE,
+        nativeUnwinder: NativeCrashHandler.Unwinder = NativeCrashHandler.Unwinder.UNWIND_BACKTRACE,
+        nativeMinidump: Boolean = false
+    ) {
         if (isInitialized) {
             android.util.Log.w("EnhancedCrashReporter", "Already initialized, skipping...")
             return
@@ -119,7 +126,7 @@ object EnhancedCrashReporter {
 
             // Initialize native crash handler
             try {
-                NativeCrashHandler.initialize(appContext)
+                NativeCrashHandler.initialize(appContext, nativeCaptureMode, nativeUnwinder, nativeMinidump)
                 android.util.Log.i("EnhancedCrashReporter", "✅ Native crash handler initialized")
             } catch (e: Exception) {
                 android.util.Log.w("EnhancedCrashReporter", "Failed to initialize native crash handler: ${e.message}")
@@ -406,24 +413,28 @@ object EnhancedCrashReporter {
     }
 
     /**
-     * Process native crash from previous session
+     * Process native crashes from previous sessions
      */
     private fun processNativeCrash() {
         scope.launch {
             try {
-                val nativeCrashFile = NativeCrashHandler.getPendingNativeCrash()
-                if (nativeCrashFile != null) {
-                    android.util.Log.i("EnhancedCrashReporter", "🔍 Found native crash from previous session")
-
-                    val nativeCrashContent = nativeCrashFile.readText()
-                    val crashData = parseNativeCrash(nativeCrashContent)
+                for (record in NativeCrashHandler.getPendingNativeCrashes()) {
+                    android.util.Log.i("EnhancedCrashReporter", "🔍 Found native crash #${record.sequence} from previous session")
+
+                    // Frames were recorded as module + offset; resolve names now, off the crash path
+                    val report = NativeCrashHandler.parseNativeCrash(record)
+                    if (report == null) {
+                        android.util.Log.w("EnhancedCrashReporter", "⚠️ Skipping undecodable native crash #${record.sequence}")
+                        continue
+                    }
+                    val crashData = createNativeCrashData(report)
 
                     crashStorage.saveCrash(crashData)
 
                     val success = crashSender.processCrash(crashData)
                     if (success) {
                         android.util.Log.i("EnhancedCrashReporter", "✅ Native crash processed successfully")
-                        NativeCrashHandler.deleteNativeCrashFile()
+                        NativeCrashHandler.acknowledgeNativeCrash(record)
                     } else {
                         android.util.Log.w("EnhancedCrashReporter", "⚠️ Failed to process native crash, will retry later")
                     }
@@ -435,44 +446,24 @@ object EnhancedCrashReporter {
     }
 
     /**
-     * Parse enhanced native crash file
+     * Build the crash report for a parsed native crash record
      */
-    private fun parseNativeCrash(content: String): CrashData {
-        val lines = content.split("\n")
-        var signal = "UNKNOWN"
-        var description = "Native crash"
-        var faultAddress = "unknown"
-        var threadName = "unknown"
-        var stackTrace = ""
-        val registers = mutableMapOf<String, String>()
-        var memoryDump = ""
-
-        var inRegisters = false
-        var inStackTrace = false
-        var inMemoryDump = false
-
-        for (line in lines) {
-            when {
-                line.startsWith("Signal:") -> signal = line.substringAfter("Signal:").trim()
-                line.startsWith("Description:") -> description = line.substringAfter("Description:").trim()
-                line.startsWith("Fault Address:") -> faultAddress = line.substringAfter("Fault Address:").trim()
-                line.startsWith("Thread:") -> threadName = line.substringAfter("Thread:").trim()
-                line.startsWith("REGISTERS:") -> { inRegisters = true; inStackTrace = false; inMemoryDump = false }
-                line.startsWith("STACK TRACE:") -> { inRegisters = false; inStackTrace = true; inMemoryDump = false }
-                line.startsWith("MEMORY DUMP:") -> { inRegisters = false; inStackTrace = false; inMemoryDump = true }
-                inRegisters && line.contains(":") -> {
-                    val parts = line.trim().split(":")
-                    if (parts.size == 2) {
-                        registers[parts[0].trim()] = parts[1].trim()
-                    }
-                }
-                inStackTrace && (line.startsWith("#") || line.trim().startsWith("at ")) -> stackTrace += line + "\n"
-                inMemoryDump -> memoryDump += line + "\n"
-            }
-        }
+    private fun createNativeCrashData(report: NativeCrashHandler.NativeCrashReport): CrashData {
+        val signal = report.signal
+        val description = report.description
+        val faultAddress = report.faultAddress
+        val threadName = report.threadName
+        val stackTrace = report.stackTrace
+        val registers = report.registers
+        val memoryDump = report.memoryDump
+        val secondaryCrashes = report.secondaryCrashes
 
         // Add operation tracking data to custom data for SLO monitoring
         val customDataWithOperations = CustomDataManager.getCustomData().toMutableMap()
+        if (secondaryCrashes.isNotEmpty()) {
+            // Other threads that crashed while this record was being captured
+            customDataWithOperations["nativeSecondaryCrashes"] = secondaryCrashes.joinToString("\n")
+        }
         try {
             val currentOp = OperationTracker.getCurrentOperation()
             val lastSuccessOp = OperationTracker.getLastSuccessfulOperation()
@@ -494,7 +485,7 @@ object EnhancedCrashReporter {
             timestamp = System.currentTimeMillis(),
             exceptionType = signal,
             exceptionMessage = "$description at $faultAddress",
-            stackTrace = stackTrace.ifEmpty { content },
+            stackTrace = stackTrace,
             threadName = threadName,
             deviceInfo = deviceInfoCollector.getDeviceInfo(),
             appInfo = deviceInfoCollector.getAppInfo(),
@@ -526,6 +517,7 @@ object EnhancedCrashReporter {
             nativeFaultAddress = faultAddress,
             nativeRegisters = registers,
             memoryDump = memoryDump,
+            nativeCrash = report.json,
             memoryWarnings = memoryWarningTracker?.getWarnings() ?: emptyList(),
             memoryPressure = deviceInfoCollector.getMemoryPressure(),
             networkChanges = reachabilityTracker?.getNetworkChanges() ?: emptyList(),
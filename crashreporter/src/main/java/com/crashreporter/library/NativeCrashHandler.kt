@@ -2,6 +2,11 @@ package com.crashreporter.library
 
 import android.content.Context
 import java.io.File
+import java.io.RandomAccessFile
+import java.nio.Buffer
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.channels.FileChannel
 
 /**
  * JNI Bridge to native crash handler
@@ -9,6 +14,219 @@ import java.io.File
  */
 object NativeCrashHandler {
 
+    /**
+     * How the native handler persists a crash record
+     * FILE: pwrite() into the pre-opened, pre-allocated crash journal
+     * MMAP: format straight into a MAP_SHARED mapping of the journal (no syscalls at crash time)
+     */
+    enum class CaptureMode(val nativeValue: Int) {
+        FILE(0),
+        MMAP(1)
+    }
+
+    /**
+     * Primary native stack unwinder
+     * UNWIND_BACKTRACE: _Unwind_Backtrace from the faulting context
+     * FRAME_POINTER: bounds-checked frame-pointer walk
+     * CFI: lock-free DWARF .eh_frame unwinder; handles libraries built without frame pointers
+     * FRAME_POINTER and CFI fall back to UNWIND_BACKTRACE when the walk cannot start
+     * (e.g. stack overflow) or finds fewer than three frames
+     */
+    enum class Unwinder(val nativeValue: Int) {
+        UNWIND_BACKTRACE(0),
+        FRAME_POINTER(1),
+        CFI(2)
+    }
+
+    // Crash journal layout written by the native handler (see crash_journal.h)
+    private const val JOURNAL_FILE = "native_crash.journal"
+    private const val JOURNAL_MAGIC = "NCRJRNL1"
+    private const val JOURNAL_HEADER_SIZE = 64
+    private const val SLOT_MAGIC = "NCRSLOT1"
+    private const val SLOT_HEADER_SIZE = 64
+
+    // Binary records start with "NCRB" (see crash_record_format.h); older versions wrote text
+    private const val RECORD_MAGIC = 0x4252434e
+    // CrashRecordHeader field offsets, and the sections (u8 type, u32 length, payload) that follow it
+    private const val RECORD_HEADER_SIZE_OFFSET = 6
+    private const val RECORD_LENGTH_OFFSET = 8
+    private const val RECORD_FLAGS_OFFSET = 14
+    private const val RECORD_SIGNAL_OFFSET = 16
+    private const val RECORD_CODE_OFFSET = 20
+    private const val RECORD_PID_OFFSET = 24
+    private const val RECORD_TID_OFFSET = 28
+    private const val RECORD_TIME_OFFSET = 32
+    private const val RECORD_FAULT_ADDRESS_OFFSET = 40
+    private const val RECORD_FLAG_TRUNCATED = 0x1
+    private const val SECTION_HEADER_SIZE = 5
+    private const val SECTION_FRAMES = 2
+    private const val SECTION_MEMORY = 7
+
+    // Single-file record written by older versions, or when the journal cannot be prepared
+    private const val LEGACY_CRASH_FILE = "native_crash.txt"
+
+    // Symbol indexes of the app's libraries, by build-id (see symbol_cache.h)
+    private const val SYMBOL_CACHE_DIR = "symbols"
+    private const val LEGACY_SLOT = -1
+
+    // Breakpad-compatible minidumps, one <time>-<tid>.dmp per crash (see minidump_writer.h)
+    private const val MINIDUMP_DIR = "minidumps"
+    private const val MINIDUMP_EXTENSION = "dmp"
+
+    /**
+     * A committed native crash record from a previous session
+     * @param slot Journal slot index ([LEGACY_SLOT] for the single-file record)
+     * @param sequence Crash sequence number; higher is newer
+     * @param buffer The record in place: a read-only, little-endian view of the memory-mapped journal.
+     * Neither it nor the views below copy the record onto the Java heap
+     */
+    class NativeCrashRecord internal constructor(
+        val slot: Int,
+        val sequence: Long,
+        val buffer: ByteBuffer
+    ) {
+        /** Binary record (crash_record_format.h); false for a text record from an older version */
+        val isBinary: Boolean get() = isBinaryRecord(buffer)
+
+        // Header fields of a binary record; 0 for a text record or a field an older writer did not have
+        val signal: Int get() = headerInt(RECORD_SIGNAL_OFFSET)
+        val signalCode: Int get() = headerInt(RECORD_CODE_OFFSET)
+        val pid: Int get() = headerInt(RECORD_PID_OFFSET)
+        val tid: Int get() = headerInt(RECORD_TID_OFFSET)
+        val crashTimeSeconds: Long get() = headerLong(RECORD_TIME_OFFSET)
+        val faultAddress: Long get() = headerLong(RECORD_FAULT_ADDRESS_OFFSET)
+
+        /** The handler ran out of room and the last section is cut short */
+        val isTruncated: Boolean
+            get() = headerSize > RECORD_FLAGS_OFFSET &&
+                (buffer.get(RECORD_FLAGS_OFFSET).toInt() and RECORD_FLAG_TRUNCATED) != 0
+
+        /**
+         * Address of the first byte of [memoryDump]; 0 if there is none. Like [faultAddress] it holds the
+         * unsigned 64-bit value, so tagged and kernel-half addresses read as negative: format with toULong()
+         */
+        val memoryDumpAddress: Long
+            get() = section(SECTION_MEMORY)?.let { readVarint(it) } ?: 0
+
+        /**
+         * The record in the handler's text layout; null if it cannot be decoded
+         */
+        val content: String? get() = decodeRecord(buffer)
+
+        /**
+         * Raw bytes the handler captured around the fault address, as a view of the record; null if none
+         */
+        fun memoryDump(): ByteBuffer? {
+            val section = section(SECTION_MEMORY) ?: return null
+            readVarint(section) ?: return null
+            val length = readVarint(section) ?: return null
+            if (length !in 1..section.remaining()) {
+                return null
+            }
+            return section.view(section.position(), section.position() + length.toInt())
+        }
+
+        /**
+         * Visit the recorded frames, innermost first: the module's index in the record's module
+         * table (-1 outside every module, with the absolute pc as offset) and the offset into it
+         */
+        fun forEachFrame(action: (module: Int, offset: Long) -> Unit) {
+            val section = section(SECTION_FRAMES) ?: return
+            val count = readVarint(section) ?: return
+            var frame = 0L
+            while (frame++ < count) {
+                val module = readVarint(section) ?: return
+                val offset = readVarint(section) ?: return
+                action(module.toInt() - 1, offset)
+            }
+        }
+
+        private val headerSize: Int
+            get() = if (isBinary && buffer.limit() >= RECORD_LENGTH_OFFSET) {
+                minOf(buffer.getShort(RECORD_HEADER_SIZE_OFFSET).toInt() and 0xffff, buffer.limit())
+            } else {
+                0
+            }
+
+        private fun headerInt(offset: Int): Int = if (offset + 4 <= headerSize) buffer.getInt(offset) else 0
+
+        private fun headerLong(offset: Int): Long = if (offset + 8 <= headerSize) buffer.getLong(offset) else 0
+
+        // Payload of the first section of a type, as a view positioned at its start
+        private fun section(type: Int): ByteBuffer? {
+            val start = headerSize
+            if (start < RECORD_SIGNAL_OFFSET) {
+                return null
+            }
+            val length = buffer.getInt(RECORD_LENGTH_OFFSET).toLong() and 0xffffffffL
+            // Unfinished or cut off records are read to the end of the slot, as the native decoder does
+            val end = if (length < start || length > buffer.limit()) buffer.limit() else length.toInt()
+            var position = start
+            while (end - position >= SECTION_HEADER_SIZE) {
+                val sectionType = buffer.get(position).toInt() and 0xff
+                val sectionLength = minOf(
+                    buffer.getInt(position + 1).toLong() and 0xffffffffL,
+                    (end - position - SECTION_HEADER_SIZE).toLong()
+                ).toInt()
+                position += SECTION_HEADER_SIZE
+                if (sectionType == type) {
+                    return buffer.view(position, position + sectionLength)
+                }
+                position += sectionLength
+            }
+            return null
+        }
+    }
+
+    /**
+     * A native crash record parsed into its parts (see [parseNativeCrash]).
+     * The native decoder sets the @JvmField properties in one call (see crash_record_jni.h).
+     */
+    class NativeCrashReport internal constructor() {
+        @JvmField var signal: String = "UNKNOWN"
+        @JvmField var description: String = "Native crash"
+        @JvmField var faultAddress: String = "unknown"
+        @JvmField var threadName: String = "unknown"
+        @JvmField var truncated: Boolean = false
+        @JvmField var registerNames: Array<String> = emptyArray()
+        @JvmField var registerValues: Array<String> = emptyArray()
+        @JvmField var secondaryCrashes: Array<String> = emptyArray()
+        @JvmField var memoryDump: String = ""
+
+        // Frames as recorded: absolute pc, module position in modulePaths (-1 if not listed) and offset into it
+        @JvmField internal var framePcs: LongArray = LongArray(0)
+        @JvmField internal var frameModules: IntArray = IntArray(0)
+        @JvmField internal var frameOffsets: LongArray = LongArray(0)
+        @JvmField internal var modulePaths: Array<String> = emptyArray()
+        @JvmField internal var moduleBuildIds: Array<String> = emptyArray()
+
+        // Symbol of each frame as resolved on this launch; null where unresolved
+        internal var frameSymbols: Array<String?> = emptyArray()
+
+        /** Symbolized frames, one "#000 pc 0x... path (symbol+0xdelta)" line each */
+        var stackTrace: String = ""
+            internal set
+
+        /**
+         * The record as one JSON object (frames with their symbols, registers, modules, memory), written
+         * natively by a streaming writer and uploaded verbatim as "nativeCrash"; empty for text records
+         */
+        var json: String = ""
+            internal set
+
+        val registers: Map<String, String>
+            get() = registerNames.indices.associate { registerNames[it] to registerValues[it] }
+    }
+
+    // Frames and addresses the handler records as module index + offset
+    // ("#000 pc 0x7f1200 [3]+0x1a2b0", "fault [3]+0x40010", "x19 [5]+0x2000")
+    private val MODULE_FRAME = Regex("""^(#\d+ pc 0x[0-9a-fA-F]+|[a-z]+\d*) \[(\d+)]\+0x([0-9a-fA-F]+)$""")
+    // Module table entries following the stack trace ("[3] 0x7f1000 9c3f...e1 /data/app/.../libfoo.so",
+    // "-" for a module without build-id; records from older versions have no build-id column)
+    private val MODULE_ENTRY = Regex("""^\[(\d+)] 0x[0-9a-fA-F]+ (?:([0-9a-f]+|-) )?(.*)$""")
+
+    private class SlotInfo(val index: Int, val offset: Long, val sequence: Long, val bodyLength: Long, val bodyCrc: Long)
+
     private var isNativeInitialized = false
     private lateinit var crashDir: File
 
@@ -24,8 +242,14 @@ object NativeCrashHandler {
 
     /**
      * Initialize native crash handler
+     * @param writeMinidump Also write a Breakpad-compatible minidump of each crash (see [getPendingMinidumps])
      */
-    fun initialize(context: Context) {
+    fun initialize(
+        context: Context,
+        captureMode: CaptureMode = CaptureMode.FILE,
+        unwinder: Unwinder = Unwinder.UNWIND_BACKTRACE,
+        writeMinidump: Boolean = false
+    ) {
         if (isNativeInitialized) {
             android.util.Log.w("NativeCrashHandler", "Native crash handler already initialized")
             return
@@ -38,7 +262,7 @@ object NativeCrashHandler {
             }
 
             // Call native initialization
-            initialize(crashDir.absolutePath)
+            initialize(crashDir.absolutePath, captureMode.nativeValue, unwinder.nativeValue, writeMinidump)
             isNativeInitialized = true
 
             android.util.Log.i("NativeCrashHandler", "Native crash handler initialized")
@@ -48,36 +272,448 @@ object NativeCrashHandler {
     }
 
     /**
-     * Check if there's a pending native crash from previous session
+     * Iterate over all committed native crash records from previous sessions, oldest first.
+     * Torn slots (the process died before the commit marker was written) are logged and cleared
      */
-    fun getPendingNativeCrash(): File? {
+    fun getPendingNativeCrashes(): Iterator<NativeCrashRecord> {
         if (!::crashDir.isInitialized) {
+            return emptyList<NativeCrashRecord>().iterator()
+        }
+
+        val journalFile = File(crashDir, JOURNAL_FILE)
+        val legacyFile = File(crashDir, LEGACY_CRASH_FILE)
+        val slots = try {
+            readCommittedSlots(journalFile)
+        } catch (e: Exception) {
+            android.util.Log.e("NativeCrashHandler", "Failed to read crash journal", e)
+            emptyList()
+        }
+
+        return iterator {
+            if (legacyFile.exists() && legacyFile.length() > 0) {
+                mapFile(legacyFile)?.let { yield(NativeCrashRecord(LEGACY_SLOT, 0, it)) }
+            }
+            val journal = if (slots.isEmpty()) null else mapFile(journalFile)
+            for (slot in slots) {
+                val body = journal?.let { slotBody(it, slot) } ?: continue
+                yield(NativeCrashRecord(slot.index, slot.sequence, body))
+            }
+        }
+    }
+
+    /**
+     * Read every slot header and return the committed ones, oldest first
+     */
+    private fun readCommittedSlots(journalFile: File): List<SlotInfo> {
+        if (!journalFile.exists()) {
+            return emptyList()
+        }
+
+        RandomAccessFile(journalFile, "rw").use { raf ->
+            if (raf.length() < JOURNAL_HEADER_SIZE) {
+                return emptyList()
+            }
+            val journalHeader = ByteArray(JOURNAL_HEADER_SIZE)
+            raf.readFully(journalHeader)
+            if (String(journalHeader, 0, JOURNAL_MAGIC.length, Charsets.US_ASCII) != JOURNAL_MAGIC) {
+                return emptyList()
+            }
+            val journal = ByteBuffer.wrap(journalHeader).order(ByteOrder.LITTLE_ENDIAN)
+            val slotCount = journal.getInt(16)
+            val slotSize = journal.getInt(20).toLong()
+
+            val committed = mutableListOf<SlotInfo>()
+            val slotHeader = ByteArray(SLOT_HEADER_SIZE)
+            for (index in 0 until slotCount) {
+                val offset = JOURNAL_HEADER_SIZE + index * slotSize
+                if (offset + SLOT_HEADER_SIZE > raf.length()) {
+                    break
+                }
+                raf.seek(offset)
+                raf.readFully(slotHeader)
+                if (String(slotHeader, 0, SLOT_MAGIC.length, Charsets.US_ASCII) != SLOT_MAGIC) {
+                    continue
+                }
+
+                val header = ByteBuffer.wrap(slotHeader).order(ByteOrder.LITTLE_ENDIAN)
+                val sequence = header.getLong(16)
+                val bodyCapacity = header.getLong(24)
+                val bodyLength = header.getLong(32)
+                val bodyCrc = header.getInt(40).toLong() and 0xffffffffL
+                val commitSequence = header.getLong(48)
+
+                if (sequence == 0L) {
+                    continue
+                }
+                if (commitSequence != sequence || bodyLength <= 0 || bodyLength > bodyCapacity) {
+                    android.util.Log.w("NativeCrashHandler", "Discarding torn native crash record #$sequence in slot $index")
+                    clearSlot(raf, offset)
+                    continue
+                }
+                committed += SlotInfo(index, offset, sequence, bodyLength, bodyCrc)
+            }
+
+            return committed.sortedBy { it.sequence }
+        }
+    }
+
+    /**
+     * Map a file read-only, little-endian. Records are then read in place from the page cache
+     * instead of being copied onto the Java heap; the mapping goes away with the last view of it
+     */
+    private fun mapFile(file: File): ByteBuffer? = try {
+        RandomAccessFile(file, "r").use { raf ->
+            raf.channel.map(FileChannel.MapMode.READ_ONLY, 0, raf.length()).order(ByteOrder.LITTLE_ENDIAN)
+        }
+    } catch (e: Exception) {
+        android.util.Log.e("NativeCrashHandler", "Failed to map ${file.name}", e)
+        null
+    }
+
+    /**
+     * View and checksum a slot body; null if the slot was overwritten or fails validation
+     */
+    private fun slotBody(journal: ByteBuffer, slot: SlotInfo): ByteBuffer? {
+        val start = slot.offset + SLOT_HEADER_SIZE
+        if (start + slot.bodyLength > journal.limit()) {
+            return null
+        }
+        val body = journal.view(start.toInt(), (start + slot.bodyLength).toInt())
+        // The CRC is computed natively over the mapped pages (CRC32.update(ByteBuffer) needs API 26)
+        val crc = try {
+            nativeChecksum(body)
+        } catch (e: UnsatisfiedLinkError) {
+            -1L
+        }
+        if (crc != slot.bodyCrc) {
+            android.util.Log.w("NativeCrashHandler", "Native crash record #${slot.sequence} failed checksum validation")
             return null
         }
+        return body
+    }
 
-        val nativeCrashFile = File(crashDir, "native_crash.txt")
-        return if (nativeCrashFile.exists() && nativeCrashFile.length() > 0) {
-            nativeCrashFile
-        } else {
-            null
+    // Bytes [from, to) of a buffer as a little-endian view; the Buffer casts keep to the
+    // position/limit signatures that older Android versions have
+    private fun ByteBuffer.view(from: Int, to: Int): ByteBuffer {
+        val view = duplicate()
+        (view as Buffer).limit(to)
+        (view as Buffer).position(from)
+        return view.slice().order(ByteOrder.LITTLE_ENDIAN)
+    }
+
+    // Unsigned LEB128 from the buffer's position, as the raw 64 bits (values past Long.MAX_VALUE
+    // come back negative); null if it runs past the end
+    private fun readVarint(buffer: ByteBuffer): Long? {
+        var value = 0L
+        var shift = 0
+        while (shift < 64 && buffer.hasRemaining()) {
+            val byte = buffer.get().toInt()
+            value = value or ((byte and 0x7f).toLong() shl shift)
+            if (byte and 0x80 == 0) {
+                return value
+            }
+            shift += 7
         }
+        return null
     }
 
+    private fun isBinaryRecord(body: ByteBuffer): Boolean =
+        body.limit() >= 4 && body.getInt(0) == RECORD_MAGIC
+
     /**
-     * Delete native crash file after successful processing
+     * Text of a record: binary records are decoded natively in one pass, text from older versions is used as is
      */
-    fun deleteNativeCrashFile() {
+    private fun decodeRecord(body: ByteBuffer): String? {
+        if (!isBinaryRecord(body)) {
+            return Charsets.UTF_8.decode(body.duplicate()).toString()
+        }
+        return nativeDecodeRecord(body).also {
+            if (it == null) {
+                android.util.Log.w("NativeCrashHandler", "Failed to decode native crash record")
+            }
+        }
+    }
+
+    private fun clearSlot(raf: RandomAccessFile, offset: Long) {
+        raf.seek(offset)
+        raf.write(ByteArray(SLOT_HEADER_SIZE))
+    }
+
+    /**
+     * Release a record after successful processing so its slot can be reused
+     */
+    fun acknowledgeNativeCrash(record: NativeCrashRecord) {
         if (!::crashDir.isInitialized) {
             return
         }
 
-        val nativeCrashFile = File(crashDir, "native_crash.txt")
-        if (nativeCrashFile.exists()) {
-            nativeCrashFile.delete()
+        if (record.slot == LEGACY_SLOT) {
+            File(crashDir, LEGACY_CRASH_FILE).delete()
             android.util.Log.i("NativeCrashHandler", "Native crash file deleted")
+            return
+        }
+
+        RandomAccessFile(File(crashDir, JOURNAL_FILE), "rw").use { raf ->
+            val journalHeader = ByteArray(JOURNAL_HEADER_SIZE)
+            raf.readFully(journalHeader)
+            val slotSize = ByteBuffer.wrap(journalHeader).order(ByteOrder.LITTLE_ENDIAN).getInt(20).toLong()
+            val offset = JOURNAL_HEADER_SIZE + record.slot * slotSize
+
+            // Only clear the slot if a newer crash has not claimed it in the meantime
+            val slotHeader = ByteArray(SLOT_HEADER_SIZE)
+            raf.seek(offset)
+            raf.readFully(slotHeader)
+            if (ByteBuffer.wrap(slotHeader).order(ByteOrder.LITTLE_ENDIAN).getLong(16) == record.sequence) {
+                clearSlot(raf, offset)
+                android.util.Log.i("NativeCrashHandler", "Native crash record #${record.sequence} acknowledged")
+            }
+        }
+    }
+
+    /**
+     * Minidumps written by previous sessions, oldest first. Upload them as is
+     * (Breakpad/Crashpad tooling reads them), then [acknowledgeMinidump].
+     */
+    fun getPendingMinidumps(): List<File> {
+        if (!::crashDir.isInitialized) {
+            return emptyList()
+        }
+        // The dump being prepared for this session is "dump.pending" and is not listed
+        val dumps = File(crashDir, MINIDUMP_DIR).listFiles { file -> file.extension == MINIDUMP_EXTENSION }
+        return dumps?.sortedBy { it.name.substringBefore('-').toLongOrNull() ?: 0L } ?: emptyList()
+    }
+
+    /**
+     * Delete a minidump after successful processing
+     */
+    fun acknowledgeMinidump(minidump: File) {
+        if (minidump.delete()) {
+            android.util.Log.i("NativeCrashHandler", "Minidump ${minidump.name} acknowledged")
+        }
+    }
+
+    /**
+     * Parse a record into its parts and symbolize its frames; null if it cannot be decoded.
+     * Binary records are decoded natively in one call; text records from older versions are
+     * symbolized and parsed line by line. Reads the module files, so call it off the main thread.
+     */
+    fun parseNativeCrash(record: NativeCrashRecord): NativeCrashReport? {
+        if (!record.isBinary) {
+            return parseTextRecord(symbolizeNativeCrash(record.content.orEmpty()))
+        }
+
+        val report = NativeCrashReport()
+        val parsed = try {
+            nativeParseRecord(record.buffer, report)
+        } catch (e: Throwable) {
+            android.util.Log.w("NativeCrashHandler", "Failed to parse native crash record: ${e.message}")
+            false
+        }
+        if (!parsed) {
+            android.util.Log.w("NativeCrashHandler", "Failed to decode native crash record #${record.sequence}")
+            return null
+        }
+        report.stackTrace = symbolizeFrames(report).ifEmpty { record.content.orEmpty() }
+        report.json = nativeRecordToJson(record.buffer, report.frameSymbols).orEmpty()
+        return report
+    }
+
+    /**
+     * Parse the text layout written by older versions of the handler
+     */
+    private fun parseTextRecord(content: String): NativeCrashReport {
+        val report = NativeCrashReport()
+        val stackTrace = StringBuilder(content.length)
+        val memoryDump = StringBuilder()
+        val registerNames = mutableListOf<String>()
+        val registerValues = mutableListOf<String>()
+        val secondaryCrashes = mutableListOf<String>()
+
+        var inRegisters = false
+        var inStackTrace = false
+        var inMemoryDump = false
+        var inSecondaryCrashes = false
+
+        for (line in content.lineSequence()) {
+            when {
+                line.startsWith("Signal:") -> report.signal = line.substringAfter("Signal:").trim()
+                line.startsWith("Description:") -> report.description = line.substringAfter("Description:").trim()
+                line.startsWith("Fault Address:") -> report.faultAddress = line.substringAfter("Fault Address:").trim()
+                line.startsWith("Thread:") -> report.threadName = line.substringAfter("Thread:").trim()
+                line.startsWith("SECONDARY CRASHES:") -> inSecondaryCrashes = true
+                line.startsWith("REGISTERS:") -> { inRegisters = true; inStackTrace = false; inMemoryDump = false; inSecondaryCrashes = false }
+                line.startsWith("STACK TRACE:") -> { inRegisters = false; inStackTrace = true; inMemoryDump = false; inSecondaryCrashes = false }
+                line.startsWith("MEMORY DUMP:") -> { inRegisters = false; inStackTrace = false; inMemoryDump = true; inSecondaryCrashes = false }
+                inSecondaryCrashes && line.trim().startsWith("tid ") -> secondaryCrashes += line.trim()
+                inRegisters && line.contains(":") -> {
+                    val parts = line.trim().split(":")
+                    if (parts.size == 2) {
+                        registerNames += parts[0].trim()
+                        registerValues += parts[1].trim()
+                    }
+                }
+                inStackTrace && (line.startsWith("#") || line.trim().startsWith("at ")) -> stackTrace.append(line).append('\n')
+                inMemoryDump -> memoryDump.append(line).append('\n')
+            }
+        }
+
+        report.registerNames = registerNames.toTypedArray()
+        report.registerValues = registerValues.toTypedArray()
+        report.secondaryCrashes = secondaryCrashes.toTypedArray()
+        report.memoryDump = memoryDump.toString()
+        report.stackTrace = stackTrace.ifEmpty { content }.toString()
+        return report
+    }
+
+    /**
+     * Resolve a parsed record's frames to "path (symbol+0xdelta)", one symbol index lookup batch per module
+     */
+    private fun symbolizeFrames(report: NativeCrashReport): String {
+        val frameCount = report.framePcs.size
+        val symbols = arrayOfNulls<String>(frameCount)
+        val startNanos = System.nanoTime()
+        val cacheDir = symbolCacheDir()
+        var symbolizedModules = 0
+        for (module in report.modulePaths.indices) {
+            val offsets = (0 until frameCount).filter { report.frameModules[it] == module }
+                .map { report.frameOffsets[it] }.distinct().toLongArray()
+            if (offsets.isEmpty()) {
+                continue
+            }
+            val names = try {
+                nativeSymbolize(report.modulePaths[module], report.moduleBuildIds[module], cacheDir, offsets)
+            } catch (e: Throwable) {
+                android.util.Log.w("NativeCrashHandler", "Failed to symbolize ${report.modulePaths[module]}: ${e.message}")
+                continue
+            }
+            symbolizedModules++
+            val byOffset = offsets.indices.associate { offsets[it] to names[it] }
+            for (frame in 0 until frameCount) {
+                if (report.frameModules[frame] == module) {
+                    symbols[frame] = byOffset[report.frameOffsets[frame]]
+                }
+            }
+        }
+        android.util.Log.d(
+            "NativeCrashHandler",
+            "Symbolized $symbolizedModules modules in ${(System.nanoTime() - startNanos) / 1_000_000} ms"
+        )
+        report.frameSymbols = symbols
+
+        // Same lines symbolizeNativeCrash() produces from the text layout
+        val indexWidth = if (frameCount > 100) 3 else 2
+        val stackTrace = StringBuilder(frameCount * 96)
+        for (frame in 0 until frameCount) {
+            stackTrace.append('#').append(frame.toString().padStart(indexWidth, '0'))
+                .append(" pc 0x").append(java.lang.Long.toHexString(report.framePcs[frame]))
+            val module = report.frameModules[frame]
+            if (module < 0) {
+                stackTrace.append(" ???\n")
+                continue
+            }
+            val symbol = symbols[frame] ?: "???+0x${java.lang.Long.toHexString(report.frameOffsets[frame])}"
+            stackTrace.append(' ').append(report.modulePaths[module]).append(" (").append(symbol).append(")\n")
+        }
+        return stackTrace.toString()
+    }
+
+    // Symbol indexes of the app's libraries are cached across launches; "" disables the cache
+    private fun symbolCacheDir(): String = if (::crashDir.isInitialized) {
+        File(crashDir, SYMBOL_CACHE_DIR).apply { mkdirs() }.absolutePath
+    } else {
+        ""
+    }
+
+    /**
+     * Resolve the "[module]+0xoffset" frames and addresses of a native crash record to "path (symbol+0xdelta)".
+     * The handler no longer symbolizes while crashing; this reads the module files,
+     * so call it off the main thread. Frames that cannot be resolved keep their module path;
+     * a library whose build-id differs from the crashed one (app updated since) is not symbolized.
+     */
+    fun symbolizeNativeCrash(content: String): String {
+        val lines = content.split("\n")
+
+        val modulePaths = mutableMapOf<Int, String>()
+        val moduleBuildIds = mutableMapOf<Int, String>()
+        var inModules = false
+        for (line in lines) {
+            if (line.equals("MODULES:", ignoreCase = true)) {
+                inModules = true
+                continue
+            }
+            if (inModules) {
+                val entry = MODULE_ENTRY.matchEntire(line)
+                if (entry == null) {
+                    inModules = false
+                } else {
+                    val module = entry.groupValues[1].toInt()
+                    modulePaths[module] = entry.groupValues[3]
+                    moduleBuildIds[module] = entry.groupValues[2].takeIf { it != "-" }.orEmpty()
+                }
+            }
+        }
+        if (modulePaths.isEmpty()) {
+            return content
+        }
+
+        // One symbol index per module, mapped from the cache after the first time
+        val startNanos = System.nanoTime()
+        val cacheDir = symbolCacheDir()
+        val offsetsByModule = mutableMapOf<Int, MutableSet<Long>>()
+        for (line in lines) {
+            val frame = MODULE_FRAME.matchEntire(line) ?: continue
+            val module = frame.groupValues[2].toInt()
+            if (module in modulePaths) {
+                offsetsByModule.getOrPut(module) { mutableSetOf() } += frame.groupValues[3].toLong(16)
+            }
+        }
+        val symbols = mutableMapOf<Pair<Int, Long>, String>()
+        for ((module, offsets) in offsetsByModule) {
+            val offsetArray = offsets.toLongArray()
+            val names = try {
+                nativeSymbolize(modulePaths.getValue(module), moduleBuildIds.getValue(module), cacheDir, offsetArray)
+            } catch (e: Throwable) {
+                android.util.Log.w("NativeCrashHandler", "Failed to symbolize ${modulePaths[module]}: ${e.message}")
+                continue
+            }
+            for (i in offsetArray.indices) {
+                names[i]?.let { symbols[module to offsetArray[i]] = it }
+            }
+        }
+        android.util.Log.d(
+            "NativeCrashHandler",
+            "Symbolized ${offsetsByModule.size} modules in ${(System.nanoTime() - startNanos) / 1_000_000} ms"
+        )
+
+        return lines.joinToString("\n") { line ->
+            val frame = MODULE_FRAME.matchEntire(line) ?: return@joinToString line
+            val module = frame.groupValues[2].toInt()
+            val path = modulePaths[module] ?: return@joinToString line
+            val symbol = symbols[module to frame.groupValues[3].toLong(16)] ?: "???+0x${frame.groupValues[3]}"
+            "${frame.groupValues[1]} $path ($symbol)"
         }
     }
 
+    /**
+     * Re-snapshot loaded native libraries for the crash handler's module map
+     * A background thread already picks up dlopen/dlclose within a second; call this to
+     * bring the map up to date immediately. It only rebuilds if the set of modules changed.
+     */
+    fun refreshLoadedModules() {
+        if (isNativeInitialized) {
+            nativeRefreshLoadedModules()
+        }
+    }
+
+    /**
+     * System.loadLibrary() that also brings the crash handler's module map up to date,
+     * so crashes in the new library are attributed to it
+     */
+    fun loadLibrary(libName: String) {
+        System.loadLibrary(libName)
+        refreshLoadedModules()
+    }
+
     /**
      * Trigger a native crash for testing purposes
      * @param type 0=SIGSEGV, 1=SIGABRT, 2=SIGFPE, 3=Invalid memory, 4=Stack overflow
@@ -88,7 +724,13 @@ object NativeCrashHandler {
     }
 
     // Native methods
-    private external fun initialize(crashDir: String)
+    private external fun initialize(crashDir: String, captureMode: Int, unwinder: Int, writeMinidump: Boolean)
     private external fun triggerNativeCrash(type: Int)
+    private external fun nativeRefreshLoadedModules()
+    private external fun nativeDecodeRecord(record: ByteBuffer): String?
+    private external fun nativeParseRecord(record: ByteBuffer, report: NativeCrashReport): Boolean
+    private external fun nativeChecksum(buffer: ByteBuffer): Long
+    private external fun nativeRecordToJson(record: ByteBuffer, frameSymbols: Array<String?>): String?
+    private external fun nativeSymbolize(modulePath: String, buildId: String, cacheDir: String, offsets: LongArray): Array<String?>
     external fun isInitialized(): Boolean
 }
@@ -2,11 +2,15 @@ package com.crashreporter.library
 
 import com.google.gson.Gson
 import com.google.gson.JsonElement
+import com.google.gson.JsonObject
+import com.google.gson.JsonPrimitive
 import com.google.gson.TypeAdapter
 import com.google.gson.TypeAdapterFactory
 import com.google.gson.reflect.TypeToken
 import com.google.gson.stream.JsonReader
+import com.google.gson.stream.JsonToken
 import com.google.gson.stream.JsonWriter
+import java.io.StringReader
 
 /**
  * Custom Gson TypeAdapterFactory for Payload Optimization
@@ -29,9 +33,20 @@ import com.google.gson.stream.JsonWriter
  * After:  {"crashId":"123"}
  *
  * Size reduction: ~300-400 bytes per crash (3-5%)
+ *
+ * The native crash document (CrashData.nativeCrash) is already JSON, written by the
+ * native handler's streaming writer; it is embedded verbatim as an object rather than
+ * escaped into a string, and never parsed into a tree. A streaming pass over it checks
+ * it is one strict JSON object first, so a document that is not (a corrupt journal, a
+ * writer from another version) goes out as a string instead of breaking the whole
+ * upload. Reading accepts either form and keeps it as a string.
  */
 class PayloadOptimizationAdapterFactory : TypeAdapterFactory {
 
+    private companion object {
+        const val NATIVE_CRASH_FIELD = "nativeCrash"
+    }
+
     override fun <T> create(gson: Gson, type: TypeToken<T>): TypeAdapter<T>? {
         // Only handle CrashData - let Gson handle other types normally
         if (type.rawType != CrashData::class.java) {
@@ -41,6 +56,7 @@ class PayloadOptimizationAdapterFactory : TypeAdapterFactory {
         // Get the delegate adapter (the default Gson serializer for this type)
         // This prevents infinite recursion by using Gson's built-in serialization
         val delegate = gson.getDelegateAdapter(this, type)
+        val elementAdapter = gson.getAdapter(JsonElement::class.java)
 
         @Suppress("UNCHECKED_CAST")
         return object : TypeAdapter<T>() {
@@ -56,13 +72,57 @@ class PayloadOptimizationAdapterFactory : TypeAdapterFactory {
                 // Clean up the JSON (remove nulls, empty strings, empty collections)
                 val cleaned = cleanJsonElement(jsonElement)
 
-                // Write the cleaned JSON
-                gson.toJson(cleaned, out)
+                val nativeCrash = (cleaned as? JsonObject)?.get(NATIVE_CRASH_FIELD)
+                if (cleaned !is JsonObject || nativeCrash !is JsonPrimitive || !nativeCrash.isString) {
+                    gson.toJson(cleaned, out)
+                    return
+                }
+
+                // Write the cleaned JSON, with the native crash document spliced in as it was written
+                val document = nativeCrash.asString
+                val embed = isJsonObject(document)
+                out.beginObject()
+                for ((key, element) in cleaned.entrySet()) {
+                    out.name(key)
+                    if (key == NATIVE_CRASH_FIELD && embed) {
+                        out.jsonValue(document)
+                    } else {
+                        gson.toJson(element, out)
+                    }
+                }
+                out.endObject()
             }
 
             override fun read(reader: JsonReader): T {
-                // Use delegate for deserialization
-                return delegate.read(reader)
+                // Use delegate for deserialization, with the native crash document back as a string
+                val element = elementAdapter.read(reader)
+                val nativeCrash = (element as? JsonObject)?.get(NATIVE_CRASH_FIELD)
+                if (element is JsonObject && nativeCrash is JsonObject) {
+                    element.addProperty(NATIVE_CRASH_FIELD, nativeCrash.toString())
+                }
+                return delegate.fromJsonTree(element)
+            }
+
+            /**
+             * Whether the whole document is one strict JSON object (no NaN or other lenient
+             * syntax), checked by skipping over it without building a tree
+             */
+            private fun isJsonObject(document: String): Boolean {
+                val valid = try {
+                    val reader = JsonReader(StringReader(document))
+                    if (reader.peek() == JsonToken.BEGIN_OBJECT) {
+                        reader.skipValue()
+                        reader.peek() == JsonToken.END_DOCUMENT
+                    } else {
+                        false
+                    }
+                } catch (e: Exception) {
+                    false
+                }
+                if (!valid) {
+                    android.util.Log.w("PayloadOptimization", "Native crash document is not a JSON object, sending it as a string")
+                }
+                return valid
             }
 
             /**
@@ -0,0 +1,121 @@
+/**
+ * Crash records for the benchmarks that read them
+ *
+ * Binary records (crash_record_format.h) written the way the enhanced
+ * handler's write_crash_to_file() writes them, with every part at its
+ * limit: 128 frames spread over this process's modules, all registers and
+ * the addresses they point to, and 2 x 256 bytes of memory with an
+ * unreadable range. Frame symbols are long, demangled C++ names, as the
+ * app resolves them on the next launch.
+ */
+
+#ifndef CRASHREPORTER_BENCH_RECORDS_H
+#define CRASHREPORTER_BENCH_RECORDS_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "crash_record_builder.h"
+#include "module_map.h"
+#include "unwind_method.h"
+
+#define BENCH_RECORD_FRAMES 128
+#define BENCH_RECORD_MEMORY 512
+#define BENCH_RECORD_BUFFER_SIZE (64 * 1024)
+
+static inline uint64_t bench_record_next(uint64_t* seed) {
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 11;
+}
+
+// An address inside one of the map's modules
+static inline uintptr_t bench_record_module_address(const ModuleMap* map, uint64_t* seed) {
+    size_t index = bench_record_next(seed) % map->count;
+    return map->starts[index] + bench_record_next(seed) % (map->ends[index] - map->starts[index]);
+}
+
+// One record; seed varies its addresses, thread and memory
+static inline std::string bench_crash_record(const ModuleMap* map, uint64_t seed) {
+    std::vector<char> buffer(BENCH_RECORD_BUFFER_SIZE);
+    FormatBuffer fmt;
+    fmt_init(&fmt, buffer.data(), buffer.size());
+
+    uintptr_t frames[BENCH_RECORD_FRAMES];
+    for (uintptr_t& frame : frames) {
+        frame = bench_record_module_address(map, &seed);
+    }
+    const CrashRecordArchInfo* arch = crash_record_arch_info(CRASH_RECORD_ARCH_NATIVE);
+    uintptr_t registers[CRASH_RECORD_MAX_REGISTERS];
+    for (size_t i = 0; i < arch->register_count; i++) {
+        registers[i] = i % 3 ? (uintptr_t)bench_record_next(&seed) : bench_record_module_address(map, &seed);
+    }
+    uintptr_t fault_address = (uintptr_t)bench_record_next(&seed) & ~(uintptr_t)0xfff;
+
+    CrashRecordHeader header;
+    crash_record_init_header(&header, SIGSEGV, SEGV_MAPERR, fault_address, 4321, 4400 + (int)(seed % 64),
+                             1760000000 + (long)(seed % 100000), UNWIND_METHOD_CFI);
+    crash_record_begin(&fmt, &header);
+    char thread_name[32];
+    snprintf(thread_name, sizeof(thread_name), "RenderThread-%u", (unsigned)(seed % 8));
+    size_t section = crash_record_begin_section(&fmt, CRASH_RECORD_SECTION_THREAD_NAME);
+    fmt_append_strn(&fmt, thread_name, sizeof(thread_name));
+    crash_record_end_section(&fmt, section);
+
+    section = crash_record_begin_section(&fmt, CRASH_RECORD_SECTION_REGISTERS);
+    fmt_append_bytes(&fmt, (const char*)registers, arch->register_count * sizeof(uintptr_t));
+    crash_record_end_section(&fmt, section);
+
+    CrashRecordModules referenced;
+    crash_record_modules_init(&referenced, map);
+    crash_record_write_frames(&fmt, &referenced, frames, BENCH_RECORD_FRAMES);
+    section = crash_record_begin_section(&fmt, CRASH_RECORD_SECTION_ADDRESSES);
+    crash_record_write_module_address(&fmt, &referenced, -1, fault_address);
+    for (size_t i = 0; i < arch->register_count; i++) {
+        if ((int)i != arch->sp) {
+            crash_record_write_module_address(&fmt, &referenced, (int)i, registers[i]);
+        }
+    }
+    crash_record_end_section(&fmt, section);
+    crash_record_write_referenced_modules(&fmt, &referenced);
+
+    // The dump around the fault address; its first page unreadable, as at the start of a mapping
+    uintptr_t memory_start = fault_address - BENCH_RECORD_MEMORY / 2;
+    uint8_t memory[BENCH_RECORD_MEMORY];
+    for (size_t i = 0; i < sizeof(memory); i++) {
+        memory[i] = i < BENCH_RECORD_MEMORY / 2 ? 0 : (uint8_t)bench_record_next(&seed);
+    }
+    section = crash_record_begin_section(&fmt, CRASH_RECORD_SECTION_MEMORY);
+    crash_record_put_varint(&fmt, memory_start);
+    crash_record_put_varint(&fmt, sizeof(memory));
+    fmt_append_bytes(&fmt, (const char*)memory, sizeof(memory));
+    crash_record_put_varint(&fmt, 1);
+    crash_record_put_varint(&fmt, 0);
+    crash_record_put_varint(&fmt, BENCH_RECORD_MEMORY / 2);
+    crash_record_end_section(&fmt, section);
+    crash_record_finish(&fmt);
+    return std::string(buffer.data(), fmt.length);
+}
+
+// A "symbol+0xdelta" per frame, as NativeCrashHandler resolves them
+static inline std::vector<std::string> bench_frame_symbols(size_t count) {
+    static const char* const kSymbols[] = {
+        "render::Mesh::draw(render::VertexBuffer const&, unsigned long) const",
+        "game::Level::update(float, game::Scenario const&)",
+        "std::__ndk1::function<void (float)>::operator()(float) const",
+        "game::World::tick(std::__ndk1::chrono::duration<long long, std::__ndk1::ratio<1l, 1000000000l> >)",
+        "android_main",
+    };
+    std::vector<std::string> symbols(count);
+    for (size_t i = 0; i < count; i++) {
+        char delta[24];
+        snprintf(delta, sizeof(delta), "+0x%zx", 0x40 + i * 0x1c);
+        symbols[i] = std::string(kSymbols[i % (sizeof(kSymbols) / sizeof(kSymbols[0]))]) + delta;
+    }
+    return symbols;
+}
+
+#endif // CRASHREPORTER_BENCH_RECORDS_H
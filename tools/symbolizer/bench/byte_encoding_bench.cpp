@@ -0,0 +1,140 @@
+/**
+ * byte_encoding.h kernels against snprintf, at memory dump sizes
+ *
+ * Encodes runs of the sizes the handler dumps (a register's neighbourhood,
+ * MEMORY_DUMP_SIZE, a page) as hex with snprintf("%02x") per byte, the
+ * scalar encoder, the SSE2 kernel and the AVX2 one, and as base64 with the
+ * scalar encoder, the SSSE3 kernel and the AVX2 one; then through
+ * hex_encode()/base64_encode(), which pick among them. Vector kernels are
+ * chained with the scalar tail as the dispatchers do. On x86 this file is
+ * built with -mssse3, the Android x86 baseline; the AVX2 kernels run only
+ * when the CPU has AVX2. Every path's output is compared with the scalar
+ * encoding first.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "byte_encoding.h"
+#include "host_bench.h"
+
+typedef size_t (*EncodeBytes)(char* out, const uint8_t* in, size_t length);
+
+struct EncodeBenchCase {
+    const char* name;
+    EncodeBytes encode;
+    EncodeBytes reference;
+};
+
+static size_t hex_snprintf(char* out, const uint8_t* in, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        snprintf(out + 2 * i, 3, "%02x", in[i]);
+    }
+    return 2 * length;
+}
+
+static size_t hex_scalar(char* out, const uint8_t* in, size_t length) {
+    hex_encode_scalar(out, in, length);
+    return 2 * length;
+}
+
+static size_t hex_dispatch(char* out, const uint8_t* in, size_t length) {
+    return hex_encode(out, in, length);
+}
+
+static size_t base64_dispatch(char* out, const uint8_t* in, size_t length) {
+    return base64_encode(out, in, length);
+}
+
+#if defined(__SSE2__)
+static size_t hex_sse2(char* out, const uint8_t* in, size_t length) {
+    size_t done = hex_encode_sse2(out, in, length);
+    hex_encode_scalar(out + 2 * done, in + done, length - done);
+    return 2 * length;
+}
+#endif
+
+#if defined(__SSSE3__)
+static size_t base64_ssse3(char* out, const uint8_t* in, size_t length) {
+    size_t done = base64_encode_ssse3(out, in, length);
+    return done / 3 * 4 + base64_encode_scalar(out + done / 3 * 4, in + done, length - done);
+}
+#endif
+
+#if defined(BYTE_ENCODING_AVX2)
+static size_t hex_avx2(char* out, const uint8_t* in, size_t length) {
+    size_t done = hex_encode_avx2(out, in, length);
+    hex_encode_scalar(out + 2 * done, in + done, length - done);
+    return 2 * length;
+}
+
+static size_t base64_avx2(char* out, const uint8_t* in, size_t length) {
+    size_t done = base64_encode_avx2(out, in, length);
+    return done / 3 * 4 + base64_encode_scalar(out + done / 3 * 4, in + done, length - done);
+}
+#endif
+
+int main(int argc, char** argv) {
+    size_t iterations = bench_iterations(argc, argv, 100000);
+    const size_t sizes[] = { 64, 256, 4096 };
+
+    std::vector<EncodeBenchCase> cases = {
+        { "hex snprintf", hex_snprintf, hex_scalar },
+        { "hex scalar", hex_scalar, hex_scalar },
+#if defined(__SSE2__)
+        { "hex SSE2", hex_sse2, hex_scalar },
+#endif
+        { "hex_encode()", hex_dispatch, hex_scalar },
+        { "base64 scalar", base64_encode_scalar, base64_encode_scalar },
+#if defined(__SSSE3__)
+        { "base64 SSSE3", base64_ssse3, base64_encode_scalar },
+#endif
+        { "base64_encode()", base64_dispatch, base64_encode_scalar },
+    };
+#if defined(BYTE_ENCODING_AVX2)
+    if (byte_encoding_has_avx2()) {
+        cases.push_back({ "hex AVX2", hex_avx2, hex_scalar });
+        cases.push_back({ "base64 AVX2", base64_avx2, base64_encode_scalar });
+    }
+#endif
+
+    std::vector<uint8_t> input(sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (uint8_t& byte : input) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        byte = (uint8_t)(seed >> 56);
+    }
+    std::vector<char> out(2 * input.size());
+    std::vector<char> expected(2 * input.size());
+
+    int mismatches = 0;
+    for (const EncodeBenchCase& test : cases) {
+        for (size_t size : sizes) {
+            size_t length = test.encode(out.data(), input.data(), size);
+            size_t expected_length = test.reference(expected.data(), input.data(), size);
+            if (length != expected_length || memcmp(out.data(), expected.data(), length) != 0) {
+                fprintf(stderr, "byte_encoding_bench: %s differs from the scalar encoding at %zu bytes\n",
+                        test.name, size);
+                mismatches++;
+            }
+        }
+    }
+    if (mismatches) {
+        return 1;
+    }
+
+    printf("byte_encoding_bench: %zu encodings per size\n", iterations);
+    for (size_t size : sizes) {
+        printf("%zu bytes\n", size);
+        for (const EncodeBenchCase& test : cases) {
+            double ns = bench_ns_per_op(iterations, [&](size_t) {
+                g_bench_sink += test.encode(out.data(), input.data(), size);
+            });
+            bench_report_bytes(test.name, ns, size);
+        }
+    }
+    return 0;
+}
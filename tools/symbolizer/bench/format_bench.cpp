@@ -0,0 +1,180 @@
+/**
+ * signal_safe_format.h against snprintf
+ *
+ * Formats the kinds of line the crash path writes (frame, register,
+ * memory dump row, thread name, fault address) from random values, once
+ * with the fmt_* helpers and once with the snprintf format they replace.
+ * Every line is compared first; the timings are per line.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "host_bench.h"
+#include "signal_safe_format.h"
+
+#define FORMAT_BENCH_LINE_SIZE 128
+
+// Random values, with the extremes every few lines
+struct FormatValues {
+    uint64_t address;
+    int64_t number;
+    uint8_t bytes[16];
+};
+
+typedef size_t (*FormatLine)(char* out, size_t size, const FormatValues& values, size_t index);
+
+static size_t frame_fmt(char* out, size_t size, const FormatValues& values, size_t index) {
+    FormatBuffer buf;
+    fmt_init(&buf, out, size);
+    fmt_append_char(&buf, '#');
+    fmt_append_udec_padded(&buf, index % 128, 2);
+    fmt_append_str(&buf, " pc ");
+    fmt_append_hex_padded(&buf, values.address, 16);
+    fmt_append_char(&buf, '\n');
+    return buf.length;
+}
+
+static size_t frame_snprintf(char* out, size_t size, const FormatValues& values, size_t index) {
+    return (size_t)snprintf(out, size, "#%02u pc %016llx\n", (unsigned)(index % 128),
+                            (unsigned long long)values.address);
+}
+
+static size_t register_fmt(char* out, size_t size, const FormatValues& values, size_t index) {
+    FormatBuffer buf;
+    fmt_init(&buf, out, size);
+    fmt_append_str(&buf, "  x");
+    fmt_append_udec_padded(&buf, index % 31, 2);
+    fmt_append_str(&buf, ":  ");
+    fmt_append_hex_padded(&buf, values.address, 16);
+    fmt_append_char(&buf, '\n');
+    return buf.length;
+}
+
+static size_t register_snprintf(char* out, size_t size, const FormatValues& values, size_t index) {
+    return (size_t)snprintf(out, size, "  x%02u:  %016llx\n", (unsigned)(index % 31),
+                            (unsigned long long)values.address);
+}
+
+static size_t memory_row_fmt(char* out, size_t size, const FormatValues& values, size_t index) {
+    FormatBuffer buf;
+    fmt_init(&buf, out, size);
+    fmt_append_hex_padded(&buf, (index * 16) % 512, 4);
+    fmt_append_str(&buf, ": ");
+    for (uint8_t byte : values.bytes) {
+        fmt_append_hex_padded(&buf, byte, 2);
+        fmt_append_char(&buf, ' ');
+    }
+    fmt_append_char(&buf, '\n');
+    return buf.length;
+}
+
+static size_t memory_row_snprintf(char* out, size_t size, const FormatValues& values, size_t index) {
+    size_t length = (size_t)snprintf(out, size, "%04x: ", (unsigned)((index * 16) % 512));
+    for (uint8_t byte : values.bytes) {
+        length += (size_t)snprintf(out + length, size - length, "%02x ", byte);
+    }
+    length += (size_t)snprintf(out + length, size - length, "\n");
+    return length;
+}
+
+static size_t thread_name_fmt(char* out, size_t size, const FormatValues& values, size_t /* index */) {
+    FormatBuffer buf;
+    fmt_init(&buf, out, size);
+    fmt_append_str(&buf, "Thread-");
+    fmt_append_dec(&buf, values.number);
+    return buf.length;
+}
+
+static size_t thread_name_snprintf(char* out, size_t size, const FormatValues& values, size_t /* index */) {
+    return (size_t)snprintf(out, size, "Thread-%lld", (long long)values.number);
+}
+
+static size_t fault_fmt(char* out, size_t size, const FormatValues& values, size_t index) {
+    FormatBuffer buf;
+    fmt_init(&buf, out, size);
+    fmt_append_str(&buf, "Fault address: 0x");
+    fmt_append_hex(&buf, values.address);
+    fmt_append_str(&buf, " (");
+    fmt_append_str(&buf, index % 2 ? "SEGV_MAPERR" : "SEGV_ACCERR");
+    fmt_append_str(&buf, ")\n");
+    return buf.length;
+}
+
+static size_t fault_snprintf(char* out, size_t size, const FormatValues& values, size_t index) {
+    return (size_t)snprintf(out, size, "Fault address: 0x%llx (%s)\n", (unsigned long long)values.address,
+                            index % 2 ? "SEGV_MAPERR" : "SEGV_ACCERR");
+}
+
+struct FormatCase {
+    const char* name;
+    FormatLine fmt;
+    FormatLine reference;
+};
+
+static std::vector<FormatValues> make_values(size_t count) {
+    std::vector<FormatValues> values(count);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < count; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        // Addresses of every magnitude, then zero, the maximum and INT64_MIN
+        values[i].address = i % 8 == 5 ? 0 : i % 8 == 6 ? UINT64_MAX : seed >> (seed % 64);
+        values[i].number = i % 8 == 7 ? INT64_MIN : (int64_t)(seed >> (seed % 64)) * (i % 2 ? -1 : 1);
+        for (size_t j = 0; j < sizeof(values[i].bytes); j++) {
+            values[i].bytes[j] = (uint8_t)(seed >> (j * 4));
+        }
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = bench_iterations(argc, argv, 1000000);
+    std::vector<FormatValues> values = make_values(4096);
+    const FormatCase cases[] = {
+        { "frame", frame_fmt, frame_snprintf },
+        { "register", register_fmt, register_snprintf },
+        { "memory row", memory_row_fmt, memory_row_snprintf },
+        { "thread name", thread_name_fmt, thread_name_snprintf },
+        { "fault address", fault_fmt, fault_snprintf },
+    };
+
+    int mismatches = 0;
+    for (const FormatCase& test : cases) {
+        for (size_t i = 0; i < values.size(); i++) {
+            char line[FORMAT_BENCH_LINE_SIZE];
+            char expected[FORMAT_BENCH_LINE_SIZE];
+            size_t length = test.fmt(line, sizeof(line), values[i], i);
+            size_t expected_length = test.reference(expected, sizeof(expected), values[i], i);
+            if (length != expected_length || memcmp(line, expected, length) != 0) {
+                fprintf(stderr, "%s: \"%.*s\" != \"%.*s\"\n", test.name, (int)length, line, (int)expected_length,
+                        expected);
+                mismatches++;
+                break;
+            }
+        }
+    }
+    if (mismatches) {
+        return 1;
+    }
+
+    printf("format_bench: %zu lines per case\n", iterations);
+    for (const FormatCase& test : cases) {
+        char line[FORMAT_BENCH_LINE_SIZE];
+        size_t mask = values.size() - 1;
+        double fmt_ns = bench_ns_per_op(iterations, [&](size_t i) {
+            g_bench_sink += test.fmt(line, sizeof(line), values[i & mask], i);
+        });
+        double snprintf_ns = bench_ns_per_op(iterations, [&](size_t i) {
+            g_bench_sink += test.reference(line, sizeof(line), values[i & mask], i);
+        });
+        printf("%s\n", test.name);
+        bench_report("signal_safe_format", fmt_ns);
+        bench_report("snprintf", snprintf_ns);
+    }
+    return 0;
+}
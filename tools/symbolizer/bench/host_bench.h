@@ -0,0 +1,50 @@
+/**
+ * Timing for the host benchmarks of the native crash handler code
+ *
+ * Each benchmark is its own executable taking an iteration count (argv[1]).
+ * ctest runs them with a small count under the "bench" label, as a smoke
+ * test: a benchmark exits non-zero when the implementations it compares
+ * disagree, so the numbers it prints are always for equivalent output.
+ *
+ *   ctest --test-dir BUILD -L bench -V
+ *   BUILD/format-bench 1000000
+ */
+
+#ifndef CRASHREPORTER_HOST_BENCH_H
+#define CRASHREPORTER_HOST_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+// Keeps the timed results observable so the loops are not optimized away
+static volatile uint64_t g_bench_sink = 0;
+
+static inline size_t bench_iterations(int argc, char** argv, size_t fallback) {
+    size_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 0;
+    return iterations ? iterations : fallback;
+}
+
+// Nanoseconds per call of body(i), for i in [0, iterations)
+template <typename Body>
+static inline double bench_ns_per_op(size_t iterations, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        body(i);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (double)iterations;
+}
+
+static inline void bench_report(const char* name, double ns_per_op) {
+    printf("  %-28s %10.1f ns/op\n", name, ns_per_op);
+}
+
+// Also as throughput, for operations over bytes_per_op bytes of input
+static inline void bench_report_bytes(const char* name, double ns_per_op, size_t bytes_per_op) {
+    printf("  %-28s %10.1f ns/op %10.1f MB/s\n", name, ns_per_op, (double)bytes_per_op * 1e3 / ns_per_op);
+}
+
+#endif // CRASHREPORTER_HOST_BENCH_H
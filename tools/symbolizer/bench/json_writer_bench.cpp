@@ -0,0 +1,167 @@
+/**
+ * json_writer.h throughput and peak stack use
+ *
+ * Renders records at the handler's limits (bench_records.h) as the JSON
+ * document the app uploads, into a fixed buffer as crash_record_to_json()
+ * does, and times the whole document, the escaping of the frame symbols
+ * and the base64 of the memory dump, per byte of output. The document
+ * written into the fixed buffer must equal crash_record_to_json()'s.
+ *
+ * Peak stack use is measured by painting: the document is rendered on a
+ * thread whose stack is filled with a pattern beforehand, and the deepest
+ * byte no longer holding it marks the peak. An empty thread on the same
+ * kind of stack is measured too and subtracted, which leaves out the
+ * thread's start-up frames and, on glibc, its TLS.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "bench_records.h"
+#include "crash_record_decoder.h"
+#include "host_bench.h"
+
+#define JSON_BENCH_RECORDS 16
+#define JSON_BENCH_STACK_SIZE (256 * 1024)
+#define JSON_BENCH_STACK_PAINT 0xa5
+
+struct JsonBenchInput {
+    CrashRecord record;
+    std::vector<const char*> symbols;
+    std::vector<char>* buffer;
+    size_t length;              // Of the document written
+};
+
+static size_t write_document(const JsonBenchInput* input, char* buffer, size_t size) {
+    FormatBuffer fmt;
+    fmt_init(&fmt, buffer, size);
+    JsonWriter json;
+    json_writer_init(&json, &fmt);
+    crash_record_write_json(&json, input->record, input->symbols.data());
+    return json_finish(&json) ? fmt.length : 0;
+}
+
+static void* render_document(void* arg) {
+    JsonBenchInput* input = (JsonBenchInput*)arg;
+    input->length = write_document(input, input->buffer->data(), input->buffer->size());
+    return nullptr;
+}
+
+static void* do_nothing(void* /* arg */) {
+    return nullptr;
+}
+
+// Bytes of a painted stack that body(arg) overwrote on a thread of its own; 0 if it could not run
+static size_t painted_stack_use(void* (*body)(void*), void* arg) {
+    uint8_t* stack = (uint8_t*)aligned_alloc(4096, JSON_BENCH_STACK_SIZE);
+    if (!stack) {
+        return 0;
+    }
+    memset(stack, JSON_BENCH_STACK_PAINT, JSON_BENCH_STACK_SIZE);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, JSON_BENCH_STACK_SIZE);
+    pthread_t thread;
+    size_t used = 0;
+    if (pthread_create(&thread, &attr, body, arg) == 0) {
+        pthread_join(thread, nullptr);
+        // The stack grows down: the lowest overwritten byte is the peak
+        size_t lowest = 0;
+        while (lowest < JSON_BENCH_STACK_SIZE && stack[lowest] == JSON_BENCH_STACK_PAINT) {
+            lowest++;
+        }
+        used = JSON_BENCH_STACK_SIZE - lowest;
+    }
+    pthread_attr_destroy(&attr);
+    free(stack);
+    return used;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = bench_iterations(argc, argv, 10000);
+    module_map_build();
+    const ModuleMap* map = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE);
+    if (!map || map->count == 0) {
+        return 1;
+    }
+
+    std::vector<std::string> symbols = bench_frame_symbols(BENCH_RECORD_FRAMES);
+    std::vector<char> buffer(BENCH_RECORD_BUFFER_SIZE * 2);
+    std::vector<JsonBenchInput> inputs(JSON_BENCH_RECORDS);
+    size_t document_bytes = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::string bytes = bench_crash_record(map, i + 1);
+        JsonBenchInput& input = inputs[i];
+        size_t consumed = 0;
+        if (!crash_record_decode(bytes.data(), bytes.size(), &input.record, &consumed) ||
+            input.record.frames.size() != BENCH_RECORD_FRAMES || input.record.memory.size() != BENCH_RECORD_MEMORY) {
+            fprintf(stderr, "json_writer_bench: record %zu did not decode whole\n", i);
+            return 1;
+        }
+        for (const std::string& symbol : symbols) {
+            input.symbols.push_back(symbol.c_str());
+        }
+        input.buffer = &buffer;
+        std::string expected = crash_record_to_json(input.record, input.symbols.data());
+        size_t length = write_document(&input, buffer.data(), buffer.size());
+        if (length != expected.size() || memcmp(buffer.data(), expected.data(), length) != 0) {
+            fprintf(stderr, "json_writer_bench: record %zu renders differently into a fixed buffer\n", i);
+            return 1;
+        }
+        document_bytes += length;
+    }
+    size_t mask = inputs.size() - 1;
+    size_t average_bytes = document_bytes / inputs.size();
+
+    printf("json_writer_bench: %zu documents of %zu frames, %zu bytes on average\n", iterations,
+           (size_t)BENCH_RECORD_FRAMES, average_bytes);
+    double document_ns = bench_ns_per_op(iterations, [&](size_t i) {
+        g_bench_sink += write_document(&inputs[i & mask], buffer.data(), buffer.size());
+    });
+    bench_report_bytes("document", document_ns, average_bytes);
+
+    size_t symbol_bytes = 0;
+    for (const std::string& symbol : symbols) {
+        symbol_bytes += symbol.size() + 2;
+    }
+    double symbols_ns = bench_ns_per_op(iterations, [&](size_t) {
+        FormatBuffer fmt;
+        fmt_init(&fmt, buffer.data(), buffer.size());
+        JsonWriter json;
+        json_writer_init(&json, &fmt);
+        json_begin_array(&json);
+        for (const std::string& symbol : symbols) {
+            json_string_n(&json, symbol.data(), symbol.size());
+        }
+        json_finish(&json);
+        g_bench_sink += fmt.length;
+    });
+    bench_report_bytes("frame symbols (escaped)", symbols_ns, symbol_bytes);
+
+    const std::string& memory = inputs[0].record.memory;
+    double memory_ns = bench_ns_per_op(iterations, [&](size_t) {
+        FormatBuffer fmt;
+        fmt_init(&fmt, buffer.data(), buffer.size());
+        JsonWriter json;
+        json_writer_init(&json, &fmt);
+        json_base64_bytes(&json, memory.data(), memory.size());
+        g_bench_sink += fmt.length;
+    });
+    bench_report_bytes("memory (base64)", memory_ns, base64_encoded_length(memory.size()) + 2);
+
+    size_t baseline = painted_stack_use(do_nothing, nullptr);
+    size_t peak = painted_stack_use(render_document, &inputs[0]);
+    if (peak == 0 || peak <= baseline || inputs[0].length == 0) {
+        fprintf(stderr, "json_writer_bench: stack use not measured\n");
+        return 1;
+    }
+    printf("  %-28s %10zu bytes (thread start-up %zu bytes excluded)\n", "peak stack, document", peak - baseline,
+           baseline);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * Module map builds and build-id reads, timed over this process's modules
+ *
+ * A cold build parses every module's build-id note and .eh_frame_hdr from
+ * its mapped headers; a warm rebuild reuses them for the modules that are
+ * still loaded; an unchanged refresh only compares the loader counters.
+ * Reading the same build-ids from the files on disk is timed alongside, and
+ * every build-id in the map must match its file before timings are printed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elf_symbolizer.h"
+#include "host_bench.h"
+#include "module_map.h"
+
+// Forget the published map, so the next build parses every module again
+static void module_map_forget() {
+    __atomic_store_n(&g_module_map, (ModuleMap*)nullptr, __ATOMIC_RELEASE);
+}
+
+// Modules whose file could be read; false if any of their build-ids differ from the map
+static bool check_build_ids(const ModuleMap* map, size_t* checked) {
+    *checked = 0;
+    for (size_t i = 0; i < map->count; i++) {
+        const LoadedModule* module = &map->modules[i];
+        const char* path = module_map_path(map, module);
+        ElfBuildId from_file;
+        if (path[0] != '/' || !elf_file_build_id(path, &from_file)) {
+            continue;   // Main executable (empty name) and the vDSO
+        }
+        if (!elf_build_id_equal(&module->build_id, &from_file)) {
+            fprintf(stderr, "module_map_bench: build-id of %s differs from its file\n", path);
+            return false;
+        }
+        (*checked)++;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = bench_iterations(argc, argv, 10000);
+    module_map_build();
+    const ModuleMap* map = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE);
+    size_t checked = 0;
+    if (!map || !check_build_ids(map, &checked) || checked == 0) {
+        return 1;
+    }
+
+    printf("module_map_bench: %zu modules (%zu build-ids checked against their files), %zu builds\n", map->count,
+           checked, iterations);
+    double cold_ns = bench_ns_per_op(iterations, [](size_t) {
+        module_map_forget();
+        module_map_build();
+    });
+    double warm_ns = bench_ns_per_op(iterations, [](size_t) {
+        module_map_build();
+    });
+    double refresh_ns = bench_ns_per_op(iterations, [](size_t) {
+        g_bench_sink += module_map_refresh_if_changed();
+    });
+    double file_ns = bench_ns_per_op(iterations, [map](size_t) {
+        for (size_t i = 0; i < map->count; i++) {
+            ElfBuildId build_id;
+            g_bench_sink += elf_file_build_id(module_map_path(map, &map->modules[i]), &build_id);
+        }
+    });
+    bench_report("cold build", cold_ns);
+    bench_report("warm rebuild", warm_ns);
+    bench_report("unchanged refresh", refresh_ns);
+    bench_report("build-ids from files", file_ns);
+    return 0;
+}
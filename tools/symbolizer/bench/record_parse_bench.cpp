@@ -0,0 +1,436 @@
+/**
+ * NativeCrashHandler.parseNativeCrash(): the native parse against the Kotlin one it replaced
+ *
+ * Both paths turn a binary record at the handler's limits (bench_records.h:
+ * 128 frames, registers, a memory dump) into the report the app builds its
+ * CrashData from, with the frames symbolized:
+ *
+ *   native  crash_record_decode() and crash_record_report(), the code
+ *           nativeParseRecord runs, then symbolizeFrames()'s batching and
+ *           stack trace lines
+ *   text    crash_record_to_text() (nativeDecodeRecord), then
+ *           symbolizeNativeCrash() and parseTextRecord() as they are
+ *           written in Kotlin, modeled line for line in C++
+ *
+ * Symbol lookups (nativeSymbolize) are the same stub in both, so neither
+ * pays for reading module files. The model is cheaper than the code it
+ * stands for: its MODULE_FRAME and MODULE_ENTRY matchers are hand-written
+ * rather than java.util.regex, and it allocates no JVM strings, so the
+ * text path's time is a lower bound. The native path's JNI calls (about
+ * two hundred NewStringUTF) are not timed either. Both must produce the
+ * same report for every record before anything is timed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bench_records.h"
+#include "crash_record_decoder.h"
+#include "host_bench.h"
+
+#define PARSE_BENCH_RECORDS 16
+
+// The NativeCrashReport fields CrashData is built from
+struct ParsedReport {
+    std::string signal;
+    std::string description;
+    std::string fault_address;
+    std::string thread_name;
+    std::string stack_trace;
+    std::string memory_dump;
+    std::vector<std::string> register_names;
+    std::vector<std::string> register_values;
+    std::vector<std::string> secondary_crashes;
+};
+
+// Stands in for nativeSymbolize(): one name per offset, the same in both paths
+static std::vector<std::string> resolve_offsets(const std::vector<uint64_t>& offsets) {
+    static const std::vector<std::string> names = bench_frame_symbols(64);
+    std::vector<std::string> resolved(offsets.size());
+    for (size_t i = 0; i < offsets.size(); i++) {
+        resolved[i] = names[offsets[i] % names.size()];
+    }
+    return resolved;
+}
+
+static std::string hex(uint64_t value) {
+    char digits[24];
+    snprintf(digits, sizeof(digits), "%llx", (unsigned long long)value);
+    return digits;
+}
+
+// ---- Native: nativeParseRecord, then symbolizeFrames() ----
+
+static bool parse_binary(const std::string& bytes, ParsedReport* report) {
+    CrashRecord record;
+    size_t consumed = 0;
+    if (!crash_record_decode(bytes.data(), bytes.size(), &record, &consumed)) {
+        return false;
+    }
+    CrashRecordReport fields;
+    crash_record_report(record, &fields);
+    report->signal = fields.signal;
+    report->description = crash_signal_description(record.header.signal);
+    report->fault_address = fields.fault_address;
+    report->thread_name = record.thread_name;
+    report->register_names = fields.register_names;
+    report->register_values = fields.register_values;
+    report->secondary_crashes = fields.secondary_crashes;
+    report->memory_dump = fields.memory_dump;
+
+    // One batch of distinct offsets per module
+    size_t frame_count = fields.frame_pcs.size();
+    std::vector<std::string> symbols(frame_count);
+    std::vector<bool> resolved(frame_count);
+    for (size_t module = 0; module < fields.module_paths.size(); module++) {
+        std::vector<uint64_t> offsets;
+        std::unordered_set<uint64_t> seen;
+        for (size_t frame = 0; frame < frame_count; frame++) {
+            uint64_t offset = (uint64_t)fields.frame_offsets[frame];
+            if (fields.frame_modules[frame] == (int32_t)module && seen.insert(offset).second) {
+                offsets.push_back(offset);
+            }
+        }
+        if (offsets.empty()) {
+            continue;
+        }
+        std::vector<std::string> names = resolve_offsets(offsets);
+        std::unordered_map<uint64_t, std::string> by_offset;
+        for (size_t i = 0; i < offsets.size(); i++) {
+            by_offset[offsets[i]] = names[i];
+        }
+        for (size_t frame = 0; frame < frame_count; frame++) {
+            if (fields.frame_modules[frame] == (int32_t)module) {
+                symbols[frame] = by_offset[(uint64_t)fields.frame_offsets[frame]];
+                resolved[frame] = true;
+            }
+        }
+    }
+
+    size_t index_width = frame_count > 100 ? 3 : 2;
+    std::string& stack_trace = report->stack_trace;
+    stack_trace.reserve(frame_count * 96);
+    for (size_t frame = 0; frame < frame_count; frame++) {
+        std::string index = std::to_string(frame);
+        stack_trace += '#';
+        stack_trace.append(index.size() < index_width ? index_width - index.size() : 0, '0');
+        stack_trace += index;
+        stack_trace += " pc 0x";
+        stack_trace += hex((uint64_t)fields.frame_pcs[frame]);
+        int32_t module = fields.frame_modules[frame];
+        if (module < 0) {
+            stack_trace += " ???\n";
+            continue;
+        }
+        stack_trace += ' ';
+        stack_trace += fields.module_paths[module];
+        stack_trace += " (";
+        stack_trace += resolved[frame] ? symbols[frame] : "???+0x" + hex((uint64_t)fields.frame_offsets[frame]);
+        stack_trace += ")\n";
+    }
+    return true;
+}
+
+// ---- Text: nativeDecodeRecord, then symbolizeNativeCrash() and parseTextRecord() ----
+
+static std::vector<std::string> split_lines(const std::string& content) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = content.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(content.substr(start, end - start));
+    }
+    lines.push_back(content.substr(start));
+    return lines;
+}
+
+static bool is_hex(char c, bool upper) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (upper && c >= 'A' && c <= 'F');
+}
+
+// Advances past one or more characters of a class; false if there is none
+template <typename Class>
+static bool skip_run(const std::string& line, size_t* at, Class in_class) {
+    size_t start = *at;
+    while (*at < line.size() && in_class(line[*at])) {
+        (*at)++;
+    }
+    return *at > start;
+}
+
+static bool skip_literal(const std::string& line, size_t* at, const char* literal) {
+    size_t length = strlen(literal);
+    if (line.compare(*at, length, literal) != 0) {
+        return false;
+    }
+    *at += length;
+    return true;
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// MODULE_FRAME: ^(#\d+ pc 0x[0-9a-fA-F]+|[a-z]+\d*) \[(\d+)]\+0x([0-9a-fA-F]+)$
+static bool match_frame(const std::string& line, std::string* prefix, int* module, std::string* offset) {
+    size_t at = 0;
+    if (skip_literal(line, &at, "#")) {
+        if (!skip_run(line, &at, is_digit) || !skip_literal(line, &at, " pc 0x") ||
+            !skip_run(line, &at, [](char c) { return is_hex(c, true); })) {
+            return false;
+        }
+    } else {
+        if (!skip_run(line, &at, [](char c) { return c >= 'a' && c <= 'z'; })) {
+            return false;
+        }
+        skip_run(line, &at, is_digit);
+    }
+    size_t prefix_end = at;
+    if (!skip_literal(line, &at, " [")) {
+        return false;
+    }
+    size_t module_start = at;
+    if (!skip_run(line, &at, is_digit)) {
+        return false;
+    }
+    size_t module_end = at;
+    if (!skip_literal(line, &at, "]+0x")) {
+        return false;
+    }
+    size_t offset_start = at;
+    if (!skip_run(line, &at, [](char c) { return is_hex(c, true); }) || at != line.size()) {
+        return false;
+    }
+    *prefix = line.substr(0, prefix_end);
+    *module = atoi(line.substr(module_start, module_end - module_start).c_str());
+    *offset = line.substr(offset_start);
+    return true;
+}
+
+// MODULE_ENTRY: ^\[(\d+)] 0x[0-9a-fA-F]+ (?:([0-9a-f]+|-) )?(.*)$
+static bool match_module_entry(const std::string& line, int* module, std::string* build_id, std::string* path) {
+    size_t at = 0;
+    if (!skip_literal(line, &at, "[")) {
+        return false;
+    }
+    size_t module_start = at;
+    if (!skip_run(line, &at, is_digit)) {
+        return false;
+    }
+    size_t module_end = at;
+    if (!skip_literal(line, &at, "] 0x") || !skip_run(line, &at, [](char c) { return is_hex(c, true); }) ||
+        !skip_literal(line, &at, " ")) {
+        return false;
+    }
+    *module = atoi(line.substr(module_start, module_end - module_start).c_str());
+    size_t token_end = line.find(' ', at);
+    bool dash = token_end == at + 1 && line[at] == '-';
+    bool hex_token = token_end != std::string::npos && token_end > at;
+    for (size_t i = at; hex_token && i < token_end; i++) {
+        hex_token = is_hex(line[i], false);
+    }
+    if (dash || hex_token) {
+        *build_id = line.substr(at, token_end - at);
+        at = token_end + 1;
+    } else {
+        build_id->clear();
+    }
+    *path = line.substr(at);
+    return true;
+}
+
+static uint64_t module_offset_key(int module, uint64_t offset) {
+    return (uint64_t)module << 48 ^ offset;
+}
+
+static std::string symbolize_text(const std::string& content) {
+    std::vector<std::string> lines = split_lines(content);
+
+    std::unordered_map<int, std::string> module_paths;
+    std::unordered_map<int, std::string> module_build_ids;
+    bool in_modules = false;
+    for (const std::string& line : lines) {
+        if (line == "MODULES:") {
+            in_modules = true;
+            continue;
+        }
+        if (in_modules) {
+            int module = 0;
+            std::string build_id;
+            std::string path;
+            if (!match_module_entry(line, &module, &build_id, &path)) {
+                in_modules = false;
+            } else {
+                module_paths[module] = path;
+                module_build_ids[module] = build_id == "-" ? "" : build_id;
+            }
+        }
+    }
+    if (module_paths.empty()) {
+        return content;
+    }
+
+    std::unordered_map<int, std::vector<uint64_t>> offsets_by_module;
+    std::unordered_set<uint64_t> seen;
+    for (const std::string& line : lines) {
+        std::string prefix;
+        int module = 0;
+        std::string offset;
+        if (match_frame(line, &prefix, &module, &offset) && module_paths.count(module)) {
+            uint64_t value = strtoull(offset.c_str(), nullptr, 16);
+            if (seen.insert(module_offset_key(module, value)).second) {
+                offsets_by_module[module].push_back(value);
+            }
+        }
+    }
+    std::unordered_map<uint64_t, std::string> symbols;
+    for (const auto& entry : offsets_by_module) {
+        std::vector<std::string> names = resolve_offsets(entry.second);
+        for (size_t i = 0; i < entry.second.size(); i++) {
+            symbols[module_offset_key(entry.first, entry.second[i])] = names[i];
+        }
+    }
+
+    std::string out;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i > 0) {
+            out += '\n';
+        }
+        const std::string& line = lines[i];
+        std::string prefix;
+        int module = 0;
+        std::string offset;
+        auto path = match_frame(line, &prefix, &module, &offset) ? module_paths.find(module) : module_paths.end();
+        if (path == module_paths.end()) {
+            out += line;
+            continue;
+        }
+        auto symbol = symbols.find(module_offset_key(module, strtoull(offset.c_str(), nullptr, 16)));
+        out += prefix + " " + path->second + " (" + (symbol != symbols.end() ? symbol->second : "???+0x" + offset) +
+               ")";
+    }
+    return out;
+}
+
+static std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t");
+    size_t end = text.find_last_not_of(" \t");
+    return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+}
+
+static bool starts_with(const std::string& text, const char* prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (size_t end; (end = text.find(separator, start)) != std::string::npos; start = end + 1) {
+        parts.push_back(text.substr(start, end - start));
+    }
+    parts.push_back(text.substr(start));
+    return parts;
+}
+
+static void parse_text_record(const std::string& content, ParsedReport* report) {
+    bool in_registers = false;
+    bool in_stack_trace = false;
+    bool in_memory_dump = false;
+    bool in_secondary_crashes = false;
+    for (const std::string& line : split_lines(content)) {
+        if (starts_with(line, "Signal:")) {
+            report->signal = trim(line.substr(7));
+        } else if (starts_with(line, "Description:")) {
+            report->description = trim(line.substr(12));
+        } else if (starts_with(line, "Fault Address:")) {
+            report->fault_address = trim(line.substr(14));
+        } else if (starts_with(line, "Thread:")) {
+            report->thread_name = trim(line.substr(7));
+        } else if (starts_with(line, "SECONDARY CRASHES:")) {
+            in_secondary_crashes = true;
+        } else if (starts_with(line, "REGISTERS:")) {
+            in_registers = true, in_stack_trace = false, in_memory_dump = false, in_secondary_crashes = false;
+        } else if (starts_with(line, "STACK TRACE:")) {
+            in_registers = false, in_stack_trace = true, in_memory_dump = false, in_secondary_crashes = false;
+        } else if (starts_with(line, "MEMORY DUMP:")) {
+            in_registers = false, in_stack_trace = false, in_memory_dump = true, in_secondary_crashes = false;
+        } else if (in_secondary_crashes && starts_with(trim(line), "tid ")) {
+            report->secondary_crashes.push_back(trim(line));
+        } else if (in_registers && line.find(':') != std::string::npos) {
+            std::vector<std::string> parts = split(trim(line), ':');
+            if (parts.size() == 2) {
+                report->register_names.push_back(trim(parts[0]));
+                report->register_values.push_back(trim(parts[1]));
+            }
+        } else if (in_stack_trace && (starts_with(line, "#") || starts_with(trim(line), "at "))) {
+            report->stack_trace += line + "\n";
+        } else if (in_memory_dump) {
+            report->memory_dump += line + "\n";
+        }
+    }
+    if (report->stack_trace.empty()) {
+        report->stack_trace = content;
+    }
+}
+
+static bool parse_text(const std::string& bytes, ParsedReport* report) {
+    CrashRecord record;
+    size_t consumed = 0;
+    if (!crash_record_decode(bytes.data(), bytes.size(), &record, &consumed)) {
+        return false;
+    }
+    parse_text_record(symbolize_text(crash_record_to_text(record)), report);
+    return true;
+}
+
+// ----
+
+static bool same_report(const ParsedReport& native, const ParsedReport& text) {
+    // The text layout ends with a newline, which parseTextRecord() keeps as an empty last dump line
+    return native.signal == text.signal && native.description == text.description &&
+           native.fault_address == text.fault_address && native.thread_name == text.thread_name &&
+           native.stack_trace == text.stack_trace && native.memory_dump + "\n" == text.memory_dump &&
+           native.register_names == text.register_names && native.register_values == text.register_values &&
+           native.secondary_crashes == text.secondary_crashes;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = bench_iterations(argc, argv, 10000);
+    module_map_build();
+    const ModuleMap* map = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE);
+    if (!map || map->count == 0) {
+        return 1;
+    }
+
+    std::vector<std::string> records(PARSE_BENCH_RECORDS);
+    for (size_t i = 0; i < records.size(); i++) {
+        records[i] = bench_crash_record(map, i + 1);
+        ParsedReport native;
+        ParsedReport text;
+        if (!parse_binary(records[i], &native) || !parse_text(records[i], &text) || !same_report(native, text)) {
+            fprintf(stderr, "record_parse_bench: record %zu parses differently\n", i);
+            return 1;
+        }
+    }
+    size_t mask = records.size() - 1;
+
+    printf("record_parse_bench: %zu records of %zu frames with %zu bytes of memory\n", iterations,
+           (size_t)BENCH_RECORD_FRAMES, (size_t)BENCH_RECORD_MEMORY);
+    double native_ns = bench_ns_per_op(iterations, [&](size_t i) {
+        ParsedReport report;
+        g_bench_sink += parse_binary(records[i & mask], &report);
+    });
+    double text_ns = bench_ns_per_op(iterations, [&](size_t i) {
+        ParsedReport report;
+        g_bench_sink += parse_text(records[i & mask], &report);
+    });
+    bench_report("native parse", native_ns);
+    bench_report("text layout, Kotlin model", text_ns);
+    return 0;
+}
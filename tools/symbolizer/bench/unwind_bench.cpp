@@ -0,0 +1,132 @@
+/**
+ * Stack unwinders of stack_unwinder.h, timed from the same context
+ *
+ * A recursion UNWIND_BENCH_DEPTH calls deep faults, and its SIGSEGV handler
+ * times every unwinder from the context it receives, as the crash handler
+ * would walk it. The CFI walk reads the same .eh_frame_hdr tables as
+ * _Unwind_Backtrace, without its locks. The frame-pointer walk needs frame
+ * records, so this file is built with -fno-omit-frame-pointer. All traces
+ * must list the faulting pc and the recursion frames identically before
+ * any timing is printed.
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_bench.h"
+#include "stack_unwinder.h"
+
+#define UNWIND_BENCH_DEPTH 48
+#define UNWIND_BENCH_FRAMES 128
+
+struct UnwindBenchCase {
+    const char* name;
+    size_t (*unwind)(const void* context, const ModuleMap* modules, uintptr_t* frames, size_t max_frames);
+};
+
+static size_t unwind_with_backtrace(const void* context, const ModuleMap* modules, uintptr_t* frames,
+                                    size_t max_frames) {
+    UnwindMethod method = UNWIND_METHOD_NONE;
+    return capture_stack_from_context(context, modules, frames, max_frames, &method);
+}
+
+static size_t unwind_with_frame_pointers(const void* context, const ModuleMap* /* modules */,
+                                         uintptr_t* frames, size_t max_frames) {
+    UnwindRegisters regs;
+    StackBounds bounds;
+    if (!crash_context_registers(context, &regs) || !crash_thread_stack_bounds(regs.sp, &bounds)) {
+        return 0;
+    }
+    return unwind_frame_pointers(&regs, &bounds, frames, max_frames);
+}
+
+static size_t unwind_with_cfi(const void* context, const ModuleMap* modules, uintptr_t* frames, size_t max_frames) {
+    UnwindRegisters regs;
+    StackBounds bounds;
+    if (!crash_context_registers(context, &regs) || !crash_thread_stack_bounds(regs.sp, &bounds)) {
+        return 0;
+    }
+    return unwind_cfi(context, &bounds, modules, frames, max_frames);
+}
+
+static const UnwindBenchCase kUnwinders[] = {
+    { "_Unwind_Backtrace", unwind_with_backtrace },
+    { "frame pointers", unwind_with_frame_pointers },
+    { "CFI", unwind_with_cfi },
+};
+
+static size_t g_iterations = 0;
+static const ModuleMap* g_modules = nullptr;
+
+// The frames every unwinder must agree on: the pc, then the recursion's return addresses
+static bool same_recursion(const uintptr_t* a, size_t a_count, const uintptr_t* b, size_t b_count) {
+    if (a_count < UNWIND_BENCH_DEPTH || b_count < UNWIND_BENCH_DEPTH) {
+        return false;
+    }
+    for (size_t i = 0; i < UNWIND_BENCH_DEPTH; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bench_handler(int /* sig */, siginfo_t* /* info */, void* context) {
+    const ModuleMap* modules = g_modules;
+    int mismatches = 0;
+    const size_t count = sizeof(kUnwinders) / sizeof(kUnwinders[0]);
+    uintptr_t traces[count][UNWIND_BENCH_FRAMES];
+    size_t lengths[count];
+    for (size_t u = 0; u < count; u++) {
+        lengths[u] = kUnwinders[u].unwind(context, modules, traces[u], UNWIND_BENCH_FRAMES);
+        if (!same_recursion(traces[0], lengths[0], traces[u], lengths[u])) {
+            fprintf(stderr, "unwind_bench: %s disagrees with %s (%zu and %zu frames)\n", kUnwinders[u].name,
+                    kUnwinders[0].name, lengths[u], lengths[0]);
+            mismatches++;
+        }
+    }
+    if (mismatches) {
+        _exit(1);
+    }
+
+    printf("unwind_bench: %zu walks of %zu frames or more\n", g_iterations, (size_t)UNWIND_BENCH_DEPTH);
+    for (size_t u = 0; u < count; u++) {
+        uintptr_t frames[UNWIND_BENCH_FRAMES];
+        double ns = bench_ns_per_op(g_iterations, [&](size_t) {
+            g_bench_sink += kUnwinders[u].unwind(context, modules, frames, UNWIND_BENCH_FRAMES);
+        });
+        bench_report(kUnwinders[u].name, ns);
+    }
+    fflush(stdout);
+    _exit(0);
+}
+
+static void __attribute__((noinline)) recurse(int depth) {
+    if (depth == 0) {
+        volatile int* volatile address = nullptr;
+        *address = 1;
+    } else {
+        recurse(depth - 1);
+    }
+    __asm__ volatile("" ::: "memory");  // Not a tail call
+}
+
+int main(int argc, char** argv) {
+    g_iterations = bench_iterations(argc, argv, 100000);
+    stack_unwinder_init();
+    g_modules = module_map_begin_crash();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = bench_handler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, nullptr);
+
+    // The faulting pc, then UNWIND_BENCH_DEPTH - 1 return addresses into the recursion
+    recurse(UNWIND_BENCH_DEPTH - 1);
+    return 1;
+}
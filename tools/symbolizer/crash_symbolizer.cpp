@@ -0,0 +1,798 @@
+/**
+ * Offline symbolizer for native crash records
+ *
+ * Reads crash records as the handler writes them (binary records, see
+ * crash_record_format.h, or the text of older versions: frames and
+ * addresses as "[module]+0xoffset", followed by the module table with
+ * build-ids) and prints them with every frame resolved to
+ * "path (function+0xdelta)", demangled through a memoizing cache.
+ * Unstripped libraries are found in a symbol directory by build-id, or by
+ * file name for records without one. Each library is loaded once into a
+ * symbol index (symbol_index.h) that stays cached across all the records
+ * of a run.
+ *
+ * Libraries with debug info also give each address its source line and
+ * the functions inlined there (dwarf_line_index.h), outermost first:
+ *
+ *   #03 pc 0x7f3a41c2 /data/app/.../libgame.so (Game::update()+0x1c) at src/game.cpp:42
+ *       inlined Vec::length() const at src/vec.h:18
+ *       inlined Vec::dot(Vec const&) const at src/vec.h:12
+ *
+ *   crash-symbolizer --symbols DIR [RECORD...]     (stdin when no record is given)
+ *   crash-symbolizer --symbols DIR --bench FRAMES [RECORD...]
+ *   crash-symbolizer --bench-lookup LIBRARY LOOKUPS
+ *   crash-symbolizer --bench-demangle LIBRARY NAMES
+ *   crash-symbolizer --bench-lines LIBRARY LOOKUPS
+ *   crash-symbolizer --bench-debugdata LIBRARY LOADS
+ *
+ * --bench reports the symbolization throughput over the binary records
+ * given, repeated up to FRAMES frames (testdata/corpus holds recorded ones
+ * with their libraries), or without records over a synthetic corpus built
+ * from the symbols in DIR. --bench-lookup compares single address lookups
+ * in one library: symbol index, sorted vector, dladdr().
+ * --bench-demangle demangles a skewed stream of the library's C++ symbol
+ * names (few hot frames, long tail) with and without the cache.
+ * --bench-lines times opening the library's debug info and resolving
+ * random code addresses to lines and inline chains, cold and warm.
+ * --bench-debugdata loads a stripped library whose local symbols are in
+ * .gnu_debugdata (MiniDebugInfo), decompressing them each time, and
+ * compares that with mapping its index from the build-id cache.
+ */
+
+#include <ctype.h>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Batch tool: a generation holds the names of several large libraries
+#define DEMANGLE_CACHE_ARENA_SIZE (32 * 1024 * 1024)
+#define DEMANGLE_CACHE_SLOTS (256 * 1024)
+
+#include "crash_record_decoder.h"
+#include "demangle_cache.h"
+#include "dwarf_line_index.h"
+#include "elf_build_id.h"
+#include "elf_symbolizer.h"
+#include "symbol_cache.h"
+#include "symbol_index.h"
+
+// Frames per record in the --bench corpus
+#define BENCH_FRAMES_PER_RECORD 32
+
+// Lookups timed for dladdr() in --bench-lookup
+#define BENCH_DLADDR_LOOKUPS 20000
+
+struct SymbolFile {
+    std::string path;
+    bool loaded = false;                                // Load attempted
+    bool usable = false;
+    ElfSymbolTable table;
+    std::string index_image;
+    SymbolIndex index;
+    bool has_lines = false;                             // Debug info opened
+    DwarfLineIndex lines;
+};
+
+// Shared by all libraries: records repeat the same frames heavily
+static DemangleCache g_demangle_cache;
+
+struct SymbolStore {
+    std::unordered_map<std::string, std::unique_ptr<SymbolFile>> by_build_id;   // Lowercase hex
+    std::unordered_map<std::string, SymbolFile*> by_file_name;
+};
+
+// Module table entry of the record being symbolized
+struct RecordModule {
+    std::string build_id;       // Empty if unknown
+    std::string path;
+};
+
+static std::string build_id_hex(const ElfBuildId* build_id) {
+    static const char kHexDigits[] = "0123456789abcdef";
+    std::string hex;
+    for (size_t i = 0; i < build_id->length; i++) {
+        hex += kHexDigits[build_id->bytes[i] >> 4];
+        hex += kHexDigits[build_id->bytes[i] & 0xf];
+    }
+    return hex;
+}
+
+static std::string file_name_of(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Index every ELF file under dir by build-id; symbols are loaded on first use
+static size_t index_symbol_dir(const std::string& dir, SymbolStore* store) {
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied,
+                                                     error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (!it->is_regular_file(error)) {
+            continue;
+        }
+        std::string path = it->path().string();
+        ElfBuildId build_id;
+        if (!elf_file_build_id(path.c_str(), &build_id)) {
+            continue;
+        }
+        std::unique_ptr<SymbolFile>& file = store->by_build_id[build_id_hex(&build_id)];
+        if (file) {
+            continue;
+        }
+        file.reset(new SymbolFile());
+        file->path = path;
+        store->by_file_name.emplace(file_name_of(path), file.get());
+    }
+    return store->by_build_id.size();
+}
+
+static SymbolFile* find_symbol_file(SymbolStore* store, const RecordModule& module) {
+    SymbolFile* file = nullptr;
+    if (!module.build_id.empty()) {
+        auto it = store->by_build_id.find(module.build_id);
+        file = it == store->by_build_id.end() ? nullptr : it->second.get();
+    } else {
+        // Records without build-id: best effort by file name
+        auto it = store->by_file_name.find(file_name_of(module.path));
+        file = it == store->by_file_name.end() ? nullptr : it->second;
+    }
+    if (file && !file->loaded) {
+        file->loaded = true;
+        if (elf_symbols_load(file->path.c_str(), &file->table)) {
+            symbol_index_build(&file->table, &file->index_image);
+            file->usable = symbol_index_open(file->index_image.data(), file->index_image.size(), &file->index);
+            file->has_lines = file->usable && dwarf_line_index_open(file->path.c_str(), &file->lines);
+        }
+    }
+    return file && file->usable ? file : nullptr;
+}
+
+// "[3] 0x7f1000 9c3f...e1 /data/app/.../libfoo.so"; "-" or no column when there is no build-id
+static bool parse_module_entry(const std::string& line, size_t* index, RecordModule* module) {
+    if (line.size() < 4 || line[0] != '[') {
+        return false;
+    }
+    char* end = nullptr;
+    unsigned long value = strtoul(line.c_str() + 1, &end, 10);
+    if (end == line.c_str() + 1 || strncmp(end, "] 0x", 4) != 0) {
+        return false;
+    }
+    const char* pos = end + 4;
+    while (isxdigit((unsigned char)*pos)) {
+        pos++;
+    }
+    if (*pos != ' ') {
+        return false;
+    }
+    pos++;
+
+    const char* token_end = strchr(pos, ' ');
+    module->build_id.clear();
+    if (token_end && (token_end - pos == 1 && *pos == '-')) {
+        pos = token_end + 1;
+    } else if (token_end && strspn(pos, "0123456789abcdef") == (size_t)(token_end - pos)) {
+        module->build_id.assign(pos, token_end);
+        pos = token_end + 1;
+    }
+    module->path = pos;
+    *index = value;
+    return true;
+}
+
+// "<prefix> [index]+0xoffset" (frames, fault address, registers)
+static bool parse_module_address(const std::string& line, size_t* prefix_length, size_t* index, uint64_t* offset) {
+    size_t open = line.rfind(" [");
+    if (open == std::string::npos || open == 0) {
+        return false;
+    }
+    char* end = nullptr;
+    unsigned long value = strtoul(line.c_str() + open + 2, &end, 10);
+    if (end == line.c_str() + open + 2 || strncmp(end, "]+0x", 4) != 0) {
+        return false;
+    }
+    char* offset_end = nullptr;
+    *offset = strtoull(end + 4, &offset_end, 16);
+    if (offset_end == end + 4 || *offset_end != '\0') {
+        return false;
+    }
+    *prefix_length = open;
+    *index = value;
+    return true;
+}
+
+static bool is_module_table_header(const std::string& line) {
+    return line == "Modules:" || line == "MODULES:";
+}
+
+// Frames below the first hold return addresses: the call is the instruction before
+static bool is_caller_frame(const std::string& line) {
+    return line.size() > 1 && line[0] == '#' && strtoul(line.c_str() + 1, nullptr, 10) > 0;
+}
+
+static void append_source_line(const DwarfFrame& frame, std::string* out) {
+    if (frame.file) {
+        char number[16];
+        snprintf(number, sizeof(number), ":%u", frame.line);
+        *out += " at ";
+        *out += frame.file;
+        *out += number;
+    }
+}
+
+// Resolve the address lines of one record against the module table that follows them
+static void flush_record(SymbolStore* store, std::vector<std::string>* lines,
+                         const std::unordered_map<size_t, RecordModule>& modules, std::string* out,
+                         size_t* frame_count) {
+    struct ResolvedLine {
+        size_t prefix_length;
+        const RecordModule* module;     // Null: copied as is
+        SymbolFile* file;
+        uint64_t offset;
+        uint64_t lookup;                // offset, or the call before a return address
+    };
+    std::vector<ResolvedLine> resolved(lines->size());
+    std::unordered_map<size_t, SymbolFile*> files;
+    std::unordered_map<SymbolFile*, std::vector<size_t>> line_lookups;     // Lines to resolve, per library
+    for (size_t i = 0; i < lines->size(); i++) {
+        const std::string& line = (*lines)[i];
+        ResolvedLine& entry = resolved[i];
+        size_t index;
+        entry.module = nullptr;
+        if (modules.empty() || !parse_module_address(line, &entry.prefix_length, &index, &entry.offset)) {
+            continue;
+        }
+        auto module = modules.find(index);
+        if (module == modules.end()) {
+            continue;
+        }
+        entry.module = &module->second;
+        entry.lookup = entry.offset - (is_caller_frame(line) && entry.offset > 0 ? 1 : 0);
+        auto cached = files.find(index);
+        entry.file = cached != files.end() ? cached->second : (files[index] = find_symbol_file(store, module->second));
+        if (entry.file && entry.file->has_lines) {
+            line_lookups[entry.file].push_back(i);
+        }
+    }
+
+    // One batch per library, so each compilation unit is decoded and searched once
+    std::vector<DwarfLocation> locations(lines->size());
+    std::vector<uint64_t> addresses;
+    std::vector<DwarfLocation> batch;
+    for (auto& lookup : line_lookups) {
+        addresses.clear();
+        for (size_t i : lookup.second) {
+            addresses.push_back(resolved[i].lookup);
+        }
+        batch.resize(addresses.size());
+        dwarf_line_index_lookup(&lookup.first->lines, addresses.data(), addresses.size(), batch.data());
+        for (size_t j = 0; j < lookup.second.size(); j++) {
+            locations[lookup.second[j]].frames.swap(batch[j].frames);
+        }
+    }
+
+    for (size_t i = 0; i < lines->size(); i++) {
+        const std::string& line = (*lines)[i];
+        const ResolvedLine& entry = resolved[i];
+        if (!entry.module) {
+            *out += line;
+            *out += '\n';
+            continue;
+        }
+
+        uint64_t start = 0;
+        const SymbolIndexEntry* symbol = entry.file ? symbol_index_lookup(&entry.file->index, entry.lookup, &start)
+                                                    : nullptr;
+        char delta[24];
+        out->append(line, 0, entry.prefix_length);
+        *out += ' ';
+        *out += entry.module->path;
+        *out += " (";
+        if (symbol) {
+            *out += demangle_cache_lookup(&g_demangle_cache, symbol_index_name(&entry.file->index, symbol));
+            snprintf(delta, sizeof(delta), "+0x%llx", (unsigned long long)(entry.offset - start));
+        } else {
+            *out += "???";
+            snprintf(delta, sizeof(delta), "+0x%llx", (unsigned long long)entry.offset);
+        }
+        *out += delta;
+        *out += ')';
+
+        const std::vector<DwarfFrame>& frames = locations[i].frames;
+        if (!frames.empty()) {
+            append_source_line(frames[0], out);
+        }
+        *out += '\n';
+        for (size_t j = 1; j < frames.size(); j++) {
+            *out += "    inlined ";
+            *out += frames[j].function ? demangle_cache_lookup(&g_demangle_cache, frames[j].function) : "???";
+            append_source_line(frames[j], out);
+            *out += '\n';
+        }
+        (*frame_count)++;
+    }
+    lines->clear();
+}
+
+// Symbolize a stream of one or more records; returns the number of resolved lines
+static size_t symbolize_records(SymbolStore* store, std::istream& in, std::string* out) {
+    std::vector<std::string> pending;
+    std::unordered_map<size_t, RecordModule> modules;
+    bool in_module_table = false;
+    size_t frame_count = 0;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (in_module_table) {
+            size_t index;
+            RecordModule module;
+            if (parse_module_entry(line, &index, &module)) {
+                modules[index] = module;
+                pending.push_back(line);
+                continue;
+            }
+            // End of the module table: the record's addresses can be resolved now
+            flush_record(store, &pending, modules, out, &frame_count);
+            modules.clear();
+            in_module_table = false;
+        }
+        in_module_table = is_module_table_header(line);
+        pending.push_back(line);
+    }
+    flush_record(store, &pending, modules, out, &frame_count);
+    return frame_count;
+}
+
+// Symbolize a file or stdin: binary records are decoded to the text layout first
+static size_t symbolize_input(SymbolStore* store, const std::string& input, std::string* out) {
+    if (!crash_record_is_binary(input.data(), input.size())) {
+        std::istringstream in(input);
+        return symbolize_records(store, in, out);
+    }
+    std::string text;
+    size_t offset = 0;
+    size_t consumed = 0;
+    for (CrashRecord record; offset < input.size(); record = CrashRecord()) {
+        if (!crash_record_decode(input.data() + offset, input.size() - offset, &record, &consumed)) {
+            fprintf(stderr, "Skipping %zu bytes that are not a crash record\n", input.size() - offset);
+            break;
+        }
+        text += crash_record_to_text(record);
+        text += '\n';
+        offset += consumed;
+    }
+    std::istringstream in(text);
+    return symbolize_records(store, in, out);
+}
+
+static uint64_t bench_random(uint64_t* seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    return *seed;
+}
+
+// Synthetic records whose frames land inside the functions of the indexed libraries
+static std::string build_bench_corpus(SymbolStore* store, size_t frames, size_t* frames_generated) {
+    struct Target {
+        std::string build_id;
+        SymbolFile* file;
+    };
+    std::vector<Target> targets;
+    for (auto& entry : store->by_build_id) {
+        RecordModule module = { entry.first, entry.second->path };
+        SymbolFile* file = find_symbol_file(store, module);
+        if (file && !file->table.symbols.empty()) {
+            targets.push_back({ entry.first, file });
+        }
+    }
+    *frames_generated = 0;
+    if (targets.empty()) {
+        return std::string();
+    }
+
+    std::ostringstream corpus;
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    while (*frames_generated < frames) {
+        std::vector<size_t> record_targets;
+        corpus << "NATIVE_CRASH\nSignal: 11 (SIGSEGV)\nStack Trace:\n";
+        for (size_t i = 0; i < BENCH_FRAMES_PER_RECORD && *frames_generated < frames; i++, (*frames_generated)++) {
+            size_t target = bench_random(&seed) % targets.size();
+            const ElfSymbolTable& table = targets[target].file->table;
+            const ElfSymbol& symbol = table.symbols[bench_random(&seed) % table.symbols.size()];
+            uint64_t offset = symbol.address + (symbol.size ? bench_random(&seed) % symbol.size : 0);
+            size_t index = record_targets.size();
+            for (size_t j = 0; j < record_targets.size(); j++) {
+                if (record_targets[j] == target) {
+                    index = j;
+                }
+            }
+            if (index == record_targets.size()) {
+                record_targets.push_back(target);
+            }
+            char frame[96];
+            snprintf(frame, sizeof(frame), "#%02zu pc 0x%llx [%zu]+0x%llx\n", i,
+                     (unsigned long long)(0x7f0000000000ULL + offset), index, (unsigned long long)offset);
+            corpus << frame;
+        }
+        corpus << "Modules:\n";
+        for (size_t j = 0; j < record_targets.size(); j++) {
+            const Target& target = targets[record_targets[j]];
+            corpus << '[' << j << "] 0x7f0000000000 " << target.build_id << ' ' << target.file->path << '\n';
+        }
+        corpus << '\n';
+    }
+    return corpus.str();
+}
+
+// Recorded records (binary, concatenated) repeated until they hold at least frames frames
+static std::string build_recorded_corpus(SymbolStore* store, const std::string& records, size_t frames,
+                                         size_t* frames_generated) {
+    std::string out;
+    size_t per_pass = symbolize_input(store, records, &out);
+    *frames_generated = 0;
+    std::string corpus;
+    while (per_pass > 0 && *frames_generated < frames) {
+        corpus += records;
+        *frames_generated += per_pass;
+    }
+    return corpus;
+}
+
+static int run_bench(SymbolStore* store, size_t frames, const std::string& records) {
+    size_t generated = 0;
+    std::string corpus = records.empty() ? build_bench_corpus(store, frames, &generated)
+                                         : build_recorded_corpus(store, records, frames, &generated);
+    if (generated == 0) {
+        fprintf(stderr, "%s\n",
+                records.empty() ? "No symbols to build a corpus from" : "No frames resolved in the records");
+        return 1;
+    }
+
+    // First pass loads the symbol tables; the timed pass measures steady-state throughput
+    std::string out;
+    symbolize_input(store, corpus, &out);
+
+    out.clear();
+    auto start = std::chrono::steady_clock::now();
+    size_t resolved = symbolize_input(store, corpus, &out);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu frames in %.3f s: %.0f frames/s (%zu libraries)\n", resolved, seconds, resolved / seconds,
+           store->by_build_id.size());
+    return 0;
+}
+
+struct LoadBiasQuery {
+    const char* path;
+    uintptr_t load_bias;
+};
+
+static int find_load_bias(struct dl_phdr_info* info, size_t /* size */, void* data) {
+    LoadBiasQuery* query = static_cast<LoadBiasQuery*>(data);
+    if (info->dlpi_name && strcmp(info->dlpi_name, query->path) == 0) {
+        query->load_bias = info->dlpi_addr;
+        return 1;
+    }
+    return 0;
+}
+
+template <typename Lookup>
+static double time_lookups(const std::vector<uint64_t>& addresses, size_t* resolved, Lookup lookup) {
+    *resolved = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t address : addresses) {
+        *resolved += lookup(address) ? 1 : 0;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / addresses.size();
+}
+
+// Lookups at random addresses inside the functions of one library, three ways
+static int run_bench_lookup(const char* library, size_t lookups) {
+    ElfSymbolTable table;
+    if (!elf_symbols_load(library, &table) || table.symbols.empty()) {
+        fprintf(stderr, "Cannot load symbols of %s\n", library);
+        return 1;
+    }
+    std::string image;
+    SymbolIndex index;
+    symbol_index_build(&table, &image);
+    if (!symbol_index_open(image.data(), image.size(), &index)) {
+        fprintf(stderr, "Cannot build the index of %s\n", library);
+        return 1;
+    }
+
+    std::vector<uint64_t> addresses(lookups);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (uint64_t& address : addresses) {
+        const ElfSymbol& symbol = table.symbols[bench_random(&seed) % table.symbols.size()];
+        address = symbol.address + (symbol.size ? bench_random(&seed) % symbol.size : 0);
+    }
+
+    // The index keeps the largest of aliased symbols; both must find a symbol at the same start
+    size_t mismatches = 0;
+    for (uint64_t address : addresses) {
+        uint64_t start = 0;
+        const ElfSymbol* expected = elf_symbols_lookup(&table, address);
+        const SymbolIndexEntry* found = symbol_index_lookup(&index, address, &start);
+        if ((expected != nullptr) != (found != nullptr) || (found && start != expected->address)) {
+            mismatches++;
+        }
+    }
+
+    size_t resolved = 0;
+    printf("%s: %zu symbols, index %zu bytes, %zu lookups, %zu mismatches\n", library,
+           (size_t)index.header->count, image.size(), lookups, mismatches);
+    double ns = time_lookups(addresses, &resolved, [&](uint64_t address) {
+        uint64_t start;
+        return symbol_index_lookup(&index, address, &start) != nullptr;
+    });
+    printf("  symbol index   %7.1f ns/lookup  %zu resolved\n", ns, resolved);
+    ns = time_lookups(addresses, &resolved, [&](uint64_t address) {
+        return elf_symbols_lookup(&table, address) != nullptr;
+    });
+    printf("  sorted vector  %7.1f ns/lookup  %zu resolved\n", ns, resolved);
+
+    void* handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+    LoadBiasQuery query = { library, 0 };
+    if (!handle || !dl_iterate_phdr(find_load_bias, &query)) {
+        printf("  dladdr         (cannot load %s)\n", library);
+        return 0;
+    }
+    // dladdr() scans the dynamic symbol table linearly: time a subset
+    addresses.resize(std::min<size_t>(addresses.size(), BENCH_DLADDR_LOOKUPS));
+    ns = time_lookups(addresses, &resolved, [&](uint64_t address) {
+        Dl_info info;
+        return dladdr((void*)(query.load_bias + address), &info) != 0 && info.dli_sname != nullptr;
+    });
+    printf("  dladdr         %7.1f ns/lookup  %zu of %zu resolved (exported symbols only)\n", ns, resolved,
+           addresses.size());
+    return 0;
+}
+
+// Demangle a Zipf-like stream of the library's mangled names, with and without the cache
+static int run_bench_demangle(const char* library, size_t count) {
+    ElfSymbolTable table;
+    std::vector<const char*> mangled;
+    if (elf_symbols_load(library, &table)) {
+        for (const ElfSymbol& symbol : table.symbols) {
+            const char* name = elf_symbol_name(&table, &symbol);
+            if (strncmp(name, "_Z", 2) == 0) {
+                mangled.push_back(name);
+            }
+        }
+    }
+    if (mangled.empty()) {
+        fprintf(stderr, "No C++ symbols in %s\n", library);
+        return 1;
+    }
+
+    // Rank r is drawn with probability ~1/r over a random permutation of the names
+    std::vector<const char*> stream(count);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = mangled.size(); i > 1; i--) {
+        std::swap(mangled[i - 1], mangled[bench_random(&seed) % i]);
+    }
+    std::vector<double> cumulative(mangled.size());
+    double sum = 0;
+    for (size_t r = 0; r < mangled.size(); r++) {
+        sum += 1.0 / (r + 1);
+        cumulative[r] = sum;
+    }
+    for (const char*& name : stream) {
+        double target = (double)(bench_random(&seed) >> 11) / (double)(1ULL << 53) * sum;
+        size_t rank = std::lower_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin();
+        name = mangled[std::min(rank, mangled.size() - 1)];
+    }
+
+    size_t total_length = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const char* name : stream) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        total_length += demangled ? strlen(demangled) : 0;
+        free(demangled);
+    }
+    double uncached = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t cached_length = 0;
+    demangle_cache_reset(&g_demangle_cache);
+    g_demangle_cache.hits = g_demangle_cache.misses = 0;
+    start = std::chrono::steady_clock::now();
+    for (const char* name : stream) {
+        cached_length += strlen(demangle_cache_lookup(&g_demangle_cache, name));
+    }
+    double cached = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s: %zu C++ symbols, %zu names demangled\n", library, mangled.size(), count);
+    printf("  __cxa_demangle  %10.0f names/s\n", count / uncached);
+    printf("  memo cache      %10.0f names/s  (%.1f%% hits)\n", count / cached,
+           100.0 * g_demangle_cache.hits / (g_demangle_cache.hits + g_demangle_cache.misses));
+    return total_length == cached_length ? 0 : 1;
+}
+
+// Resolve random code addresses of one library to lines: first batch decodes the units it touches
+static int run_bench_lines(const char* library, size_t lookups) {
+    ElfSymbolTable table;
+    if (!elf_symbols_load(library, &table) || table.symbols.empty()) {
+        fprintf(stderr, "Cannot load symbols of %s\n", library);
+        return 1;
+    }
+    DwarfLineIndex index;
+    auto start = std::chrono::steady_clock::now();
+    if (!dwarf_line_index_open(library, &index)) {
+        fprintf(stderr, "No debug info in %s\n", library);
+        return 1;
+    }
+    double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint64_t> addresses(lookups);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (uint64_t& address : addresses) {
+        const ElfSymbol& symbol = table.symbols[bench_random(&seed) % table.symbols.size()];
+        address = symbol.address + (symbol.size ? bench_random(&seed) % symbol.size : 0);
+    }
+    std::vector<DwarfLocation> locations(lookups);
+    printf("%s: %.1f MB mapped, %zu units, opened in %.1f ms\n", library, index.mapping_size / 1e6,
+           index.units.size(), open_ms);
+    for (const char* pass : { "cold", "warm" }) {
+        start = std::chrono::steady_clock::now();
+        dwarf_line_index_lookup(&index, addresses.data(), addresses.size(), locations.data());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t with_line = 0;
+        size_t inlined = 0;
+        for (const DwarfLocation& location : locations) {
+            with_line += !location.frames.empty() && location.frames.back().file ? 1 : 0;
+            inlined += location.frames.size() > 1 ? location.frames.size() - 1 : 0;
+        }
+        printf("  %s  %8.0f ns/address  %zu units decoded, %zu of %zu with a line, %zu inlined frames\n", pass,
+               seconds * 1e9 / lookups, index.decoded_units, with_line, lookups, inlined);
+    }
+    dwarf_line_index_close(&index);
+    return 0;
+}
+
+// Load a MiniDebugInfo library repeatedly: decoded every time vs mapped from the symbol cache
+static int run_bench_debugdata(const char* library, size_t loads) {
+    ElfSymbolTable table;
+    if (!elf_symbols_load(library, &table) || table.build_id.length == 0) {
+        fprintf(stderr, "Cannot load symbols and build-id of %s\n", library);
+        return 1;
+    }
+    if (table.debugdata_symbols == 0) {
+        fprintf(stderr, "No .gnu_debugdata symbols in %s\n", library);
+        return 1;
+    }
+    printf("%s: %zu symbols, %zu of them from .gnu_debugdata\n", library, table.symbols.size(),
+           table.debugdata_symbols);
+
+    loads = std::max<size_t>(loads, 1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < loads; i++) {
+        ElfSymbolTable loaded;
+        std::string image;
+        SymbolIndex index;
+        elf_symbols_load(library, &loaded);
+        symbol_index_build(&loaded, &image);
+        symbol_index_open(image.data(), image.size(), &index);
+    }
+    double decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    char cache_dir[] = "/tmp/crash-symbolizer-XXXXXX";
+    if (!mkdtemp(cache_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string build_id = build_id_hex(&table.build_id);
+    SymbolIndex index;
+    std::string filled;
+    symbol_cache_load(cache_dir, library, build_id.c_str(), &index, &filled);
+    start = std::chrono::steady_clock::now();
+    size_t hits = 0;
+    for (size_t i = 0; i < loads; i++) {
+        std::string image;     // Stays empty when the index is mapped from the cache
+        if (symbol_cache_load(cache_dir, library, build_id.c_str(), &index, &image) && image.empty()) {
+            hits++;
+            symbol_index_unmap(&index);
+        }
+    }
+    double cached_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::filesystem::remove_all(cache_dir);
+
+    printf("  decode + index  %8.2f ms/load\n", decode_ms / loads);
+    printf("  cached index    %8.2f ms/load  (%zu of %zu from the cache)\n", cached_ms / loads, hits, loads);
+    return hits == loads ? 0 : 1;
+}
+
+static void print_usage() {
+    fprintf(stderr,
+            "Usage: crash-symbolizer --symbols DIR [RECORD...]\n"
+            "       crash-symbolizer --symbols DIR --bench FRAMES [RECORD...]\n"
+            "       crash-symbolizer --bench-lookup LIBRARY LOOKUPS\n"
+            "       crash-symbolizer --bench-demangle LIBRARY NAMES\n"
+            "       crash-symbolizer --bench-lines LIBRARY LOOKUPS\n"
+            "       crash-symbolizer --bench-debugdata LIBRARY LOADS\n");
+}
+
+int main(int argc, char** argv) {
+    std::string symbols_dir;
+    size_t bench_frames = 0;
+    std::vector<std::string> records;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc) {
+            symbols_dir = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_frames = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--bench-lookup") == 0 && i + 2 < argc) {
+            return run_bench_lookup(argv[i + 1], strtoull(argv[i + 2], nullptr, 10));
+        } else if (strcmp(argv[i], "--bench-demangle") == 0 && i + 2 < argc) {
+            return run_bench_demangle(argv[i + 1], strtoull(argv[i + 2], nullptr, 10));
+        } else if (strcmp(argv[i], "--bench-lines") == 0 && i + 2 < argc) {
+            return run_bench_lines(argv[i + 1], strtoull(argv[i + 2], nullptr, 10));
+        } else if (strcmp(argv[i], "--bench-debugdata") == 0 && i + 2 < argc) {
+            return run_bench_debugdata(argv[i + 1], strtoull(argv[i + 2], nullptr, 10));
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            print_usage();
+            return 2;
+        } else {
+            records.push_back(argv[i]);
+        }
+    }
+    if (symbols_dir.empty()) {
+        print_usage();
+        return 2;
+    }
+
+    SymbolStore store;
+    if (index_symbol_dir(symbols_dir, &store) == 0) {
+        fprintf(stderr, "No ELF files with a build-id under %s\n", symbols_dir.c_str());
+    }
+    if (bench_frames > 0) {
+        std::string recorded;
+        for (const std::string& record : records) {
+            std::ifstream in(record, std::ios::binary);
+            std::stringstream input;
+            input << in.rdbuf();
+            if (!in || !crash_record_is_binary(input.str().data(), input.str().size())) {
+                fprintf(stderr, "%s is not a binary crash record\n", record.c_str());
+                return 1;
+            }
+            recorded += input.str();
+        }
+        return run_bench(&store, bench_frames, recorded);
+    }
+
+    std::string out;
+    if (records.empty()) {
+        std::stringstream input;
+        input << std::cin.rdbuf();
+        symbolize_input(&store, input.str(), &out);
+    }
+    for (const std::string& record : records) {
+        std::ifstream in(record, std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "Cannot read %s\n", record.c_str());
+            return 1;
+        }
+        std::stringstream input;
+        input << in.rdbuf();
+        symbolize_input(&store, input.str(), &out);
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
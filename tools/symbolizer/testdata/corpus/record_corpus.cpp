@@ -0,0 +1,145 @@
+/**
+ * Records the checked-in crash corpus: real NCRB records of crashes in
+ * two small unstripped libraries, for crash-symbolizer's tests and --bench
+ *
+ * Each scenario runs in a child that loads lib/libcorpus_render.so and
+ * lib/libcorpus_game.so, which links it, and crashes in them: a null vertex buffer
+ * read in an inlined template (SIGSEGV), a failed check (SIGABRT) and an
+ * out-of-range dispatch (SIGILL). Its handler captures the stack with the
+ * CFI unwinder and writes the record the way the enhanced handler does
+ * (thread name, registers, frames, module addresses, modules) to
+ * records/<scenario>.ncrb. Regenerate from testdata/corpus, so the
+ * recorded library paths are relative:
+ *
+ *   cd src && g++ -g -O2 -fPIC -shared -fdebug-prefix-map=$PWD=src \
+ *       -Wl,-soname,libcorpus_render.so -o ../lib/libcorpus_render.so corpus_render.cpp
+ *   g++ -g -O2 -fPIC -shared -fdebug-prefix-map=$PWD=src -o ../lib/libcorpus_game.so \
+ *       corpus_game.cpp -L../lib -lcorpus_render -Wl,-rpath,'$ORIGIN' && cd ..
+ *   BUILD/record-corpus lib records
+ *
+ * and for each records/NAME.ncrb, the expected symbolizer output:
+ *
+ *   BUILD/crash-symbolizer --symbols lib records/NAME.ncrb > expected/NAME.txt
+ */
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "crash_record_builder.h"
+#include "crash_record_writer.h"
+#include "stack_unwinder.h"
+
+#define CORPUS_MAX_FRAMES 64
+
+struct CorpusScenario {
+    const char* name;
+    int signal;
+};
+
+static const CorpusScenario kScenarios[] = {
+    { "null_vertices", SIGSEGV },
+    { "failed_check", SIGABRT },
+    { "bad_dispatch", SIGILL },
+};
+
+static char g_record_buffer[64 * 1024];
+static int g_record_fd = -1;
+
+static void record_handler(int sig, siginfo_t* info, void* context) {
+    const ModuleMap* modules = module_map_begin_crash();
+    uintptr_t frames[CORPUS_MAX_FRAMES];
+    UnwindMethod method = UNWIND_METHOD_NONE;
+    size_t frame_count = capture_stack(context, UNWINDER_CFI, modules, frames, CORPUS_MAX_FRAMES, &method);
+    uintptr_t registers[CRASH_RECORD_MAX_REGISTERS];
+    size_t register_count = crash_record_capture_registers(context, registers);
+
+    CrashRecordWriter writer;
+    record_writer_init(&writer, g_record_buffer, sizeof(g_record_buffer));
+    FormatBuffer* fmt = &writer.fmt;
+    CrashRecordHeader header;
+    crash_record_init_header(&header, sig, info->si_code, (uintptr_t)info->si_addr, getpid(), gettid(),
+                             time(nullptr), method);
+    crash_record_begin(fmt, &header);
+    size_t section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_THREAD_NAME);
+    fmt_append_str(fmt, "GameThread");
+    crash_record_end_section(fmt, section);
+
+    section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_REGISTERS);
+    fmt_append_bytes(fmt, (const char*)registers, register_count * sizeof(uintptr_t));
+    crash_record_end_section(fmt, section);
+
+    CrashRecordModules referenced;
+    crash_record_modules_init(&referenced, modules);
+    crash_record_write_frames(fmt, &referenced, frames, frame_count);
+    int sp = crash_record_arch_info(CRASH_RECORD_ARCH_NATIVE)->sp;
+    section = crash_record_begin_section(fmt, CRASH_RECORD_SECTION_ADDRESSES);
+    crash_record_write_module_address(fmt, &referenced, -1, (uintptr_t)info->si_addr);
+    for (size_t i = 0; i < register_count; i++) {
+        if ((int)i != sp) {
+            crash_record_write_module_address(fmt, &referenced, (int)i, registers[i]);
+        }
+    }
+    crash_record_end_section(fmt, section);
+    crash_record_write_referenced_modules(fmt, &referenced);
+    crash_record_finish(fmt);
+    _exit(record_writer_flush(&writer, g_record_fd) ? 0 : 1);
+}
+
+// Runs in the child: load the libraries, then crash in them
+static void record_scenario(const char* lib_dir, int scenario, const char* path) {
+    // Loaded by path first, so the recorded path is the one given, not the rpath's
+    std::string render = std::string(lib_dir) + "/libcorpus_render.so";
+    std::string game = std::string(lib_dir) + "/libcorpus_game.so";
+    void* library = dlopen(render.c_str(), RTLD_NOW) ? dlopen(game.c_str(), RTLD_NOW) : nullptr;
+    int (*run)(int) = library ? (int (*)(int))dlsym(library, "corpus_run") : nullptr;
+    if (!run) {
+        fprintf(stderr, "Cannot load %s: %s\n", game.c_str(), dlerror());
+        _exit(2);
+    }
+    g_record_fd = open(path, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+    if (g_record_fd < 0) {
+        perror(path);
+        _exit(2);
+    }
+    stack_unwinder_init();
+    record_writer_reserve(g_record_buffer, sizeof(g_record_buffer));
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = record_handler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(kScenarios[scenario].signal, &action, nullptr);
+
+    run(scenario);
+    _exit(3);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: record-corpus LIB_DIR OUT_DIR\n");
+        return 2;
+    }
+    for (int i = 0; i < (int)(sizeof(kScenarios) / sizeof(kScenarios[0])); i++) {
+        std::string path = std::string(argv[2]) + "/" + kScenarios[i].name + ".ncrb";
+        pid_t child = fork();
+        if (child == 0) {
+            record_scenario(argv[1], i, path.c_str());
+        }
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "%s: not recorded\n", kScenarios[i].name);
+            return 1;
+        }
+        printf("%s\n", path.c_str());
+    }
+    return 0;
+}
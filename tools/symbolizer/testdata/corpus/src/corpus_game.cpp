@@ -0,0 +1,50 @@
+// libcorpus_game.so: calls into libcorpus_render.so for each corpus scenario
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace corpus {
+namespace render {
+struct Mesh {
+    const int* vertices;
+    size_t count;
+};
+int draw(const Mesh& mesh);
+void check(bool condition);
+int dispatch(const std::vector<int>& commands, size_t index);
+}  // namespace render
+
+class Scene {
+public:
+    virtual ~Scene() {}
+    virtual int update(int scenario) = 0;
+};
+
+class Level : public Scene {
+public:
+    __attribute__((noinline)) int update(int scenario) override {
+        switch (scenario) {
+            case 0: {
+                render::Mesh mesh = { nullptr, 16 };    // Vertex buffer never uploaded
+                return render::draw(mesh);
+            }
+            case 1:
+                render::check(commands_.size() > 8);
+                return 0;
+            default:
+                return render::dispatch(commands_, commands_.size());
+        }
+    }
+
+private:
+    std::vector<int> commands_ = { 1, 2, 3 };
+};
+
+}  // namespace corpus
+
+extern "C" __attribute__((noinline)) int corpus_run(int scenario) {
+    corpus::Level level;
+    corpus::Scene* scene = &level;
+    return scene->update(scenario) + 1;
+}
@@ -0,0 +1,42 @@
+// libcorpus_render.so: the library the corpus crashes in (see record_corpus.cpp)
+
+#include <stdlib.h>
+
+#include <vector>
+
+namespace corpus {
+namespace render {
+
+struct Mesh {
+    const int* vertices;
+    size_t count;
+};
+
+template <typename T>
+static inline __attribute__((always_inline)) T weighted_sum(const T* values, size_t count) {
+    T sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += values[i] * (T)(i + 1);
+    }
+    return sum;
+}
+
+__attribute__((noinline)) int draw(const Mesh& mesh) {
+    return weighted_sum(mesh.vertices, mesh.count);
+}
+
+__attribute__((noinline)) void check(bool condition) {
+    if (!condition) {
+        abort();
+    }
+}
+
+__attribute__((noinline)) int dispatch(const std::vector<int>& commands, size_t index) {
+    if (index >= commands.size()) {
+        __builtin_trap();
+    }
+    return commands[index];
+}
+
+}  // namespace render
+}  // namespace corpus
@@ -0,0 +1,170 @@
+/**
+ * byte_encoding.h: every vector kernel against the scalar encoder
+ *
+ * Built three times (default flags, -mssse3, -mavx2) so each compile-time
+ * baseline is exercised; the AVX2 kernels also run in the other builds
+ * when the CPU has AVX2. Each kernel is called directly, chained with the
+ * scalar tail as hex_encode()/base64_encode() do, and the dispatchers
+ * themselves are checked too: for every length up to BYTE_TEST_MAX_LENGTH
+ * and every input and output misalignment within a 32-byte block, the
+ * output must equal the scalar encoding, with nothing written past its end.
+ * The scalar encoders are checked by decoding their output.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "byte_encoding.h"
+#include "host_test.h"
+
+#define BYTE_TEST_MAX_LENGTH 300
+#define BYTE_TEST_MAX_OFFSET 32
+#define BYTE_TEST_GUARD 64
+
+typedef size_t (*EncodeBlocks)(char* out, const uint8_t* in, size_t length);
+
+struct EncodePath {
+    const char* name;
+    EncodeBlocks hex;           // Null: scalar only
+    EncodeBlocks base64;
+    bool dispatch;              // hex_encode()/base64_encode() themselves
+};
+
+static size_t encode_hex(const EncodePath& path, char* out, const uint8_t* in, size_t length) {
+    if (path.dispatch) {
+        return hex_encode(out, in, length);
+    }
+    size_t done = path.hex ? path.hex(out, in, length) : 0;
+    CHECK(done <= length);
+    hex_encode_scalar(out + 2 * done, in + done, length - done);
+    return 2 * length;
+}
+
+static size_t encode_base64(const EncodePath& path, char* out, const uint8_t* in, size_t length) {
+    if (path.dispatch) {
+        return base64_encode(out, in, length);
+    }
+    size_t done = path.base64 ? path.base64(out, in, length) : 0;
+    CHECK(done <= length && done % 3 == 0);
+    return done / 3 * 4 + base64_encode_scalar(out + done / 3 * 4, in + done, length - done);
+}
+
+static int hex_value(char c) {
+    return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static int base64_value(char c) {
+    const char* found = c ? strchr(kBase64Alphabet, c) : nullptr;
+    return found ? (int)(found - kBase64Alphabet) : -1;
+}
+
+// The scalar encoders are the reference: decode their output back to the input
+static void check_scalar(const uint8_t* in, size_t length) {
+    std::vector<char> hex(2 * length);
+    hex_encode_scalar(hex.data(), in, length);
+    for (size_t i = 0; i < length; i++) {
+        CHECK(hex_value(hex[2 * i]) * 16 + hex_value(hex[2 * i + 1]) == in[i]);
+    }
+
+    std::vector<char> base64(base64_encoded_length(length));
+    CHECK(base64_encode_scalar(base64.data(), in, length) == base64.size());
+    for (size_t i = 0, o = 0; i < length; i += 3, o += 4) {
+        uint32_t group = 0;
+        for (int k = 0; k < 4; k++) {
+            int value = base64_value(base64[o + k]);
+            bool padding = i + (size_t)k > length;  // Characters 2 and 3 of a short final group
+            CHECK(padding ? base64[o + k] == '=' : value >= 0);
+            group = group << 6 | (uint32_t)(value < 0 ? 0 : value);
+        }
+        CHECK((uint8_t)(group >> 16) == in[i]);
+        CHECK(i + 1 >= length || (uint8_t)(group >> 8) == in[i + 1]);
+        CHECK(i + 2 >= length || (uint8_t)group == in[i + 2]);
+    }
+}
+
+static void check_path(const EncodePath& path, const std::vector<uint8_t>& source) {
+    std::vector<uint8_t> input(BYTE_TEST_MAX_LENGTH + BYTE_TEST_MAX_OFFSET);
+    std::vector<char> out(2 * BYTE_TEST_MAX_LENGTH + BYTE_TEST_MAX_OFFSET + BYTE_TEST_GUARD);
+    std::vector<char> expected(2 * BYTE_TEST_MAX_LENGTH);
+    int failures = g_host_test_failures;
+
+    for (size_t length = 0; length <= BYTE_TEST_MAX_LENGTH; length++) {
+        for (size_t offset = 0; offset < BYTE_TEST_MAX_OFFSET; offset++) {
+            // Shift the same bytes to each misalignment; the output gets a different one
+            memcpy(input.data() + offset, source.data(), length);
+            const uint8_t* in = input.data() + offset;
+            char* at = out.data() + (offset * 7) % BYTE_TEST_MAX_OFFSET;
+            size_t limit = out.size() - (size_t)(at - out.data());
+
+            memset(out.data(), '#', out.size());
+            hex_encode_scalar(expected.data(), in, length);
+            CHECK(encode_hex(path, at, in, length) == 2 * length);
+            CHECK(memcmp(at, expected.data(), 2 * length) == 0);
+            for (size_t i = 2 * length; i < limit; i++) {
+                CHECK(at[i] == '#');
+            }
+
+            memset(out.data(), '#', out.size());
+            size_t base64_length = base64_encode_scalar(expected.data(), in, length);
+            CHECK(encode_base64(path, at, in, length) == base64_length);
+            CHECK(memcmp(at, expected.data(), base64_length) == 0);
+            for (size_t i = base64_length; i < limit; i++) {
+                CHECK(at[i] == '#');
+            }
+
+            if (g_host_test_failures != failures) {
+                fprintf(stderr, "%s: length %zu, offset %zu\n", path.name, length, offset);
+                return;
+            }
+        }
+    }
+}
+
+int main() {
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2")) {
+        printf("byte_encoding_test: built for AVX2, which this CPU lacks\n");
+        return HOST_TEST_SKIP;
+    }
+#endif
+
+    // Every byte value, including the ones next to each range boundary of the alphabet
+    std::vector<uint8_t> source(BYTE_TEST_MAX_LENGTH);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < source.size(); i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        source[i] = i < 256 ? (uint8_t)(i * 167) : (uint8_t)(seed >> 56);
+    }
+    for (size_t length = 0; length <= BYTE_TEST_MAX_LENGTH; length++) {
+        check_scalar(source.data(), length);
+    }
+
+    std::vector<EncodePath> paths;
+    paths.push_back({ "scalar", nullptr, nullptr, false });
+    paths.push_back({ "dispatch", nullptr, nullptr, true });
+#if defined(__ARM_NEON)
+    paths.push_back({ "neon", hex_encode_neon, base64_encode_neon, false });
+#endif
+#if defined(__SSE2__)
+    paths.push_back({ "sse2", hex_encode_sse2, nullptr, false });
+#endif
+#if defined(__SSSE3__)
+    paths.push_back({ "ssse3", nullptr, base64_encode_ssse3, false });
+#endif
+#if defined(BYTE_ENCODING_AVX2)
+    if (byte_encoding_has_avx2()) {
+        paths.push_back({ "avx2", hex_encode_avx2, base64_encode_avx2, false });
+    } else {
+        printf("byte_encoding_test: no AVX2 on this CPU, AVX2 kernels not run\n");
+    }
+#endif
+
+    for (const EncodePath& path : paths) {
+        check_path(path, source);
+        printf("byte_encoding_test: %s checked\n", path.name);
+    }
+    return host_test_result("byte_encoding_test");
+}
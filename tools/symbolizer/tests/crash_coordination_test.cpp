@@ -0,0 +1,187 @@
+/**
+ * Concurrent crash stress test for crash_coordination.h and crash_journal.h
+ *
+ * A child process installs a handler shaped like the native one (elect an
+ * owner; secondaries add an entry and park; the owner writes and commits a
+ * record), then CRASH_STRESS_THREADS threads fault at once behind a
+ * barrier. For both capture modes the parent checks that every run dies of
+ * SIGSEGV, never of a recursive or a premature exit, with exactly one
+ * committed record whose secondary entries are distinct crashing threads.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "crash_context.h"
+#include "crash_coordination.h"
+#include "crash_journal.h"
+#include "crash_record_builder.h"
+#include "crash_record_decoder.h"
+#include "host_test.h"
+#include "unwind_method.h"
+
+#define CRASH_STRESS_THREADS 32
+#define CRASH_STRESS_RUNS 25
+
+// Time the owner spends capturing, so the other threads fault while it writes
+#define CRASH_STRESS_CAPTURE_MS 20
+
+static CrashCoordinator g_coordinator;
+static CrashJournal g_journal = { -1, nullptr, 0, 0, 0, 0, 0 };
+static char g_record_buffer[CRASH_JOURNAL_BODY_SIZE];
+static pthread_barrier_t g_barrier;
+
+static void stress_handler(int sig, siginfo_t* info, void* context) {
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    switch (crash_coordinator_enter(&g_coordinator, tid)) {
+        case CRASH_ROLE_RECURSIVE:
+            _exit(1);
+
+        case CRASH_ROLE_SECONDARY:
+            crash_coordinator_add_secondary(&g_coordinator, tid, info, crash_context_pc(context));
+            crash_coordinator_park(&g_coordinator);
+            signal(sig, SIG_DFL);
+            raise(sig);
+            return;
+
+        case CRASH_ROLE_OWNER:
+            break;
+    }
+
+    struct timespec capture = { 0, CRASH_STRESS_CAPTURE_MS * 1000000L };
+    nanosleep(&capture, nullptr);
+
+    CrashJournalSlot slot;
+    if (crash_journal_claim(&g_journal, &slot)) {
+        CrashRecordWriter writer;
+        record_writer_init(&writer, slot.mapped_body ? slot.mapped_body : g_record_buffer, g_journal.body_capacity);
+        CrashRecordHeader header;
+        crash_record_init_header(&header, sig, info->si_code, (uintptr_t)info->si_addr, getpid(), tid,
+                                 time(nullptr), UNWIND_METHOD_NONE);
+        crash_record_begin(&writer.fmt, &header);
+        crash_record_write_secondary_crashes(&writer.fmt, &g_coordinator);
+        crash_record_finish(&writer.fmt);
+        crash_journal_commit(&g_journal, &slot, &writer);
+    }
+    crash_coordinator_finish(&g_coordinator);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void* stress_thread(void* /* arg */) {
+    pthread_barrier_wait(&g_barrier);
+    volatile int* volatile address = nullptr;
+    *address = 1;
+    return nullptr;
+}
+
+// Runs in the child; only returns through a signal
+static void stress_child(const char* path, bool mapped) {
+    if (!crash_journal_open(&g_journal, path, CRASH_JOURNAL_SLOT_COUNT, CRASH_JOURNAL_BODY_SIZE, mapped)) {
+        _exit(2);
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = stress_handler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, nullptr);
+
+    pthread_barrier_init(&g_barrier, nullptr, CRASH_STRESS_THREADS);
+    pthread_t threads[CRASH_STRESS_THREADS];
+    for (int i = 0; i < CRASH_STRESS_THREADS; i++) {
+        pthread_create(&threads[i], nullptr, stress_thread, nullptr);
+    }
+    for (int i = 0; i < CRASH_STRESS_THREADS; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    _exit(3);
+}
+
+// The journal must hold exactly one committed record, written by the owner
+static void check_journal(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CrashJournalHeader journal;
+    CHECK(data.size() >= CRASH_JOURNAL_HEADER_SIZE);
+    if (data.size() < CRASH_JOURNAL_HEADER_SIZE) {
+        return;
+    }
+    memcpy(&journal, data.data(), sizeof(journal));
+    CHECK(journal.slot_count == CRASH_JOURNAL_SLOT_COUNT);
+
+    int committed = 0;
+    for (uint32_t i = 0; i < journal.slot_count; i++) {
+        size_t offset = CRASH_JOURNAL_HEADER_SIZE + (size_t)i * journal.slot_size;
+        CrashSlotHeader slot;
+        if (offset + journal.slot_size > data.size()) {
+            break;
+        }
+        memcpy(&slot, data.data() + offset, sizeof(slot));
+        if (slot.sequence == 0 || slot.commit_sequence != slot.sequence) {
+            continue;
+        }
+        committed++;
+        const char* body = data.data() + offset + CRASH_SLOT_HEADER_SIZE;
+        CHECK(slot.body_length <= slot.body_capacity);
+        CHECK(crc32_update(0, body, slot.body_length) == slot.body_crc32);
+
+        CrashRecord record;
+        size_t consumed = 0;
+        CHECK(crash_record_decode(body, slot.body_length, &record, &consumed));
+        CHECK(!record.truncated);
+        CHECK(record.header.signal == SIGSEGV);
+        CHECK(record.header.fault_address == 0);
+        CHECK(!record.secondary_crashes.empty());
+        CHECK(record.secondary_crashes.size() <= MAX_SECONDARY_CRASHES);
+        std::set<int32_t> tids;
+        for (const CrashRecordSecondary& secondary : record.secondary_crashes) {
+            CHECK(secondary.tid != record.header.tid);
+            CHECK(secondary.signal == SIGSEGV);
+            CHECK(secondary.fault_address == 0);
+            CHECK(tids.insert(secondary.tid).second);
+        }
+    }
+    CHECK(committed == 1);
+}
+
+static void run_stress(const char* dir, bool mapped) {
+    std::string path = std::string(dir) + (mapped ? "/mapped.journal" : "/file.journal");
+    for (int run = 0; run < CRASH_STRESS_RUNS; run++) {
+        unlink(path.c_str());
+        pid_t child = fork();
+        if (child == 0) {
+            stress_child(path.c_str(), mapped);
+        }
+        int status = 0;
+        CHECK(child > 0 && waitpid(child, &status, 0) == child);
+        CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+        check_journal(path);
+    }
+    unlink(path.c_str());
+}
+
+int main() {
+    char dir[] = "/tmp/crash-coordination-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    run_stress(dir, false);
+    run_stress(dir, true);
+    rmdir(dir);
+    return host_test_result("crash_coordination_test");
+}
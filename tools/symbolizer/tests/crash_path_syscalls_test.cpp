@@ -0,0 +1,202 @@
+/**
+ * Syscall-count regression check for the crash record path
+ *
+ * A traced child runs what the signal handler does after electing itself
+ * owner: capture the stack from a context with each unwinder, build the
+ * record (crash_record_builder.h) and commit it to the journal. The parent
+ * stops it at every syscall (PTRACE_SYSCALL) between two marker getppid()
+ * calls and checks the list: the three pwrite()s of claim, body and seal
+ * in CAPTURE_MODE_FILE, and none at all in CAPTURE_MODE_MMAP. gettid() is
+ * not counted: glibc enters the kernel for it, bionic reads a cached value.
+ * Neither are the CFI walk's checks that a module's unwind table is still
+ * mapped (process_vm_readv), which are bounded instead: at most one per
+ * module per walk, in the CFI capture and in the _Unwind_Backtrace one,
+ * which falls back to CFI from a context it cannot reach.
+ */
+
+#include <elf.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "crash_journal.h"
+#include "crash_record_builder.h"
+#include "host_test.h"
+#include "stack_unwinder.h"
+
+#define SYSCALL_TEST_FRAMES 64
+
+// Recursion under the capture, so every unwinder has frames to walk
+#define SYSCALL_TEST_DEPTH 12
+
+static CrashJournal g_journal = { -1, nullptr, 0, 0, 0, 0, 0 };
+static char g_record_buffer[CRASH_JOURNAL_BODY_SIZE];
+
+// The handler's work once it owns the capture, without its fixed setup
+static void __attribute__((noinline)) crash_path(const ModuleMap* modules, pid_t pid, pid_t tid) {
+    // Stands in for the context the kernel hands the handler; glibc's getcontext() saves the signal mask
+    ucontext_t context;
+    getcontext(&context);
+
+    syscall(SYS_getppid);
+    for (int unwinder : { UNWINDER_FRAME_POINTER, UNWINDER_CFI, UNWINDER_UNWIND_BACKTRACE }) {
+        uintptr_t frames[SYSCALL_TEST_FRAMES];
+        UnwindMethod method = UNWIND_METHOD_NONE;
+        size_t count = capture_stack(&context, unwinder, modules, frames, SYSCALL_TEST_FRAMES, &method);
+
+        CrashJournalSlot slot;
+        if (!crash_journal_claim(&g_journal, &slot)) {
+            continue;
+        }
+        CrashRecordWriter writer;
+        record_writer_init(&writer, slot.mapped_body ? slot.mapped_body : g_record_buffer, g_journal.body_capacity);
+        CrashRecordHeader header;
+        crash_record_init_header(&header, SIGSEGV, SEGV_MAPERR, 0, pid, tid, time(nullptr), method);
+        crash_record_begin(&writer.fmt, &header);
+        CrashRecordModules referenced;
+        crash_record_modules_init(&referenced, modules);
+        crash_record_write_frames(&writer.fmt, &referenced, frames, count);
+        crash_record_write_referenced_modules(&writer.fmt, &referenced);
+        crash_record_finish(&writer.fmt);
+        crash_journal_commit(&g_journal, &slot, &writer);
+    }
+    syscall(SYS_getppid);
+}
+
+static void __attribute__((noinline)) recurse(int depth, const ModuleMap* modules, pid_t pid, pid_t tid) {
+    if (depth == 0) {
+        crash_path(modules, pid, tid);
+    } else {
+        recurse(depth - 1, modules, pid, tid);
+    }
+    __asm__ volatile("" ::: "memory");  // Not a tail call
+}
+
+static void traced_child(const char* path, bool mapped) {
+    stack_unwinder_init();
+    if (!crash_journal_open(&g_journal, path, CRASH_JOURNAL_SLOT_COUNT, CRASH_JOURNAL_BODY_SIZE, mapped)) {
+        _exit(2);
+    }
+    record_writer_reserve(g_record_buffer, sizeof(g_record_buffer));
+    pid_t pid = getpid();
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+
+    ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+    raise(SIGSTOP);
+    recurse(SYSCALL_TEST_DEPTH, module_map_begin_crash(), pid, tid);
+    _exit(0);
+}
+
+// Number of the syscall a child stopped at syscall entry is making; -1 if unknown
+static long syscall_number(pid_t child) {
+#if defined(__x86_64__)
+    struct user_regs_struct regs;
+    return ptrace(PTRACE_GETREGS, child, nullptr, &regs) == 0 ? (long)regs.orig_rax : -1;
+#elif defined(__aarch64__)
+    struct user_pt_regs regs;
+    struct iovec vec = { &regs, sizeof(regs) };
+    return ptrace(PTRACE_GETREGSET, child, (void*)NT_PRSTATUS, &vec) == 0 ? (long)regs.regs[8] : -1;
+#else
+    (void)child;
+    return -1;
+#endif
+}
+
+// Syscalls between the markers, less the unwind table checks counted in probes;
+// false if the child could not be traced
+static bool trace_crash_path(const char* path, bool mapped, std::vector<long>* calls, size_t* probes) {
+    pid_t child = fork();
+    if (child == 0) {
+        traced_child(path, mapped);
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) != child || !WIFSTOPPED(status)) {
+        return false;
+    }
+    ptrace(PTRACE_SETOPTIONS, child, nullptr, (void*)PTRACE_O_TRACESYSGOOD);
+
+    bool entry = true;      // Stops alternate between syscall entry and exit
+    int markers = 0;
+    while (ptrace(PTRACE_SYSCALL, child, nullptr, nullptr) == 0 && waitpid(child, &status, 0) == child) {
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            break;
+        }
+        if (WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+            continue;
+        }
+        if (entry) {
+            long number = syscall_number(child);
+            if (number == SYS_getppid) {
+                markers++;
+            } else if (markers == 1 && number == SYS_process_vm_readv) {
+                (*probes)++;
+            } else if (markers == 1 && number != SYS_gettid) {
+                calls->push_back(number);
+            }
+        }
+        entry = !entry;
+    }
+    return markers == 2 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static std::string syscall_list(const std::vector<long>& calls) {
+    std::string list;
+    for (long number : calls) {
+        list += (list.empty() ? "" : " ") + std::to_string(number);
+    }
+    return list.empty() ? "none" : list;
+}
+
+int main() {
+#if !defined(__x86_64__) && !defined(__aarch64__)
+    printf("crash_path_syscalls_test: syscall numbers not decoded on this architecture\n");
+    return HOST_TEST_SKIP;
+#endif
+
+    char dir[] = "/tmp/crash-syscalls-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const int records = 3;  // One per unwinder
+    const int cfi_walks = 2;
+    module_map_build();
+    size_t module_count = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE)->count;
+    for (bool mapped : { false, true }) {
+        std::string path = std::string(dir) + (mapped ? "/mapped.journal" : "/file.journal");
+        std::vector<long> calls;
+        size_t probes = 0;
+        bool traced = trace_crash_path(path.c_str(), mapped, &calls, &probes);
+        unlink(path.c_str());
+        if (!traced && calls.empty()) {
+            printf("crash_path_syscalls_test: ptrace is not permitted here\n");
+            rmdir(dir);
+            return HOST_TEST_SKIP;
+        }
+        CHECK(traced);
+
+        // Per record: pwrite() of the claimed slot header, of the body, of the sealed header
+        std::vector<long> expected;
+        if (!mapped) {
+            expected.assign(3 * records, SYS_pwrite64);
+        }
+        printf("crash_path_syscalls_test: %s mode, %d records: %s, %zu unwind table checks\n",
+               mapped ? "mmap" : "file", records, syscall_list(calls).c_str(), probes);
+        CHECK(calls == expected);
+        CHECK(probes > 0 && probes <= cfi_walks * module_count);
+    }
+    rmdir(dir);
+    return host_test_result("crash_path_syscalls_test");
+}
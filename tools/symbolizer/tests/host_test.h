@@ -0,0 +1,36 @@
+/**
+ * Minimal checks for the host tests of the native crash handler code
+ *
+ * Each test is its own executable, run by ctest: CHECK() reports the
+ * failing expression and keeps going, and host_test_result() turns the
+ * failures into the exit status. HOST_TEST_SKIP is the status ctest reports
+ * as skipped (SKIP_RETURN_CODE), for checks the host cannot run.
+ */
+
+#ifndef CRASHREPORTER_HOST_TEST_H
+#define CRASHREPORTER_HOST_TEST_H
+
+#include <stdio.h>
+
+#define HOST_TEST_SKIP 77
+
+static int g_host_test_failures = 0;
+
+#define CHECK(condition)                                                                 \
+    do {                                                                                 \
+        if (!(condition)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_host_test_failures++;                                                      \
+        }                                                                                \
+    } while (0)
+
+static inline int host_test_result(const char* name) {
+    if (g_host_test_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, g_host_test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif // CRASHREPORTER_HOST_TEST_H
@@ -0,0 +1,82 @@
+/**
+ * crash_record_modified_utf8(): record bytes as NewStringUTF() takes them
+ *
+ * Fixed cases first: ASCII and 2/3-byte characters unchanged, NUL as C0 80,
+ * a supplementary character as a surrogate pair, and malformed bytes (a
+ * name cut mid-character, overlongs, encoded surrogates, stray
+ * continuation bytes) as U+FFFD each, as json_escape() replaces them.
+ * Then random bytes, whose conversion must always be what CheckJNI
+ * accepts: no NUL byte, no 4-byte sequence, every continuation in place.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "crash_record_decoder.h"
+#include "host_test.h"
+
+#define MODIFIED_UTF8_RANDOM_STRINGS 20000
+#define MODIFIED_UTF8_RANDOM_LENGTH 24
+
+static bool converts_to(const std::string& bytes, const std::string& expected) {
+    std::string out = crash_record_modified_utf8(bytes);
+    if (out != expected) {
+        fprintf(stderr, "modified_utf8_test: %zu bytes converted to %zu, expected %zu\n", bytes.size(), out.size(),
+                expected.size());
+        return false;
+    }
+    return true;
+}
+
+// What CheckJNI's NewStringUTF() accepts: whole 1-3 byte sequences, no NUL byte
+static bool is_modified_utf8(const std::string& s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = (unsigned char)s[i];
+        size_t continuation = c < 0x80 ? 0 : (c & 0xe0) == 0xc0 ? 1 : (c & 0xf0) == 0xe0 ? 2 : 3;
+        if (c == 0 || continuation == 3 || i + continuation >= s.size()) {
+            return false;
+        }
+        for (size_t k = 1; k <= continuation; k++) {
+            if (((unsigned char)s[i + k] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        i += continuation + 1;
+    }
+    return true;
+}
+
+int main() {
+    const std::string replacement = "\xef\xbf\xbd";
+    CHECK(converts_to("RenderThread-3", "RenderThread-3"));
+    CHECK(converts_to("/data/app/~~x/lib/arm64/libg\xc3\xa4me.so", "/data/app/~~x/lib/arm64/libg\xc3\xa4me.so"));
+    CHECK(converts_to("\xe6\xb8\xb2\xe6\x9f\x93", "\xe6\xb8\xb2\xe6\x9f\x93"));
+    CHECK(converts_to(std::string("a\0b", 3), "a\xc0\x80" "b"));
+    CHECK(converts_to("\xf0\x9f\x98\x80", "\xed\xa0\xbd\xed\xb8\x80"));      // U+1F600
+    CHECK(converts_to("\xf4\x8f\xbf\xbf", "\xed\xaf\xbf\xed\xbf\xbf"));      // U+10FFFF
+    CHECK(converts_to("Render\xe6\xb8", "Render" + replacement + replacement));
+    CHECK(converts_to("\xc0\xaf", replacement + replacement));
+    CHECK(converts_to("\xed\xa0\x80", replacement + replacement + replacement));
+    CHECK(converts_to("\x80x\xff", replacement + "x" + replacement));
+    CHECK(converts_to("\xf4\x90\x80\x80", replacement + replacement + replacement + replacement));
+    CHECK(converts_to("", ""));
+
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+    int invalid = 0;
+    for (int n = 0; n < MODIFIED_UTF8_RANDOM_STRINGS; n++) {
+        std::string bytes(MODIFIED_UTF8_RANDOM_LENGTH, '\0');
+        for (char& byte : bytes) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            // Mostly high bytes, so sequences of every length come up
+            byte = (char)((seed >> 56) | ((seed >> 40) & 1 ? 0x80 : 0));
+        }
+        if (!is_modified_utf8(crash_record_modified_utf8(bytes))) {
+            invalid++;
+        }
+    }
+    CHECK(invalid == 0);
+    return host_test_result("modified_utf8_test");
+}
@@ -0,0 +1,48 @@
+/**
+ * Main thread stack bounds cached from another thread
+ *
+ * initialize() may run on any thread. The main thread's bounds must then
+ * come from its [stack] mapping, and match what pthread_getattr_np()
+ * reports on the main thread itself: exactly on bionic; glibc puts the top
+ * at the page above __libc_stack_end instead, below argv and the
+ * environment, and the bottom the same distance lower. Without cached
+ * bounds, a crash on the main thread gets none rather than a
+ * /proc/self/maps read in the handler.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "crash_context.h"
+#include "host_test.h"
+
+static void* cache_bounds(void* /* arg */) {
+    stack_bounds_cache_main_thread();
+    return nullptr;
+}
+
+int main() {
+    StackBounds expected;
+    CHECK(stack_bounds_of_current_thread(&expected));
+    uintptr_t sp = (uintptr_t)__builtin_frame_address(0);
+    StackBounds bounds = { 0, 0 };
+
+    // Not cached: no bounds for the main thread
+    CHECK(!crash_thread_stack_bounds(sp, &bounds));
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, nullptr, cache_bounds, nullptr) == 0);
+    pthread_join(thread, nullptr);
+    CHECK(g_main_thread_tid == getpid());
+    CHECK(crash_thread_stack_bounds(sp, &bounds));
+    uintptr_t above = bounds.hi - expected.hi;
+    CHECK(bounds.hi >= expected.hi && above < 64 * 4096);
+    CHECK(bounds.lo <= expected.lo + above && bounds.lo + above >= expected.lo);
+    if (g_host_test_failures) {
+        fprintf(stderr, "stack_bounds_test: [%#lx, %#lx) from the maps, [%#lx, %#lx) on the main thread\n",
+                (unsigned long)bounds.lo, (unsigned long)bounds.hi, (unsigned long)expected.lo,
+                (unsigned long)expected.hi);
+    }
+    return host_test_result("stack_bounds_test");
+}
@@ -0,0 +1,75 @@
+/**
+ * The CFI walk after a library left the module map stale
+ *
+ * A library is loaded, the map built, and the library unloaded without
+ * a rebuild: the state a crash sees between a dlclose() and the watcher's
+ * next tick. Its .eh_frame_hdr is no longer mapped, so the walk must treat
+ * the module as having no unwind table instead of faulting on it, while
+ * the modules still loaded keep theirs.
+ */
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cfi_unwinder.h"
+#include "host_test.h"
+
+// Index of the module whose path ends in name; -1 if it is not in the map
+static int find_module(const ModuleMap* map, const char* name) {
+    size_t name_length = strlen(name);
+    for (size_t i = 0; i < map->count; i++) {
+        const char* path = module_map_path(map, &map->modules[i]);
+        size_t length = strlen(path);
+        if (length >= name_length && strcmp(path + length - name_length, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int main() {
+    stack_bounds_cache_main_thread();
+    safe_memory_init();
+    const char* path = CRASHREPORTER_CORPUS_DIR "/lib/libcorpus_render.so";
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        fprintf(stderr, "stale_module_test: cannot load %s: %s\n", path, dlerror());
+        return 1;
+    }
+    module_map_build();
+    const ModuleMap* map = __atomic_load_n(&g_module_map, __ATOMIC_ACQUIRE);
+    int stale = find_module(map, "/libcorpus_render.so");
+    int loaded = module_map_find(map, (uintptr_t)&main);
+    CHECK(stale >= 0 && loaded >= 0 && map->modules[stale].has_eh_frame);
+    if (stale < 0 || loaded < 0) {
+        return host_test_result("stale_module_test");
+    }
+
+    memset(g_cfi_module_state, CFI_MODULE_UNCHECKED, sizeof(g_cfi_module_state));
+    CHECK(cfi_module_table(map, stale) == &map->modules[stale].eh_frame);
+
+    dlclose(library);
+    if (dlopen(path, RTLD_NOW | RTLD_NOLOAD)) {
+        printf("stale_module_test: the loader kept %s mapped\n", path);
+        return HOST_TEST_SKIP;
+    }
+    memset(g_cfi_module_state, CFI_MODULE_UNCHECKED, sizeof(g_cfi_module_state));
+    CHECK(cfi_module_table(map, stale) == nullptr);
+    CHECK(g_cfi_module_state[stale] == CFI_MODULE_STALE);
+    CHECK(cfi_module_table(map, loaded) == &map->modules[loaded].eh_frame);
+
+    // A pc in the unloaded range ends the walk there
+    ucontext_t context;
+    getcontext(&context);
+    UnwindRegisters regs;
+    StackBounds bounds;
+    CfiRegisters cfi;
+    CHECK(crash_context_registers(&context, &regs) && crash_thread_stack_bounds(regs.sp, &bounds) &&
+          cfi_registers_from_context(&context, &cfi));
+    cfi.pc = (uintptr_t)map->modules[stale].eh_frame.hdr;
+    bool exact_pc = true;
+    memset(g_cfi_module_state, CFI_MODULE_UNCHECKED, sizeof(g_cfi_module_state));
+    CHECK(!cfi_step(&cfi, &exact_pc, &bounds, map));
+    return host_test_result("stale_module_test");
+}
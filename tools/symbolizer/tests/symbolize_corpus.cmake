@@ -0,0 +1,29 @@
+# Symbolizes the recorded corpus (testdata/corpus) with crash-symbolizer and
+# compares the output with the expected text: each record on its own, then
+# all of them in one run, which shares the loaded libraries between records.
+#
+#   cmake -DSYMBOLIZER=BUILD/crash-symbolizer -DCORPUS=testdata/corpus -P symbolize_corpus.cmake
+
+file(GLOB records RELATIVE ${CORPUS} ${CORPUS}/records/*.ncrb)
+list(SORT records)
+if(NOT records)
+    message(FATAL_ERROR "No records in ${CORPUS}/records")
+endif()
+
+set(all_expected "")
+foreach(record ${records})
+    get_filename_component(name ${record} NAME_WE)
+    file(READ ${CORPUS}/expected/${name}.txt expected)
+    string(APPEND all_expected "${expected}")
+    execute_process(COMMAND ${SYMBOLIZER} --symbols lib ${record} WORKING_DIRECTORY ${CORPUS}
+                    OUTPUT_VARIABLE output RESULT_VARIABLE result)
+    if(NOT result EQUAL 0 OR NOT output STREQUAL expected)
+        message(SEND_ERROR "${record}: output differs from expected/${name}.txt:\n${output}")
+    endif()
+endforeach()
+
+execute_process(COMMAND ${SYMBOLIZER} --symbols lib ${records} WORKING_DIRECTORY ${CORPUS}
+                OUTPUT_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0 OR NOT output STREQUAL all_expected)
+    message(SEND_ERROR "All records in one run: output differs from the expected files:\n${output}")
+endif()
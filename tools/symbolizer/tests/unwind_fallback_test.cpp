@@ -0,0 +1,69 @@
+/**
+ * capture_stack_from_context() when _Unwind_Backtrace never reaches the fault
+ *
+ * A context taken with getcontext() in a recursion's deepest call stands in
+ * for a signal frame the system unwinder cannot cross: _Unwind_Backtrace
+ * walks only the capturing frames, whose pcs never match the context's.
+ * The trace must then come from the context itself, through the CFI walk,
+ * with none of the capturing frames in it. Built with
+ * -fno-omit-frame-pointer so the frame-pointer walk can be compared too.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <ucontext.h>
+
+#include "host_test.h"
+#include "stack_unwinder.h"
+
+#define FALLBACK_TEST_DEPTH 16
+#define FALLBACK_TEST_FRAMES 64
+
+static void __attribute__((noinline)) check_fallback(const ModuleMap* modules) {
+    ucontext_t context;
+    getcontext(&context);
+
+    uintptr_t frames[FALLBACK_TEST_FRAMES];
+    UnwindMethod method = UNWIND_METHOD_NONE;
+    size_t count = capture_stack_from_context(&context, modules, frames, FALLBACK_TEST_FRAMES, &method);
+
+    UnwindRegisters regs;
+    StackBounds bounds;
+    CHECK(crash_context_registers(&context, &regs) && crash_thread_stack_bounds(regs.sp, &bounds));
+    uintptr_t expected[FALLBACK_TEST_FRAMES];
+    size_t expected_count = unwind_cfi(&context, &bounds, modules, expected, FALLBACK_TEST_FRAMES);
+    uintptr_t walked[FALLBACK_TEST_FRAMES];
+    size_t walked_count = unwind_frame_pointers(&regs, &bounds, walked, FALLBACK_TEST_FRAMES);
+
+    CHECK(method == UNWIND_METHOD_CFI);
+    CHECK(count == expected_count && count > FALLBACK_TEST_DEPTH);
+    CHECK(count > 0 && frames[0] == regs.pc);
+    for (size_t i = 0; i < count && i < expected_count; i++) {
+        CHECK(frames[i] == expected[i]);
+    }
+    // The recursion's frames, as the frame-pointer walk sees them
+    CHECK(walked_count > FALLBACK_TEST_DEPTH);
+    for (size_t i = 0; i <= FALLBACK_TEST_DEPTH && i < count && i < walked_count; i++) {
+        CHECK(frames[i] == walked[i]);
+    }
+
+    // Too little room for a useful walk still yields the registers' frames
+    method = UNWIND_METHOD_NONE;
+    CHECK(capture_stack_from_context(&context, modules, frames, 1, &method) == 1);
+    CHECK(frames[0] == regs.pc);
+}
+
+static void __attribute__((noinline)) recurse(int depth, const ModuleMap* modules) {
+    if (depth == 0) {
+        check_fallback(modules);
+    } else {
+        recurse(depth - 1, modules);
+    }
+    __asm__ volatile("" ::: "memory");  // Not a tail call
+}
+
+int main() {
+    stack_unwinder_init();
+    recurse(FALLBACK_TEST_DEPTH, module_map_begin_crash());
+    return host_test_result("unwind_fallback_test");
+}